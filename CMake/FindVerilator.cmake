@@ -19,6 +19,18 @@ find_file(VERILATED_VCD_CPP verilated_vcd_c.cpp
 find_file(VERILATED_DPI_CPP verilated_dpi.cpp
           HINTS /usr/share/verilator/include
           /usr/local/share/verilator/include)
+find_file(VERILATED_SAVE_CPP verilated_save.cpp
+          HINTS /usr/share/verilator/include
+          /usr/local/share/verilator/include)
+find_file(VERILATED_FST_CPP verilated_fst_c.cpp
+          HINTS /usr/share/verilator/include
+          /usr/local/share/verilator/include)
+find_path(VERILATOR_GTKWAVE_DIR fstapi.c
+          HINTS /usr/share/verilator/include/gtkwave
+          /usr/local/share/verilator/include/gtkwave)
+find_file(VERILATED_THREADS_CPP verilated_threads.cpp
+          HINTS /usr/share/verilator/include
+          /usr/local/share/verilator/include)
 
 if (VERILATOR_INCLUDE_DIR AND EXISTS "${VERILATOR_INCLUDE_DIR}/verilated_config.h")
     file(STRINGS "${VERILATOR_INCLUDE_DIR}/verilated_config.h" VERILATOR_VERSION_STRING_LINE REGEX "^#define[ \t]+VERILATOR_VERSION[ \t]+\".*\"$")
@@ -26,7 +38,7 @@ if (VERILATOR_INCLUDE_DIR AND EXISTS "${VERILATOR_INCLUDE_DIR}/verilated_config.
 endif ()
 
 set(VERILATOR_INCLUDE_DIRS ${VERILATOR_INCLUDE_DIR} ${VERILATOR_VPI_INCLUDE_DIR} ${VERILATOR_VCD_INCLUDE_DIR})
-set(VERILATOR_LIB_SOURCES ${VERILATED_CPP} ${VERILATED_COV_CPP} ${VERILATED_VCD_CPP} ${VERILATED_DPI_CPP})
+set(VERILATOR_LIB_SOURCES ${VERILATED_CPP} ${VERILATED_COV_CPP} ${VERILATED_VCD_CPP} ${VERILATED_DPI_CPP} ${VERILATED_SAVE_CPP})
 
 include(FindPackageHandleStandardArgs)
 
@@ -9,13 +9,29 @@ if(CMAKE_BUILD_TYPE STREQUAL "Coverage")
     set(CMAKE_CXX_FLAGS_COVERAGE "${CMAKE_CXX_FLAGS_COVERAGE} -DVM_COVERAGE=1")
 endif()
 
-if(CMAKE_BUILD_TYPE STREQUAL "Debug")
+# Tracing is always built in and enabled at runtime.
+if(S80X86_TRACE_FST)
+    if(VERILATOR_VERSION_STRING VERSION_LESS 4.0)
+        message(FATAL_ERROR "FST tracing requires Verilator 4.0 or later")
+    endif()
+    set(VERILATOR_TRACE_FLAGS --trace-fst --trace-underscore)
+else()
     set(VERILATOR_TRACE_FLAGS --trace --trace-underscore)
 endif()
 
+# The runtime and every model must agree on VL_THREADED, so once any model is
+# multithreaded all of them are built with --threads, defaulting to one.
+if(VERILATOR_THREADS GREATER 0)
+    if(VERILATOR_VERSION_STRING VERSION_LESS 4.0)
+        message(FATAL_ERROR "VERILATOR_THREADS requires Verilator 4.0 or later")
+    endif()
+    find_package(Threads REQUIRED)
+    add_definitions(-DVL_THREADED=1)
+endif()
+
 function(verilate)
     set(options "")
-    set(oneValueArgs TOPLEVEL)
+    set(oneValueArgs TOPLEVEL THREADS SAVABLE)
     set(multiValueArgs VERILOG_SOURCES GENERATED_SOURCES DEPENDS)
     cmake_parse_arguments(verilate "${options}" "${oneValueArgs}" "${multiValueArgs}" ${ARGN})
     set(generated
@@ -23,11 +39,21 @@ function(verilate)
         ${CMAKE_CURRENT_BINARY_DIR}/V${verilate_TOPLEVEL}.h
         ${CMAKE_CURRENT_BINARY_DIR}/V${verilate_TOPLEVEL}__Syms.cpp
         ${CMAKE_CURRENT_BINARY_DIR}/V${verilate_TOPLEVEL}__Syms.h)
+    list(APPEND generated
+         ${CMAKE_CURRENT_BINARY_DIR}/V${verilate_TOPLEVEL}__Trace.cpp
+         ${CMAKE_CURRENT_BINARY_DIR}/V${verilate_TOPLEVEL}__Trace__Slow.cpp)
     list(APPEND generated ${verilate_GENERATED_SOURCES})
-    if(CMAKE_BUILD_TYPE STREQUAL "Debug")
-        list(APPEND generated
-             ${CMAKE_CURRENT_BINARY_DIR}/V${verilate_TOPLEVEL}__Trace.cpp
-             ${CMAKE_CURRENT_BINARY_DIR}/V${verilate_TOPLEVEL}__Trace__Slow.cpp)
+    set(thread_flags)
+    if(VERILATOR_THREADS GREATER 0)
+        if(verilate_THREADS)
+            set(thread_flags --threads ${verilate_THREADS})
+        else()
+            set(thread_flags --threads 1)
+        endif()
+    endif()
+    set(savable_flags)
+    if(verilate_SAVABLE)
+        set(savable_flags --savable)
     endif()
     foreach(source ${verilate_VERILOG_SOURCES})
         get_source_file_property(res ${source} COMPILE_FLAGS)
@@ -50,6 +76,7 @@ function(verilate)
                             -I${CMAKE_CURRENT_SOURCE_DIR}
                             -I${CMAKE_CURRENT_BINARY_DIR}
                             ${VERILATOR_TRACE_FLAGS} ${VERILATOR_COVERAGE_FLAGS}
+                            ${thread_flags} ${savable_flags}
                             ${extra_compile_flags} --cc --top-module ${verilate_TOPLEVEL}
                             --Mdir ${CMAKE_CURRENT_BINARY_DIR}
                             ${VERILATOR_INCLUDE_ARGS}
@@ -18,6 +18,7 @@
 #include "config.h"
 #include "bda.h"
 #include "bios.h"
+#include "disk.h"
 #include "display.h"
 #include "sd.h"
 #include "io.h"
@@ -205,5 +206,6 @@ void root(void)
     mouse_hw_init();
 
     sd_init();
+    disk_init();
     sd_boot();
 }
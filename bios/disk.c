@@ -16,6 +16,7 @@
 // along with s80x86.  If not, see <http://www.gnu.org/licenses/>.
 
 #include "bios.h"
+#include "disk.h"
 #include "sd.h"
 #include "io.h"
 #include "leds.h"
@@ -29,6 +30,86 @@
 
 #define FLOPPY_TIMEOUT 0x80
 
+#ifdef PV_DISK
+/*
+ * Simulator only paravirtual disk, the device copies sectors directly
+ * between the disk image and memory.
+ */
+#define PV_DISK_ID_PORT 0xffd0
+#define PV_DISK_COMMAND_PORT 0xffd0
+#define PV_DISK_STATUS_PORT 0xffd2
+#define PV_DISK_LBA_LOW_PORT 0xffd4
+#define PV_DISK_LBA_HIGH_PORT 0xffd6
+#define PV_DISK_COUNT_PORT 0xffd8
+#define PV_DISK_SEGMENT_PORT 0xffda
+#define PV_DISK_OFFSET_PORT 0xffdc
+
+#define PV_DISK_ID 0x5056
+#define PV_DISK_CMD_READ 0x1
+#define PV_DISK_CMD_WRITE 0x2
+#define PV_DISK_STATUS_DONE (1 << 0)
+#define PV_DISK_STATUS_ERROR (1 << 1)
+
+static char pv_disk_present;
+
+static unsigned short pv_disk_transfer(unsigned short command,
+                                       unsigned long lba,
+                                       unsigned short count,
+                                       unsigned short seg,
+                                       unsigned short offs)
+{
+    unsigned short status;
+
+    outw(PV_DISK_LBA_LOW_PORT, lba & 0xffff);
+    outw(PV_DISK_LBA_HIGH_PORT, lba >> 16);
+    outw(PV_DISK_COUNT_PORT, count);
+    outw(PV_DISK_SEGMENT_PORT, seg);
+    outw(PV_DISK_OFFSET_PORT, offs);
+    outw(PV_DISK_COMMAND_PORT, command);
+
+    do {
+        status = inw(PV_DISK_STATUS_PORT);
+    } while (!(status & PV_DISK_STATUS_DONE));
+
+    return status & PV_DISK_STATUS_ERROR ? 0 : count;
+}
+#endif // PV_DISK
+
+static unsigned short disk_read_sectors(unsigned long lba,
+                                        unsigned short count,
+                                        unsigned short seg,
+                                        unsigned short offs)
+{
+#ifdef PV_DISK
+    if (pv_disk_present)
+        return pv_disk_transfer(PV_DISK_CMD_READ, lba, count, seg, offs);
+#endif // PV_DISK
+
+    return read_sectors(lba, count, seg, offs);
+}
+
+static unsigned short disk_write_sectors(unsigned long lba,
+                                         unsigned short count,
+                                         unsigned short seg,
+                                         unsigned short offs)
+{
+#ifdef PV_DISK
+    if (pv_disk_present)
+        return pv_disk_transfer(PV_DISK_CMD_WRITE, lba, count, seg, offs);
+#endif // PV_DISK
+
+    return write_sectors(lba, count, seg, offs);
+}
+
+void disk_init(void)
+{
+#ifdef PV_DISK
+    pv_disk_present = inw(PV_DISK_ID_PORT) == PV_DISK_ID;
+    if (pv_disk_present)
+        putstr("Paravirtual disk present\n");
+#endif // PV_DISK
+}
+
 static void set_disk_status(struct callregs *regs, unsigned char err)
 {
     if (err)
@@ -52,19 +133,11 @@ static void disk_read(struct callregs *regs)
     unsigned long sector = regs->cx.l & 0x3f;
     unsigned long lba =
         (cylinder * NUM_HEADS + head) * SECTORS_PER_TRACK + (sector - 1);
-    unsigned short i;
     unsigned short dst = regs->bx.x;
     unsigned short count = regs->ax.l;
 
-    regs->ax.l = 0;
     regs->flags &= ~CF;
-
-    for (i = 0; i < count; ++i) {
-        read_sector(lba, regs->es, dst);
-        ++lba;
-        dst += SECTOR_SIZE;
-        ++regs->ax.l;
-    }
+    regs->ax.l = disk_read_sectors(lba, count, regs->es, dst);
 
     set_disk_status(regs, regs->ax.l != count ? 0xff : 0x00);
 }
@@ -82,22 +155,11 @@ static void disk_write(struct callregs *regs)
     unsigned long sector = regs->cx.l & 0x3f;
     unsigned long lba =
         (cylinder * NUM_HEADS + head) * SECTORS_PER_TRACK + (sector - 1);
-    unsigned short i;
     unsigned short dst = regs->bx.x;
     unsigned short count = regs->ax.l;
 
-    regs->ax.l = 0;
     regs->flags &= ~CF;
-
-    for (i = 0; i < count; ++i) {
-        if (write_sector(lba, regs->es, dst)) {
-            regs->flags |= CF;
-            break;
-        }
-        ++lba;
-        dst += SECTOR_SIZE;
-        ++regs->ax.l;
-    }
+    regs->ax.l = disk_write_sectors(lba, count, regs->es, dst);
 
     set_disk_status(regs, regs->ax.l != count ? 0xff : 0x00);
 }
@@ -404,6 +404,191 @@ int read_sector(unsigned long sector, unsigned short dseg, unsigned short daddr)
     return 0;
 }
 
+static unsigned char noinline spi_xfer_byte(unsigned char v)
+{
+    outw(SPI_TRANSFER_PORT, v);
+    spi_wait_idle();
+
+    return inw(SPI_TRANSFER_PORT) & 0xff;
+}
+
+static unsigned char noinline sd_poll_not_ff(unsigned int max_bytes)
+{
+    unsigned char v = 0xff;
+    unsigned int m;
+
+    for (m = 0; m < max_bytes && v == 0xff; ++m)
+        v = spi_xfer_byte(0xff);
+
+    return v;
+}
+
+static int noinline sd_wait_not_busy(void)
+{
+    unsigned int m;
+
+    for (m = 0; m < 32768; ++m)
+        if (spi_xfer_byte(0xff) == 0xff)
+            return 0;
+
+    return -1;
+}
+
+/*
+ * Send a command without clocking out a fixed length response so that the
+ * data following R1 in a multiple block transfer isn't consumed.
+ */
+static unsigned char noinline sd_command_r1(unsigned char cmd,
+                                            unsigned long address)
+{
+    // Fast clock, CS enabled.
+    outw(SPI_CONTROL_PORT, 0x1);
+
+    spi_xfer_byte(0xff);
+    spi_xfer_byte(cmd);
+    spi_xfer_byte((address >> 24) & 0xff);
+    spi_xfer_byte((address >> 16) & 0xff);
+    spi_xfer_byte((address >> 8) & 0xff);
+    spi_xfer_byte((address >> 0) & 0xff);
+    spi_xfer_byte(0x01); // CRC + end bit
+
+    return sd_poll_not_ff(SD_NCR + 1);
+}
+
+static int noinline sd_stop_transmission(void)
+{
+    unsigned char r1;
+
+    outw(SPI_CONTROL_PORT, 0x1);
+
+    spi_xfer_byte(0x4c);
+    spi_xfer_byte(0x00);
+    spi_xfer_byte(0x00);
+    spi_xfer_byte(0x00);
+    spi_xfer_byte(0x00);
+    spi_xfer_byte(0x61);
+    // Stuff byte, may still be data.
+    spi_xfer_byte(0xff);
+
+    r1 = sd_poll_not_ff(SD_NCR + 1);
+    if (sd_wait_not_busy())
+        return -1;
+
+    return r1 & R1_ERROR_MASK;
+}
+
+static void noinline spi_receive(int len)
+{
+    int m;
+
+    for (m = 0; m < len; ++m) {
+        outw(SPI_TRANSFER_PORT, 0xff);
+        spi_wait_idle();
+        spi_xfer_buf[m] = inw(SPI_TRANSFER_PORT) & 0xff;
+    }
+}
+
+static void noinline spi_transmit(int len)
+{
+    int m;
+
+    for (m = 0; m < len; ++m)
+        spi_xfer_byte(spi_xfer_buf[m]);
+}
+
+static unsigned long sd_address(unsigned long sector)
+{
+    return sd_is_sdhc ? sector : sector * 512LU;
+}
+
+/*
+ * Read count sectors with a single READ_MULTIPLE_BLOCK command, returning the
+ * number of sectors successfully read.
+ */
+unsigned short read_sectors(unsigned long sector,
+                            unsigned short count,
+                            unsigned short dseg,
+                            unsigned short daddr)
+{
+    unsigned short i;
+
+    if (count == 0)
+        return 0;
+    if (count == 1)
+        return read_sector(sector, dseg, daddr) ? 0 : 1;
+
+    mouse_suspend();
+    if (sd_command_r1(0x52, sd_address(sector)) & R1_ERROR_MASK) {
+        putstr("Read sectors failed\n");
+        mouse_resume();
+        return 0;
+    }
+
+    for (i = 0; i < count; ++i) {
+        if (sd_poll_not_ff(MAX_DATA_START_OFFS) != DATA_START_TOKEN) {
+            putstr("No data start token\n");
+            break;
+        }
+
+        /* data, CRC16 */
+        spi_receive(BLOCK_SIZE + 2);
+        memcpy_seg(dseg, (void *)daddr, get_cs(), spi_xfer_buf, BLOCK_SIZE);
+        daddr += BLOCK_SIZE;
+    }
+
+    if (sd_stop_transmission())
+        i = 0;
+    mouse_resume();
+
+    return i;
+}
+
+/*
+ * Write count sectors with a single WRITE_MULTIPLE_BLOCK command, returning
+ * the number of sectors successfully written.
+ */
+unsigned short write_sectors(unsigned long sector,
+                             unsigned short count,
+                             unsigned short sseg,
+                             unsigned short saddr)
+{
+    unsigned short i;
+
+    if (count == 0)
+        return 0;
+    if (count == 1)
+        return write_sector(sector, sseg, saddr) ? 0 : 1;
+
+    mouse_suspend();
+    if (sd_command_r1(0x59, sd_address(sector)) & R1_ERROR_MASK) {
+        mouse_resume();
+        return 0;
+    }
+
+    for (i = 0; i < count; ++i) {
+        spi_xfer_buf_set(0, 0xff); // Gap
+        spi_xfer_buf_set(1, 0xfc); // Multiple block data start token
+        memcpy_seg(get_cs(), spi_xfer_buf + 2, sseg, (const void *)saddr,
+                   BLOCK_SIZE);
+        spi_xfer_buf_set(2 + BLOCK_SIZE, 0x0); // CRC1
+        spi_xfer_buf_set(3 + BLOCK_SIZE, 0x0); // CRC2
+        spi_transmit(4 + BLOCK_SIZE);
+
+        if (!write_received(sd_poll_not_ff(SD_NCR)) || sd_wait_not_busy())
+            break;
+        saddr += BLOCK_SIZE;
+    }
+
+    // Stop tran token, then one byte before the card signals busy.
+    spi_xfer_byte(0xfd);
+    spi_xfer_byte(0xff);
+    if (sd_wait_not_busy())
+        i = 0;
+    mouse_resume();
+
+    return i;
+}
+
 void sd_init(void)
 {
     sd_send_initial_clock();
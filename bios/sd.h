@@ -25,3 +25,11 @@ int read_sector(unsigned long sector,
 int write_sector(unsigned long sector,
                  unsigned short sseg,
                  unsigned short saddr);
+unsigned short read_sectors(unsigned long sector,
+                            unsigned short count,
+                            unsigned short dseg,
+                            unsigned short daddr);
+unsigned short write_sectors(unsigned long sector,
+                             unsigned short count,
+                             unsigned short sseg,
+                             unsigned short saddr);
@@ -33,7 +33,10 @@ module BlockRam(input logic clk,
 parameter words = 8;
 localparam addr_bits = $clog2(words);
 
+// The simulator's cache backdoor writes the RAM directly.
+// verilator lint_off BLKANDNBLK
 logic [1:0][7:0] ram[0:words-1] /* synthesis syn_ramstyle = "no_rw_check"*/;
+// verilator lint_on BLKANDNBLK
 
 logic [15:0] r_a, r_b, bypass_a_val, bypass_b_val;
 logic bypass_a, bypass_b;
@@ -201,4 +201,36 @@ always_ff @(posedge clk) begin
         fill_line();
 end
 
+`ifdef verilator
+// Backdoor access for the simulator, which writes memory directly and needs
+// any cached copy of the byte to be kept coherent.
+export "DPI-C" function cache_busy;
+
+function int cache_busy;
+    cache_busy = {31'b0, busy | flushing | updating};
+endfunction
+
+function bit cache_holds(input int addr);
+    cache_holds = ValidRam.ram[addr[index_end:index_start]] == 1'b1 &&
+        TagRam.ram[addr[index_end:index_start]] == addr[19:tag_start];
+endfunction
+
+export "DPI-C" function cache_read_byte;
+
+// The cached byte at addr, or -1 if it isn't cached.
+function int cache_read_byte(input int addr);
+    if (cache_holds(addr))
+        cache_read_byte = {24'b0, LineRAM.ram[addr[index_end:1]][addr[0]]};
+    else
+        cache_read_byte = -1;
+endfunction
+
+export "DPI-C" function cache_write_byte;
+
+function void cache_write_byte(input int addr, input int val);
+    if (cache_holds(addr))
+        LineRAM.ram[addr[index_end:1]][addr[0]] = val[7:0];
+endfunction
+`endif
+
 endmodule
@@ -18,6 +18,7 @@
 #include <boost/python.hpp>
 #include <boost/version.hpp>
 
+#include "Disassembler.h"
 #include "RegisterFile.h"
 #include "RTLCPU.h"
 #include "SoftwareCPU.h"
@@ -55,8 +56,24 @@ void write_vector16(T *c,
     c->write_vector16(segment, addr, vec);
 }
 
+// Returns a (length, text) tuple for the instruction at the start of bytes.
+boost::python::tuple py_disassemble(boost::python::list bytes, uint16_t ip)
+{
+    std::vector<uint8_t> vec;
+
+    for (auto i = 0; i < boost::python::len(bytes); ++i)
+        vec.push_back(boost::python::extract<uint8_t>(bytes[i]));
+
+    std::string text;
+    auto length = disassemble(vec.data(), vec.size(), ip, &text);
+
+    return boost::python::make_tuple(length, text);
+}
+
 BOOST_PYTHON_MODULE(Cpu)
 {
+    def("disassemble", &py_disassemble);
+    def("enable_waveforms", &enable_waveforms);
     class_<SoftwareCPU, boost::noncopyable>("Sim", init<const std::string &>())
         .def("reset", &SoftwareCPU::reset)
         .def("write_reg", &SoftwareCPU::write_reg)
@@ -98,7 +115,13 @@ BOOST_PYTHON_MODULE(Cpu)
         .def("step", &rtlcpu::step)
         .def("idle", &rtlcpu::idle)
         .def("time_step", &rtlcpu::time_step)
-        .def("has_trapped", &rtlcpu::has_trapped);
+        .def("has_trapped", &rtlcpu::has_trapped)
+        .def("start_waveform", &rtlcpu::start_waveform)
+        .def("stop_waveform", &rtlcpu::stop_waveform)
+        .def("waveform_window", &rtlcpu::waveform_window)
+        .def("start_microcode_profile", &rtlcpu::start_microcode_profile)
+        .def("write_microcode_profile", &rtlcpu::write_microcode_profile)
+        .def("cycle_count", &rtlcpu::cycle_count);
     class_<JTAGCPU, boost::noncopyable>("JTAGCPU", init<const std::string &>())
         .def("reset", &JTAGCPU::reset)
         .def("write_reg", &JTAGCPU::write_reg)
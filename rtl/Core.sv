@@ -164,7 +164,6 @@ assign mar_wr_val = mar_wr_sel == MARWrSel_EA ?
 wire [`MC_ALUOp_t_BITS-1:0] alu_op;
 wire [31:0] alu_out;
 wire [15:0] alu_flags_out;
-wire alu_busy;
 
 // Microcode
 wire [2:0] microcode_reg_rd_sel[2];
@@ -201,7 +200,7 @@ wire next_microinstruction;
 // Misc control signals
 wire debug_set_ip = debug_stopped && ip_wr_en;
 wire do_next_instruction = (next_instruction & ~do_stall) | debug_set_ip;
-wire do_stall = loadstore_busy | divide_busy | alu_busy;
+wire do_stall = loadstore_busy | divide_busy;
 wire start_interrupt;
 
 // IP
@@ -499,8 +498,7 @@ ALU             ALU(.a(a_bus),
                     .flags_in(flags),
                     .flags_out(alu_flags_out),
                     .multibit_shift(multibit_shift),
-                    .shift_count(tmp_val[4:0]),
-                    .busy(alu_busy));
+                    .shift_count(tmp_val[4:0]));
 
 Divider         Divider(.clk(clk),
                         .reset(reset),
@@ -531,6 +529,40 @@ function int get_and_clear_instr_length;
     instr_length = 0;
 endfunction
 
+// Values written to TEMP by the microcode, the read all registers debug
+// procedure passes each register through TEMP in turn.
+reg [15:0] tmp_log[16];
+// verilator lint_off BLKANDNBLK
+int tmp_log_len;
+// verilator lint_on BLKANDNBLK
+
+always @(posedge clk)
+    if (microcode_tmp_wr_en && tmp_log_len < 16) begin
+        tmp_log[tmp_log_len[3:0]] <= tmp_wr_val;
+        tmp_log_len <= tmp_log_len + 1;
+    end
+
+export "DPI-C" function clear_tmp_log;
+
+function void clear_tmp_log;
+    tmp_log_len = 0;
+endfunction
+
+export "DPI-C" function get_tmp_log;
+
+function int get_tmp_log(input int idx);
+    get_tmp_log = {16'b0, tmp_log[idx[3:0]]};
+endfunction
+
+// Sampled each cycle by the microcode profiler to attribute stalls to the
+// current instruction.
+export "DPI-C" function get_profile_state;
+
+function int get_profile_state;
+    get_profile_state = {21'b0, instruction_fifo_rd_en, divide_busy,
+                         loadstore_busy, opcode};
+endfunction
+
 `endif
 
 endmodule
@@ -16,31 +16,38 @@
 // along with s80x86.  If not, see <http://www.gnu.org/licenses/>.
 
 task do_rcr;
-    output [31:0] out;
+    output [15:0] out;
     input is_8_bit;
     input [15:0] a;
-    input [4:0] shift_count;
+    input [4:0] count;
     input [15:0] flags_in;
     output [15:0] flags_out;
-    output busy;
-    input multibit_shift;
+
+    reg [4:0] rotate;
 
     begin
         flags_out = flags_in;
-        out = {11'b0, shift_count, a};
+        out = a;
 
-        if (|shift_count || !multibit_shift) begin
-            if (!is_8_bit)
-                {out[15:0], flags_out[CF_IDX]} = {flags_out[CF_IDX], a[15:0]};
-            else
-                {out[7:0], flags_out[CF_IDX]} = {flags_out[CF_IDX], a[7:0]};
+        // The carry flag is rotated with the operand so the rotation is
+        // modulo 9 or 17.
+        if (|count) begin
+            if (!is_8_bit) begin
+                rotate = count >= 5'd17 ? count - 5'd17 : count;
+                {flags_out[CF_IDX], out[15:0]} =
+                    ({flags_in[CF_IDX], a} >> rotate) |
+                    ({flags_in[CF_IDX], a} << (5'd17 - rotate));
+            end else begin
+                rotate = count >= 5'd27 ? count - 5'd27 :
+                    count >= 5'd18 ? count - 5'd18 :
+                    count >= 5'd9 ? count - 5'd9 : count;
+                {flags_out[CF_IDX], out[7:0]} =
+                    ({flags_in[CF_IDX], a[7:0]} >> rotate) |
+                    ({flags_in[CF_IDX], a[7:0]} << (5'd9 - rotate));
+            end
             flags_out[OF_IDX] = is_8_bit ? a[7] ^ flags_in[CF_IDX] :
                 a[15] ^ flags_in[CF_IDX];
             shift_flags(flags_out, is_8_bit, out[15:0], a);
-
-            out[31:16] = {11'b0, shift_count - 1'b1};
         end
-
-        busy = multibit_shift && |out[20:16];
     end
 endtask
@@ -24,6 +24,7 @@
 #include "CPU.h"
 #include "Cursor.h"
 #include "Display.h"
+#include "FrameCapture.h"
 
 static const GraphicsPalette cga_alt_palette = {{
     {0, 0, 0},          // black
@@ -382,7 +383,26 @@ public:
         return 0;
     }
 
+    // The retrace bits in the status register toggle as it is polled.
+    bool read_is_volatile(uint16_t port_num, unsigned offs) const
+    {
+        return (port_num == 6 || port_num == 0x26) && offs == 0;
+    }
+
     void update();
+    void capture(FrameCapture *capture, unsigned long cycle);
+    unsigned frame_width() const
+    {
+        return display.get_width();
+    }
+    unsigned frame_height() const
+    {
+        return display.get_height();
+    }
+    void set_status(const std::string &status)
+    {
+        display.set_status(status);
+    }
 
 private:
     Cursor get_cursor() const
@@ -444,9 +464,10 @@ private:
         return status;
     }
 
-    void update_text();
-    void update_graphics();
-    void update_graphics_256();
+    void load_display();
+    void load_text();
+    void load_graphics();
+    void load_graphics_256();
 
     Memory *mem;
     Display display;
@@ -480,19 +501,41 @@ private:
     }
 };
 
-void CGA::update()
+void CGA::load_display()
 {
     display.set_graphics(is_graphics());
 
     if (is_graphics_256())
-        update_graphics_256();
+        load_graphics_256();
     else if (is_graphics())
-        update_graphics();
+        load_graphics();
     else
-        update_text();
+        load_text();
 }
 
-void CGA::update_graphics()
+void CGA::update()
+{
+    load_display();
+
+    if (is_graphics())
+        display.refresh();
+    else
+        display.refresh(get_cursor());
+}
+
+void CGA::capture(FrameCapture *capture, unsigned long cycle)
+{
+    load_display();
+
+    if (is_graphics())
+        display.render();
+    else
+        display.render(get_cursor());
+
+    capture->submit(cycle, display.get_framebuffer());
+}
+
+void CGA::load_graphics()
 {
     int cols = 320;
     int rows = 200;
@@ -514,11 +557,9 @@ void CGA::update_graphics()
             display.set_pixel(row, col, pixel);
         }
     }
-
-    display.refresh();
 }
 
-void CGA::update_graphics_256()
+void CGA::load_graphics_256()
 {
     int cols = 320;
     int rows = 200;
@@ -531,11 +572,9 @@ void CGA::update_graphics_256()
             display.set_pixel(row, col, pixel);
         }
     }
-
-    display.refresh();
 }
 
-void CGA::update_text()
+void CGA::load_text()
 {
     int cols = 80;
     int rows = 25;
@@ -549,6 +588,4 @@ void CGA::update_text()
             display.write_char(char_attr);
         }
     }
-
-    display.refresh(get_cursor());
 }
@@ -0,0 +1,135 @@
+// Copyright Jamie Iles, 2017
+//
+// This file is part of s80x86.
+//
+// s80x86 is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// s80x86 is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with s80x86.  If not, see <http://www.gnu.org/licenses/>.
+
+#include "CacheModel.h"
+
+#include <boost/format.hpp>
+#include <sstream>
+#include <stdexcept>
+
+static bool is_power_of_2(size_t v)
+{
+    return v > 0 && (v & (v - 1)) == 0;
+}
+
+CacheConfig::CacheConfig(const std::string &spec) : CacheConfig()
+{
+    std::istringstream fields(spec);
+    std::string field;
+
+    while (std::getline(fields, field, ',')) {
+        auto eq = field.find('=');
+        auto key = field.substr(0, eq);
+        auto value = eq == std::string::npos ? "" : field.substr(eq + 1);
+
+        try {
+            if (key == "size")
+                size = std::stoul(value);
+            else if (key == "line")
+                line_size = std::stoul(value);
+            else if (key == "ways")
+                ways = std::stoul(value);
+            else if (key == "policy" && (value == "wb" || value == "wt"))
+                write_back = value == "wb";
+            else if (!field.empty())
+                throw std::invalid_argument(key);
+        } catch (std::logic_error &) {
+            throw std::invalid_argument("invalid cache field \"" + field +
+                                        "\"");
+        }
+    }
+
+    if (!is_power_of_2(size) || !is_power_of_2(line_size) ||
+        !is_power_of_2(ways) || line_size < 2 ||
+        size < static_cast<size_t>(line_size) * ways)
+        throw std::invalid_argument("invalid cache configuration \"" + spec +
+                                    "\"");
+}
+
+std::string CacheConfig::name() const
+{
+    auto size_name = size >= 1024 ? std::to_string(size / 1024) + "K"
+                                  : std::to_string(size);
+
+    return (boost::format("%s/%uB/%u-way/%s") % size_name % line_size % ways %
+            (write_back ? "wb" : "wt"))
+        .str();
+}
+
+CacheModel::CacheModel(const CacheConfig &config, unsigned word_cycles)
+    : cfg(config),
+      word_cycles(word_cycles),
+      line_bits(0),
+      num_sets(config.size / config.line_size / config.ways),
+      lines(config.size / config.line_size, Line{false, false, 0, 0}),
+      use_count(0),
+      cache_stats()
+{
+    while ((1U << line_bits) < cfg.line_size)
+        ++line_bits;
+}
+
+bool CacheModel::access(phys_addr addr, bool write)
+{
+    auto line_addr = addr >> line_bits;
+    auto set = line_addr & (num_sets - 1);
+    uint32_t tag = line_addr / num_sets;
+    auto first = lines.begin() + set * cfg.ways;
+    auto line_words = cfg.line_size / 2;
+
+    ++cache_stats.accesses;
+    ++use_count;
+    if (write)
+        ++cache_stats.writes;
+
+    auto victim = first;
+    for (auto l = first; l != first + cfg.ways; ++l) {
+        if (l->valid && l->tag == tag) {
+            ++cache_stats.hits;
+            l->last_use = use_count;
+            if (write && cfg.write_back) {
+                l->dirty = true;
+            } else if (write) {
+                ++cache_stats.write_throughs;
+                cache_stats.stall_cycles += word_cycles;
+            }
+            return true;
+        }
+        if (!l->valid || (victim->valid && l->last_use < victim->last_use))
+            victim = l;
+    }
+
+    if (write && !cfg.write_back) {
+        ++cache_stats.write_throughs;
+        cache_stats.stall_cycles += word_cycles;
+        return false;
+    }
+
+    if (victim->valid && victim->dirty) {
+        ++cache_stats.writebacks;
+        cache_stats.stall_cycles += line_words * word_cycles;
+    }
+    ++cache_stats.fills;
+    cache_stats.stall_cycles += line_words * word_cycles;
+
+    victim->valid = true;
+    victim->dirty = write;
+    victim->tag = tag;
+    victim->last_use = use_count;
+
+    return false;
+}
@@ -0,0 +1,107 @@
+// Copyright Jamie Iles, 2017
+//
+// This file is part of s80x86.
+//
+// s80x86 is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// s80x86 is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with s80x86.  If not, see <http://www.gnu.org/licenses/>.
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+#include "Memory.h"
+
+// The defaults are Cache.sv: 8KB of direct mapped, write back 16 byte lines
+// with write allocate.  Write through caches don't allocate on a write miss.
+struct CacheConfig {
+    CacheConfig() : size(8192), line_size(16), ways(1), write_back(true)
+    {
+    }
+
+    // Comma separated key=value pairs overriding the defaults, for example
+    // "size=16384,ways=2".  Keys are size and line in bytes, ways and policy,
+    // either wb or wt.
+    explicit CacheConfig(const std::string &spec);
+    // For example "8K/16B/1-way/wb".
+    std::string name() const;
+
+    size_t size;
+    unsigned line_size;
+    unsigned ways;
+    bool write_back;
+};
+
+struct CacheStats {
+    CacheStats()
+        : accesses(0),
+          writes(0),
+          hits(0),
+          fills(0),
+          writebacks(0),
+          write_throughs(0),
+          stall_cycles(0)
+    {
+    }
+
+    unsigned long accesses;
+    unsigned long writes;
+    unsigned long hits;
+    // Lines read from memory and dirty lines written back.
+    unsigned long fills;
+    unsigned long writebacks;
+    // Words written straight to memory by a write through cache.
+    unsigned long write_throughs;
+    // Estimated from the number of words transferred to and from memory.
+    unsigned long stall_cycles;
+};
+
+// A functional cache model.  With the default configuration it gives the
+// same hits, fills and writebacks as Cache.sv for the same references.
+// Lines in a set are replaced least recently used first, and on a miss the
+// victim is written back if dirty then the whole line is filled.
+class CacheModel
+{
+public:
+    // word_cycles is the cost of transferring one word to or from memory.
+    CacheModel(const CacheConfig &config, unsigned word_cycles);
+
+    // Returns true for a hit.
+    bool access(phys_addr addr, bool write);
+    const CacheConfig &config() const
+    {
+        return cfg;
+    }
+    const CacheStats &stats() const
+    {
+        return cache_stats;
+    }
+
+private:
+    struct Line {
+        bool valid;
+        bool dirty;
+        uint32_t tag;
+        unsigned long last_use;
+    };
+
+    CacheConfig cfg;
+    unsigned word_cycles;
+    unsigned line_bits;
+    unsigned num_sets;
+    std::vector<Line> lines;
+    unsigned long use_count;
+    CacheStats cache_stats;
+};
@@ -0,0 +1,141 @@
+// Copyright Jamie Iles, 2017
+//
+// This file is part of s80x86.
+//
+// s80x86 is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// s80x86 is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with s80x86.  If not, see <http://www.gnu.org/licenses/>.
+
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include <boost/format.hpp>
+#include <boost/program_options.hpp>
+
+#include "CacheModel.h"
+#include "MemoryTrace.h"
+
+// Capacities from 2KB to 32KB, direct mapped to 4-way with 16 and 32 byte
+// lines, all write back.
+static std::vector<CacheConfig> default_sweep()
+{
+    std::vector<CacheConfig> configs;
+
+    for (size_t size = 2048; size <= 32768; size *= 2)
+        for (unsigned line_size : {16, 32})
+            for (unsigned ways : {1, 2, 4}) {
+                CacheConfig config;
+                config.size = size;
+                config.line_size = line_size;
+                config.ways = ways;
+                configs.push_back(config);
+            }
+
+    return configs;
+}
+
+static void simulate(const std::string &path,
+                     const std::vector<CacheConfig> &configs,
+                     unsigned word_cycles,
+                     unsigned long count)
+{
+    std::vector<CacheModel> models;
+    for (auto &config : configs)
+        models.emplace_back(config, word_cycles);
+
+    MemoryTraceReader reader(path);
+    MemoryReference ref;
+    unsigned long num_references = 0;
+    while ((count == 0 || num_references < count) && reader.next(&ref)) {
+        for (auto &model : models)
+            model.access(ref.addr, ref.write);
+        ++num_references;
+    }
+
+    std::cout << boost::format("%lu references\n\n") % num_references;
+    std::cout << boost::format("%-20s %8s %10s %10s %10s %12s %8s\n") %
+                     "configuration" % "hit rate" % "fills" % "writebacks" %
+                     "wr-through" % "stall cycles" % "per ref";
+    for (auto &model : models) {
+        auto &stats = model.stats();
+        auto accesses = std::max(stats.accesses, 1UL);
+        std::cout << boost::format(
+                         "%-20s %7.2f%% %10lu %10lu %10lu %12lu %8.2f\n") %
+                         model.config().name() %
+                         (100.0 * stats.hits / accesses) % stats.fills %
+                         stats.writebacks % stats.write_throughs %
+                         stats.stall_cycles %
+                         (static_cast<double>(stats.stall_cycles) / accesses);
+    }
+}
+
+int main(int argc, char **argv)
+{
+    namespace po = boost::program_options;
+    std::string trace_path;
+    std::vector<std::string> config_specs;
+    unsigned word_cycles = 4;
+    unsigned long count = 0;
+
+    po::options_description desc("Options");
+    // clang-format off
+    desc.add_options()
+        ("help,h", "print this usage information and exit")
+        ("config", po::value<std::vector<std::string>>(&config_specs),
+         "a cache configuration as key=value overrides of size, line, ways and policy (wb or wt), may be repeated, default a sweep of sizes, line sizes and ways")
+        ("word-cycles", po::value<unsigned>(&word_cycles),
+         "cycles to transfer a word to or from memory, default 4")
+        ("count", po::value<unsigned long>(&count),
+         "number of references to simulate, default 0 for all")
+        ("trace", po::value<std::string>(&trace_path)->required(),
+         "the memory trace written by the simulator");
+    // clang-format on
+
+    po::positional_options_description positional;
+    positional.add("trace", 1);
+
+    std::vector<CacheConfig> configs;
+    po::variables_map variables_map;
+    try {
+        po::store(po::command_line_parser(argc, argv)
+                      .options(desc)
+                      .positional(positional)
+                      .run(),
+                  variables_map);
+        if (variables_map.count("help")) {
+            std::cout << desc << std::endl;
+            return 0;
+        }
+        po::notify(variables_map);
+
+        for (auto &spec : config_specs)
+            configs.emplace_back(spec);
+        if (configs.empty())
+            configs = default_sweep();
+    } catch (std::invalid_argument &e) {
+        std::cerr << "Error: " << e.what() << std::endl;
+        return 2;
+    } catch (boost::program_options::error &e) {
+        std::cerr << "Error: " << e.what() << std::endl;
+        return 2;
+    }
+
+    try {
+        simulate(trace_path, configs, word_cycles, count);
+    } catch (std::runtime_error &e) {
+        std::cerr << "Error: " << e.what() << std::endl;
+        return 1;
+    }
+
+    return 0;
+}
@@ -0,0 +1,283 @@
+// Copyright Jamie Iles, 2017
+//
+// This file is part of s80x86.
+//
+// s80x86 is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// s80x86 is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with s80x86.  If not, see <http://www.gnu.org/licenses/>.
+
+#include "DiskImage.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+static const char delta_magic[8] = {'S', '8', '0', 'X', '8', '6', 'O', 'V'};
+static const uint32_t delta_version = 1;
+
+struct DeltaHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t block_size;
+    uint64_t base_size;
+};
+
+static const off_t record_size = sizeof(uint32_t) + DiskImage::block_size;
+
+static std::string errno_string()
+{
+    return strerror(errno);
+}
+
+void DiskImage::restore_blocks(const BlockMap &blocks)
+{
+    if (!blocks.empty())
+        throw std::runtime_error(
+            "snapshot contains overlay blocks but the disk has no overlay");
+}
+
+MappedDiskImage::MappedDiskImage(const std::string &path, bool writable)
+    : fd(-1), base(nullptr), length(0), writable(writable)
+{
+    fd = open(path.c_str(), writable ? O_RDWR : O_RDONLY);
+    if (fd < 0)
+        throw std::runtime_error("failed to open disk image " + path + ": " +
+                                 errno_string());
+
+    struct stat st;
+    if (fstat(fd, &st)) {
+        close(fd);
+        throw std::runtime_error("failed to stat disk image " + path);
+    }
+    length = st.st_size;
+
+    if (length == 0)
+        return;
+
+    auto prot = writable ? PROT_READ | PROT_WRITE : PROT_READ;
+    auto m = mmap(nullptr, length, prot, MAP_SHARED, fd, 0);
+    if (m == MAP_FAILED) {
+        close(fd);
+        throw std::runtime_error("failed to map disk image " + path + ": " +
+                                 errno_string());
+    }
+    base = static_cast<uint8_t *>(m);
+}
+
+MappedDiskImage::~MappedDiskImage()
+{
+    if (base)
+        munmap(base, length);
+    if (fd >= 0)
+        close(fd);
+}
+
+void MappedDiskImage::read(uint64_t offset, uint8_t *dst, size_t len) const
+{
+    size_t valid = offset < length ? std::min<uint64_t>(len, length - offset)
+                                   : 0;
+
+    if (valid)
+        memcpy(dst, base + offset, valid);
+    memset(dst + valid, 0xff, len - valid);
+}
+
+void MappedDiskImage::write(uint64_t offset, const uint8_t *src, size_t len)
+{
+    size_t valid = offset < length ? std::min<uint64_t>(len, length - offset)
+                                   : 0;
+
+    if (!writable)
+        throw std::logic_error("write to read-only disk image");
+
+    if (valid)
+        memcpy(base + offset, src, valid);
+}
+
+OverlayDiskImage::OverlayDiskImage(const std::string &base_path,
+                                   const std::string &delta_path)
+    : base(base_path, false),
+      blocks(),
+      records(),
+      delta_fd(-1),
+      delta_end(sizeof(DeltaHeader))
+{
+    if (delta_path == "")
+        return;
+
+    delta_fd = open(delta_path.c_str(), O_RDWR | O_CREAT, 0644);
+    if (delta_fd < 0)
+        throw std::runtime_error("failed to open overlay " + delta_path +
+                                 ": " + errno_string());
+
+    try {
+        load_delta();
+    } catch (std::runtime_error &e) {
+        close(delta_fd);
+        throw std::runtime_error(delta_path + ": " + e.what());
+    }
+}
+
+OverlayDiskImage::~OverlayDiskImage()
+{
+    if (delta_fd >= 0)
+        close(delta_fd);
+}
+
+void OverlayDiskImage::load_delta()
+{
+    struct stat st;
+    if (fstat(delta_fd, &st))
+        throw std::runtime_error("failed to stat overlay");
+
+    if (st.st_size == 0) {
+        write_header();
+        return;
+    }
+
+    DeltaHeader header;
+    if (pread(delta_fd, &header, sizeof(header), 0) != sizeof(header) ||
+        memcmp(header.magic, delta_magic, sizeof(delta_magic)) ||
+        header.version != delta_version || header.block_size != block_size)
+        throw std::runtime_error("not a valid overlay file");
+    if (header.base_size != base.size())
+        throw std::runtime_error("overlay was created for a different image");
+
+    // A record torn by an interrupted write is dropped and will be
+    // overwritten by the next new block.
+    for (delta_end = sizeof(header); delta_end + record_size <= st.st_size;
+         delta_end += record_size) {
+        uint32_t block_num;
+        std::vector<uint8_t> data(block_size);
+
+        if (pread(delta_fd, &block_num, sizeof(block_num), delta_end) !=
+                sizeof(block_num) ||
+            pread(delta_fd, data.data(), block_size,
+                  delta_end + sizeof(block_num)) != block_size)
+            throw std::runtime_error("failed to read overlay record");
+
+        blocks[block_num] = std::move(data);
+        records[block_num] = delta_end;
+    }
+}
+
+void OverlayDiskImage::write_header()
+{
+    DeltaHeader header;
+
+    memcpy(header.magic, delta_magic, sizeof(delta_magic));
+    header.version = delta_version;
+    header.block_size = block_size;
+    header.base_size = base.size();
+
+    if (pwrite(delta_fd, &header, sizeof(header), 0) != sizeof(header))
+        throw std::runtime_error("failed to write overlay header: " +
+                                 errno_string());
+    delta_end = sizeof(header);
+}
+
+void OverlayDiskImage::store_block(uint32_t block_num,
+                                   const std::vector<uint8_t> &data)
+{
+    if (delta_fd < 0)
+        return;
+
+    auto record = records.find(block_num);
+    off_t offs = record != records.end() ? record->second : delta_end;
+
+    if (pwrite(delta_fd, &block_num, sizeof(block_num), offs) !=
+            sizeof(block_num) ||
+        pwrite(delta_fd, data.data(), block_size, offs + sizeof(block_num)) !=
+            block_size)
+        throw std::runtime_error("failed to write overlay: " + errno_string());
+
+    if (record == records.end()) {
+        records[block_num] = offs;
+        delta_end += record_size;
+    }
+}
+
+void OverlayDiskImage::read(uint64_t offset, uint8_t *dst, size_t len) const
+{
+    while (len > 0) {
+        uint32_t block_num = offset / block_size;
+        size_t block_offs = offset % block_size;
+        size_t count = std::min<size_t>(len, block_size - block_offs);
+
+        auto block = blocks.find(block_num);
+        if (block != blocks.end())
+            memcpy(dst, block->second.data() + block_offs, count);
+        else
+            base.read(offset, dst, count);
+
+        offset += count;
+        dst += count;
+        len -= count;
+    }
+}
+
+void OverlayDiskImage::write(uint64_t offset, const uint8_t *src, size_t len)
+{
+    while (len > 0 && offset < base.size()) {
+        uint32_t block_num = offset / block_size;
+        size_t block_offs = offset % block_size;
+        size_t count = std::min<size_t>(len, block_size - block_offs);
+
+        auto &data = blocks[block_num];
+        if (data.empty()) {
+            data.resize(block_size);
+            base.read(static_cast<uint64_t>(block_num) * block_size,
+                      data.data(), block_size);
+        }
+        memcpy(data.data() + block_offs, src, count);
+        store_block(block_num, data);
+
+        offset += count;
+        src += count;
+        len -= count;
+    }
+}
+
+void OverlayDiskImage::restore_blocks(const BlockMap &saved)
+{
+    blocks = saved;
+    records.clear();
+
+    if (delta_fd < 0)
+        return;
+
+    // The snapshot is authoritative, rewrite the delta to match it.
+    if (ftruncate(delta_fd, 0))
+        throw std::runtime_error("failed to truncate overlay: " +
+                                 errno_string());
+    write_header();
+    for (auto &b : blocks)
+        store_block(b.first, b.second);
+}
+
+std::unique_ptr<DiskImage> open_disk_image(const std::string &path,
+                                           const std::string &overlay_path,
+                                           bool discard_writes)
+{
+    if (discard_writes)
+        return std::make_unique<OverlayDiskImage>(path, "");
+    if (overlay_path != "")
+        return std::make_unique<OverlayDiskImage>(path, overlay_path);
+
+    return std::make_unique<MappedDiskImage>(path, true);
+}
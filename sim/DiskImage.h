@@ -0,0 +1,120 @@
+// Copyright Jamie Iles, 2017
+//
+// This file is part of s80x86.
+//
+// s80x86 is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// s80x86 is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with s80x86.  If not, see <http://www.gnu.org/licenses/>.
+
+#pragma once
+
+#include <map>
+#include <memory>
+#include <stddef.h>
+#include <stdint.h>
+#include <string>
+#include <sys/types.h>
+#include <vector>
+
+// Backing store for the emulated SD card.
+class DiskImage
+{
+public:
+    static const unsigned block_size = 512;
+    typedef std::map<uint32_t, std::vector<uint8_t>> BlockMap;
+
+    virtual ~DiskImage()
+    {
+    }
+
+    // Reads past the end of the image return 0xff, as an erased card would.
+    virtual void read(uint64_t offset, uint8_t *dst, size_t len) const = 0;
+    // Writes past the end of the image are discarded.
+    virtual void write(uint64_t offset, const uint8_t *src, size_t len) = 0;
+    virtual uint64_t size() const = 0;
+
+    // Blocks that are not held in the backing image and so must be saved
+    // with a machine snapshot.
+    virtual BlockMap saved_blocks() const
+    {
+        return BlockMap();
+    }
+    virtual void restore_blocks(const BlockMap &blocks);
+};
+
+// A disk image file mapped into the simulator's address space.  Block
+// accesses are plain copies to/from the mapping, the kernel page cache
+// provides caching and writeback.
+class MappedDiskImage : public DiskImage
+{
+public:
+    MappedDiskImage(const std::string &path, bool writable);
+    ~MappedDiskImage();
+    MappedDiskImage(const MappedDiskImage &) = delete;
+    MappedDiskImage &operator=(const MappedDiskImage &) = delete;
+
+    void read(uint64_t offset, uint8_t *dst, size_t len) const;
+    void write(uint64_t offset, const uint8_t *src, size_t len);
+    uint64_t size() const
+    {
+        return length;
+    }
+
+private:
+    int fd;
+    uint8_t *base;
+    uint64_t length;
+    bool writable;
+};
+
+// Copy-on-write overlay on a read-only base image.  Written blocks are kept
+// in memory and, unless the overlay is volatile, in a delta file recording
+// only those blocks so that many instances can share one base image.
+class OverlayDiskImage : public DiskImage
+{
+public:
+    // An empty delta_path gives a volatile overlay that discards all writes
+    // when the simulator exits.
+    OverlayDiskImage(const std::string &base_path,
+                     const std::string &delta_path);
+    ~OverlayDiskImage();
+    OverlayDiskImage(const OverlayDiskImage &) = delete;
+    OverlayDiskImage &operator=(const OverlayDiskImage &) = delete;
+
+    void read(uint64_t offset, uint8_t *dst, size_t len) const;
+    void write(uint64_t offset, const uint8_t *src, size_t len);
+    uint64_t size() const
+    {
+        return base.size();
+    }
+    BlockMap saved_blocks() const
+    {
+        return blocks;
+    }
+    void restore_blocks(const BlockMap &blocks);
+
+private:
+    void load_delta();
+    void write_header();
+    void store_block(uint32_t block_num, const std::vector<uint8_t> &data);
+
+    MappedDiskImage base;
+    BlockMap blocks;
+    // Offset of each block's record in the delta file.
+    std::map<uint32_t, off_t> records;
+    int delta_fd;
+    off_t delta_end;
+};
+
+std::unique_ptr<DiskImage> open_disk_image(const std::string &path,
+                                           const std::string &overlay_path,
+                                           bool discard_writes);
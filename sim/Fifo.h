@@ -17,24 +17,32 @@
 
 #pragma once
 
+#include <algorithm>
 #include <stdexcept>
+#include <utility>
 #include <vector>
 
+#include <boost/serialization/split_member.hpp>
+
+// Fixed capacity ring buffer, storage is allocated once at construction so
+// pushing and popping never allocates.
 template <typename T>
 class Fifo
 {
 public:
-    explicit Fifo(unsigned int max_depth) : max_depth(max_depth)
+    explicit Fifo(unsigned int max_depth)
+        : max_depth(max_depth), entries(max_depth), head(0), count(0)
     {
     }
 
     T pop()
     {
-        if (entries.size() == 0)
+        if (count == 0)
             throw std::underflow_error("Fifo underflow");
 
-        T e = *entries.begin();
-        entries.erase(entries.begin());
+        T e = entries[head];
+        head = (head + 1) % max_depth;
+        --count;
 
         return e;
     }
@@ -43,15 +51,117 @@ public:
     {
         if (is_full())
             throw std::overflow_error("Fifo overflow");
-        entries.push_back(e);
+        entries[(head + count) % max_depth] = e;
+        ++count;
+    }
+
+    // Push a contiguous block, at most two copies when the block wraps.
+    void push(const T *v, size_t num)
+    {
+        if (num > max_depth - count)
+            throw std::overflow_error("Fifo overflow");
+
+        auto tail = (head + count) % max_depth;
+        auto first = std::min<size_t>(num, max_depth - tail);
+        std::copy(v, v + first, entries.begin() + tail);
+        std::copy(v + first, v + num, entries.begin());
+        count += num;
+    }
+
+    struct Span {
+        T *data;
+        size_t len;
+    };
+
+    // Reserve space for num entries at the tail so that a producer can fill
+    // the storage in place.  The space is returned as at most two spans, the
+    // second is empty unless the space wraps.  The entries are not visible
+    // until commit().
+    std::pair<Span, Span> reserve(size_t num)
+    {
+        if (num > max_depth - count)
+            throw std::overflow_error("Fifo overflow");
+
+        auto tail = (head + count) % max_depth;
+        auto first = std::min<size_t>(num, max_depth - tail);
+
+        return std::make_pair(Span{entries.data() + tail, first},
+                              Span{entries.data(), num - first});
+    }
+
+    void commit(size_t num)
+    {
+        if (num > max_depth - count)
+            throw std::overflow_error("Fifo overflow");
+
+        count += num;
+    }
+
+    const T &front() const
+    {
+        if (count == 0)
+            throw std::underflow_error("Fifo underflow");
+
+        return entries[head];
+    }
+
+    const T &operator[](size_t idx) const
+    {
+        return entries[(head + idx) % max_depth];
+    }
+
+    void clear()
+    {
+        head = 0;
+        count = 0;
+    }
+
+    size_t size() const
+    {
+        return count;
+    }
+
+    bool empty() const
+    {
+        return count == 0;
     }
 
     bool is_full() const
     {
-        return entries.size() == max_depth;
+        return count == max_depth;
     }
 
 private:
     const unsigned int max_depth;
     std::vector<T> entries;
+    size_t head;
+    size_t count;
+
+    friend class boost::serialization::access;
+    template <class Archive>
+    void save(Archive &ar, const unsigned int /* version */) const
+    {
+        // clang-format off
+        ar & count;
+        for (size_t m = 0; m < count; ++m)
+            ar & (*this)[m];
+        // clang-format on
+    }
+
+    template <class Archive>
+    void load(Archive &ar, const unsigned int /* version */)
+    {
+        size_t num = 0;
+
+        // clang-format off
+        ar & num;
+        clear();
+        for (size_t m = 0; m < num; ++m) {
+            T v;
+            ar & v;
+            push(v);
+        }
+        // clang-format on
+    }
+    BOOST_SERIALIZATION_SPLIT_MEMBER()
 };
@@ -0,0 +1,90 @@
+// Copyright Jamie Iles, 2017
+//
+// This file is part of s80x86.
+//
+// s80x86 is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// s80x86 is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with s80x86.  If not, see <http://www.gnu.org/licenses/>.
+
+#include "FlightRecorder.h"
+
+#include <boost/format.hpp>
+
+#include "Disassembler.h"
+
+static const char *reg_names[NUM_16BIT_REGS] = {"ax", "cx", "dx", "bx", "sp",
+                                                 "bp", "si", "di", "es", "cs",
+                                                 "ss", "ds", "ip"};
+
+const size_t FlightRecorder::max_length;
+
+size_t FlightRecorder::ring_size(size_t num_entries)
+{
+    size_t size = 1;
+
+    while (size < num_entries)
+        size <<= 1;
+
+    return size;
+}
+
+FlightRecorder::FlightRecorder(SimCPU *cpu,
+                               size_t num_entries,
+                               bool with_registers)
+    : cpu(cpu),
+      mem(cpu->get_memory()),
+      with_registers(with_registers),
+      entries(ring_size(num_entries)),
+      mask(entries.size() - 1),
+      num_recorded(0)
+{
+}
+
+void FlightRecorder::dump(std::ostream &out, const std::string &reason) const
+{
+    unsigned long count = std::min<unsigned long>(num_recorded, entries.size());
+
+    out << "Flight recorder: " << reason << ", last " << count << " of "
+        << num_recorded << " instructions" << std::endl;
+
+    const Entry *prev = nullptr;
+    for (auto n = num_recorded - count; n < num_recorded; ++n) {
+        auto &entry = entries[n & mask];
+
+        std::string hex_bytes;
+        for (size_t m = 0; m < entry.length; ++m)
+            hex_bytes += (boost::format("%02x ") %
+                          static_cast<unsigned>(entry.bytes[m]))
+                             .str();
+
+        std::string text;
+        disassemble(entry.bytes, entry.length, entry.ip, &text);
+
+        // IP is implied by the next entry.
+        std::string changed;
+        for (int r = 0; with_registers && prev && r < IP; ++r)
+            if (entry.state.registers[r] != prev->state.registers[r])
+                changed += (boost::format(" %s=%04x") % reg_names[r] %
+                            entry.state.registers[r])
+                               .str();
+        if (with_registers && prev && entry.state.flags != prev->state.flags)
+            changed +=
+                (boost::format(" flags=%04x") % entry.state.flags).str();
+
+        out << boost::format("%10lu [%04x:%04x] %-21s%s%s") % n % entry.cs %
+                   entry.ip % hex_bytes % text %
+                   (changed.empty() ? "" : "  ;" + changed)
+            << std::endl;
+
+        prev = &entry;
+    }
+}
@@ -0,0 +1,78 @@
+// Copyright Jamie Iles, 2017
+//
+// This file is part of s80x86.
+//
+// s80x86 is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// s80x86 is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with s80x86.  If not, see <http://www.gnu.org/licenses/>.
+
+#pragma once
+
+#include <algorithm>
+#include <ostream>
+#include <stddef.h>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+#include "CPU.h"
+
+// A ring of the most recently executed instructions for working out how the
+// guest got into a bad state.  Recording an instruction is a handful of
+// stores into the next slot, plus a read of each register if they are
+// recorded too.  The instruction bytes are read back from memory after the
+// instruction has executed.
+class FlightRecorder
+{
+public:
+    // The number of entries is rounded up to a power of two.
+    FlightRecorder(SimCPU *cpu, size_t num_entries, bool with_registers);
+
+    void record(uint16_t cs, uint16_t ip, size_t length)
+    {
+        auto &entry = entries[num_recorded++ & mask];
+
+        entry.cs = cs;
+        entry.ip = ip;
+        entry.length = std::min(length, max_length);
+        for (size_t m = 0; m < entry.length; ++m)
+            entry.bytes[m] = mem->read<uint8_t>(
+                get_phys_addr(cs, static_cast<uint16_t>(ip + m)));
+
+        if (with_registers)
+            entry.state = cpu->read_all_regs();
+    }
+
+    // Disassembled listing, oldest first, with the registers that each
+    // instruction changed when they are recorded.
+    void dump(std::ostream &out, const std::string &reason) const;
+
+private:
+    struct Entry {
+        uint16_t cs;
+        uint16_t ip;
+        size_t length;
+        uint8_t bytes[15];
+        RegisterState state;
+    };
+
+    static const size_t max_length = sizeof(Entry::bytes);
+
+    static size_t ring_size(size_t num_entries);
+
+    SimCPU *cpu;
+    Memory *mem;
+    bool with_registers;
+    std::vector<Entry> entries;
+    size_t mask;
+    unsigned long num_recorded;
+};
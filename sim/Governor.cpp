@@ -0,0 +1,110 @@
+// Copyright Jamie Iles, 2017
+//
+// This file is part of s80x86.
+//
+// s80x86 is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// s80x86 is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with s80x86.  If not, see <http://www.gnu.org/licenses/>.
+
+#include "Governor.h"
+
+#include <cerrno>
+
+static uint64_t clock_ns(clockid_t clock)
+{
+    struct timespec ts;
+
+    clock_gettime(clock, &ts);
+
+    return static_cast<uint64_t>(ts.tv_sec) * 1000000000LLU + ts.tv_nsec;
+}
+
+Governor::Governor(unsigned long cpu_clock_hz, bool turbo)
+    : cpu_clock_hz(cpu_clock_hz),
+      turbo(turbo),
+      origin_ns(0),
+      origin_cycle(0),
+      rebase_pending(true),
+      last_report_ns(clock_ns(CLOCK_MONOTONIC)),
+      last_report_cpu_ns(clock_ns(CLOCK_PROCESS_CPUTIME_ID)),
+      last_report_cycle(0)
+{
+}
+
+uint64_t Governor::cycles_to_ns(unsigned long cycles) const
+{
+    // Whole seconds split out to avoid overflow on long runs.
+    return (cycles / cpu_clock_hz) * ns_per_sec +
+           ((cycles % cpu_clock_hz) * ns_per_sec) / cpu_clock_hz;
+}
+
+void Governor::rebase(unsigned long cycle_num, uint64_t now)
+{
+    origin_ns = now;
+    origin_cycle = cycle_num;
+    rebase_pending = false;
+}
+
+void Governor::set_turbo(bool enabled)
+{
+    // Leaving turbo, the guest is far ahead of the old origin.
+    if (turbo && !enabled)
+        rebase_pending = true;
+    turbo = enabled;
+}
+
+void Governor::pace(unsigned long cycle_num)
+{
+    if (turbo)
+        return;
+
+    auto now = clock_ns(CLOCK_MONOTONIC);
+    if (rebase_pending) {
+        rebase(cycle_num, now);
+        return;
+    }
+
+    auto deadline = origin_ns + cycles_to_ns(cycle_num - origin_cycle);
+    if (now > deadline + max_lag_ns) {
+        rebase(cycle_num, now);
+        return;
+    }
+    if (now >= deadline)
+        return;
+
+    struct timespec ts;
+    ts.tv_sec = deadline / ns_per_sec;
+    ts.tv_nsec = deadline % ns_per_sec;
+    while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, nullptr) ==
+           EINTR)
+        continue;
+}
+
+bool Governor::sample(unsigned long cycle_num, Report *report)
+{
+    auto now = clock_ns(CLOCK_MONOTONIC);
+    auto elapsed = now - last_report_ns;
+
+    if (elapsed < report_interval_ns)
+        return false;
+
+    auto cpu_ns = clock_ns(CLOCK_PROCESS_CPUTIME_ID);
+
+    report->mhz = (cycle_num - last_report_cycle) * 1000.0 / elapsed;
+    report->host_cpu_percent = (cpu_ns - last_report_cpu_ns) * 100.0 / elapsed;
+
+    last_report_ns = now;
+    last_report_cpu_ns = cpu_ns;
+    last_report_cycle = cycle_num;
+
+    return true;
+}
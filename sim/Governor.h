@@ -0,0 +1,70 @@
+// Copyright Jamie Iles, 2017
+//
+// This file is part of s80x86.
+//
+// s80x86 is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// s80x86 is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with s80x86.  If not, see <http://www.gnu.org/licenses/>.
+
+#pragma once
+
+#include <stdint.h>
+#include <time.h>
+
+// Locks guest time to wall clock time at the emulated CPU frequency.
+//
+// pace() is called after each slice of guest cycles and sleeps until the wall
+// clock reaches the time that the guest has run to.  Deadlines are computed
+// from a fixed origin with an absolute sleep so that oversleeping and rounding
+// don't accumulate.  If the host falls too far behind, for example when the
+// simulator is stopped or the host is too slow, the origin is moved rather
+// than running flat out to catch up.
+//
+// In turbo mode the guest runs unthrottled.
+class Governor
+{
+public:
+    struct Report {
+        double mhz;
+        double host_cpu_percent;
+    };
+
+    Governor(unsigned long cpu_clock_hz, bool turbo);
+
+    void pace(unsigned long cycle_num);
+    void set_turbo(bool enabled);
+    bool is_turbo() const
+    {
+        return turbo;
+    }
+    // Fill in the effective frequency and host CPU usage since the previous
+    // report, returning true at most once per report_interval_ns.
+    bool sample(unsigned long cycle_num, Report *report);
+
+private:
+    static const uint64_t ns_per_sec = 1000000000LLU;
+    static const uint64_t max_lag_ns = 100000000LLU;
+    static const uint64_t report_interval_ns = 1000000000LLU;
+
+    uint64_t cycles_to_ns(unsigned long cycles) const;
+    void rebase(unsigned long cycle_num, uint64_t now);
+
+    unsigned long cpu_clock_hz;
+    bool turbo;
+    // Wall clock time in ns that origin_cycle corresponds to.
+    uint64_t origin_ns;
+    unsigned long origin_cycle;
+    bool rebase_pending;
+    uint64_t last_report_ns;
+    uint64_t last_report_cpu_ns;
+    unsigned long last_report_cycle;
+};
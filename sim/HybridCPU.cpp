@@ -0,0 +1,147 @@
+// Copyright Jamie Iles, 2017
+//
+// This file is part of s80x86.
+//
+// s80x86 is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// s80x86 is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with s80x86.  If not, see <http://www.gnu.org/licenses/>.
+
+#include "HybridCPU.h"
+
+#include <climits>
+
+void HybridControl::write8(uint16_t __unused port_num,
+                           unsigned offs,
+                           uint8_t v)
+{
+    if (offs == 0)
+        cpu->request_rtl(v & 0x1);
+}
+
+uint8_t HybridControl::read8(uint16_t __unused port_num, unsigned offs)
+{
+    return offs == 0 ? cpu->on_rtl() : 0;
+}
+
+HybridCPU::HybridCPU(const std::string &name)
+    : SimCPU(name),
+      software(name, &mem),
+      rtl(name, &mem),
+      active(&software),
+      control(this),
+      rtl_after(0),
+      have_rtl_at(false),
+      rtl_at_cs(0),
+      rtl_at_ip(0),
+      rtl_for(0),
+      requested(REQUEST_NONE),
+      base_cycles(0),
+      active_start_cycles(software.cycle_count()),
+      num_instructions(0),
+      active_instructions(0),
+      num_rtl_instructions(0),
+      previous_rtl_cycles(0),
+      switches(0),
+      guest_io_callback(),
+      translated_io_callback([this](unsigned long cycle_num) {
+          guest_io_callback(base_cycles + cycle_num - active_start_cycles);
+      })
+{
+    add_ioport(&control);
+}
+
+void HybridCPU::reset()
+{
+    if (on_rtl())
+        switch_to(&software);
+    software.reset();
+    rtl.reset();
+}
+
+void HybridCPU::return_to_software()
+{
+    if (on_rtl())
+        switch_to(&software);
+    requested = REQUEST_NONE;
+}
+
+unsigned long HybridCPU::rtl_cycles() const
+{
+    return previous_rtl_cycles +
+           (on_rtl() ? rtl.cycle_count() - active_start_cycles : 0);
+}
+
+bool HybridCPU::should_switch() const
+{
+    if (on_rtl())
+        return requested == REQUEST_SOFTWARE ||
+               (rtl_for != 0 && active_instructions >= rtl_for);
+
+    return requested == REQUEST_RTL ||
+           (rtl_after != 0 && num_instructions >= rtl_after) ||
+           (have_rtl_at && software.read_reg(IP) == rtl_at_ip &&
+            software.read_reg(CS) == rtl_at_cs);
+}
+
+// Only the registers and any interrupt raised but not yet taken move, memory
+// is shared and the devices keep their own state.  The PIC raises an
+// interrupt once, so a pending one left behind would never be taken.
+void HybridCPU::switch_to(SimCPU *to)
+{
+    to->write_all_regs(active->read_all_regs());
+    auto irq_num = active->take_pending_irq();
+    if (irq_num)
+        to->raise_irq(irq_num);
+
+    if (on_rtl())
+        previous_rtl_cycles += rtl.cycle_count() - active_start_cycles;
+
+    base_cycles = cycle_count();
+    active = to;
+    active_start_cycles = active->cycle_count();
+    active_instructions = 0;
+    ++switches;
+}
+
+size_t HybridCPU::step_with_io(std::function<void(unsigned long)> io_callback)
+{
+    if (should_switch()) {
+        switch_to(on_rtl() ? static_cast<SimCPU *>(&software) : &rtl);
+        requested = REQUEST_NONE;
+        rtl_after = 0;
+    }
+
+    guest_io_callback = io_callback;
+    auto len = active->step_with_io(translated_io_callback);
+
+    ++num_instructions;
+    ++active_instructions;
+    if (on_rtl())
+        ++num_rtl_instructions;
+
+    return len;
+}
+
+void HybridCPU::set_fast_forward(std::function<unsigned long()> next_event)
+{
+    if (!next_event) {
+        software.set_fast_forward(next_event);
+        return;
+    }
+
+    software.set_fast_forward([this, next_event] {
+        auto deadline = next_event();
+        return deadline == ULONG_MAX
+                   ? deadline
+                   : deadline - base_cycles + active_start_cycles;
+    });
+}
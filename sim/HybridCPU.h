@@ -0,0 +1,272 @@
+// Copyright Jamie Iles, 2017
+//
+// This file is part of s80x86.
+//
+// s80x86 is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// s80x86 is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with s80x86.  If not, see <http://www.gnu.org/licenses/>.
+
+#pragma once
+
+#include <functional>
+#include <stdint.h>
+#include <string>
+
+#include "CPU.h"
+#include "RTLCPU.h"
+#include "SoftwareCPU.h"
+
+class HybridCPU;
+
+// Guest requests to change backend: writing 1 to the port switches to the
+// RTLCPU and writing 0 switches back to the SoftwareCPU after the current
+// instruction.  Simulator only, the port sits below the paravirtual disk and
+// clear of the mouse at 0xffe0.
+class HybridControl : public IOPorts
+{
+public:
+    explicit HybridControl(HybridCPU *cpu) : IOPorts(0xffc0, 1), cpu(cpu)
+    {
+    }
+
+    void write8(uint16_t port_num, unsigned offs, uint8_t v);
+    uint8_t read8(uint16_t port_num, unsigned offs);
+
+private:
+    HybridCPU *cpu;
+};
+
+// Runs on the SoftwareCPU until a trigger, then hands the architectural
+// state over to the RTLCPU to continue cycle accurately, and optionally back
+// again.  Both CPUs share this CPU's memory and have the same I/O ports so
+// only the registers need to be moved.  Guest cycles continue from where
+// the previous CPU left off so the devices see a single timeline.
+class HybridCPU : public SimCPU
+{
+public:
+    typedef RTLCPU<verilator_debug_enabled> RTLBackend;
+
+    explicit HybridCPU(const std::string &name);
+
+    // Switch to the RTLCPU once num_instructions have executed, 0 for never.
+    void set_rtl_after(unsigned long num_instructions)
+    {
+        rtl_after = num_instructions;
+    }
+    // Switch to the RTLCPU each time cs:ip is about to execute.
+    void set_rtl_at(uint16_t cs, uint16_t ip)
+    {
+        have_rtl_at = true;
+        rtl_at_cs = cs;
+        rtl_at_ip = ip;
+    }
+    // Return to the SoftwareCPU after num_instructions on the RTLCPU, 0 to
+    // stay on the RTLCPU.
+    void set_rtl_for(unsigned long num_instructions)
+    {
+        rtl_for = num_instructions;
+    }
+    void request_rtl(bool rtl)
+    {
+        requested = rtl ? REQUEST_RTL : REQUEST_SOFTWARE;
+    }
+    // Hand the state back to the SoftwareCPU now, snapshots are only
+    // restored to the SoftwareCPU.
+    void return_to_software();
+
+    bool on_rtl() const
+    {
+        return active == &rtl;
+    }
+    unsigned long rtl_cycles() const;
+    unsigned long rtl_instructions() const
+    {
+        return num_rtl_instructions;
+    }
+    unsigned num_switches() const
+    {
+        return switches;
+    }
+
+    size_t step_with_io(std::function<void(unsigned long)> io_callback);
+    void cycle_cpu_with_io(std::function<void(unsigned long)> io_callback)
+    {
+        guest_io_callback = io_callback;
+        active->cycle_cpu_with_io(translated_io_callback);
+    }
+    size_t step()
+    {
+        return step_with_io([](unsigned long) {});
+    }
+    void debug_detach()
+    {
+        active->debug_detach();
+    }
+
+    unsigned long cycle_count() const
+    {
+        return base_cycles + active->cycle_count() - active_start_cycles;
+    }
+
+    bool has_instruction_length() const
+    {
+        return active->has_instruction_length();
+    }
+    void write_reg(GPR regnum, uint16_t val)
+    {
+        active->write_reg(regnum, val);
+    }
+    uint16_t read_reg(GPR regnum) const
+    {
+        return active->read_reg(regnum);
+    }
+    void write_flags(uint16_t val)
+    {
+        active->write_flags(val);
+    }
+    uint16_t read_flags() const
+    {
+        return active->read_flags();
+    }
+    RegisterState read_all_regs() const
+    {
+        return active->read_all_regs();
+    }
+    void write_all_regs(const RegisterState &state)
+    {
+        active->write_all_regs(state);
+    }
+    bool has_trapped()
+    {
+        return active->has_trapped();
+    }
+    void reset();
+    bool instruction_had_side_effects() const
+    {
+        return active->instruction_had_side_effects();
+    }
+    void clear_side_effects()
+    {
+        active->clear_side_effects();
+    }
+
+    void write_mem8(uint16_t segment, uint16_t addr, uint8_t val)
+    {
+        active->write_mem8(segment, addr, val);
+    }
+    void write_mem16(uint16_t segment, uint16_t addr, uint16_t val)
+    {
+        active->write_mem16(segment, addr, val);
+    }
+    void write_mem32(uint16_t segment, uint16_t addr, uint32_t val)
+    {
+        active->write_mem32(segment, addr, val);
+    }
+    uint8_t read_mem8(uint16_t segment, uint16_t addr)
+    {
+        return active->read_mem8(segment, addr);
+    }
+    uint16_t read_mem16(uint16_t segment, uint16_t addr)
+    {
+        return active->read_mem16(segment, addr);
+    }
+    uint32_t read_mem32(uint16_t segment, uint16_t addr)
+    {
+        return active->read_mem32(segment, addr);
+    }
+    void write_io8(uint32_t addr, uint8_t val)
+    {
+        active->write_io8(addr, val);
+    }
+    void write_io16(uint32_t addr, uint16_t val)
+    {
+        active->write_io16(addr, val);
+    }
+    uint8_t read_io8(uint32_t addr)
+    {
+        return active->read_io8(addr);
+    }
+    uint16_t read_io16(uint32_t addr)
+    {
+        return active->read_io16(addr);
+    }
+    void add_ioport(IOPorts *p)
+    {
+        software.add_ioport(p);
+        rtl.add_ioport(p);
+    }
+
+    void raise_nmi()
+    {
+        active->raise_nmi();
+    }
+    void raise_irq(int irq_num)
+    {
+        active->raise_irq(irq_num);
+    }
+    void set_inta_handler(std::function<void(int)> handler)
+    {
+        software.set_inta_handler(handler);
+        rtl.set_inta_handler(handler);
+    }
+
+    // Skipping idle loops and the statistics are SoftwareCPU only.
+    void set_fast_forward(std::function<unsigned long()> next_event);
+    unsigned long fast_forwarded_cycles() const
+    {
+        return software.fast_forwarded_cycles();
+    }
+    void write_instruction_stats(std::ostream &out) const
+    {
+        software.write_instruction_stats(out);
+    }
+    void set_invalid_opcode_handler(std::function<void()> handler)
+    {
+        software.set_invalid_opcode_handler(handler);
+    }
+
+private:
+    enum Request {
+        REQUEST_NONE,
+        REQUEST_RTL,
+        REQUEST_SOFTWARE,
+    };
+
+    bool should_switch() const;
+    void switch_to(SimCPU *to);
+
+    SoftwareCPU software;
+    RTLBackend rtl;
+    SimCPU *active;
+    HybridControl control;
+
+    unsigned long rtl_after;
+    bool have_rtl_at;
+    uint16_t rtl_at_cs;
+    uint16_t rtl_at_ip;
+    unsigned long rtl_for;
+    Request requested;
+
+    // Guest cycles at the last switch and the active CPU's own count then.
+    unsigned long base_cycles;
+    unsigned long active_start_cycles;
+    unsigned long num_instructions;
+    unsigned long active_instructions;
+    unsigned long num_rtl_instructions;
+    unsigned long previous_rtl_cycles;
+    unsigned switches;
+
+    // The active CPU reports its own cycle count, translated into guest
+    // cycles for the devices.
+    std::function<void(unsigned long)> guest_io_callback;
+    std::function<void(unsigned long)> translated_io_callback;
+};
@@ -0,0 +1,90 @@
+// Copyright Jamie Iles, 2017
+//
+// This file is part of s80x86.
+//
+// s80x86 is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// s80x86 is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with s80x86.  If not, see <http://www.gnu.org/licenses/>.
+
+#include "InputThread.h"
+
+#include <cerrno>
+#include <exception>
+#include <poll.h>
+#include <stdexcept>
+#include <unistd.h>
+
+// Pseudo terminals report a hangup until the slave is opened, so back off
+// rather than spinning when there is nothing to read.
+static const int hangup_backoff_ms = 50;
+static const int queue_full_backoff_ms = 1;
+
+InputThread::InputThread(SerialBackend *serial, SPSCQueue<uint8_t> *serial_rx)
+    : serial(serial), serial_rx(serial_rx), stop_fds(), thread()
+{
+    if (pipe(stop_fds))
+        throw std::runtime_error("Failed to create input thread pipe");
+
+    thread = std::thread([this] { this->run(); });
+}
+
+InputThread::~InputThread()
+{
+    uint8_t v = 0;
+
+    if (write(stop_fds[1], &v, sizeof(v)) != sizeof(v))
+        std::terminate();
+    thread.join();
+
+    close(stop_fds[0]);
+    close(stop_fds[1]);
+}
+
+bool InputThread::wait_for_stop(int timeout_ms)
+{
+    struct pollfd fd = {stop_fds[0], POLLIN, 0};
+
+    return poll(&fd, 1, timeout_ms) > 0;
+}
+
+void InputThread::run()
+{
+    uint8_t buf[64];
+    size_t len = 0;
+    size_t pos = 0;
+
+    for (;;) {
+        if (pos < len) {
+            while (pos < len && serial_rx->push(buf[pos]))
+                ++pos;
+            if (pos < len && wait_for_stop(queue_full_backoff_ms))
+                return;
+            continue;
+        }
+
+        struct pollfd fds[2] = {
+            {stop_fds[0], POLLIN, 0}, {serial->poll_fd(), POLLIN, 0},
+        };
+        if (poll(fds, fds[1].fd >= 0 ? 2 : 1, -1) < 0) {
+            if (errno == EINTR)
+                continue;
+            return;
+        }
+        if (fds[0].revents)
+            return;
+
+        len = serial->read(buf, sizeof(buf));
+        pos = 0;
+        if (len == 0 && wait_for_stop(hangup_backoff_ms))
+            return;
+    }
+}
@@ -0,0 +1,48 @@
+// Copyright Jamie Iles, 2017
+//
+// This file is part of s80x86.
+//
+// s80x86 is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// s80x86 is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with s80x86.  If not, see <http://www.gnu.org/licenses/>.
+
+#pragma once
+
+#include <stdint.h>
+#include <thread>
+
+#include "SerialBackend.h"
+#include "SPSCQueue.h"
+
+// Collects host serial input on a dedicated thread that blocks in poll() so
+// that the simulation loop never makes a syscall to look for it.  Received
+// bytes are pushed onto a lock-free queue that the UART drains when its
+// receive FIFO has room.  While the queue is full the bytes are left in the
+// host's buffers.
+class InputThread
+{
+public:
+    InputThread(SerialBackend *serial, SPSCQueue<uint8_t> *serial_rx);
+    ~InputThread();
+    InputThread(const InputThread &) = delete;
+    InputThread &operator=(const InputThread &) = delete;
+
+private:
+    void run();
+    bool wait_for_stop(int timeout_ms);
+
+    SerialBackend *serial;
+    SPSCQueue<uint8_t> *serial_rx;
+    // Written on destruction to wake the thread.
+    int stop_fds[2];
+    std::thread thread;
+};
@@ -35,6 +35,7 @@
 #include "PIC.h"
 #include "../bios/bda.h"
 #include "PS2.h"
+#include "Timer.h"
 
 static std::map<int, std::vector<unsigned char>> sdl_to_keyboard = {
     {SDLK_a, {0x1e}},
@@ -120,11 +121,39 @@ static std::map<int, std::vector<unsigned char>> sdl_to_keyboard = {
 class Keyboard : public PS2
 {
 public:
-    explicit Keyboard(PIC *pic) : PS2(pic, 0x0060, 1)
+    Keyboard(PIC *pic, TimerTick *timer)
+        : PS2(pic, 0x0060, 1), timer(timer), speaker_control(0)
     {
         add_byte(0xaa);
     }
 
+    // The control register also carries the PC speaker timer gate and data
+    // enable in [1:0], with the timer channel 2 output readable in [5].
+    void write8(uint16_t port_num, unsigned offs, uint8_t v)
+    {
+        if (offs == 1) {
+            speaker_control = v & 0x3;
+            timer->set_gate(2, v & 0x1);
+        }
+        PS2::write8(port_num, offs, v);
+    }
+
+    uint8_t read8(uint16_t port_num, unsigned offs)
+    {
+        auto v = PS2::read8(port_num, offs);
+
+        if (offs == 1)
+            v |= speaker_control | (timer->output(2) << 5);
+
+        return v;
+    }
+
+    // The timer channel 2 output follows guest time.
+    bool read_is_volatile(uint16_t __unused port_num, unsigned offs) const
+    {
+        return offs == 1;
+    }
+
     void process_event(SDL_Event e)
     {
         if (sdl_to_keyboard.count(e.key.keysym.sym) == 0)
@@ -137,4 +166,8 @@ public:
                 add_byte(e.type == SDL_KEYUP ? 0x80 | b : b);
         }
     }
+
+private:
+    TimerTick *timer;
+    uint8_t speaker_control;
 };
@@ -0,0 +1,161 @@
+// Copyright Jamie Iles, 2017
+//
+// This file is part of s80x86.
+//
+// s80x86 is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// s80x86 is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with s80x86.  If not, see <http://www.gnu.org/licenses/>.
+
+#include "MemoryTrace.h"
+
+#include <cstring>
+#include <stdexcept>
+
+static const char memory_trace_magic[8] = {'S', '8', '0', 'M',
+                                           'E', 'M', 'R', 'F'};
+static const uint32_t memory_trace_version = 1;
+
+static uint32_t encode_reference(phys_addr word_addr,
+                                 uint8_t bytesel,
+                                 bool write)
+{
+    return ((word_addr & 0x7ffff) << 3) | ((bytesel & 0x3) << 1) |
+           (write ? 1 : 0);
+}
+
+MemoryTraceWriter::MemoryTraceWriter(const std::string &path, bool compress)
+    : file(gzopen(path.c_str(), compress ? "wb1" : "wbT")),
+      buffer(),
+      have_last(false),
+      last(0),
+      num_references(0)
+{
+    if (!file)
+        throw std::runtime_error("Failed to open memory trace " + path);
+
+    buffer.reserve(buffer_size);
+    buffer.insert(buffer.end(), memory_trace_magic,
+                  memory_trace_magic + sizeof(memory_trace_magic));
+    put(memory_trace_version);
+}
+
+MemoryTraceWriter::~MemoryTraceWriter()
+{
+    flush();
+    gzclose(file);
+}
+
+void MemoryTraceWriter::put(uint32_t v)
+{
+    for (int m = 0; m < 4; ++m)
+        buffer.push_back((v >> (m * 8)) & 0xff);
+    if (buffer.size() >= buffer_size && !flush())
+        throw std::runtime_error("Failed to write memory trace");
+}
+
+bool MemoryTraceWriter::flush()
+{
+    auto ok = buffer.empty() || gzwrite(file, buffer.data(), buffer.size()) ==
+                                    static_cast<int>(buffer.size());
+    buffer.clear();
+
+    return ok;
+}
+
+void MemoryTraceWriter::access(phys_addr addr,
+                               unsigned width,
+                               bool write,
+                               uint32_t __unused value)
+{
+    auto end = addr + width;
+
+    for (auto word = addr >> 1; word <= (end - 1) >> 1; ++word) {
+        uint8_t bytesel = 0;
+        if (addr <= word << 1)
+            bytesel |= 1 << 0;
+        if (end > (word << 1) + 1)
+            bytesel |= 1 << 1;
+
+        auto v = encode_reference(word, bytesel, write);
+        // Any read of the word that was just read.
+        if (!write && have_last && !(last & 1) && (last >> 3) == (v >> 3))
+            continue;
+
+        put(v);
+        have_last = true;
+        last = v;
+        ++num_references;
+    }
+}
+
+MemoryTraceReader::MemoryTraceReader(const std::string &path)
+    : file(gzopen(path.c_str(), "rb")),
+      buffer(64 * 1024),
+      buffer_pos(0),
+      buffer_len(0)
+{
+    if (!file)
+        throw std::runtime_error("Failed to open memory trace " + path);
+
+    char header[sizeof(memory_trace_magic) + sizeof(uint32_t)];
+    if (gzread(file, header, sizeof(header)) != sizeof(header) ||
+        memcmp(header, memory_trace_magic, sizeof(memory_trace_magic)) != 0) {
+        gzclose(file);
+        throw std::runtime_error(path + " is not a memory trace");
+    }
+
+    uint32_t version = 0;
+    for (int m = 3; m >= 0; --m)
+        version = (version << 8) |
+                  static_cast<uint8_t>(header[sizeof(memory_trace_magic) + m]);
+    if (version != memory_trace_version) {
+        gzclose(file);
+        throw std::runtime_error("Unsupported memory trace version in " +
+                                 path);
+    }
+}
+
+MemoryTraceReader::~MemoryTraceReader()
+{
+    gzclose(file);
+}
+
+bool MemoryTraceReader::fill()
+{
+    auto rc = gzread(file, buffer.data(), buffer.size());
+    if (rc < 0)
+        throw std::runtime_error("Failed to read memory trace");
+    if (rc % 4)
+        throw std::runtime_error("Truncated memory trace");
+
+    buffer_pos = 0;
+    buffer_len = rc;
+
+    return buffer_len != 0;
+}
+
+bool MemoryTraceReader::next(MemoryReference *ref)
+{
+    if (buffer_pos == buffer_len && !fill())
+        return false;
+
+    uint32_t v = 0;
+    for (int m = 3; m >= 0; --m)
+        v = (v << 8) | buffer[buffer_pos + m];
+    buffer_pos += 4;
+
+    ref->addr = ((v >> 3) & 0x7ffff) << 1;
+    ref->bytesel = (v >> 1) & 0x3;
+    ref->write = v & 1;
+
+    return true;
+}
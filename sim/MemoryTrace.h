@@ -0,0 +1,94 @@
+// Copyright Jamie Iles, 2017
+//
+// This file is part of s80x86.
+//
+// s80x86 is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// s80x86 is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with s80x86.  If not, see <http://www.gnu.org/licenses/>.
+
+#pragma once
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include <zlib.h>
+
+#include "Memory.h"
+
+// Memory reference streams, as seen by the CPU's 16-bit bus.  A stream
+// starts with the magic "S80MEMRF" and a 32-bit version, then holds one
+// 32-bit little endian word per reference:
+//
+//   bit 0      write
+//   bits 1-2   byte select
+//   bits 3-21  word address, bits 19:1 of the physical address
+//
+// Byte and word accesses are split into the bus words that they touch.
+// Repeated reads of the same word, such as fetching the bytes of an
+// instruction, are recorded once as the prefetcher reads each word once.
+// The file may be gzip compressed.
+struct MemoryReference {
+    // Word aligned.
+    phys_addr addr;
+    uint8_t bytesel;
+    bool write;
+};
+
+class MemoryTraceWriter : public MemoryObserver
+{
+public:
+    MemoryTraceWriter(const std::string &path, bool compress);
+    ~MemoryTraceWriter();
+    MemoryTraceWriter(const MemoryTraceWriter &) = delete;
+    MemoryTraceWriter &operator=(const MemoryTraceWriter &) = delete;
+
+    void access(phys_addr addr,
+                unsigned width,
+                bool write,
+                uint32_t value);
+    unsigned long references_written() const
+    {
+        return num_references;
+    }
+
+private:
+    void put(uint32_t v);
+    bool flush();
+
+    static const size_t buffer_size = 1024 * 1024;
+
+    gzFile file;
+    std::vector<uint8_t> buffer;
+    bool have_last;
+    uint32_t last;
+    unsigned long num_references;
+};
+
+class MemoryTraceReader
+{
+public:
+    explicit MemoryTraceReader(const std::string &path);
+    ~MemoryTraceReader();
+    MemoryTraceReader(const MemoryTraceReader &) = delete;
+    MemoryTraceReader &operator=(const MemoryTraceReader &) = delete;
+
+    // Returns false at the end of the stream.
+    bool next(MemoryReference *ref);
+
+private:
+    bool fill();
+
+    gzFile file;
+    std::vector<uint8_t> buffer;
+    size_t buffer_pos;
+    size_t buffer_len;
+};
@@ -27,6 +27,7 @@
 #include <boost/serialization/string.hpp>
 #include <boost/serialization/version.hpp>
 
+#include <algorithm>
 #include <map>
 #include <deque>
 #include <set>
@@ -43,8 +44,8 @@ class Mouse : public PS2
 public:
     explicit Mouse(PIC *pic)
         : PS2(pic, 0xffe0, 7),
-          last_x(0),
-          last_y(0),
+          dx(0),
+          dy(0),
           capture_enabled(SDL_TRUE),
           left_down(false),
           right_down(false)
@@ -76,13 +77,21 @@ public:
         SDL_CaptureMouse(capture_enabled);
     }
 
+    void process_motion(const SDL_Event &e)
+    {
+        dx += e.motion.xrel;
+        dy -= e.motion.yrel;
+    }
+
+    // Motion is accumulated between packets and sent once there is room in
+    // the FIFO.
     void update()
     {
         // Avoid FIFO overflow
-        if (num_pending_bytes() >= 5)
+        if (num_pending_bytes() >= 5 || (dx == 0 && dy == 0))
             return;
 
-        poll_movement();
+        send_movement();
     }
 
     void process_event(SDL_Event e)
@@ -116,22 +125,27 @@ public:
     }
 
 private:
-    int last_x, last_y;
+    int dx, dy;
     SDL_bool capture_enabled;
     bool left_down, right_down;
 
-    void poll_movement()
+    static int clamp_delta(int v)
     {
-        int mouse_x, mouse_y;
-        SDL_GetMouseState(&mouse_x, &mouse_y);
-
-        if (mouse_x == last_x && mouse_y == last_y)
-            return;
+        return std::max(-255, std::min(255, v));
+    }
 
-        int x_delta = mouse_x - last_x;
-        int y_delta = -(mouse_y - last_y);
+    void send_movement()
+    {
+        // Deltas are 9 bit two's complement, anything larger is carried over
+        // into the next packet.
+        int x_delta = clamp_delta(dx);
+        int y_delta = clamp_delta(dy);
 
         uint8_t b = 0x08;
+        if (left_down)
+            b |= (1 << 0);
+        if (right_down)
+            b |= (1 << 1);
         if (x_delta < 0)
             b |= (1 << 4);
         if (y_delta < 0)
@@ -140,8 +154,8 @@ private:
         add_byte(x_delta);
         add_byte(y_delta);
 
-        last_x = mouse_x;
-        last_y = mouse_y;
+        dx -= x_delta;
+        dy -= y_delta;
     }
 
     friend class boost::serialization::access;
@@ -149,8 +163,8 @@ private:
     void serialize(Archive &ar, const unsigned int version)
     {
         // clang-format off
-        ar & last_x;
-        ar & last_y;
+        ar & dx;
+        ar & dy;
         ar & left_down;
         ar & right_down;
         // clang-format on
@@ -0,0 +1,102 @@
+// Copyright Jamie Iles, 2017
+//
+// This file is part of s80x86.
+//
+// s80x86 is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// s80x86 is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with s80x86.  If not, see <http://www.gnu.org/licenses/>.
+
+#include "PVDisk.h"
+
+const uint16_t PVDisk::id;
+
+PVDisk::PVDisk(Memory *mem, std::shared_ptr<DiskImage> disk)
+    : IOPorts(0xffd0, NUM_REGS),
+      mem(mem),
+      disk(disk),
+      block(DiskImage::block_size),
+      regs()
+{
+}
+
+void PVDisk::write8(uint16_t port_num, unsigned offs, uint8_t v)
+{
+    auto reg = port_num / sizeof(uint16_t);
+    auto shift = 8 * offs;
+    uint16_t mask = 0xff << shift;
+
+    if (reg >= NUM_REGS)
+        return;
+
+    if (reg == REG_STATUS) {
+        regs[REG_STATUS] = 0;
+        return;
+    }
+
+    regs[reg] &= ~mask;
+    regs[reg] |= static_cast<uint16_t>(v) << shift;
+
+    // Commands are issued by the final byte of the command register, word
+    // writes from the BIOS always reach it.
+    if (reg == REG_COMMAND && offs == 1)
+        run_command(regs[REG_COMMAND]);
+}
+
+uint8_t PVDisk::read8(uint16_t port_num, unsigned offs)
+{
+    auto reg = port_num / sizeof(uint16_t);
+    auto shift = 8 * offs;
+
+    if (reg == REG_COMMAND)
+        return id >> shift;
+    if (reg < NUM_REGS)
+        return regs[reg] >> shift;
+
+    return 0;
+}
+
+phys_addr PVDisk::buffer_address(size_t offs) const
+{
+    uint16_t ip = regs[REG_OFFSET] + offs;
+
+    return ((static_cast<phys_addr>(regs[REG_SEGMENT]) << 4) + ip) %
+           MEMORY_SIZE;
+}
+
+void PVDisk::run_command(uint16_t command)
+{
+    uint64_t lba = (static_cast<uint32_t>(regs[REG_LBA_HIGH]) << 16) |
+                   regs[REG_LBA_LOW];
+    size_t len = static_cast<size_t>(regs[REG_COUNT]) * DiskImage::block_size;
+
+    if ((command != CMD_READ && command != CMD_WRITE) ||
+        (lba + regs[REG_COUNT]) * DiskImage::block_size > disk->size()) {
+        regs[REG_STATUS] = status_done | status_error;
+        return;
+    }
+
+    for (size_t offs = 0; offs < len; offs += DiskImage::block_size) {
+        auto disk_offs = lba * DiskImage::block_size + offs;
+
+        if (command == CMD_READ) {
+            disk->read(disk_offs, block.data(), block.size());
+            for (size_t m = 0; m < block.size(); ++m)
+                mem->write<uint8_t>(buffer_address(offs + m), block[m]);
+        } else {
+            for (size_t m = 0; m < block.size(); ++m)
+                block[m] = mem->read<uint8_t>(buffer_address(offs + m));
+            disk->write(disk_offs, block.data(), block.size());
+        }
+    }
+
+    regs[REG_STATUS] = status_done;
+}
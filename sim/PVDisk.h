@@ -0,0 +1,88 @@
+// Copyright Jamie Iles, 2017
+//
+// This file is part of s80x86.
+//
+// s80x86 is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// s80x86 is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with s80x86.  If not, see <http://www.gnu.org/licenses/>.
+
+#pragma once
+
+#include <memory>
+#include <stdint.h>
+#include <vector>
+
+#include <boost/serialization/version.hpp>
+
+#include "CPU.h"
+#include "DiskImage.h"
+#include "Memory.h"
+
+// Simulator only paravirtual disk.  The guest programs the LBA, sector count
+// and a segment:offset buffer then writes a command, the sectors are copied
+// directly between the disk image and memory and the done bit is set before
+// the command write completes.
+//
+// Register map (16-bit, byte offsets from the base port):
+//   0x0: read: identification, write: command (1 = read, 2 = write)
+//   0x2: status, bit 0 done, bit 1 error, any write clears
+//   0x4: LBA[15:0]
+//   0x6: LBA[31:16]
+//   0x8: sector count
+//   0xa: buffer segment
+//   0xc: buffer offset
+class PVDisk : public IOPorts
+{
+public:
+    static const uint16_t id = 0x5056;
+
+    PVDisk(Memory *mem, std::shared_ptr<DiskImage> disk);
+    void write8(uint16_t port_num, unsigned offs, uint8_t v);
+    uint8_t read8(uint16_t port_num, unsigned offs);
+
+private:
+    enum Register {
+        REG_COMMAND,
+        REG_STATUS,
+        REG_LBA_LOW,
+        REG_LBA_HIGH,
+        REG_COUNT,
+        REG_SEGMENT,
+        REG_OFFSET,
+        NUM_REGS,
+    };
+
+    enum Command {
+        CMD_READ = 1,
+        CMD_WRITE = 2,
+    };
+
+    static const uint16_t status_done = 1 << 0;
+    static const uint16_t status_error = 1 << 1;
+
+    void run_command(uint16_t command);
+    phys_addr buffer_address(size_t offs) const;
+
+    Memory *mem;
+    std::shared_ptr<DiskImage> disk;
+    std::vector<uint8_t> block;
+    uint16_t regs[NUM_REGS];
+
+    friend class boost::serialization::access;
+    template <class Archive>
+    void serialize(Archive &ar, const unsigned int __unused version)
+    {
+        // clang-format off
+        ar & regs;
+        // clang-format on
+    }
+};
@@ -0,0 +1,230 @@
+// Copyright Jamie Iles, 2017
+//
+// This file is part of s80x86.
+//
+// s80x86 is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// s80x86 is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with s80x86.  If not, see <http://www.gnu.org/licenses/>.
+
+#include "Profiler.h"
+
+#include <boost/format.hpp>
+#include <cctype>
+#include <fstream>
+#include <regex>
+#include <sstream>
+#include <stdexcept>
+
+const int SymbolTable::any_segment;
+
+// Decimal, C style hex or NASM style hex with an h suffix.
+static unsigned long parse_number(const std::string &str)
+{
+    size_t end;
+    unsigned long v;
+
+    if (str.size() > 1 && tolower(str.back()) == 'h') {
+        v = std::stoul(str.substr(0, str.size() - 1), &end, 16);
+        ++end;
+    } else {
+        v = std::stoul(str, &end, 0);
+    }
+
+    if (end != str.size())
+        throw std::invalid_argument("invalid number " + str);
+
+    return v;
+}
+
+void SymbolTable::load(const std::string &spec)
+{
+    auto path = spec;
+    auto segment_override = false;
+    int segment = any_segment;
+
+    auto at = spec.rfind('@');
+    if (at != std::string::npos) {
+        path = spec.substr(0, at);
+        auto segment_str = spec.substr(at + 1);
+        if (segment_str.empty() || segment_str.size() > 4 ||
+            segment_str.find_first_not_of("0123456789abcdefABCDEF") !=
+                std::string::npos)
+            throw std::invalid_argument("invalid segment in " + spec);
+        segment = std::stoul(segment_str, nullptr, 16);
+        segment_override = true;
+    }
+
+    std::ifstream file(path);
+    if (!file.is_open())
+        throw std::runtime_error("Failed to open symbols " + path);
+    std::stringstream contents;
+    contents << file.rdbuf();
+    auto str = contents.str();
+
+    std::istringstream in(str);
+    if (str.find("NASM Map file") != std::string::npos)
+        load_nasm_map(in, segment);
+    else if (str.find("Linker script and memory map") != std::string::npos)
+        load_link_map(in, segment_override ? segment : bios_segment);
+    else
+        load_nasm_listing(in, segment);
+}
+
+void SymbolTable::load_link_map(std::istream &in, int segment)
+{
+    // Symbol definitions are an address and a name alone on a line, section
+    // and input file lines have more fields and assignments have an "=".
+    static const std::regex symbol_re(
+        "^\\s+0x([0-9a-fA-F]+)\\s+([A-Za-z_.$][A-Za-z0-9_.$]*)\\s*$");
+    std::string line;
+
+    while (std::getline(in, line)) {
+        std::smatch m;
+        if (std::regex_match(line, m, symbol_re))
+            add(segment, std::stoul(m[1], nullptr, 16), m[2]);
+    }
+}
+
+void SymbolTable::load_nasm_map(std::istream &in, int segment)
+{
+    static const std::regex symbol_re(
+        "^\\s*[0-9a-fA-F]+\\s+([0-9a-fA-F]+)\\s+(\\S+)\\s*$");
+    std::string line;
+    bool in_symbols = false;
+
+    while (std::getline(in, line)) {
+        if (line.compare(0, 3, "-- ") == 0) {
+            in_symbols = line.compare(0, 10, "-- Symbols") == 0;
+            continue;
+        }
+
+        std::smatch m;
+        if (in_symbols && std::regex_match(line, m, symbol_re))
+            add(segment, std::stoul(m[1], nullptr, 16), m[2]);
+    }
+}
+
+void SymbolTable::load_nasm_listing(std::istream &in, int segment)
+{
+    // Each line is a line number, the offset and generated bytes if there
+    // are any, a macro nesting level and then the source.  Labels on lines
+    // without code take the offset of the next line that has code, local
+    // labels are skipped.
+    static const std::regex code_re(
+        "^\\s*\\d+\\s+([0-9A-F]{8})\\s+\\S+\\s+(?:<\\d+>\\s*)?(.*)$");
+    static const std::regex source_re("^\\s*\\d+\\s+(?:<\\d+>\\s*)?(.*)$");
+    static const std::regex label_re("^([A-Za-z_?][A-Za-z0-9_$#@~.?]*):");
+    static const std::regex org_re("^org\\s+(\\S+)", std::regex::icase);
+    std::vector<std::string> pending_labels;
+    unsigned long origin = 0;
+    std::string line;
+
+    while (std::getline(in, line)) {
+        std::smatch m;
+        std::string source;
+        bool has_code = std::regex_match(line, m, code_re);
+
+        if (has_code) {
+            auto offset = origin + std::stoul(m[1], nullptr, 16);
+            source = m[2];
+            for (auto &label : pending_labels)
+                add(segment, offset, label);
+            pending_labels.clear();
+
+            std::smatch label;
+            if (std::regex_search(source, label, label_re))
+                add(segment, offset, label[1]);
+        } else if (std::regex_match(line, m, source_re)) {
+            source = m[1];
+
+            std::smatch label;
+            if (std::regex_search(source, label, label_re))
+                pending_labels.push_back(label[1]);
+            else if (std::regex_search(source, label, org_re))
+                origin = parse_number(label[1]);
+        }
+    }
+}
+
+void SymbolTable::add(int segment,
+                      unsigned long offset,
+                      const std::string &name)
+{
+    if (offset > 0xffff)
+        return;
+
+    symbols[segment][offset] = name;
+}
+
+std::string SymbolTable::lookup(uint16_t segment, uint16_t offset) const
+{
+    auto table = symbols.find(segment);
+    if (table == symbols.end())
+        table = symbols.find(any_segment);
+    if (table == symbols.end())
+        return "";
+
+    auto it = table->second.upper_bound(offset);
+    if (it == table->second.begin())
+        return "";
+
+    return (--it)->second;
+}
+
+Profiler::Profiler(const SymbolTable *symbols)
+    : symbols(symbols), samples(), total_samples(0)
+{
+}
+
+void Profiler::add_sample(uint16_t cs,
+                          uint16_t ip,
+                          const std::vector<uint16_t> &callers,
+                          unsigned long count)
+{
+    std::vector<uint16_t> key;
+
+    key.reserve(2 + callers.size());
+    key.push_back(cs);
+    key.push_back(ip);
+    key.insert(key.end(), callers.begin(), callers.end());
+
+    samples[key] += count;
+    total_samples += count;
+}
+
+std::string Profiler::frame_name(uint16_t cs, uint16_t ip) const
+{
+    auto name = symbols->lookup(cs, ip);
+
+    return name.empty() ? (boost::format("%04x:%04x") % cs % ip).str() : name;
+}
+
+void Profiler::write_folded(std::ostream &out) const
+{
+    // Different addresses in the same functions fold into one stack.
+    std::map<std::string, unsigned long> stacks;
+
+    for (auto &sample : samples) {
+        auto &key = sample.first;
+        auto cs = key[0];
+        std::string stack;
+
+        for (auto caller = key.rbegin(); caller != key.rend() - 2; ++caller)
+            stack += frame_name(cs, *caller) + ";";
+        stack += frame_name(cs, key[1]);
+
+        stacks[stack] += sample.second;
+    }
+
+    for (auto &stack : stacks)
+        out << stack.first << " " << stack.second << "\n";
+}
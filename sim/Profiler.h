@@ -0,0 +1,93 @@
+// Copyright Jamie Iles, 2017
+//
+// This file is part of s80x86.
+//
+// s80x86 is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// s80x86 is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with s80x86.  If not, see <http://www.gnu.org/licenses/>.
+
+#pragma once
+
+#include <istream>
+#include <map>
+#include <ostream>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+// Guest code symbols, each covering the addresses from its offset up to the
+// next symbol in the same segment.  Symbols loaded for any segment are used
+// for segments without a table of their own, which suits DOS programs that
+// are loaded wherever there is free memory.
+class SymbolTable
+{
+public:
+    static const int any_segment = -1;
+    static const uint16_t bios_segment = 0xf000;
+
+    SymbolTable() : symbols()
+    {
+    }
+
+    // Load "<path>[@<segment>]" with the format detected from the contents.
+    // Link maps default to the BIOS segment, NASM maps and listings to any
+    // segment.
+    void load(const std::string &spec);
+    // GNU ld -Map output, as produced for bios/bios.x.
+    void load_link_map(std::istream &in, int segment);
+    // NASM map files, from the [map] directive.
+    void load_nasm_map(std::istream &in, int segment);
+    // NASM -l listings.  Offsets in a listing are relative to the section so
+    // an org directive in the source is added to them.
+    void load_nasm_listing(std::istream &in, int segment);
+    // The containing symbol or an empty string if there is none.
+    std::string lookup(uint16_t segment, uint16_t offset) const;
+
+private:
+    void add(int segment, unsigned long offset, const std::string &name);
+
+    std::map<int, std::map<uint16_t, std::string>> symbols;
+};
+
+// Aggregates sampled guest call stacks.  Samples are counted by raw address
+// and only symbolized when written so that sampling stays cheap.
+class Profiler
+{
+public:
+    explicit Profiler(const SymbolTable *symbols);
+    Profiler(const Profiler &) = delete;
+    Profiler &operator=(const Profiler &) = delete;
+
+    // callers are near return addresses in the same code segment, innermost
+    // first.  count is the number of sampling intervals that the stack
+    // stands for.
+    void add_sample(uint16_t cs,
+                    uint16_t ip,
+                    const std::vector<uint16_t> &callers,
+                    unsigned long count = 1);
+    unsigned long num_samples() const
+    {
+        return total_samples;
+    }
+    // One line per distinct stack, outermost frame first, separated by
+    // semicolons and followed by the sample count, as read by flamegraph.pl
+    // and speedscope.  Frames without a symbol are written as CS:IP.
+    void write_folded(std::ostream &out) const;
+
+private:
+    std::string frame_name(uint16_t cs, uint16_t ip) const;
+
+    const SymbolTable *symbols;
+    // Keyed by CS, IP then the callers.
+    std::map<std::vector<uint16_t>, unsigned long> samples;
+    unsigned long total_samples;
+};
@@ -17,9 +17,11 @@
 
 #include <stdexcept>
 #include <fstream>
+#include <config.h>
 #include <VerilogDriver.h>
 #include <VRTLCPU.h>
 #include <boost/algorithm/string/replace.hpp>
+#include <boost/format.hpp>
 
 #include "svdpi.h"
 
@@ -34,6 +36,7 @@ union reg_converter {
 };
 
 static const int max_cycles_per_step = 100000000;
+static const int max_quiesce_cycles = 10000;
 
 double cur_time_stamp = 0;
 double sc_time_stamp()
@@ -42,21 +45,34 @@ double sc_time_stamp()
 }
 
 template <bool debug_enabled>
-RTLCPU<debug_enabled>::RTLCPU(const std::string &test_name)
+RTLCPU<debug_enabled>::RTLCPU(const std::string &test_name,
+                              Memory *shared_mem,
+                              const std::string &reset_image)
     : VerilogDriver<VRTLCPU, debug_enabled>(test_name),
-      SimCPU(test_name),
+      SimCPU(test_name, shared_mem),
       mem_in_progress(false),
       io_in_progress(false),
       mem_latency(0),
       test_name(test_name),
-      is_stopped(true)
+      is_stopped(true),
+      backdoor_check(false),
+      reset_cycle(~0LLU),
+      microcode_profiler(nullptr),
+      debug_proc_running(false),
+      sdram(nullptr)
 {
     core_scope = svGetScopeFromName("TOP.RTLCPU.Core");
+    cache_scope = svGetScopeFromName("TOP.RTLCPU.Cache");
     microcode_scope = svGetScopeFromName("TOP.RTLCPU.Core.Microcode");
 
     this->dut.debug_seize = 1;
     this->dut.cache_enabled = 0;
-    this->reset();
+    if (reset_image.empty()) {
+        this->reset();
+    } else {
+        restore_model(reset_image);
+        reset_cycle = this->cur_cycle();
+    }
 
     this->periodic(ClockSetup, [&] { this->mem_access(); });
     this->periodic(ClockSetup, [&] { this->io_access(); });
@@ -117,6 +133,9 @@ int RTLCPU<debug_enabled>::debug_run_proc(
     unsigned addr,
     std::function<void(unsigned long)> io_callback)
 {
+    // Procedure 0 steps the guest, the rest only serve the debugger.
+    debug_proc_running = addr != 0x00;
+
     this->after_n_cycles(0, [&] {
         this->dut.debug_addr = addr;
         this->dut.debug_run = 1;
@@ -144,6 +163,8 @@ int RTLCPU<debug_enabled>::debug_run_proc(
         io_callback(this->cur_cycle());
     }
 
+    debug_proc_running = false;
+
     if (cycle_count >= max_cycles_per_step)
         throw std::runtime_error("execution timeout");
 
@@ -183,7 +204,7 @@ void RTLCPU<debug_enabled>::start_instruction()
 
     // Give the FIFO sufficient time to fill so that we go straight to the
     // instruction and can detect the first real yield.
-    this->cycle((mem_latency + 1) * 128);
+    this->cycle((max_mem_latency() + 1) * 128);
 
     this->after_n_cycles(0, [&] {
         this->dut.debug_addr = 0;
@@ -229,6 +250,46 @@ void RTLCPU<debug_enabled>::write_coverage()
 #endif
 }
 
+template <bool debug_enabled>
+void RTLCPU<debug_enabled>::start_microcode_profile()
+{
+    if (microcode_profiler)
+        return;
+
+    svSetScope(microcode_scope);
+    microcode_profiler = std::make_unique<MicrocodeProfiler>(
+        this->dut.get_microcode_num_instructions());
+    this->periodic(ClockCapture, [&] { this->sample_microcode_profile(); });
+}
+
+template <bool debug_enabled>
+void RTLCPU<debug_enabled>::sample_microcode_profile()
+{
+    if (debug_proc_running)
+        return;
+
+    auto address = get_microcode_address();
+
+    // {starting, divide_busy, loadstore_busy, opcode[7:0]}
+    svSetScope(core_scope);
+    auto state = this->dut.get_profile_state();
+
+    microcode_profiler->add_sample(address, state & 0xff, (state >> 8) & 0x3,
+                                   state & (1 << 10));
+}
+
+template <bool debug_enabled>
+void RTLCPU<debug_enabled>::write_microcode_profile(const std::string &path)
+{
+    if (!microcode_profiler)
+        throw std::runtime_error("Microcode profiling has not been started");
+
+    std::ofstream out(path);
+    if (!out.good())
+        throw std::runtime_error("Failed to open " + path);
+    microcode_profiler->write(out);
+}
+
 template <bool debug_enabled>
 void RTLCPU<debug_enabled>::reset()
 {
@@ -238,10 +299,67 @@ void RTLCPU<debug_enabled>::reset()
     pending_irq = 0;
     int_in_progress = false;
 
+    if (this->cur_cycle() == reset_cycle)
+        return;
+
     VerilogDriver<VRTLCPU, debug_enabled>::reset();
 
     while (get_microcode_address() != 0x102)
         this->cycle();
+
+    reset_cycle = this->cur_cycle();
+}
+
+template <bool debug_enabled>
+void RTLCPU<debug_enabled>::save_model(const std::string &path)
+{
+#if S80X86_RTL_SAVABLE
+    // Deferred events can't be saved, let bus transactions such as
+    // prefetches complete first.
+    for (int i = 0; this->has_pending_events(); ++i) {
+        if (i == max_quiesce_cycles)
+            throw std::runtime_error("Failed to quiesce RTLCPU for saving");
+        this->cycle();
+    }
+
+    VerilatedSave os;
+    os.open(path.c_str());
+    if (!os.isOpen())
+        throw std::runtime_error("Failed to open " + path);
+
+    VerilogDriver<VRTLCPU, debug_enabled>::save_model(os);
+    vluint32_t latency = mem_latency;
+    os << latency << pending_irq << int_in_progress << is_stopped;
+    os.close();
+#else
+    (void)path;
+    throw std::runtime_error("Failed to save RTLCPU, multithreaded models "
+                             "can't be saved");
+#endif
+}
+
+template <bool debug_enabled>
+void RTLCPU<debug_enabled>::restore_model(const std::string &path)
+{
+#if S80X86_RTL_SAVABLE
+    VerilatedRestore is;
+    is.open(path.c_str());
+    if (!is.isOpen())
+        throw std::runtime_error("Failed to open " + path);
+
+    VerilogDriver<VRTLCPU, debug_enabled>::restore_model(is);
+    vluint32_t latency = 0;
+    is >> latency >> pending_irq >> int_in_progress >> is_stopped;
+    is.close();
+
+    mem_latency = latency;
+    mem_in_progress = false;
+    io_in_progress = false;
+#else
+    (void)path;
+    throw std::runtime_error("Failed to restore RTLCPU, multithreaded models "
+                             "can't be restored");
+#endif
 }
 
 template <bool debug_enabled>
@@ -349,6 +467,47 @@ uint16_t RTLCPU<debug_enabled>::read_sr(GPR regnum) const
     return this->dut.debug_val;
 }
 
+template <bool debug_enabled>
+RegisterState RTLCPU<debug_enabled>::read_all_regs() const
+{
+    auto self = const_cast<RTLCPU<debug_enabled> *>(this);
+
+    svSetScope(core_scope);
+    self->dut.clear_tmp_log();
+    self->debug_run_proc(0x30); // Read all registers
+
+    RegisterState state;
+    svSetScope(core_scope);
+    for (int r = 0; r < NUM_16BIT_REGS; ++r)
+        state.registers[r] = self->dut.get_tmp_log(r);
+    state.flags = self->dut.get_tmp_log(NUM_16BIT_REGS);
+
+    return state;
+}
+
+// Each register goes through TEMP with its own debug procedure rather than
+// being staged in guest memory, which would pull lines into the cache and
+// change the timing of the code that follows.  IP is written last so that
+// the prefetcher is given the new CS:IP.
+template <bool debug_enabled>
+void RTLCPU<debug_enabled>::write_all_regs(const RegisterState &state)
+{
+    for (int r = 0; r < IP; ++r)
+        write_reg(static_cast<GPR>(r), state.registers[r]);
+    write_flags(state.flags);
+    write_ip(state.registers[IP]);
+}
+
+template <bool debug_enabled>
+bool RTLCPU<debug_enabled>::has_trapped()
+{
+    auto int_cs = read_mem16(0, VEC_INT + 2);
+    auto int_ip = read_mem16(0, VEC_INT + 0);
+    auto state = read_all_regs();
+
+    return state.registers[CS] == int_cs && state.registers[IP] == int_ip;
+}
+
 template <bool debug_enabled>
 size_t RTLCPU<debug_enabled>::get_and_clear_instr_length()
 {
@@ -411,12 +570,24 @@ uint16_t RTLCPU<debug_enabled>::read_flags() const
 }
 
 template <bool debug_enabled>
-bool RTLCPU<debug_enabled>::has_trapped()
+void RTLCPU<debug_enabled>::set_sdram_timing(const SDRAMTiming &timing)
 {
-    auto int_cs = read_mem16(0, VEC_INT + 2);
-    auto int_ip = read_mem16(0, VEC_INT + 0);
+    auto model = std::make_unique<SDRAMModel>(timing);
 
-    return read_sr(CS) == int_cs && read_ip() == int_ip;
+    if (model->worst_case_latency() >= this->max_deferred_delta)
+        throw std::invalid_argument(
+            (boost::format("SDRAM timing has a worst case latency of %d "
+                           "cycles, the limit is %d") %
+             model->worst_case_latency() % (this->max_deferred_delta - 1))
+                .str());
+
+    sdram = std::move(model);
+}
+
+template <bool debug_enabled>
+int RTLCPU<debug_enabled>::max_mem_latency() const
+{
+    return sdram ? sdram->worst_case_latency() : mem_latency;
 }
 
 template <bool debug_enabled>
@@ -431,7 +602,11 @@ void RTLCPU<debug_enabled>::mem_access()
         this->dut.q_m_data_in = v;
     });
     mem_in_progress = true;
-    this->after_n_cycles(mem_latency, [&] {
+    auto latency =
+        sdram ? sdram->access(this->cur_cycle(), this->dut.q_m_addr << 1,
+                              this->dut.q_m_wr_en)
+              : mem_latency;
+    this->after_n_cycles(latency, [&] {
         this->dut.q_m_ack = 1;
         this->after_n_cycles(1, [&] {
             this->dut.q_m_ack = 0;
@@ -480,18 +655,62 @@ uint16_t RTLCPU<debug_enabled>::get_microcode_address()
     return this->dut.get_microcode_address();
 }
 
+template <bool debug_enabled>
+void RTLCPU<debug_enabled>::backdoor_write8(phys_addr addr, uint8_t val)
+{
+    svSetScope(cache_scope);
+    // Let any line fill or flush complete so that it can't overwrite the
+    // new value.
+    while (this->dut.cache_busy())
+        this->cycle();
+
+    this->mem.template write<uint8_t>(addr, val);
+    this->dut.cache_write_byte(addr, val);
+}
+
+template <bool debug_enabled>
+uint8_t RTLCPU<debug_enabled>::backdoor_read8(phys_addr addr)
+{
+    svSetScope(cache_scope);
+    while (this->dut.cache_busy())
+        this->cycle();
+
+    // A dirty line is newer than memory.
+    auto cached = this->dut.cache_read_byte(addr);
+
+    return cached >= 0 ? cached
+                       : this->mem.template read<uint8_t>(addr);
+}
+
+template <bool debug_enabled>
+void RTLCPU<debug_enabled>::check_backdoor(uint16_t segment,
+                                           uint16_t addr,
+                                           unsigned width)
+{
+    uint16_t expected = width == 1 ? debug_read_mem8(segment, addr)
+                                   : debug_read_mem16(segment, addr);
+    uint16_t actual = backdoor_read8(get_phys_addr(segment, addr));
+    if (width == 2)
+        actual |= backdoor_read8(get_phys_addr(
+                      segment, static_cast<uint16_t>(addr + 1)))
+                  << 8;
+
+    if (actual != expected)
+        throw std::runtime_error(
+            (boost::format("Backdoor access to %04x:%04x read %x, "
+                           "debug port read %x") %
+             segment % addr % actual % expected)
+                .str());
+}
+
 template <bool debug_enabled>
 void RTLCPU<debug_enabled>::write_mem8(uint16_t segment,
                                        uint16_t addr,
                                        uint8_t val)
 {
-    auto prev_ds = read_reg(DS);
-
-    write_reg(DS, segment);
-    write_mar(addr);
-    write_mdr(val);
-    debug_run_proc(0x23); // Write mem 8
-    write_reg(DS, prev_ds);
+    backdoor_write8(get_phys_addr(segment, addr), val);
+    if (backdoor_check)
+        check_backdoor(segment, addr, 1);
 }
 
 template <bool debug_enabled>
@@ -499,13 +718,11 @@ void RTLCPU<debug_enabled>::write_mem16(uint16_t segment,
                                         uint16_t addr,
                                         uint16_t val)
 {
-    auto prev_ds = read_reg(DS);
-
-    write_reg(DS, segment);
-    write_mar(addr);
-    write_mdr(val);
-    debug_run_proc(0x24); // Write mem 16
-    write_reg(DS, prev_ds);
+    backdoor_write8(get_phys_addr(segment, addr), val & 0xff);
+    backdoor_write8(
+        get_phys_addr(segment, static_cast<uint16_t>(addr + 1)), val >> 8);
+    if (backdoor_check)
+        check_backdoor(segment, addr, 2);
 }
 
 template <bool debug_enabled>
@@ -513,17 +730,8 @@ void RTLCPU<debug_enabled>::write_vector8(uint16_t segment,
                                           uint16_t addr,
                                           const std::vector<uint8_t> &v)
 {
-    auto prev_ds = read_reg(DS);
-
-    write_reg(DS, segment);
-
-    write_mar(addr);
-    for (auto &b : v) {
-        write_mdr(b);
-        debug_run_proc(0x23); // Write mem 8
-    }
-
-    write_reg(DS, prev_ds);
+    for (auto &b : v)
+        write_mem8(segment, addr++, b);
 }
 
 template <bool debug_enabled>
@@ -531,17 +739,10 @@ void RTLCPU<debug_enabled>::write_vector16(uint16_t segment,
                                            uint16_t addr,
                                            const std::vector<uint16_t> &v)
 {
-    auto prev_ds = read_reg(DS);
-
-    write_reg(DS, segment);
-
-    write_mar(addr);
-    for (auto &b : v) {
-        write_mdr(b);
-        debug_run_proc(0x24); // Write mem 16
+    for (auto &w : v) {
+        write_mem16(segment, addr, w);
+        addr += sizeof(uint16_t);
     }
-
-    write_reg(DS, prev_ds);
 }
 
 template <bool debug_enabled>
@@ -569,6 +770,35 @@ void RTLCPU<debug_enabled>::write_mdr(uint16_t v)
 
 template <bool debug_enabled>
 uint8_t RTLCPU<debug_enabled>::read_mem8(uint16_t segment, uint16_t addr)
+{
+    if (backdoor_check)
+        check_backdoor(segment, addr, 1);
+
+    return backdoor_read8(get_phys_addr(segment, addr));
+}
+
+template <bool debug_enabled>
+uint16_t RTLCPU<debug_enabled>::read_mem16(uint16_t segment, uint16_t addr)
+{
+    if (backdoor_check)
+        check_backdoor(segment, addr, 2);
+
+    return backdoor_read8(get_phys_addr(segment, addr)) |
+           (backdoor_read8(get_phys_addr(
+                segment, static_cast<uint16_t>(addr + 1)))
+            << 8);
+}
+
+template <bool debug_enabled>
+uint32_t RTLCPU<debug_enabled>::read_mem32(uint16_t segment, uint16_t addr)
+{
+    return read_mem16(segment, addr) |
+           (static_cast<uint32_t>(read_mem16(segment, addr + 2)) << 16);
+}
+
+template <bool debug_enabled>
+uint8_t RTLCPU<debug_enabled>::debug_read_mem8(uint16_t segment,
+                                               uint16_t addr)
 {
     auto prev_ds = read_reg(DS);
 
@@ -584,7 +814,8 @@ uint8_t RTLCPU<debug_enabled>::read_mem8(uint16_t segment, uint16_t addr)
 }
 
 template <bool debug_enabled>
-uint16_t RTLCPU<debug_enabled>::read_mem16(uint16_t segment, uint16_t addr)
+uint16_t RTLCPU<debug_enabled>::debug_read_mem16(uint16_t segment,
+                                                 uint16_t addr)
 {
     auto prev_ds = read_reg(DS);
 
@@ -599,13 +830,6 @@ uint16_t RTLCPU<debug_enabled>::read_mem16(uint16_t segment, uint16_t addr)
     return val;
 }
 
-template <bool debug_enabled>
-uint32_t RTLCPU<debug_enabled>::read_mem32(uint16_t segment, uint16_t addr)
-{
-    return read_mem16(segment, addr) |
-           (static_cast<uint32_t>(read_mem16(segment, addr + 2)) << 16);
-}
-
 template <bool debug_enabled>
 void RTLCPU<debug_enabled>::write_io8(uint32_t addr, uint8_t val)
 {
@@ -640,7 +864,14 @@ uint16_t RTLCPU<debug_enabled>::read_io16(uint32_t addr)
     return this->dut.debug_val;
 }
 
-template RTLCPU<verilator_debug_enabled>::RTLCPU(const std::string &);
+template RTLCPU<verilator_debug_enabled>::RTLCPU(const std::string &,
+                                                 Memory *,
+                                                 const std::string &);
 template void RTLCPU<verilator_debug_enabled>::idle(int count);
 template int RTLCPU<verilator_debug_enabled>::time_step();
 template void RTLCPU<verilator_debug_enabled>::enable_cache();
+template void RTLCPU<verilator_debug_enabled>::set_sdram_timing(
+    const SDRAMTiming &);
+template void RTLCPU<verilator_debug_enabled>::save_model(const std::string &);
+template void RTLCPU<verilator_debug_enabled>::restore_model(
+    const std::string &);
@@ -0,0 +1,104 @@
+// Copyright Jamie Iles, 2017
+//
+// This file is part of s80x86.
+//
+// s80x86 is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// s80x86 is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with s80x86.  If not, see <http://www.gnu.org/licenses/>.
+
+#include "MicrocodeProfiler.h"
+
+#include <boost/format.hpp>
+
+const unsigned MicrocodeProfiler::loadstore_busy;
+const unsigned MicrocodeProfiler::divide_busy;
+const uint16_t MicrocodeProfiler::next_instruction_address;
+const uint16_t MicrocodeProfiler::debug_wait_address;
+const uint16_t MicrocodeProfiler::modrm_wait_address;
+
+MicrocodeProfiler::MicrocodeProfiler(size_t num_addresses)
+    : addresses(num_addresses, Counters{}),
+      opcodes(),
+      instructions(),
+      pending_dispatch(0),
+      instruction_started(false),
+      total_cycles(0),
+      total_instructions(0)
+{
+}
+
+void MicrocodeProfiler::add_sample(uint16_t address,
+                                   uint8_t opcode,
+                                   unsigned stalls,
+                                   bool starting)
+{
+    // Stopped for the debugger.
+    if (address == debug_wait_address || address >= addresses.size())
+        return;
+
+    ++total_cycles;
+    auto &counters = addresses[address];
+    ++counters[Cycles];
+
+    if (address == next_instruction_address ||
+        address == modrm_wait_address) {
+        ++counters[Dispatch];
+        ++pending_dispatch;
+        instruction_started = starting;
+        return;
+    }
+
+    // The opcode is updated as the instruction starts, so the dispatch
+    // cycles are now known to belong to it.
+    auto &op = opcodes[opcode];
+    if (instruction_started) {
+        ++instructions[opcode];
+        ++total_instructions;
+        op[Cycles] += pending_dispatch;
+        op[Dispatch] += pending_dispatch;
+        pending_dispatch = 0;
+    }
+    instruction_started = starting;
+
+    ++op[Cycles];
+    // Only the first unit is counted when several are busy.
+    if (stalls & loadstore_busy) {
+        ++counters[MemoryStall];
+        ++op[MemoryStall];
+    } else if (stalls & divide_busy) {
+        ++counters[DivideStall];
+        ++op[DivideStall];
+    }
+}
+
+void MicrocodeProfiler::write(std::ostream &out) const
+{
+    auto write_counters = [&out](const Counters &c) {
+        for (auto v : c)
+            out << " " << v;
+        out << std::endl;
+    };
+
+    for (size_t m = 0; m < addresses.size(); ++m) {
+        if (!addresses[m][Cycles])
+            continue;
+        out << boost::format("address %03x") % m;
+        write_counters(addresses[m]);
+    }
+
+    for (size_t m = 0; m < opcodes.size(); ++m) {
+        if (!opcodes[m][Cycles])
+            continue;
+        out << boost::format("opcode %02x %lu") % m % instructions[m];
+        write_counters(opcodes[m]);
+    }
+}
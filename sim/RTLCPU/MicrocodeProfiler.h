@@ -0,0 +1,83 @@
+// Copyright Jamie Iles, 2017
+//
+// This file is part of s80x86.
+//
+// s80x86 is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// s80x86 is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with s80x86.  If not, see <http://www.gnu.org/licenses/>.
+
+#pragma once
+
+#include <array>
+#include <ostream>
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+// Histograms the cycles spent at each microcode address and in each x86
+// opcode.  Cycles that the core is stalled are counted against the owning
+// address and instruction by the unit that stalled it, and the cycles spent
+// waiting for the next instruction to be fetched and decoded are counted
+// against the instruction once it starts.
+class MicrocodeProfiler
+{
+public:
+    enum Counter {
+        Cycles,
+        MemoryStall,
+        DivideStall,
+        Dispatch,
+        NumCounters
+    };
+
+    // The stall mask passed to add_sample.
+    static const unsigned loadstore_busy = 1 << 0;
+    static const unsigned divide_busy = 1 << 1;
+
+    static const uint16_t next_instruction_address = 0x100;
+    static const uint16_t debug_wait_address = 0x102;
+    static const uint16_t modrm_wait_address = 0x12e;
+
+    explicit MicrocodeProfiler(size_t num_addresses);
+
+    // One sample per clock cycle.  opcode is the current instruction and
+    // starting is set on the cycle that the next instruction is read from
+    // the prefetch queue.
+    void add_sample(uint16_t address,
+                    uint8_t opcode,
+                    unsigned stalls,
+                    bool starting);
+    unsigned long num_cycles() const
+    {
+        return total_cycles;
+    }
+    unsigned long num_instructions() const
+    {
+        return total_instructions;
+    }
+    // "address <addr> <counters>" and
+    // "opcode <opcode> <instructions> <counters>" lines with the address and
+    // opcode in hex and the counters in Counter order.  Only addresses and
+    // opcodes with cycles are written.
+    void write(std::ostream &out) const;
+
+private:
+    typedef std::array<unsigned long, NumCounters> Counters;
+
+    std::vector<Counters> addresses;
+    std::array<Counters, 256> opcodes;
+    std::array<unsigned long, 256> instructions;
+    unsigned long pending_dispatch;
+    bool instruction_started;
+    unsigned long total_cycles;
+    unsigned long total_instructions;
+};
@@ -19,13 +19,16 @@
 
 #include <functional>
 #include <map>
+#include <memory>
 #include <string>
 
 #include <VerilogDriver.h>
 #include <VRTLCPU.h>
 
 #include "CPU.h"
+#include "MicrocodeProfiler.h"
 #include "RegisterFile.h"
+#include "SDRAMModel.h"
 
 static inline void null_io(unsigned long __unused v)
 {
@@ -35,12 +38,18 @@ template <bool debug_enabled = verilator_debug_enabled>
 class RTLCPU : public VerilogDriver<VRTLCPU, debug_enabled>, public SimCPU
 {
 public:
-    RTLCPU(const std::string &test_name);
+    // With a reset image the model is restored from it rather than
+    // simulating the reset sequence.
+    RTLCPU(const std::string &test_name,
+           Memory *shared_mem = nullptr,
+           const std::string &reset_image = "");
     void enable_cache();
     void write_coverage();
     void reset();
     void write_reg(GPR regnum, uint16_t val);
     uint16_t read_reg(GPR regnum) const;
+    RegisterState read_all_regs() const;
+    void write_all_regs(const RegisterState &state);
     void start_instruction();
     void cycle_cpu()
     {
@@ -94,6 +103,21 @@ public:
             io[p->get_base() + m * sizeof(uint16_t)] = p;
     }
 
+    // Memory is normally accessed directly, keeping the cache coherent,
+    // rather than through the debug procedures.  With checking enabled every
+    // access is compared against the debug port and a mismatch throws.
+    void set_backdoor_check(bool check)
+    {
+        backdoor_check = check;
+    }
+
+    // Save and restore the complete RTL state, including the prefetch FIFO,
+    // cache and microcode sequencer, once any bus transactions in flight
+    // have completed.  Memory is not included, it is part of the SimCPU
+    // state.  Unavailable for multithreaded models.
+    void save_model(const std::string &path);
+    void restore_model(const std::string &path);
+
     void write_vector8(uint16_t segment,
                        uint16_t addr,
                        const std::vector<uint8_t> &v);
@@ -120,14 +144,57 @@ public:
         pending_irq = irq_num;
     }
 
+    virtual int take_pending_irq()
+    {
+        auto irq_num = pending_irq;
+        pending_irq = 0;
+
+        return irq_num;
+    }
+
     unsigned long cycle_count() const
     {
         return static_cast<unsigned long>(this->cur_cycle());
     }
 
+    void start_waveform(const std::string &path, int depth)
+    {
+        VerilogDriver<VRTLCPU, debug_enabled>::start_waveform(path, depth);
+    }
+
+    void stop_waveform()
+    {
+        VerilogDriver<VRTLCPU, debug_enabled>::stop_waveform();
+    }
+
+    void waveform_window(unsigned long start_cycle,
+                         unsigned long stop_cycle,
+                         const std::string &path,
+                         int depth)
+    {
+        VerilogDriver<VRTLCPU, debug_enabled>::waveform_window(
+            start_cycle, stop_cycle, path, depth);
+    }
+
+    // Profile each following cycle by microcode address and opcode.  The
+    // debug procedures used to access the CPU while attached are excluded.
+    void start_microcode_profile();
+    void write_microcode_profile(const std::string &path);
+
+    // Time memory accesses with an SDRAM model rather than the fixed
+    // latency.  Throws std::invalid_argument if an access could take longer
+    // than deferred events allow.
+    void set_sdram_timing(const SDRAMTiming &timing);
+    const SDRAMModel *sdram_model() const
+    {
+        return sdram.get();
+    }
+
 private:
     uint16_t get_microcode_address();
+    void sample_microcode_profile();
     void mem_access();
+    int max_mem_latency() const;
     void io_access();
     uint16_t read_ip() const;
     uint16_t read_sr(GPR regnum) const;
@@ -139,6 +206,11 @@ private:
     void debug_write_data(uint16_t v);
     void write_mar(uint16_t v);
     void write_mdr(uint16_t v);
+    void backdoor_write8(phys_addr addr, uint8_t val);
+    uint8_t backdoor_read8(phys_addr addr);
+    void check_backdoor(uint16_t segment, uint16_t addr, unsigned width);
+    uint8_t debug_read_mem8(uint16_t segment, uint16_t addr);
+    uint16_t debug_read_mem16(uint16_t segment, uint16_t addr);
 
     bool mem_in_progress;
     bool io_in_progress;
@@ -150,4 +222,12 @@ private:
     bool int_in_progress;
     svScope microcode_scope;
     svScope core_scope;
+    svScope cache_scope;
+    bool backdoor_check;
+    // The cycle that the last reset completed on, a reset with no cycles
+    // since is a no-op.
+    vluint64_t reset_cycle;
+    std::unique_ptr<MicrocodeProfiler> microcode_profiler;
+    bool debug_proc_running;
+    std::unique_ptr<SDRAMModel> sdram;
 };
@@ -0,0 +1,209 @@
+// Copyright Jamie Iles, 2017
+//
+// This file is part of s80x86.
+//
+// s80x86 is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// s80x86 is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with s80x86.  If not, see <http://www.gnu.org/licenses/>.
+
+#include "SDRAMModel.h"
+
+#include <algorithm>
+#include <boost/format.hpp>
+#include <sstream>
+#include <stdexcept>
+
+static bool is_power_of_2(int v)
+{
+    return v > 0 && (v & (v - 1)) == 0;
+}
+
+SDRAMTiming::SDRAMTiming(const std::string &spec) : SDRAMTiming()
+{
+    std::istringstream fields(spec);
+    std::string field;
+
+    while (std::getline(fields, field, ',')) {
+        auto eq = field.find('=');
+        auto key = field.substr(0, eq);
+        auto value = eq == std::string::npos ? "" : field.substr(eq + 1);
+
+        try {
+            if (key == "banks")
+                banks = std::stoi(value);
+            else if (key == "columns")
+                column_bits = std::stoi(value);
+            else if (key == "cas")
+                cas = std::stoi(value);
+            else if (key == "trcd")
+                trcd = std::stoi(value);
+            else if (key == "trp")
+                trp = std::stoi(value);
+            else if (key == "trc")
+                trc = std::stoi(value);
+            else if (key == "twr")
+                twr = std::stoi(value);
+            else if (key == "refresh")
+                refresh_interval = std::stoul(value);
+            else if (key == "burst")
+                burst = std::stoi(value);
+            else if (!field.empty())
+                throw std::invalid_argument(key);
+        } catch (std::logic_error &) {
+            throw std::invalid_argument("invalid SDRAM timing field \"" +
+                                        field + "\"");
+        }
+    }
+
+    if (!is_power_of_2(banks) || !is_power_of_2(burst))
+        throw std::invalid_argument("SDRAM banks and burst must be powers "
+                                    "of 2");
+    if (column_bits < 1 || column_bits > 16 || cas < 0 || trcd < 0 ||
+        trp < 0 || trc < 0 || twr < 0)
+        throw std::invalid_argument("invalid SDRAM timing \"" + spec + "\"");
+    // A refresh that falls due during an access waits for it to complete.
+    // The next refresh must not be due before that one has finished, or
+    // they chain back to back past the single refresh that
+    // worst_case_latency() allows for.
+    auto longest_access = trp + trcd + std::max(cas, twr) + 1;
+    if (refresh_interval &&
+        refresh_interval <=
+            static_cast<unsigned long>(trp + trc + longest_access))
+        throw std::invalid_argument("SDRAM refresh interval must be longer "
+                                    "than a refresh and an access");
+}
+
+SDRAMModel::SDRAMModel(const SDRAMTiming &timing)
+    : timing(timing),
+      bank_bits(0),
+      banks(timing.banks, Bank{false, 0}),
+      ready_cycle(0),
+      next_refresh(timing.refresh_interval),
+      burst_valid(false),
+      burst_block(0),
+      accesses(0),
+      writes(0),
+      row_hits(0),
+      row_misses(0),
+      row_conflicts(0),
+      burst_hits(0),
+      refreshes(0),
+      refresh_stall_cycles(0),
+      total_latency(0)
+{
+    while ((1 << bank_bits) < timing.banks)
+        ++bank_bits;
+}
+
+int SDRAMModel::worst_case_latency() const
+{
+    return timing.trp + timing.trc + timing.trp + timing.trcd +
+           std::max(timing.cas, timing.twr) + 1;
+}
+
+void SDRAMModel::close_rows()
+{
+    for (auto &b : banks)
+        b.open = false;
+    burst_valid = false;
+}
+
+// Refreshes are issued on schedule, or once the access in progress has
+// completed, and precharge every bank first.  Refreshes while the device has
+// been idle for a long time are accounted without stepping through each.
+void SDRAMModel::refresh(unsigned long cycle)
+{
+    if (!timing.refresh_interval || cycle < next_refresh)
+        return;
+
+    auto missed = (cycle - next_refresh) / timing.refresh_interval;
+    if (missed > 1) {
+        refreshes += missed - 1;
+        next_refresh += (missed - 1) * timing.refresh_interval;
+    }
+
+    while (next_refresh <= cycle) {
+        auto start = std::max(next_refresh, ready_cycle);
+        ready_cycle = start + timing.trp + timing.trc;
+        ++refreshes;
+        next_refresh += timing.refresh_interval;
+    }
+
+    close_rows();
+}
+
+// The cycles spent in each of the controller's command states: precharge
+// for a row conflict, activate for a closed row then the read or write.
+int SDRAMModel::access(unsigned long cycle, uint32_t addr, bool write)
+{
+    refresh(cycle);
+
+    uint32_t word = addr >> 1;
+    auto &bank = banks[(word >> timing.column_bits) & (timing.banks - 1)];
+    uint32_t row = word >> (timing.column_bits + bank_bits);
+    uint32_t block = word / timing.burst;
+
+    int latency = 0;
+    if (ready_cycle > cycle) {
+        latency = ready_cycle - cycle;
+        refresh_stall_cycles += latency;
+    }
+
+    ++accesses;
+    if (write)
+        ++writes;
+
+    if (!write && burst_valid && block == burst_block && bank.open &&
+        bank.row == row) {
+        ++burst_hits;
+    } else {
+        if (bank.open && bank.row == row) {
+            ++row_hits;
+        } else if (bank.open) {
+            ++row_conflicts;
+            latency += timing.trp + timing.trcd;
+        } else {
+            ++row_misses;
+            latency += timing.trcd;
+        }
+        bank.open = true;
+        bank.row = row;
+        latency += write ? timing.twr + 1 : timing.cas + 1;
+    }
+
+    if (write && block == burst_block)
+        burst_valid = false;
+    else if (!write && timing.burst > 1) {
+        burst_valid = true;
+        burst_block = block;
+    }
+
+    ready_cycle = cycle + latency;
+    total_latency += latency;
+
+    return latency;
+}
+
+void SDRAMModel::write_stats(std::ostream &out) const
+{
+    auto percent = [this](unsigned long v) {
+        return accesses ? 100.0 * v / accesses : 0.0;
+    };
+
+    out << boost::format("SDRAM: %lu accesses (%lu writes), row hits "
+                         "%.1f%% (%lu burst), row misses %.1f%%, row "
+                         "conflicts %.1f%%, average latency %.2f cycles, "
+                         "%lu refreshes, %lu refresh stall cycles") %
+               accesses % writes % percent(row_hits + burst_hits) %
+               burst_hits % percent(row_misses) % percent(row_conflicts) %
+               average_latency() % refreshes % refresh_stall_cycles;
+}
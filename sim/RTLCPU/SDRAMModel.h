@@ -0,0 +1,115 @@
+// Copyright Jamie Iles, 2017
+//
+// This file is part of s80x86.
+//
+// s80x86 is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// s80x86 is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with s80x86.  If not, see <http://www.gnu.org/licenses/>.
+
+#pragma once
+
+#include <ostream>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+// Timing parameters in clock cycles.  The defaults match SDRAMController
+// with the 32MB devices on the reference designs at 50MHz.
+struct SDRAMTiming {
+    SDRAMTiming()
+        : banks(4),
+          column_bits(9),
+          cas(2),
+          trcd(2),
+          trp(2),
+          trc(8),
+          twr(2),
+          refresh_interval(390),
+          burst(1)
+    {
+    }
+
+    // Comma separated key=value pairs overriding the defaults, for example
+    // "cas=3,trcd=3,burst=8".  Keys are banks, columns, cas, trcd, trp, trc,
+    // twr, refresh and burst.  A refresh interval of 0 disables refresh,
+    // otherwise it must be longer than a refresh (trp + trc) followed by
+    // the slowest access, so that refreshes never run back to back.
+    explicit SDRAMTiming(const std::string &spec);
+
+    int banks;
+    int column_bits;
+    int cas;
+    int trcd;
+    int trp;
+    int trc;
+    int twr;
+    unsigned long refresh_interval;
+    // Words read by each read command, later reads of the same aligned
+    // block complete in a single cycle while the row stays open.
+    int burst;
+};
+
+// A single SDR SDRAM device serving one access at a time, as the controller
+// does.  Each bank keeps its row open until a different row in the same bank
+// is accessed or the device is refreshed.
+class SDRAMModel
+{
+public:
+    explicit SDRAMModel(const SDRAMTiming &timing);
+
+    // The cycles after the minimum that an access starting on cycle
+    // completes on, advancing the model to the end of the access.
+    int access(unsigned long cycle, uint32_t addr, bool write);
+    // An access after an overdue refresh to a row that needs precharging.
+    int worst_case_latency() const;
+
+    unsigned long num_accesses() const
+    {
+        return accesses;
+    }
+    unsigned long num_row_hits() const
+    {
+        return row_hits + burst_hits;
+    }
+    double average_latency() const
+    {
+        return accesses ? static_cast<double>(total_latency) / accesses : 0;
+    }
+    void write_stats(std::ostream &out) const;
+
+private:
+    struct Bank {
+        bool open;
+        uint32_t row;
+    };
+
+    void refresh(unsigned long cycle);
+    void close_rows();
+
+    SDRAMTiming timing;
+    int bank_bits;
+    std::vector<Bank> banks;
+    unsigned long ready_cycle;
+    unsigned long next_refresh;
+    bool burst_valid;
+    uint32_t burst_block;
+
+    unsigned long accesses;
+    unsigned long writes;
+    unsigned long row_hits;
+    unsigned long row_misses;
+    unsigned long row_conflicts;
+    unsigned long burst_hits;
+    unsigned long refreshes;
+    unsigned long refresh_stall_cycles;
+    unsigned long total_latency;
+};
@@ -22,14 +22,21 @@
 #include <iomanip>
 #include <stdint.h>
 
-SPI::SPI(const std::string &disk_image_path)
+SPI::SPI(std::shared_ptr<DiskImage> disk)
     : IOPorts(0xfff0, 2),
       control_reg(0),
       rx_val(0),
       state(STATE_IDLE),
-      disk_image(disk_image_path,
-                 std::ios::binary | std::ios::in | std::ios::out),
-      do_write(false)
+      // Longest command is 7 bytes, longest response is a data block with
+      // its header and CRC.
+      mosi_buf(16),
+      miso_buf(1024),
+      disk_image(std::move(disk)),
+      block(block_size),
+      after_transmit(STATE_IDLE),
+      write_count(0),
+      write_address(0),
+      read_address(0)
 {
 }
 
@@ -73,27 +80,26 @@ void SPI::transfer(uint8_t mosi_val)
 {
     switch (state) {
     case STATE_IDLE:
-        do_write = false;
+        after_transmit = STATE_IDLE;
         if (mosi_val != 0xff && !(control_reg & (1 << 9))) {
             state = STATE_RECEIVING;
-            mosi_buf.push_back(mosi_val);
+            mosi_buf.push(mosi_val);
         }
         rx_val = 0xff;
         break;
     case STATE_RECEIVING:
-        mosi_buf.push_back(mosi_val);
+        mosi_buf.push(mosi_val);
         if (transmit_ready())
             state = STATE_TRANSMITTING;
         rx_val = 0xff;
         break;
     case STATE_TRANSMITTING:
-        if (miso_buf.size() == 0) {
+        if (miso_buf.empty()) {
             rx_val = 0xff;
-            state = do_write ? STATE_WAIT_FOR_DATA : STATE_IDLE;
+            state = after_transmit;
             mosi_buf.clear();
         } else {
-            rx_val = miso_buf[0];
-            miso_buf.pop_front();
+            rx_val = miso_buf.pop();
         }
         break;
     case STATE_WAIT_FOR_DATA:
@@ -102,10 +108,10 @@ void SPI::transfer(uint8_t mosi_val)
             state = STATE_DO_WRITE_BLOCK;
         break;
     case STATE_DO_WRITE_BLOCK:
-        if (write_count < 512) {
-            disk_image.put(mosi_val);
+        if (write_count < block_size) {
+            receive_block_byte(mosi_val);
             rx_val = 0xff;
-        } else if (write_count < 514) {
+        } else if (write_count < block_size + 2) {
             // CRC
             rx_val = 0xaa;
         } else {
@@ -114,9 +120,70 @@ void SPI::transfer(uint8_t mosi_val)
         }
         ++write_count;
         break;
+    case STATE_READ_MULTIPLE: read_multiple_transfer(mosi_val); break;
+    case STATE_WAIT_FOR_MULTIPLE_DATA:
+        rx_val = 0xff;
+        if (mosi_val == 0xfc) {
+            write_count = 0;
+            state = STATE_DO_WRITE_MULTIPLE;
+        } else if (mosi_val == 0xfd) {
+            // Stop tran: one stuff byte then busy.
+            respond({0xff, 0x00});
+            after_transmit = STATE_IDLE;
+            state = STATE_TRANSMITTING;
+        }
+        break;
+    case STATE_DO_WRITE_MULTIPLE: write_multiple_transfer(mosi_val); break;
     };
 }
 
+void SPI::receive_block_byte(uint8_t mosi_val)
+{
+    block[write_count] = mosi_val;
+    // Commit the whole block to the image once it has been received.
+    if (write_count == block_size - 1) {
+        disk_image->write(write_address, block.data(), block_size);
+        write_address += block_size;
+    }
+}
+
+void SPI::read_multiple_transfer(uint8_t mosi_val)
+{
+    // The host clocks out STOP_TRANSMISSION while data is still streaming.
+    if (mosi_val != 0xff || !mosi_buf.empty())
+        mosi_buf.push(mosi_val);
+
+    if (mosi_buf.size() >= 7) {
+        // Stuff byte, R1, busy.  Anything other than CMD12 is illegal here
+        // but still terminates the transfer.
+        respond({0xff, static_cast<uint8_t>(mosi_buf[0] == 0x4c ? 0x00 : 0x04),
+                 0x00});
+        after_transmit = STATE_IDLE;
+        state = STATE_TRANSMITTING;
+        rx_val = 0xff;
+        return;
+    }
+
+    if (miso_buf.empty())
+        queue_read_block();
+    rx_val = miso_buf.pop();
+}
+
+void SPI::write_multiple_transfer(uint8_t mosi_val)
+{
+    rx_val = 0xff;
+
+    if (write_count < block_size)
+        receive_block_byte(mosi_val);
+
+    // Data response after the CRC, then busy for a byte.
+    if (++write_count == block_size + 2) {
+        respond({0x05, 0x00});
+        after_transmit = STATE_WAIT_FOR_MULTIPLE_DATA;
+        state = STATE_TRANSMITTING;
+    }
+}
+
 bool SPI::transmit_ready()
 {
     assert(mosi_buf.size() > 0);
@@ -127,13 +194,13 @@ bool SPI::transmit_ready()
     case 0x48: // IF COND
     case 0x50: // Set blocklen
         if (mosi_buf.size() >= 7) {
-            miso_buf = {0x01};
+            respond({0x01});
             return true;
         }
         break;
     case 0x69: // CMD41, reset
         if (mosi_buf.size() >= 7) {
-            miso_buf = {0x00};
+            respond({0x00});
             return true;
         }
         break;
@@ -149,9 +216,26 @@ bool SPI::transmit_ready()
             return true;
         }
         break;
+    case 0x52: // Read multiple blocks
+        if (mosi_buf.size() >= 7) {
+            // Padding, R1 then stream blocks until stopped.
+            respond({0xff, 0x00});
+            read_address = command_address();
+            after_transmit = STATE_READ_MULTIPLE;
+            return true;
+        }
+        break;
+    case 0x59: // Write multiple blocks
+        if (mosi_buf.size() >= 7) {
+            respond({0xff, 0x00});
+            write_address = command_address();
+            after_transmit = STATE_WAIT_FOR_MULTIPLE_DATA;
+            return true;
+        }
+        break;
     case 0x7a: // OCR
         if (mosi_buf.size() >= 7) {
-            miso_buf = {0x01, 0x00, 0x00, 0x00, 0x00};
+            respond({0x01, 0x00, 0x00, 0x00, 0x00});
             return true;
         }
         break;
@@ -159,46 +243,72 @@ bool SPI::transmit_ready()
         std::cout << "unknown command " << std::hex << (unsigned)mosi_buf[0]
                   << std::endl;
         // Generic error
-        miso_buf = {0xfe};
+        respond({0xfe});
         return true;
     }
 
     return false;
 }
 
+void SPI::respond(std::initializer_list<uint8_t> bytes)
+{
+    miso_buf.clear();
+    miso_buf.push(bytes.begin(), bytes.size());
+}
+
+uint32_t SPI::command_address() const
+{
+    return (static_cast<uint32_t>(mosi_buf[1]) << 24) |
+           (static_cast<uint32_t>(mosi_buf[2]) << 16) |
+           (static_cast<uint32_t>(mosi_buf[3]) << 8) |
+           static_cast<uint32_t>(mosi_buf[4]);
+}
+
+// Read a block from the image straight into the transmit ring, in two pieces
+// if the free space wraps.
+void SPI::queue_disk_block(uint32_t address)
+{
+    auto spans = miso_buf.reserve(block_size);
+
+    disk_image->read(address, spans.first.data, spans.first.len);
+    if (spans.second.len)
+        disk_image->read(address + spans.first.len, spans.second.data,
+                         spans.second.len);
+    miso_buf.commit(block_size);
+}
+
 void SPI::read_block()
 {
-    union {
-        uint8_t u8[4];
-        uint32_t u32;
-    } converter = {
-        .u8 = {mosi_buf[4], mosi_buf[3], mosi_buf[2], mosi_buf[1]},
-    };
     // Padding, R1, padding, start of data
-    miso_buf = {0xff, 0xff, 0x00, 0xff, 0xfe};
+    respond({0xff, 0xff, 0x00, 0xff, 0xfe});
     // Data
-    disk_image.seekg(converter.u32, std::ios::beg);
-    for (auto m = 0; m < 512; ++m)
-        miso_buf.push_back(disk_image.get());
+    queue_disk_block(command_address());
     // CRC
     for (auto m = 0; m < 2; ++m)
-        miso_buf.push_back(0x77);
+        miso_buf.push(0x77);
 }
 
 void SPI::write_block()
 {
-    union {
-        uint8_t u8[4];
-        uint32_t u32;
-    } converter = {
-        .u8 = {mosi_buf[4], mosi_buf[3], mosi_buf[2], mosi_buf[1]},
-    };
-
     // Padding, R1, padding, Accepted
-    miso_buf = {
+    respond({
         0xff, 0x00, 0xff, 0xff, 0x05,
-    };
-    do_write = true;
+    });
+    after_transmit = STATE_WAIT_FOR_DATA;
     write_count = 0;
-    disk_image.seekg(converter.u32, std::ios::beg);
+    write_address = command_address();
+}
+
+void SPI::queue_read_block()
+{
+    // Padding, start of data
+    miso_buf.push(0xff);
+    miso_buf.push(0xfe);
+    // Data
+    queue_disk_block(read_address);
+    // CRC
+    for (auto m = 0; m < 2; ++m)
+        miso_buf.push(0x77);
+
+    read_address += block_size;
 }
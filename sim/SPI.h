@@ -17,13 +17,16 @@
 
 #pragma once
 #include "CPU.h"
+#include "DiskImage.h"
+#include "Fifo.h"
 #include <cassert>
-#include <deque>
+#include <initializer_list>
+#include <memory>
 #include <stdint.h>
-#include <fstream>
+#include <vector>
 
 #include <boost/serialization/list.hpp>
-#include <boost/serialization/deque.hpp>
+#include <boost/serialization/map.hpp>
 #include <boost/serialization/vector.hpp>
 #include <boost/serialization/string.hpp>
 #include <boost/serialization/version.hpp>
@@ -33,7 +36,9 @@
 // is not a real SD card model!
 //
 // Blocklen is ignored and will always be 512 bytes.
-// ACMD messages are ignored too.
+// ACMD messages are ignored too.  Multiple block reads stream blocks until a
+// STOP_TRANSMISSION command is received, multiple block writes accept data
+// tokens until the stop tran token.
 class SPI : public IOPorts
 {
 private:
@@ -43,10 +48,13 @@ private:
         STATE_TRANSMITTING,
         STATE_WAIT_FOR_DATA,
         STATE_DO_WRITE_BLOCK,
+        STATE_READ_MULTIPLE,
+        STATE_WAIT_FOR_MULTIPLE_DATA,
+        STATE_DO_WRITE_MULTIPLE,
     };
 
 public:
-    SPI(const std::string &disk_image_path);
+    explicit SPI(std::shared_ptr<DiskImage> disk);
     void write8(uint16_t port_num, unsigned offs, uint8_t v);
     void write16(uint16_t port_num, uint16_t v);
     uint8_t read8(uint16_t port_num, unsigned offs);
@@ -57,27 +65,71 @@ private:
     bool transmit_ready();
     void read_block();
     void write_block();
+    void queue_read_block();
+    void queue_disk_block(uint32_t address);
+    void read_multiple_transfer(uint8_t mosi_val);
+    void write_multiple_transfer(uint8_t mosi_val);
+    void receive_block_byte(uint8_t mosi_val);
+    void respond(std::initializer_list<uint8_t> bytes);
+    uint32_t command_address() const;
+
+    static const unsigned block_size = DiskImage::block_size;
+
     uint16_t control_reg;
     uint8_t rx_val;
     SPIState state;
-    std::vector<uint8_t> mosi_buf;
-    std::deque<uint8_t> miso_buf;
-    std::fstream disk_image;
-    bool do_write;
+    Fifo<uint8_t> mosi_buf;
+    Fifo<uint8_t> miso_buf;
+    std::shared_ptr<DiskImage> disk_image;
+    // Staging for CMD24/CMD25 data, committed once the whole block is in.
+    std::vector<uint8_t> block;
+    // The state to enter once the response has been transmitted.
+    SPIState after_transmit;
     unsigned write_count;
+    uint32_t write_address;
+    uint32_t read_address;
 
     friend class boost::serialization::access;
     template <class Archive>
-    void serialize(Archive &ar, const unsigned int __unused version)
+    void save(Archive &ar, const unsigned int __unused version) const
     {
+        auto overlay_blocks = disk_image->saved_blocks();
+
         // clang-format off
         ar & control_reg;
         ar & rx_val;
         ar & state;
         ar & mosi_buf;
         ar & miso_buf;
-        ar & do_write;
+        ar & after_transmit;
         ar & write_count;
+        ar & write_address;
+        ar & read_address;
+        ar & block;
+        ar & overlay_blocks;
         // clang-format on
     }
+
+    template <class Archive>
+    void load(Archive &ar, const unsigned int __unused version)
+    {
+        DiskImage::BlockMap overlay_blocks;
+
+        // clang-format off
+        ar & control_reg;
+        ar & rx_val;
+        ar & state;
+        ar & mosi_buf;
+        ar & miso_buf;
+        ar & after_transmit;
+        ar & write_count;
+        ar & write_address;
+        ar & read_address;
+        ar & block;
+        ar & overlay_blocks;
+        // clang-format on
+
+        disk_image->restore_blocks(overlay_blocks);
+    }
+    BOOST_SERIALIZATION_SPLIT_MEMBER()
 };
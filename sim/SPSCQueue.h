@@ -0,0 +1,79 @@
+// Copyright Jamie Iles, 2017
+//
+// This file is part of s80x86.
+//
+// s80x86 is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// s80x86 is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with s80x86.  If not, see <http://www.gnu.org/licenses/>.
+
+#pragma once
+
+#include <atomic>
+#include <stddef.h>
+#include <stdexcept>
+#include <vector>
+
+// Lock-free single producer, single consumer queue for handing data from a
+// host thread to the simulation thread.  The capacity must be a power of two
+// and the indices run freely, wrapping through the mask on access.
+template <typename T>
+class SPSCQueue
+{
+public:
+    explicit SPSCQueue(size_t capacity)
+        : mask(capacity - 1), entries(capacity), head(0), tail(0)
+    {
+        if (capacity == 0 || (capacity & mask) != 0)
+            throw std::invalid_argument("SPSCQueue capacity not a power of 2");
+    }
+
+    // Producer side, returns false if the queue is full.
+    bool push(const T &v)
+    {
+        auto t = tail.load(std::memory_order_relaxed);
+
+        if (t - head.load(std::memory_order_acquire) > mask)
+            return false;
+
+        entries[t & mask] = v;
+        tail.store(t + 1, std::memory_order_release);
+
+        return true;
+    }
+
+    // Consumer side, returns false if the queue is empty.
+    bool pop(T &v)
+    {
+        auto h = head.load(std::memory_order_relaxed);
+
+        if (h == tail.load(std::memory_order_acquire))
+            return false;
+
+        v = entries[h & mask];
+        head.store(h + 1, std::memory_order_release);
+
+        return true;
+    }
+
+    bool empty() const
+    {
+        return head.load(std::memory_order_acquire) ==
+               tail.load(std::memory_order_acquire);
+    }
+
+private:
+    const size_t mask;
+    std::vector<T> entries;
+    // Written only by the consumer and producer respectively.
+    std::atomic<size_t> head;
+    std::atomic<size_t> tail;
+};
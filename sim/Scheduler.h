@@ -0,0 +1,141 @@
+// Copyright Jamie Iles, 2017
+//
+// This file is part of s80x86.
+//
+// s80x86 is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// s80x86 is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with s80x86.  If not, see <http://www.gnu.org/licenses/>.
+
+#pragma once
+
+#include <climits>
+#include <deque>
+#include <functional>
+
+// Dispatches device events at absolute guest cycles.
+//
+// Devices register an event once and then arm it with the cycle that it
+// should fire at.  The simulation loop calls advance() with the current cycle
+// which is a single comparison against the earliest deadline, so nothing
+// happens between events.  There are only ever a handful of events so the
+// earliest deadline is found with a scan.
+class Scheduler
+{
+public:
+    typedef std::function<void(unsigned long)> Callback;
+    typedef unsigned EventID;
+
+    static const unsigned long never = ULONG_MAX;
+
+    Scheduler() : now(0), next_deadline(never), events()
+    {
+    }
+    Scheduler(const Scheduler &) = delete;
+    Scheduler &operator=(const Scheduler &) = delete;
+
+    // The callback is invoked with the deadline that it was armed for, not
+    // the cycle that it was dispatched on, so periodic events can be rearmed
+    // without accumulating drift.
+    EventID add_event(Callback callback)
+    {
+        events.push_back(Event{never, callback});
+
+        return events.size() - 1;
+    }
+
+    // Fixed interval work, armed immediately and rearmed each time it fires.
+    EventID add_periodic_event(unsigned long interval, Callback callback)
+    {
+        EventID id = events.size();
+
+        events.push_back(Event{never, [this, id, interval, callback](
+                                          unsigned long deadline) {
+                                   this->schedule(id, deadline + interval);
+                                   callback(deadline);
+                               }});
+        schedule(id, now + interval);
+
+        return id;
+    }
+
+    void schedule(EventID id, unsigned long deadline)
+    {
+        events[id].deadline = deadline;
+        if (deadline < next_deadline)
+            next_deadline = deadline;
+    }
+
+    void cancel(EventID id)
+    {
+        events[id].deadline = never;
+        update_next_deadline();
+    }
+
+    bool is_scheduled(EventID id) const
+    {
+        return events[id].deadline != never;
+    }
+
+    void advance(unsigned long cycle)
+    {
+        now = cycle;
+        if (cycle >= next_deadline)
+            dispatch();
+    }
+
+    unsigned long current_cycle() const
+    {
+        return now;
+    }
+
+    unsigned long next_event() const
+    {
+        return next_deadline;
+    }
+
+private:
+    struct Event {
+        unsigned long deadline;
+        Callback callback;
+    };
+
+    void dispatch()
+    {
+        // Callbacks may rearm their own event or schedule others, so find
+        // the earliest expired event each time round.
+        while (next_deadline <= now) {
+            auto it = events.begin();
+            for (auto e = events.begin(); e != events.end(); ++e)
+                if (e->deadline < it->deadline)
+                    it = e;
+
+            auto deadline = it->deadline;
+            it->deadline = never;
+            update_next_deadline();
+            it->callback(deadline);
+        }
+    }
+
+    void update_next_deadline()
+    {
+        next_deadline = never;
+        for (auto &e : events)
+            if (e.deadline < next_deadline)
+                next_deadline = e.deadline;
+    }
+
+    unsigned long now;
+    unsigned long next_deadline;
+    // A deque so that callbacks registering new events do not move the
+    // callback that is being run.
+    std::deque<Event> events;
+};
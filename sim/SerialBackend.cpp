@@ -0,0 +1,219 @@
+// Copyright Jamie Iles, 2017
+//
+// This file is part of s80x86.
+//
+// s80x86 is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// s80x86 is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with s80x86.  If not, see <http://www.gnu.org/licenses/>.
+
+#include "SerialBackend.h"
+
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <iostream>
+#include <stdexcept>
+#include <stdlib.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+RawTTY::RawTTY()
+{
+    if (tcgetattr(STDIN_FILENO, &old_termios))
+        throw std::runtime_error("Failed to get termios");
+
+    auto termios = old_termios;
+    cfmakeraw(&termios);
+    termios.c_cc[VMIN] = 0;
+    termios.c_cc[VTIME] = 0;
+    if (tcsetattr(STDIN_FILENO, TCSANOW, &termios))
+        throw std::runtime_error("Failed to set new termios");
+}
+
+RawTTY::~RawTTY()
+{
+    tcsetattr(STDIN_FILENO, TCSANOW, &old_termios);
+}
+
+size_t TTYSerialBackend::read(uint8_t *buf, size_t len)
+{
+    auto rc = ::read(STDIN_FILENO, buf, len);
+
+    return rc > 0 ? rc : 0;
+}
+
+void TTYSerialBackend::write(const uint8_t *buf, size_t len)
+{
+    std::cout.write(reinterpret_cast<const char *>(buf), len);
+    std::cout.flush();
+}
+
+int TTYSerialBackend::poll_fd()
+{
+    return STDIN_FILENO;
+}
+
+PtySerialBackend::PtySerialBackend()
+    : master_fd(posix_openpt(O_RDWR | O_NOCTTY | O_NONBLOCK))
+{
+    if (master_fd < 0)
+        throw std::runtime_error("Failed to allocate pty");
+
+    struct termios termios;
+    if (grantpt(master_fd) || unlockpt(master_fd) ||
+        tcgetattr(master_fd, &termios)) {
+        close(master_fd);
+        throw std::runtime_error("Failed to configure pty");
+    }
+    cfmakeraw(&termios);
+    tcsetattr(master_fd, TCSANOW, &termios);
+
+    std::cout << "UART attached to " << ptsname(master_fd) << std::endl;
+}
+
+PtySerialBackend::~PtySerialBackend()
+{
+    close(master_fd);
+}
+
+size_t PtySerialBackend::read(uint8_t *buf, size_t len)
+{
+    // EIO until the slave has been opened.
+    auto rc = ::read(master_fd, buf, len);
+
+    return rc > 0 ? rc : 0;
+}
+
+void PtySerialBackend::write(const uint8_t *buf, size_t len)
+{
+    // Output is dropped if the pty buffer is full.
+    while (len > 0) {
+        auto rc = ::write(master_fd, buf, len);
+        if (rc <= 0)
+            return;
+        buf += rc;
+        len -= rc;
+    }
+}
+
+int PtySerialBackend::poll_fd()
+{
+    return master_fd;
+}
+
+SocketSerialBackend::SocketSerialBackend(const std::string &path)
+    : path(path), listen_fd(-1), client_fd(-1), lock()
+{
+    struct sockaddr_un addr;
+
+    if (path.size() >= sizeof(addr.sun_path))
+        throw std::invalid_argument("socket path too long: " + path);
+
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strncpy(addr.sun_path, path.c_str(), sizeof(addr.sun_path) - 1);
+
+    listen_fd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK, 0);
+    if (listen_fd < 0)
+        throw std::runtime_error("Failed to create socket");
+
+    unlink(path.c_str());
+    if (bind(listen_fd, reinterpret_cast<struct sockaddr *>(&addr),
+             sizeof(addr)) ||
+        listen(listen_fd, 1)) {
+        close(listen_fd);
+        throw std::runtime_error("Failed to listen on " + path + ": " +
+                                 strerror(errno));
+    }
+
+    std::cout << "UART listening on " << path << std::endl;
+}
+
+SocketSerialBackend::~SocketSerialBackend()
+{
+    disconnect();
+    close(listen_fd);
+    unlink(path.c_str());
+}
+
+bool SocketSerialBackend::connected()
+{
+    if (client_fd < 0)
+        client_fd = accept4(listen_fd, nullptr, nullptr, SOCK_NONBLOCK);
+
+    return client_fd >= 0;
+}
+
+void SocketSerialBackend::disconnect()
+{
+    if (client_fd >= 0)
+        close(client_fd);
+    client_fd = -1;
+}
+
+size_t SocketSerialBackend::read(uint8_t *buf, size_t len)
+{
+    std::lock_guard<std::mutex> guard(lock);
+
+    if (!connected())
+        return 0;
+
+    auto rc = recv(client_fd, buf, len, 0);
+    if (rc == 0 || (rc < 0 && errno != EAGAIN && errno != EWOULDBLOCK))
+        disconnect();
+
+    return rc > 0 ? rc : 0;
+}
+
+void SocketSerialBackend::write(const uint8_t *buf, size_t len)
+{
+    std::lock_guard<std::mutex> guard(lock);
+
+    if (!connected())
+        return;
+
+    while (len > 0) {
+        auto rc = send(client_fd, buf, len, MSG_NOSIGNAL);
+        if (rc < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+            return;
+        if (rc <= 0) {
+            disconnect();
+            return;
+        }
+        buf += rc;
+        len -= rc;
+    }
+}
+
+int SocketSerialBackend::poll_fd()
+{
+    std::lock_guard<std::mutex> guard(lock);
+
+    // Readable on a pending connection, which the next read accepts.
+    return client_fd >= 0 ? client_fd : listen_fd;
+}
+
+std::unique_ptr<SerialBackend> open_serial_backend(const std::string &spec)
+{
+    const std::string unix_prefix = "unix:";
+
+    if (spec == "stdio")
+        return std::make_unique<TTYSerialBackend>();
+    if (spec == "pty")
+        return std::make_unique<PtySerialBackend>();
+    if (spec.compare(0, unix_prefix.size(), unix_prefix) == 0)
+        return std::make_unique<SocketSerialBackend>(
+            spec.substr(unix_prefix.size()));
+
+    throw std::invalid_argument("invalid UART backend \"" + spec + "\"");
+}
@@ -0,0 +1,109 @@
+// Copyright Jamie Iles, 2017
+//
+// This file is part of s80x86.
+//
+// s80x86 is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// s80x86 is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with s80x86.  If not, see <http://www.gnu.org/licenses/>.
+
+#pragma once
+
+#include <memory>
+#include <mutex>
+#include <stddef.h>
+#include <stdint.h>
+#include <string>
+#include <termios.h>
+
+class RawTTY
+{
+public:
+    RawTTY();
+    ~RawTTY();
+
+private:
+    struct termios old_termios;
+};
+
+// Host side of the emulated UART.  Reads never block and return the number
+// of bytes available, up to len.  Reads are made from the input thread and
+// writes from the simulation thread.
+class SerialBackend
+{
+public:
+    virtual ~SerialBackend()
+    {
+    }
+
+    virtual size_t read(uint8_t *buf, size_t len) = 0;
+    virtual void write(const uint8_t *buf, size_t len) = 0;
+    // The descriptor to wait on for input, or -1 if there is none.
+    virtual int poll_fd() = 0;
+};
+
+// The controlling terminal, in raw mode for the lifetime of the backend.
+class TTYSerialBackend : public SerialBackend
+{
+public:
+    size_t read(uint8_t *buf, size_t len);
+    void write(const uint8_t *buf, size_t len);
+    int poll_fd();
+
+private:
+    RawTTY raw_tty;
+};
+
+// A newly allocated pseudo terminal, the slave path is printed at startup
+// for a terminal emulator or test harness to connect to.
+class PtySerialBackend : public SerialBackend
+{
+public:
+    PtySerialBackend();
+    ~PtySerialBackend();
+    PtySerialBackend(const PtySerialBackend &) = delete;
+    PtySerialBackend &operator=(const PtySerialBackend &) = delete;
+
+    size_t read(uint8_t *buf, size_t len);
+    void write(const uint8_t *buf, size_t len);
+    int poll_fd();
+
+private:
+    int master_fd;
+};
+
+// A listening Unix domain socket accepting a single client at a time.
+// Output is discarded while no client is connected.  The client is accepted
+// and dropped from either thread so the descriptors are protected by a lock.
+class SocketSerialBackend : public SerialBackend
+{
+public:
+    explicit SocketSerialBackend(const std::string &path);
+    ~SocketSerialBackend();
+    SocketSerialBackend(const SocketSerialBackend &) = delete;
+    SocketSerialBackend &operator=(const SocketSerialBackend &) = delete;
+
+    size_t read(uint8_t *buf, size_t len);
+    void write(const uint8_t *buf, size_t len);
+    int poll_fd();
+
+private:
+    bool connected();
+    void disconnect();
+
+    std::string path;
+    int listen_fd;
+    int client_fd;
+    std::mutex lock;
+};
+
+// Create a backend from a specification: "stdio", "pty" or "unix:<path>".
+std::unique_ptr<SerialBackend> open_serial_backend(const std::string &spec);
@@ -18,30 +18,46 @@
 #include <algorithm>
 #include <cassert>
 #include <chrono>
+#include <cstdio>
 #include <ctime>
 #include <fstream>
 #include <iostream>
 #include <map>
+#include <signal.h>
 #include <sstream>
 #include <unistd.h>
+#include <vector>
 
+#include <boost/format.hpp>
 #include <boost/program_options.hpp>
 #include <boost/archive/text_oarchive.hpp>
 #include <boost/archive/text_iarchive.hpp>
+#include <config.h>
 
 #include "CGA.h"
 #include "CPU.h"
 #include "Display.h"
+#include "FlightRecorder.h"
+#include "FrameCapture.h"
+#include "Governor.h"
+#include "HybridCPU.h"
+#include "InputThread.h"
 #include "Keyboard.h"
+#include "MemoryTrace.h"
 #include "Mouse.h"
 #include "SoftwareCPU.h"
 #include "RTLCPU.h"
 #include "PIC.h"
+#include "Profiler.h"
+#include "PVDisk.h"
+#include "Scheduler.h"
 #include "UART.h"
 #include "SPI.h"
 #include "Timer.h"
+#include "Trace.h"
 
-bool trace = false;
+// Set by SIGUSR1 to request a flight recorder dump.
+static volatile sig_atomic_t dump_requested = 0;
 
 namespace tty
 {
@@ -72,19 +88,199 @@ public:
     }
 };
 
+struct SimulatorOptions {
+    std::string bios_image;
+    std::string disk_image;
+    std::string overlay;
+    bool discard_writes = false;
+    bool pv_disk = false;
+    std::string uart = "stdio";
+    int uart_irq = 4;
+    unsigned long uart_flush_interval = 100000;
+    std::string restore;
+    std::string save;
+    std::string backend = "SoftwareCPU";
+    bool detached = false;
+    std::string capture_path;
+    std::string capture_format = "ppm";
+    unsigned long capture_interval = 1000000;
+    double frequency = 50.0;
+    bool turbo = false;
+    bool report_rate = false;
+    bool fast_forward = true;
+    std::string profile_path;
+    unsigned long profile_interval = 10000;
+    unsigned profile_depth = 0;
+    std::vector<std::string> profile_symbols;
+    std::string instruction_stats_path;
+    std::string microcode_profile_path;
+    bool sdram = false;
+    std::string sdram_timing;
+    std::string trace_path;
+    bool trace_compress = false;
+    bool trace_side_effects = false;
+    std::string memory_trace_path;
+    bool memory_trace_compress = false;
+    std::string trace_range;
+    unsigned long trace_start = 0;
+    unsigned long trace_count = 0;
+    size_t flight_recorder_size = 256;
+    bool flight_recorder_registers = false;
+    std::string flight_recorder_log = "flight-recorder.log";
+    std::string dump_on;
+    unsigned long rtl_after = 0;
+    std::string rtl_at;
+    unsigned long rtl_for = 0;
+    std::string waveform_path;
+    unsigned long waveform_start = 0;
+    unsigned long waveform_stop = ~0UL;
+    std::string waveform_on;
+    std::string waveform_off;
+    int waveform_depth = 99;
+};
+
+// Parse a "<cs>:<ip>" hex address.
+static void parse_address(const std::string &spec,
+                          const std::string &what,
+                          uint16_t *cs,
+                          uint16_t *ip)
+{
+    unsigned seg, offs;
+    int consumed = 0;
+
+    if (sscanf(spec.c_str(), "%x:%x%n", &seg, &offs, &consumed) != 2 ||
+        static_cast<size_t>(consumed) != spec.size() || seg > 0xffff ||
+        offs > 0xffff)
+        throw std::invalid_argument("invalid " + what + " address \"" + spec +
+                                    "\"");
+
+    *cs = seg;
+    *ip = offs;
+}
+
+template <typename T>
+static void configure_backend(T *__unused cpu,
+                              const SimulatorOptions &__unused options)
+{
+}
+
+static void configure_backend(RTLCPU<verilator_debug_enabled> *cpu,
+                              const SimulatorOptions &options)
+{
+    if (options.sdram)
+        cpu->set_sdram_timing(SDRAMTiming(options.sdram_timing));
+}
+
+static void configure_backend(HybridCPU *cpu, const SimulatorOptions &options)
+{
+    cpu->set_rtl_after(options.rtl_after);
+    cpu->set_rtl_for(options.rtl_for);
+    if (options.rtl_at != "") {
+        uint16_t cs, ip;
+        parse_address(options.rtl_at, "rtl-at", &cs, &ip);
+        cpu->set_rtl_at(cs, ip);
+    }
+}
+
+template <typename T>
+static void report_backend(const T &__unused cpu)
+{
+}
+
+static void report_backend(const RTLCPU<verilator_debug_enabled> &cpu)
+{
+    std::cout << tty::bold << tty::green << "RTL model threads: "
+              << std::max(S80X86_VERILATOR_THREADS, 1) << "\r\n";
+    if (cpu.sdram_model()) {
+        cpu.sdram_model()->write_stats(std::cout);
+        std::cout << "\r\n";
+    }
+    std::cout << tty::normal;
+}
+
+// The RTLCPU keeps the state beyond the SimCPU registers and memory in a
+// file alongside the save file.  It is only restored if present so that
+// saves remain transferable between backends.
+static std::string rtl_model_path(const std::string &path)
+{
+    return path + ".rtl";
+}
+
+// Returns the path of any model file written alongside the save file.
+template <typename T>
+static std::string save_backend(T &__unused cpu, const std::string &path)
+{
+    std::remove(rtl_model_path(path).c_str());
+
+    return "";
+}
+
+template <typename T>
+static void restore_backend(T &__unused cpu, const std::string &__unused path)
+{
+}
+
+static std::string save_backend(RTLCPU<verilator_debug_enabled> &cpu,
+                                const std::string &path)
+{
+    auto model_path = rtl_model_path(path);
+
+    cpu.save_model(model_path);
+
+    return model_path;
+}
+
+static void restore_backend(RTLCPU<verilator_debug_enabled> &cpu,
+                            const std::string &path)
+{
+    auto model_path = rtl_model_path(path);
+
+    if (std::ifstream(model_path).good())
+        cpu.restore_model(model_path);
+}
+
+// Saved from the SoftwareCPU, which is where the HybridCPU starts on
+// restore, so any RTLCPU registers and pending interrupt are carried over.
+static std::string save_backend(HybridCPU &cpu, const std::string &path)
+{
+    cpu.return_to_software();
+    std::remove(rtl_model_path(path).c_str());
+
+    return "";
+}
+
+static void report_backend(const HybridCPU &cpu)
+{
+    std::cout << tty::bold << tty::green << "RTLCPU: " << cpu.rtl_cycles()
+              << " of " << cpu.cycle_count() << " cycles, "
+              << cpu.rtl_instructions() << " instructions, "
+              << cpu.num_switches() << " switches\r\n"
+              << tty::normal;
+}
+
 template <typename T>
 class Simulator
 {
 public:
-    Simulator<T>(const std::string &bios_path,
-                 const std::string &disk_image_path,
-                 bool detached);
+    explicit Simulator<T>(const SimulatorOptions &options);
     void run();
+    void save(const std::string &path);
+    void restore(const std::string &path);
 
 private:
     void load_bios(const std::string &bios_path);
-    void process_io();
+    void schedule_events(const SimulatorOptions &options);
+    void service_uart(unsigned long cycle_num);
+    void process_events();
+    void pace(unsigned long cycle_num);
+    void profile();
+    void write_profile();
     void trace_insn(uint16_t cs, uint16_t ip, size_t instr_len);
+    void trace_memory_references(bool enabled);
+    void setup_flight_recorder(const SimulatorOptions &options);
+    void setup_waveform(const SimulatorOptions &options);
+    void check_waveform_triggers(uint16_t cs, uint16_t ip);
+    void dump_flight_recorder();
     friend class boost::serialization::access;
     template <class Archive>
     void serialize(Archive &ar, const unsigned int __unused version)
@@ -93,52 +289,248 @@ private:
         ar & cpu;
         ar & uart;
         ar & spi;
+        ar & pv_disk;
         ar & timer;
         ar & cga;
         ar & pic;
-        ar & last_cycle;
         // clang-format on
     }
 
     T cpu;
+    Scheduler scheduler;
+    Governor governor;
     PIC pic;
     SDRAMConfigRegister sdram_config_register;
     UART uart;
+    InputThread input_thread;
+    std::shared_ptr<DiskImage> disk_image;
     SPI spi;
+    PVDisk pv_disk;
     TimerTick timer;
     CGA cga;
     Keyboard kbd;
     Mouse mouse;
     bool got_exit;
     bool detached;
-    unsigned long last_cycle;
+    bool report_rate;
+    std::unique_ptr<FrameCapture> frame_capture;
+    unsigned long capture_interval;
+    SymbolTable symbols;
+    std::unique_ptr<Profiler> profiler;
+    unsigned long pending_profile_samples;
+    std::string profile_path;
+    unsigned profile_depth;
+    std::string instruction_stats_path;
+    std::string microcode_profile_path;
+    std::unique_ptr<TraceWriter> tracer;
+    TraceFilter trace_filter;
+    TraceRecord trace_record;
+    std::unique_ptr<TraceWriteLog> trace_write_log;
+    std::unique_ptr<MemoryTraceWriter> memory_tracer;
+    std::string memory_trace_path;
+    unsigned long num_instructions;
+    std::unique_ptr<FlightRecorder> flight_recorder;
+    std::string flight_recorder_log;
+    std::string dump_reason;
+    bool have_dump_on;
+    uint16_t dump_on_cs;
+    uint16_t dump_on_ip;
+    std::string waveform_path;
+    int waveform_depth;
+    unsigned long waveform_stop;
+    bool have_waveform_on;
+    uint16_t waveform_on_cs;
+    uint16_t waveform_on_ip;
+    bool have_waveform_off;
+    uint16_t waveform_off_cs;
+    uint16_t waveform_off_ip;
 };
 
 template <typename T>
-Simulator<T>::Simulator(const std::string &bios_path,
-                        const std::string &disk_image_path,
-                        bool detached)
+Simulator<T>::Simulator(const SimulatorOptions &options)
     : cpu("simulator"),
+      scheduler(),
+      governor(options.frequency * 1000000, options.turbo),
       pic(&this->cpu),
-      spi(disk_image_path),
-      timer(&this->pic),
+      uart(open_serial_backend(options.uart),
+           &this->pic,
+           options.uart_irq,
+           options.uart_flush_interval),
+      input_thread(uart.serial_backend(), uart.host_rx_queue()),
+      disk_image(open_disk_image(options.disk_image,
+                                 options.overlay,
+                                 options.discard_writes)),
+      spi(disk_image),
+      pv_disk(this->cpu.get_memory(), disk_image),
+      timer(&this->pic, &this->scheduler, options.frequency * 1000000),
       cga(this->cpu.get_memory()),
-      kbd(&this->pic),
+      kbd(&this->pic, &this->timer),
       mouse(&this->pic),
       got_exit(false),
-      detached(detached),
-      last_cycle(0)
+      detached(options.detached),
+      report_rate(options.report_rate),
+      capture_interval(options.capture_interval),
+      symbols(),
+      pending_profile_samples(0),
+      profile_path(options.profile_path),
+      profile_depth(options.profile_depth),
+      instruction_stats_path(options.instruction_stats_path),
+      microcode_profile_path(options.microcode_profile_path),
+      trace_filter(),
+      trace_record(),
+      memory_trace_path(options.memory_trace_path),
+      num_instructions(0),
+      flight_recorder_log(options.flight_recorder_log),
+      dump_reason(),
+      have_dump_on(false),
+      dump_on_cs(0),
+      dump_on_ip(0),
+      waveform_path(options.waveform_path),
+      waveform_depth(options.waveform_depth),
+      waveform_stop(options.waveform_stop),
+      have_waveform_on(false),
+      waveform_on_cs(0),
+      waveform_on_ip(0),
+      have_waveform_off(false),
+      waveform_off_cs(0),
+      waveform_off_ip(0)
 {
+    if (options.capture_path != "")
+        frame_capture = std::make_unique<FrameCapture>(
+            options.capture_path,
+            parse_capture_format(options.capture_format), cga.frame_width(),
+            cga.frame_height());
+
+    if (profile_path != "") {
+        for (auto &spec : options.profile_symbols)
+            symbols.load(spec);
+        profiler = std::make_unique<Profiler>(&symbols);
+    }
+
     cpu.add_ioport(&sdram_config_register);
     cpu.add_ioport(&uart);
     cpu.add_ioport(&spi);
+    if (options.pv_disk)
+        cpu.add_ioport(&pv_disk);
     cpu.add_ioport(&timer);
     cpu.add_ioport(&cga);
     cpu.add_ioport(&kbd);
     cpu.add_ioport(&pic);
     cpu.add_ioport(&mouse);
     cpu.reset();
-    load_bios(bios_path);
+    load_bios(options.bios_image);
+    configure_backend(&cpu, options);
+    schedule_events(options);
+    if (options.fast_forward)
+        cpu.set_fast_forward([this] { return scheduler.next_event(); });
+
+    // After loading the BIOS so that its writes are not logged.
+    if (options.trace_path != "") {
+        if (options.trace_range != "")
+            trace_filter.set_range(options.trace_range);
+        trace_filter.set_window(options.trace_start, options.trace_count);
+        tracer = std::make_unique<TraceWriter>(options.trace_path,
+                                               options.trace_compress,
+                                               options.trace_side_effects);
+        if (options.trace_side_effects) {
+            trace_write_log =
+                std::make_unique<TraceWriteLog>(&trace_record.writes);
+            cpu.get_memory()->set_observer(trace_write_log.get());
+        }
+    }
+
+    if (memory_trace_path != "")
+        memory_tracer = std::make_unique<MemoryTraceWriter>(
+            memory_trace_path, options.memory_trace_compress);
+
+    // Nothing is stepped, and so nothing is recorded, when detached.
+    if (options.flight_recorder_size && !options.detached)
+        setup_flight_recorder(options);
+
+    if (waveform_path != "")
+        setup_waveform(options);
+
+    // After loading the BIOS so that only guest code is profiled.
+    if (microcode_profile_path != "")
+        cpu.start_microcode_profile();
+}
+
+template <typename T>
+void Simulator<T>::setup_waveform(const SimulatorOptions &options)
+{
+    if (options.waveform_off != "") {
+        parse_address(options.waveform_off, "waveform-off", &waveform_off_cs,
+                      &waveform_off_ip);
+        have_waveform_off = true;
+    }
+
+    if (options.waveform_on != "") {
+        parse_address(options.waveform_on, "waveform-on", &waveform_on_cs,
+                      &waveform_on_ip);
+        have_waveform_on = true;
+    } else {
+        cpu.waveform_window(options.waveform_start, waveform_stop,
+                            waveform_path, waveform_depth);
+    }
+}
+
+// Each trigger fires once, the first time that the instruction at its
+// address is about to be executed.
+template <typename T>
+void Simulator<T>::check_waveform_triggers(uint16_t cs, uint16_t ip)
+{
+    if (have_waveform_on && cs == waveform_on_cs && ip == waveform_on_ip) {
+        have_waveform_on = false;
+        cpu.waveform_window(cpu.cycle_count(), waveform_stop, waveform_path,
+                            waveform_depth);
+    }
+    if (have_waveform_off && cs == waveform_off_cs && ip == waveform_off_ip) {
+        have_waveform_off = false;
+        cpu.stop_waveform();
+    }
+}
+
+template <typename T>
+void Simulator<T>::setup_flight_recorder(const SimulatorOptions &options)
+{
+    flight_recorder = std::make_unique<FlightRecorder>(
+        &cpu, options.flight_recorder_size, options.flight_recorder_registers);
+
+    if (options.dump_on != "") {
+        parse_address(options.dump_on, "dump-on", &dump_on_cs, &dump_on_ip);
+        have_dump_on = true;
+    }
+
+    cpu.set_invalid_opcode_handler([this] { dump_reason = "invalid opcode"; });
+    signal(SIGUSR1, [](int) { dump_requested = 1; });
+}
+
+template <typename T>
+void Simulator<T>::schedule_events(const SimulatorOptions &options)
+{
+    scheduler.add_periodic_event(1000000,
+                                 [this](unsigned long) { cga.update(); });
+    if (frame_capture)
+        scheduler.add_periodic_event(
+            capture_interval, [this](unsigned long cycle_num) {
+                cga.capture(frame_capture.get(), cycle_num);
+            });
+    scheduler.add_periodic_event(
+        1000, [this](unsigned long cycle_num) { service_uart(cycle_num); });
+    scheduler.add_periodic_event(100000,
+                                 [this](unsigned long) { process_events(); });
+    // Pace in 1ms slices of guest time.
+    scheduler.add_periodic_event(
+        std::max(1.0, options.frequency * 1000),
+        [this](unsigned long cycle_num) { pace(cycle_num); });
+    // Events run in the middle of an instruction, where reading the RTLCPU
+    // registers and memory would start a debug procedure inside the one that
+    // is running, so the sample is taken once the instruction completes.  A
+    // fast forwarded idle loop can pass several intervals in one step.
+    if (profiler)
+        scheduler.add_periodic_event(
+            options.profile_interval,
+            [this](unsigned long) { ++pending_profile_samples; });
 }
 
 template <typename T>
@@ -162,148 +554,428 @@ void Simulator<T>::load_bios(const std::string &bios_path)
     cpu.write_reg(IP, 0x0000);
 }
 
+// Serial input is collected by the input thread, this only moves it from the
+// queue into the UART and flushes output.
 template <typename T>
-void Simulator<T>::process_io()
+void Simulator<T>::service_uart(unsigned long cycle_num)
 {
-    char c;
-    if (read(STDIN_FILENO, &c, 1) == 1) {
-        if (c == 0x1d)
-            got_exit = true;
-        else
-            uart.add_char(c);
-    }
+    uart.service(cycle_num);
+    if (uart.exit_requested())
+        got_exit = true;
+}
 
+// SDL events must be handled on the thread that owns the window so they are
+// drained in batches from the simulation thread, at a rate well below the
+// instruction rate.
+template <typename T>
+void Simulator<T>::process_events()
+{
     SDL_Event e;
-    if (SDL_PollEvent(&e)) {
-        if (e.type == SDL_QUIT)
+    while (SDL_PollEvent(&e)) {
+        if (e.type == SDL_QUIT) {
             got_exit = true;
-        else if (e.type == SDL_KEYDOWN || e.type == SDL_KEYUP)
+        } else if (e.type == SDL_KEYDOWN || e.type == SDL_KEYUP) {
+            auto hotkey = (e.key.keysym.mod & KMOD_LCTRL) &&
+                          (e.key.keysym.mod & KMOD_LALT) &&
+                          e.type == SDL_KEYDOWN;
+            if (hotkey && e.key.keysym.scancode == SDL_SCANCODE_RIGHTBRACKET)
+                got_exit = true;
+            if (hotkey && e.key.keysym.scancode == SDL_SCANCODE_M)
+                mouse.toggle_capture();
+            if (hotkey && e.key.keysym.scancode == SDL_SCANCODE_T)
+                governor.set_turbo(!governor.is_turbo());
             kbd.process_event(e);
-        else if (e.type == SDL_MOUSEBUTTONDOWN || e.type == SDL_MOUSEBUTTONUP)
+        } else if (e.type == SDL_MOUSEBUTTONDOWN ||
+                   e.type == SDL_MOUSEBUTTONUP) {
             mouse.process_event(e);
+        } else if (e.type == SDL_MOUSEMOTION) {
+            mouse.process_motion(e);
+        }
     }
 
     mouse.update();
 
-    auto kbd_state = SDL_GetKeyboardState(NULL);
-    if (kbd_state[SDL_SCANCODE_LCTRL] && kbd_state[SDL_SCANCODE_LALT] &&
-        kbd_state[SDL_SCANCODE_RIGHTBRACKET])
-        got_exit = true;
+    if (dump_requested && flight_recorder) {
+        dump_requested = 0;
+        dump_reason = "SIGUSR1";
+    }
+}
+
+template <typename T>
+void Simulator<T>::pace(unsigned long cycle_num)
+{
+    governor.pace(cycle_num);
+
+    Governor::Report report;
+    if (!governor.sample(cycle_num, &report))
+        return;
+
+    auto status = (boost::format("%.1fMHz, %.0f%% host CPU%s") % report.mhz %
+                   report.host_cpu_percent %
+                   (governor.is_turbo() ? " (turbo)" : ""))
+                      .str();
+    cga.set_status(status);
+    // Headless and detached runs have no window title to read it from.
+    if (report_rate)
+        std::cerr << status << "\r\n";
+}
+
+// The callers are found by following the chain of saved BP values, assuming
+// near calls with frame pointers.  A sample taken before a function has set
+// up its frame attributes it to the caller's caller instead.
+template <typename T>
+void Simulator<T>::profile()
+{
+    std::vector<uint16_t> callers;
+    auto ss = cpu.read_reg(SS);
+    auto bp = cpu.read_reg(BP);
+
+    for (unsigned depth = 0; depth < profile_depth && bp != 0; ++depth) {
+        callers.push_back(cpu.read_mem16(ss, bp + 2));
+        auto caller_bp = cpu.read_mem16(ss, bp);
+        // Frames only ever move up the stack.
+        if (caller_bp <= bp)
+            break;
+        bp = caller_bp;
+    }
 
-    if (kbd_state[SDL_SCANCODE_LCTRL] && kbd_state[SDL_SCANCODE_LALT] &&
-        kbd_state[SDL_SCANCODE_M])
-        mouse.toggle_capture();
+    profiler->add_sample(cpu.read_reg(CS), cpu.read_reg(IP), callers,
+                         pending_profile_samples);
+    pending_profile_samples = 0;
+}
+
+template <typename T>
+void Simulator<T>::write_profile()
+{
+    std::ofstream out(profile_path);
+    profiler->write_folded(out);
+
+    std::cout << tty::bold << tty::green << "Profile: "
+              << profiler->num_samples() << " samples written to "
+              << profile_path << "\r\n"
+              << tty::normal;
 }
 
 template <typename T>
 void Simulator<T>::run()
 {
     auto start_time = std::chrono::system_clock::now();
+    auto start_cpu_time = std::clock();
 
     if (detached)
         cpu.debug_detach();
 
-    while (!got_exit) {
-        auto io_callback = [&](unsigned long cycle_num) {
-            if (cycle_num % 1000000 == 0)
-                cga.update();
-            if (cycle_num % 1000 == 0)
-                process_io();
-            timer.tick((cycle_num - last_cycle) + 1);
-            last_cycle = cycle_num;
-        };
-
-        if (detached)
-            cpu.cycle_cpu_with_io(io_callback);
-        else {
-            auto cs = cpu.read_reg(CS);
-            auto ip = cpu.read_reg(IP);
-            auto instr_len = cpu.step_with_io(io_callback);
-
-            if (trace)
-                trace_insn(cs, ip, instr_len);
+    try {
+        while (!got_exit) {
+            // Device accesses, such as CGA refreshes, are not part of the
+            // CPU's reference stream.
+            auto io_callback = [&](unsigned long cycle_num) {
+                trace_memory_references(false);
+                scheduler.advance(cycle_num);
+                trace_memory_references(true);
+            };
+
+            if (detached)
+                cpu.cycle_cpu_with_io(io_callback);
+            else {
+                auto cs = cpu.read_reg(CS);
+                auto ip = cpu.read_reg(IP);
+                if (have_waveform_on || have_waveform_off)
+                    check_waveform_triggers(cs, ip);
+                trace_memory_references(true);
+                auto instr_len = cpu.step_with_io(io_callback);
+                trace_memory_references(false);
+
+                if (tracer)
+                    trace_insn(cs, ip, instr_len);
+                if (pending_profile_samples)
+                    profile();
+                if (flight_recorder) {
+                    flight_recorder->record(cs, ip, instr_len);
+                    if (have_dump_on && cs == dump_on_cs && ip == dump_on_ip)
+                        dump_reason = "reached dump-on address";
+                    if (!dump_reason.empty())
+                        dump_flight_recorder();
+                }
+            }
         }
+    } catch (std::exception &e) {
+        if (flight_recorder) {
+            dump_reason = std::string("exception: ") + e.what();
+            dump_flight_recorder();
+        }
+        throw;
     }
 
+    uart.flush();
+
     auto end_time = std::chrono::system_clock::now();
 
     std::chrono::duration<double> elapsed_seconds = end_time - start_time;
+    double cpu_seconds =
+        static_cast<double>(std::clock() - start_cpu_time) / CLOCKS_PER_SEC;
 
     std::cout << tty::bold << tty::green << "\r\nOperating frequency: "
               << (cpu.cycle_count() / 1000000.0) / elapsed_seconds.count()
-              << "MHz\r\n"
+              << "MHz, "
+              << static_cast<int>(100.0 * cpu_seconds /
+                                  elapsed_seconds.count())
+              << "% host CPU\r\n"
               << tty::normal;
+
+    report_backend(cpu);
+
+    if (cpu.fast_forwarded_cycles())
+        std::cout << tty::bold << tty::green << "Fast forwarded: "
+                  << cpu.fast_forwarded_cycles() << " of "
+                  << cpu.cycle_count() << " cycles idle\r\n"
+                  << tty::normal;
+
+    if (frame_capture) {
+        frame_capture->finish();
+        std::cout << tty::bold << tty::green << "Captured frames: "
+                  << frame_capture->frames_written() << " ("
+                  << frame_capture->frames_dropped() << " duplicates dropped)"
+                  << "\r\n"
+                  << tty::normal;
+    }
+
+    if (profiler)
+        write_profile();
+
+    if (instruction_stats_path != "") {
+        std::ofstream stats(instruction_stats_path);
+        cpu.write_instruction_stats(stats);
+    }
+
+    if (microcode_profile_path != "") {
+        cpu.write_microcode_profile(microcode_profile_path);
+        std::cout << tty::bold << tty::green << "Microcode profile written to "
+                  << microcode_profile_path << "\r\n"
+                  << tty::normal;
+    }
+
+    if (tracer)
+        std::cout << tty::bold << tty::green << "Trace: "
+                  << tracer->records_written() << " of " << num_instructions
+                  << " instructions recorded\r\n"
+                  << tty::normal;
+
+    if (memory_tracer)
+        std::cout << tty::bold << tty::green << "Memory trace: "
+                  << memory_tracer->references_written()
+                  << " references written to " << memory_trace_path << "\r\n"
+                  << tty::normal;
 }
 
+// Dumps are appended to the log so that earlier dumps in the same run, such
+// as from dump-on, are kept.
 template <typename T>
-void Simulator<T>::trace_insn(uint16_t cs, uint16_t ip, size_t instr_len)
+void Simulator<T>::dump_flight_recorder()
 {
-    std::cout << "[" << std::hex << cs << ":" << ip << "] ";
-    auto bytes = cpu.read_vector8(cs, ip, instr_len);
+    {
+        std::ofstream log(flight_recorder_log, std::ios::app);
+        flight_recorder->dump(log, dump_reason);
+        log << std::endl;
+    }
 
-    auto flags = std::cout.flags();
+    std::cout << tty::bold << tty::green << "Flight recorder: " << dump_reason
+              << ", dumped to " << flight_recorder_log << "\r\n"
+              << tty::normal;
+    dump_reason.clear();
+}
 
-    for (auto b : bytes)
-        std::cout << std::hex << std::setfill('0') << std::setw(2)
-                  << static_cast<unsigned>(b) << " ";
+// Memory writes accumulate in the record from the start of the instruction
+// and are dropped if the instruction is filtered out.
+// Memory has a single observer, when tracing side effects the write log
+// stays attached, recording device writes too, and forwards to the memory
+// tracer.
+template <typename T>
+void Simulator<T>::trace_memory_references(bool enabled)
+{
+    if (!memory_tracer)
+        return;
 
-    std::cout.flags(flags);
-    std::cout << "\r\n";
+    auto observer = enabled ? memory_tracer.get() : nullptr;
+    if (trace_write_log)
+        trace_write_log->set_next(observer);
+    else
+        cpu.get_memory()->set_observer(observer);
 }
 
 template <typename T>
-static void run_sim(const std::string &bios_image,
-                    const std::string &disk_image,
-                    const bool detached,
-                    const std::string &save,
-                    const std::string &restore)
+void Simulator<T>::trace_insn(uint16_t cs, uint16_t ip, size_t instr_len)
 {
-    T sim(bios_image, disk_image, detached);
+    auto index = num_instructions++;
+
+    if (trace_filter.accept(index, cs, ip)) {
+        trace_record.index = index;
+        trace_record.cs = cs;
+        trace_record.ip = ip;
+        trace_record.bytes = cpu.read_vector8(
+            cs, ip, std::min(instr_len, TraceRecord::max_length));
+        if (tracer->has_side_effects()) {
+            auto state = cpu.read_all_regs();
+            std::copy(state.registers, state.registers + NUM_16BIT_REGS,
+                      trace_record.registers);
+            trace_record.flags = state.flags;
+        }
+        tracer->write(trace_record);
+    }
+
+    trace_record.writes.clear();
+}
 
-    if (restore != "") {
-        std::ifstream ifs(restore);
+template <typename T>
+void Simulator<T>::save(const std::string &path)
+{
+    // Before archiving, the backend may move state into the registers.
+    auto model_path = save_backend(cpu, path);
+
+    std::ofstream ofs(path);
+    {
+        boost::archive::text_oarchive oa(ofs);
+        oa << *this;
+    }
+
+    std::cout << tty::bold << tty::green << "Saved to " << path;
+    if (model_path != "")
+        std::cout << ", RTL model to " << model_path;
+    std::cout << "\r\n" << tty::normal;
+}
+
+template <typename T>
+void Simulator<T>::restore(const std::string &path)
+{
+    {
+        std::ifstream ifs(path);
         boost::archive::text_iarchive ia(ifs);
-        ia >> sim;
+        ia >> *this;
     }
 
+    // Restored last, the model state supersedes the registers written
+    // through the debug port when loading the archive.
+    restore_backend(cpu, path);
+}
+
+template <typename T>
+static void run_sim(const SimulatorOptions &options)
+{
+    if (options.waveform_path != "")
+        enable_waveforms();
+
+    T sim(options);
+
+    if (options.restore != "")
+        sim.restore(options.restore);
+
     sim.run();
 
-    if (save != "") {
-        std::ofstream ofs(save);
-        {
-            boost::archive::text_oarchive oa(ofs);
-            oa << sim;
-        }
-    }
+    if (options.save != "")
+        sim.save(options.save);
 }
 
 int main(int argc, char **argv)
 {
     namespace po = boost::program_options;
-    std::string bios_image;
-    std::string disk_image;
-    std::string restore;
-    std::string save;
-    std::string backend = "SoftwareCPU";
-    bool detached;
+    SimulatorOptions options;
 
     po::options_description desc("Options");
     // clang-format off
     desc.add_options()
         ("help,h", "print this usage information and exit")
-        ("backend,b", po::value<std::string>(&backend),
-         "the simulator backend module to use, either SoftwareCPU or RTLCPU, default SoftwareCPU")
-        ("restore,r", po::value<std::string>(&restore),
+        ("backend,b", po::value<std::string>(&options.backend),
+         "the simulator backend module to use, either SoftwareCPU, RTLCPU or Hybrid, default SoftwareCPU")
+        ("rtl-after", po::value<unsigned long>(&options.rtl_after),
+         "Hybrid backend: switch to the RTLCPU after this many instructions")
+        ("rtl-at", po::value<std::string>(&options.rtl_at),
+         "Hybrid backend: switch to the RTLCPU whenever <cs>:<ip> is reached, hex")
+        ("rtl-for", po::value<unsigned long>(&options.rtl_for),
+         "Hybrid backend: return to the SoftwareCPU after this many RTLCPU instructions, default 0 to stay")
+        ("restore,r", po::value<std::string>(&options.restore),
          "restore file to load from")
-        ("save,s", po::value<std::string>(&save),
+        ("save,s", po::value<std::string>(&options.save),
          "save file to write from")
         ("detached,d",
          "run the simulation in free-running mode")
-        ("trace,t",
-         "trace all instructions as they are executed")
-        ("bios", po::value<std::string>(&bios_image)->required(),
+        ("trace,t", po::value<std::string>(&options.trace_path),
+         "write a binary trace of executed instructions to this path, read with trace-dump")
+        ("trace-compress",
+         "gzip compress the instruction trace")
+        ("trace-side-effects",
+         "record register and memory writes in the instruction trace")
+        ("trace-range", po::value<std::string>(&options.trace_range),
+         "only trace instructions in <cs>:<first ip>-<last ip>, hex and inclusive")
+        ("trace-start", po::value<unsigned long>(&options.trace_start),
+         "number of instructions to execute before tracing, default 0")
+        ("trace-count", po::value<unsigned long>(&options.trace_count),
+         "number of instructions to trace from trace-start, default 0 for all")
+        ("memory-trace", po::value<std::string>(&options.memory_trace_path),
+         "write the SoftwareCPU memory reference stream to this path for cache-sim")
+        ("memory-trace-compress", "gzip compress the memory trace")
+        ("flight-recorder", po::value<size_t>(&options.flight_recorder_size),
+         "number of recent instructions to keep for crash dumps, 0 to disable, default 256")
+        ("flight-recorder-registers",
+         "keep the registers changed by each instruction in the flight recorder")
+        ("flight-recorder-log", po::value<std::string>(&options.flight_recorder_log),
+         "file that flight recorder dumps are appended to, default flight-recorder.log")
+        ("dump-on", po::value<std::string>(&options.dump_on),
+         "dump the flight recorder whenever <cs>:<ip> is executed, hex")
+        ("overlay", po::value<std::string>(&options.overlay),
+         "keep disk writes in this overlay file, the disk image is opened read-only")
+        ("discard-writes",
+         "open the disk image read-only and discard all writes on exit")
+        ("pv-disk",
+         "provide the paravirtual disk for faster disk access, SoftwareCPU only")
+        ("uart", po::value<std::string>(&options.uart),
+         "attach the UART to stdio, pty or unix:<path>, default stdio")
+        ("uart-irq", po::value<int>(&options.uart_irq),
+         "IRQ raised on UART receive when enabled by the guest, -1 for none, default 4")
+        ("uart-flush-interval", po::value<unsigned long>(&options.uart_flush_interval),
+         "maximum guest cycles to buffer UART output for, default 100000")
+        ("capture", po::value<std::string>(&options.capture_path),
+         "capture display frames to this path (file prefix for ppm, file for y4m)")
+        ("capture-format", po::value<std::string>(&options.capture_format),
+         "frame capture format, either ppm or y4m, default ppm")
+        ("capture-interval", po::value<unsigned long>(&options.capture_interval),
+         "guest cycles between captured frames, default 1000000")
+        ("frequency", po::value<double>(&options.frequency),
+         "emulated CPU frequency in MHz that guest time is paced to, default 50")
+        ("turbo",
+         "run unthrottled rather than in real time, toggled with ctrl+alt+t")
+        ("report-rate",
+         "print the effective MHz and host CPU usage to stderr every second")
+        ("no-fast-forward",
+         "execute idle loops rather than skipping to the next device event")
+        ("profile", po::value<std::string>(&options.profile_path),
+         "sample guest CS:IP and write folded stacks to this path on exit")
+        ("profile-interval", po::value<unsigned long>(&options.profile_interval),
+         "guest cycles between profile samples, default 10000")
+        ("profile-depth", po::value<unsigned>(&options.profile_depth),
+         "callers to record from the BP chain in each sample, default 0")
+        ("profile-symbols", po::value<std::vector<std::string>>(&options.profile_symbols),
+         "symbols for profiles from a link map, NASM map or listing, <path>[@<segment>], may be repeated")
+        ("instruction-stats", po::value<std::string>(&options.instruction_stats_path),
+         "write instruction statistics as JSON to this path on exit, needs S80X86_INSN_STATS")
+        ("microcode-profile", po::value<std::string>(&options.microcode_profile_path),
+         "write RTLCPU cycles per microcode address and opcode to this path on exit")
+        ("sdram-timing", po::value<std::string>(&options.sdram_timing)->implicit_value(""),
+         "time RTLCPU memory with an SDRAM model, optionally with key=value overrides of banks, columns, cas, trcd, trp, trc, twr, refresh and burst")
+        ("waveform", po::value<std::string>(&options.waveform_path),
+         "write an RTLCPU waveform to this path, VCD or FST depending on the build")
+        ("waveform-start", po::value<unsigned long>(&options.waveform_start),
+         "cycle to start the waveform on, default 0")
+        ("waveform-stop", po::value<unsigned long>(&options.waveform_stop),
+         "cycle to stop the waveform on")
+        ("waveform-on", po::value<std::string>(&options.waveform_on),
+         "start the waveform when <cs>:<ip> is first executed, hex")
+        ("waveform-off", po::value<std::string>(&options.waveform_off),
+         "stop the waveform when <cs>:<ip> is first executed, hex")
+        ("waveform-depth", po::value<int>(&options.waveform_depth),
+         "levels of RTL hierarchy to trace, default 99")
+        ("bios", po::value<std::string>(&options.bios_image)->required(),
          "the bios image to use")
-        ("diskimage", po::value<std::string>(&disk_image)->required(),
+        ("diskimage", po::value<std::string>(&options.disk_image)->required(),
          "the boot disk image");
     // clang-format on
 
@@ -323,10 +995,73 @@ int main(int argc, char **argv)
             return 0;
         }
 
-        detached = variables_map.count("detached");
-        trace = variables_map.count("trace");
+        options.detached = variables_map.count("detached");
+        options.trace_compress = variables_map.count("trace-compress");
+        options.trace_side_effects = variables_map.count("trace-side-effects");
+        options.memory_trace_compress =
+            variables_map.count("memory-trace-compress");
+        options.flight_recorder_registers =
+            variables_map.count("flight-recorder-registers");
+        options.discard_writes = variables_map.count("discard-writes");
+        options.pv_disk = variables_map.count("pv-disk");
+        options.turbo = variables_map.count("turbo");
+        options.report_rate = variables_map.count("report-rate");
+        options.fast_forward = !variables_map.count("no-fast-forward");
+        options.sdram = variables_map.count("sdram-timing");
 
         po::notify(variables_map);
+
+        if (options.discard_writes && options.overlay != "")
+            throw po::error(
+                "overlay and discard-writes are mutually exclusive");
+        // Writes from the paravirtual disk would bypass the RTL cache.
+        if (options.pv_disk && options.backend != "SoftwareCPU")
+            throw po::error("pv-disk requires the SoftwareCPU backend");
+        if (options.uart_irq < -1 || options.uart_irq > 7)
+            throw po::error("uart-irq must be -1 or 0-7");
+        if (options.frequency <= 0)
+            throw po::error("frequency must be positive");
+        // Instructions are only stepped, and so traced, when attached.
+        if (options.trace_path != "" && options.detached)
+            throw po::error("trace and detached are mutually exclusive");
+        if (options.memory_trace_path != "" &&
+            (options.backend != "SoftwareCPU" || options.detached))
+            throw po::error("memory-trace requires the SoftwareCPU backend "
+                            "attached");
+        // Backends are only switched between stepped instructions.
+        if (options.backend == "Hybrid" && options.detached)
+            throw po::error("the Hybrid backend can't be detached");
+        if (options.capture_interval == 0)
+            throw po::error("capture-interval must be non-zero");
+        if (options.profile_interval == 0)
+            throw po::error("profile-interval must be non-zero");
+        // Samples are taken between stepped instructions.
+        if (options.profile_path != "" && options.detached)
+            throw po::error("profile and detached are mutually exclusive");
+        if (options.instruction_stats_path != "" &&
+            (!S80X86_INSN_STATS || options.backend != "SoftwareCPU"))
+            throw po::error("instruction-stats requires the SoftwareCPU "
+                            "backend built with S80X86_INSN_STATS");
+        if (options.microcode_profile_path != "" &&
+            options.backend != "RTLCPU")
+            throw po::error("microcode-profile requires the RTLCPU backend");
+        if (options.sdram && options.backend != "RTLCPU")
+            throw po::error("sdram-timing requires the RTLCPU backend");
+        if (options.waveform_path != "" && options.backend != "RTLCPU")
+            throw po::error("waveform requires the RTLCPU backend");
+        if ((options.waveform_on != "" || options.waveform_off != "") &&
+            options.detached)
+            throw po::error("waveform-on and waveform-off can't be used "
+                            "detached");
+        if ((options.dump_on != "" || options.flight_recorder_registers) &&
+            options.detached)
+            throw po::error("dump-on and flight-recorder-registers can't be "
+                            "used detached");
+        if (options.capture_path != "")
+            parse_capture_format(options.capture_format);
+    } catch (std::invalid_argument &e) {
+        std::cerr << "Error: " << e.what() << std::endl;
+        return 2;
     } catch (boost::program_options::required_option &e) {
         std::cerr << "Error: missing arguments " << e.what() << std::endl;
         return 1;
@@ -335,16 +1070,23 @@ int main(int argc, char **argv)
         return 2;
     }
 
-    if (backend == "SoftwareCPU") {
-        run_sim<Simulator<SoftwareCPU>>(bios_image, disk_image, detached, save,
-                                        restore);
-    } else if (backend == "RTLCPU") {
-        run_sim<Simulator<RTLCPU<verilator_debug_enabled>>>(
-            bios_image, disk_image, detached, save, restore);
-    } else {
-        std::cerr << "Error: invalid simulation backend \"" << backend << "\""
-                  << std::endl;
-        return 3;
+    try {
+        if (options.backend == "SoftwareCPU") {
+            run_sim<Simulator<SoftwareCPU>>(options);
+        } else if (options.backend == "RTLCPU") {
+            run_sim<Simulator<RTLCPU<verilator_debug_enabled>>>(options);
+        } else if (options.backend == "Hybrid") {
+            run_sim<Simulator<HybridCPU>>(options);
+        } else {
+            std::cerr << "Error: invalid simulation backend \""
+                      << options.backend << "\"" << std::endl;
+            return 3;
+        }
+    } catch (std::invalid_argument &e) {
+        // Device configuration, such as the UART backend, is only validated
+        // when the simulator is constructed.
+        std::cerr << "Error: " << e.what() << std::endl;
+        return 2;
     }
 
     return 0;
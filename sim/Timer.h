@@ -17,6 +17,7 @@
 
 #pragma once
 
+#include <algorithm>
 #include <cassert>
 #include <stdexcept>
 
@@ -26,6 +27,7 @@
 
 #include "CPU.h"
 #include "PIC.h"
+#include "Scheduler.h"
 #include <stdint.h>
 
 class BadTimer : public std::runtime_error
@@ -40,139 +42,347 @@ public:
     if (!(expr))           \
         throw BadTimer("Invalid timer config: " #expr);
 
-static const auto cycles_per_tick = 50000000 / (65536 * 18.2);
-
+// An 8254 model supporting modes 0, 2 and 3 in binary on all three channels.
+//
+// Rather than decrementing a counter as the CPU runs, each channel records
+// the cycle that its count was loaded and the counter and output are
+// computed from the current cycle when they are read.  Channel 0 registers
+// its next terminal count with the scheduler to raise IRQ 0, so there is no
+// timer work in the simulation loop between interrupts.
+//
+// Channels 0 and 1 are permanently gated, channel 2 is gated by the PC
+// speaker control bit of the keyboard controller.
 class TimerTick : public IOPorts
 {
 public:
-    explicit TimerTick(PIC *pic)
+    static const int num_channels = 3;
+
+    TimerTick(PIC *pic, Scheduler *scheduler, unsigned long cpu_clock_hz)
         : IOPorts(0x0040, 2),
           pic(pic),
-          access(0),
-          operating_mode(0),
-          count(0),
-          latched(false),
-          latched_val(0),
-          access_low(false),
-          reload(0),
-          enabled(false)
+          scheduler(scheduler),
+          cpu_clock_hz(cpu_clock_hz),
+          channels(),
+          irq_event(scheduler->add_event(
+              [this](unsigned long deadline) { this->expire(deadline); }))
     {
+        channels[0].gate = true;
+        channels[1].gate = true;
     }
+    TimerTick(const TimerTick &) = delete;
+    TimerTick &operator=(const TimerTick &) = delete;
 
+    // Ports 0x40-0x42 are the channel data registers, 0x43 the control word.
     void write8(uint16_t port_num, unsigned offs, uint8_t v)
     {
-        if (port_num == 2 && offs == 1)
-            write_mode(v);
-        else if (port_num == 0 && offs == 0)
-            write_reload(v);
+        auto channel = port_num + offs;
+
+        if (channel == num_channels)
+            write_control(v);
+        else
+            write_data(channel, v);
     }
 
     uint8_t read8(uint16_t port_num, unsigned offs)
     {
-        if (port_num != 0 && offs != 0)
+        auto channel = port_num + offs;
+
+        if (channel == num_channels)
             return 0;
 
-        auto counter_val = this->latched ? this->latched_val : read_counter();
-        if (access_low) {
-            access_low = false;
-            return counter_val;
-        } else {
-            latched = false;
-            return counter_val >> 8;
-        }
+        return read_data(channel);
+    }
+
+    // The counters run with guest time.
+    bool read_is_volatile(uint16_t port_num, unsigned offs) const
+    {
+        return port_num + offs != num_channels;
     }
 
-    void tick(unsigned cycles)
+    void set_gate(int channel, bool gate)
     {
-        if (!enabled)
+        auto &c = channels[channel];
+
+        if (gate == c.gate)
             return;
 
-        if (count <= cycles) {
-            if (operating_mode == 2) {
-                pic->raise_irq(0);
-                do_reload();
-            }
+        auto now = scheduler->current_cycle();
+        if (!gate) {
+            c.held_ticks = elapsed_ticks(c);
+        } else if (c.mode == 0) {
+            // Mode 0 resumes counting where it was suspended, modes 2 and 3
+            // restart from the reload value on the rising edge.
+            c.start = now - pit_ticks_to_cycles(c.held_ticks);
         } else {
-            count -= cycles;
+            c.start = now;
+        }
+        c.gate = gate;
+    }
+
+    bool output(int channel) const
+    {
+        auto &c = channels[channel];
+
+        if (!c.counting)
+            return c.mode != 0;
+
+        auto period = period_ticks(c);
+        auto ticks = elapsed_ticks(c);
+
+        switch (c.mode) {
+        case 0: return ticks >= period;
+        case 2: return !c.gate || ticks % period != period - 1;
+        default: return !c.gate || ticks % period < (period + 1) / 2;
         }
     }
 
 private:
-    PIC *pic;
-    uint8_t access;
-    uint8_t operating_mode;
-    uint32_t count;
-    bool latched;
-    uint16_t latched_val;
-    bool access_low;
-    uint16_t reload;
-    bool enabled;
+    static const unsigned long pit_clock_hz = 1193182;
+
+    struct Channel {
+        uint8_t mode = 0;
+        uint8_t access = 3;
+        bool write_msb = false;
+        bool read_msb = false;
+        uint16_t reload = 0;
+        bool counting = false;
+        bool latched = false;
+        uint16_t latched_val = 0;
+        bool gate = false;
+        // The cycle that the count was loaded, or restarted by the gate.
+        unsigned long start = 0;
+        // Elapsed timer ticks when the gate was lowered.
+        unsigned long held_ticks = 0;
+        // The number of terminal counts until the next scheduled IRQ.
+        unsigned long expirations = 0;
+    };
 
-    uint16_t read_counter() const
+    // Both conversions split the whole seconds out to avoid overflow, and
+    // cycles are rounded up so that the counter has always reached terminal
+    // count by the cycle that the expiry is dispatched.
+    unsigned long cycles_to_pit_ticks(unsigned long cycles) const
     {
-        return count / cycles_per_tick;
+        return (cycles / cpu_clock_hz) * pit_clock_hz +
+               ((cycles % cpu_clock_hz) * pit_clock_hz) / cpu_clock_hz;
     }
 
-    void do_reload()
+    unsigned long pit_ticks_to_cycles(unsigned long ticks) const
     {
-        count = (((static_cast<uint32_t>(reload) & 0xffff) - 1) & 0xffff) *
-                cycles_per_tick;
+        return (ticks / pit_clock_hz) * cpu_clock_hz +
+               ((ticks % pit_clock_hz) * cpu_clock_hz + pit_clock_hz - 1) /
+                   pit_clock_hz;
     }
 
-    friend class boost::serialization::access;
-    template <class Archive>
-    void serialize(Archive &ar, const unsigned int __unused version)
+    static unsigned long period_ticks(const Channel &c)
     {
-        // clang-format off
-        ar & access;
-        ar & operating_mode;
-        ar & latched;
-        ar & latched_val;
-        ar & access_low;
-        ar & reload;
-        ar & count;
-        ar & enabled;
-        // clang-format on
+        return c.reload == 0 ? 0x10000 : c.reload;
+    }
+
+    unsigned long elapsed_ticks(const Channel &c) const
+    {
+        if (!c.gate)
+            return c.held_ticks;
+
+        return cycles_to_pit_ticks(scheduler->current_cycle() - c.start);
+    }
+
+    uint16_t counter_value(const Channel &c) const
+    {
+        if (!c.counting)
+            return c.reload;
+
+        auto period = period_ticks(c);
+        auto ticks = elapsed_ticks(c);
+
+        switch (c.mode) {
+        case 0: return c.reload - ticks;
+        case 2: return period - ticks % period;
+        default: {
+            // Mode 3 decrements by two, twice per period.
+            auto half = std::max(period / 2, 1LU);
+            return (period - 2 * (ticks % half)) & ~1;
+        }
+        }
     }
 
-    void write_mode(uint8_t v)
+    void write_control(uint8_t v)
     {
         auto channel = v >> 6;
         auto access = (v >> 4) & 0x3;
+        auto mode = (v >> 1) & 0x7;
         auto is_bcd = v & 0x1;
 
-        // Ignore DRAM refresh and sound
-        if (channel != 0)
+        // 8254 read-back is not supported.
+        if (channel == num_channels)
             return;
 
-        this->access = access;
-        if (this->access != 0) {
-            operating_mode = (v >> 1) & 0x7;
-            assert_timer(operating_mode == 2 || operating_mode == 3);
-            operating_mode = 2;
+        auto &c = channels[channel];
 
-            enabled = false;
+        if (access == 0) {
+            if (!c.latched) {
+                c.latched_val = counter_value(c);
+                c.latched = true;
+            }
+            return;
         }
+
+        // Modes 6 and 7 are aliases of 2 and 3.
+        if (mode >= 6)
+            mode -= 4;
+        assert_timer(mode == 0 || mode == 2 || mode == 3);
         assert_timer(is_bcd == 0);
 
-        access_low = this->access != 2;
-        if (access == 0 && !this->latched) {
-            this->latched_val = read_counter();
-            this->latched = true;
-        }
+        c.mode = mode;
+        c.access = access;
+        c.write_msb = access == 2;
+        c.read_msb = access == 2;
+        c.latched = false;
+        c.counting = false;
+        if (channel == 0)
+            scheduler->cancel(irq_event);
     }
 
-    void write_reload(uint8_t v)
+    void write_data(int channel, uint8_t v)
     {
-        if (this->access_low) {
-            reload &= ~0xff;
-            reload |= v;
-            access_low = false;
+        auto &c = channels[channel];
+
+        if (!c.write_msb) {
+            c.reload = (c.access == 1 ? 0 : c.reload & 0xff00) | v;
+            if (c.access == 3) {
+                // Mode 0 stops counting after the first byte.
+                c.write_msb = true;
+                if (c.mode == 0)
+                    c.counting = false;
+                return;
+            }
         } else {
-            reload &= ~0xff00;
-            reload |= static_cast<uint16_t>(v) << 8;
-            enabled = true;
-            do_reload();
+            c.reload = (c.access == 2 ? 0 : c.reload & 0x00ff) |
+                       (static_cast<uint16_t>(v) << 8);
+            c.write_msb = c.access == 2;
+        }
+
+        load_count(channel);
+    }
+
+    uint8_t read_data(int channel)
+    {
+        auto &c = channels[channel];
+        auto val = c.latched ? c.latched_val : counter_value(c);
+
+        if (c.access == 3 && !c.read_msb) {
+            c.read_msb = true;
+            return val;
+        }
+
+        c.read_msb = c.access == 2;
+        c.latched = false;
+
+        return c.access == 1 ? val : val >> 8;
+    }
+
+    void load_count(int channel)
+    {
+        auto &c = channels[channel];
+
+        c.start = scheduler->current_cycle();
+        c.held_ticks = 0;
+        c.counting = true;
+        c.expirations = 1;
+
+        if (channel == 0)
+            schedule_irq();
+    }
+
+    void schedule_irq()
+    {
+        auto &c = channels[0];
+        auto now = scheduler->current_cycle();
+        auto due = pit_ticks_to_cycles(c.expirations * period_ticks(c));
+
+        // An IRQ that was overdue when a snapshot was taken has its count
+        // start before cycle zero once restored, so the deadline would wrap.
+        // Anything already overdue fires on the current cycle instead.
+        scheduler->schedule(irq_event,
+                            due > now - c.start ? c.start + due : now);
+    }
+
+    void expire(unsigned long __unused deadline)
+    {
+        pic->raise_irq(0);
+
+        // Mode 0 is one-shot, 2 and 3 interrupt every period.
+        if (channels[0].mode != 0) {
+            ++channels[0].expirations;
+            schedule_irq();
+        }
+    }
+
+    PIC *pic;
+    Scheduler *scheduler;
+    unsigned long cpu_clock_hz;
+    Channel channels[num_channels];
+    Scheduler::EventID irq_event;
+
+    friend class boost::serialization::access;
+    template <class Archive>
+    void save(Archive &ar, const unsigned int __unused version) const
+    {
+        auto irq_pending = scheduler->is_scheduled(irq_event);
+
+        // Cycle counts restart from zero when restoring, so the start of
+        // each count is saved relative to the current cycle.
+        // clang-format off
+        for (auto &c : channels) {
+            unsigned long elapsed = scheduler->current_cycle() - c.start;
+
+            ar & c.mode;
+            ar & c.access;
+            ar & c.write_msb;
+            ar & c.read_msb;
+            ar & c.reload;
+            ar & c.counting;
+            ar & c.latched;
+            ar & c.latched_val;
+            ar & c.gate;
+            ar & elapsed;
+            ar & c.held_ticks;
+            ar & c.expirations;
+        }
+        ar & irq_pending;
+        // clang-format on
+    }
+
+    template <class Archive>
+    void load(Archive &ar, const unsigned int __unused version)
+    {
+        bool irq_pending = false;
+
+        // clang-format off
+        for (auto &c : channels) {
+            unsigned long elapsed = 0;
+
+            ar & c.mode;
+            ar & c.access;
+            ar & c.write_msb;
+            ar & c.read_msb;
+            ar & c.reload;
+            ar & c.counting;
+            ar & c.latched;
+            ar & c.latched_val;
+            ar & c.gate;
+            ar & elapsed;
+            ar & c.held_ticks;
+            ar & c.expirations;
+
+            c.start = scheduler->current_cycle() - elapsed;
         }
+        ar & irq_pending;
+        // clang-format on
+
+        if (irq_pending)
+            schedule_irq();
+        else
+            scheduler->cancel(irq_event);
     }
+    BOOST_SERIALIZATION_SPLIT_MEMBER()
 };
@@ -0,0 +1,410 @@
+// Copyright Jamie Iles, 2017
+//
+// This file is part of s80x86.
+//
+// s80x86 is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// s80x86 is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with s80x86.  If not, see <http://www.gnu.org/licenses/>.
+
+#include "Trace.h"
+
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+#include <stdexcept>
+#include <stdio.h>
+
+static const char trace_magic[8] = {'S', '8', '0', 'T', 'R', 'A', 'C', 'E'};
+static const uint32_t trace_version = 1;
+
+enum TraceTag {
+    TAG_LENGTH_MASK = 0xf,
+    TAG_CS = (1 << 4),
+    TAG_IP = (1 << 5),
+    TAG_EFFECTS = (1 << 6),
+    TAG_SKIPPED = (1 << 7),
+};
+
+static const uint16_t flags_changed = 1 << NUM_16BIT_REGS;
+
+TraceRecord::TraceRecord()
+    : index(0),
+      cs(0),
+      ip(0),
+      bytes(),
+      registers(),
+      flags(0),
+      changed(0),
+      writes()
+{
+}
+
+const size_t TraceRecord::max_length;
+
+TraceFilter::TraceFilter()
+    : have_range(false),
+      range_cs(0),
+      range_first(0),
+      range_last(0),
+      window_start(0),
+      window_count(0)
+{
+}
+
+void TraceFilter::set_range(const std::string &spec)
+{
+    unsigned cs, first, last;
+    int consumed = 0;
+
+    if (sscanf(spec.c_str(), "%x:%x-%x%n", &cs, &first, &last, &consumed) !=
+            3 ||
+        static_cast<size_t>(consumed) != spec.size() || cs > 0xffff ||
+        first > last || last > 0xffff)
+        throw std::invalid_argument("invalid trace range \"" + spec + "\"");
+
+    have_range = true;
+    range_cs = cs;
+    range_first = first;
+    range_last = last;
+}
+
+void TraceFilter::set_window(unsigned long start, unsigned long count)
+{
+    window_start = start;
+    window_count = count;
+}
+
+bool TraceFilter::accept(unsigned long index, uint16_t cs, uint16_t ip) const
+{
+    if (index < window_start || finished(index))
+        return false;
+
+    return !have_range ||
+           (cs == range_cs && ip >= range_first && ip <= range_last);
+}
+
+bool TraceFilter::finished(unsigned long index) const
+{
+    return window_count != 0 && index >= window_start + window_count;
+}
+
+TraceWriter::TraceWriter(const std::string &path,
+                         bool compress,
+                         bool side_effects)
+    : file(gzopen(path.c_str(), compress ? "wb1" : "wbT")),
+      side_effects(side_effects),
+      buffer(),
+      pending(),
+      free_buffers(),
+      stopping(false),
+      write_failed(false),
+      lock(),
+      cv(),
+      writer_thread(),
+      num_records(0),
+      next_index(0),
+      have_cs(false),
+      last_cs(0),
+      next_ip(0),
+      registers(),
+      flags(0)
+{
+    if (!file)
+        throw std::runtime_error("Failed to open trace " + path);
+
+    buffer.reserve(buffer_size);
+    buffer.insert(buffer.end(), trace_magic,
+                  trace_magic + sizeof(trace_magic));
+    put32(trace_version);
+    put32(side_effects ? TRACE_SIDE_EFFECTS : 0);
+
+    writer_thread = std::thread(&TraceWriter::writer_main, this);
+}
+
+TraceWriter::~TraceWriter()
+{
+    if (!buffer.empty())
+        submit();
+
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        stopping = true;
+    }
+    cv.notify_all();
+    writer_thread.join();
+
+    if (gzclose(file) != Z_OK || write_failed)
+        std::cerr << "Failed to write trace" << std::endl;
+}
+
+void TraceWriter::put8(uint8_t v)
+{
+    buffer.push_back(v);
+}
+
+void TraceWriter::put16(uint16_t v)
+{
+    put8(v & 0xff);
+    put8(v >> 8);
+}
+
+void TraceWriter::put32(uint32_t v)
+{
+    put16(v & 0xffff);
+    put16(v >> 16);
+}
+
+void TraceWriter::put_varint(uint32_t v)
+{
+    while (v >= 0x80) {
+        put8((v & 0x7f) | 0x80);
+        v >>= 7;
+    }
+    put8(v);
+}
+
+void TraceWriter::write(const TraceRecord &record)
+{
+    auto length = std::min(record.bytes.size(), TraceRecord::max_length);
+    auto skipped = record.index - next_index;
+    auto new_cs = !have_cs || record.cs != last_cs;
+    auto new_ip = !have_cs || record.ip != next_ip;
+
+    uint16_t changed = 0;
+    if (side_effects) {
+        for (int r = 0; r < NUM_16BIT_REGS; ++r)
+            if (r != IP && record.registers[r] != registers[r])
+                changed |= 1 << r;
+        if (record.flags != flags)
+            changed |= flags_changed;
+    }
+    auto effects = changed != 0 || !record.writes.empty();
+
+    put8(length | (new_cs ? TAG_CS : 0) | (new_ip ? TAG_IP : 0) |
+         (effects ? TAG_EFFECTS : 0) | (skipped ? TAG_SKIPPED : 0));
+    if (skipped)
+        put_varint(skipped);
+    if (new_cs)
+        put16(record.cs);
+    if (new_ip) {
+        int32_t delta = static_cast<int16_t>(record.ip - next_ip);
+        put_varint((static_cast<uint32_t>(delta) << 1) ^ (delta >> 31));
+    }
+    if (effects) {
+        put16(changed);
+        for (int r = 0; r < NUM_16BIT_REGS; ++r)
+            if (changed & (1 << r))
+                put16(record.registers[r]);
+        if (changed & flags_changed)
+            put16(record.flags);
+        put_varint(record.writes.size());
+        for (auto &w : record.writes) {
+            put_varint(w.addr);
+            put8(w.width);
+            for (unsigned b = 0; b < w.width; ++b)
+                put8(w.value >> (b * 8));
+        }
+    }
+    buffer.insert(buffer.end(), record.bytes.begin(),
+                  record.bytes.begin() + length);
+
+    have_cs = true;
+    last_cs = record.cs;
+    next_ip = record.ip + length;
+    next_index = record.index + 1;
+    if (side_effects) {
+        std::copy(record.registers, record.registers + NUM_16BIT_REGS,
+                  registers);
+        flags = record.flags;
+    }
+    ++num_records;
+
+    if (buffer.size() >= buffer_size)
+        submit();
+}
+
+void TraceWriter::submit()
+{
+    std::unique_lock<std::mutex> guard(lock);
+
+    cv.wait(guard, [this] { return pending.size() < max_pending; });
+    pending.push_back(std::move(buffer));
+    if (!free_buffers.empty()) {
+        buffer = std::move(free_buffers.back());
+        free_buffers.pop_back();
+    } else {
+        buffer = std::vector<uint8_t>();
+        buffer.reserve(buffer_size);
+    }
+    guard.unlock();
+
+    cv.notify_all();
+}
+
+void TraceWriter::writer_main()
+{
+    std::unique_lock<std::mutex> guard(lock);
+
+    for (;;) {
+        cv.wait(guard, [this] { return stopping || !pending.empty(); });
+        if (pending.empty())
+            return;
+
+        auto b = std::move(pending.front());
+        pending.pop_front();
+        guard.unlock();
+
+        if (!write_failed &&
+            gzwrite(file, b.data(), b.size()) != static_cast<int>(b.size()))
+            write_failed = true;
+        b.clear();
+
+        guard.lock();
+        free_buffers.push_back(std::move(b));
+        cv.notify_all();
+    }
+}
+
+TraceReader::TraceReader(const std::string &path)
+    : file(gzopen(path.c_str(), "rb")),
+      buffer(64 * 1024),
+      buffer_pos(0),
+      buffer_len(0),
+      side_effects(false),
+      next_index(0),
+      last_cs(0),
+      next_ip(0),
+      registers(),
+      flags(0)
+{
+    if (!file)
+        throw std::runtime_error("Failed to open trace " + path);
+
+    try {
+        char magic[sizeof(trace_magic)];
+        for (auto &c : magic)
+            c = get8();
+        if (memcmp(magic, trace_magic, sizeof(magic)) != 0)
+            throw std::runtime_error(path + " is not a trace");
+        if (get32() != trace_version)
+            throw std::runtime_error("Unsupported trace version in " + path);
+        side_effects = get32() & TRACE_SIDE_EFFECTS;
+    } catch (...) {
+        gzclose(file);
+        throw;
+    }
+}
+
+TraceReader::~TraceReader()
+{
+    gzclose(file);
+}
+
+bool TraceReader::fill()
+{
+    auto rc = gzread(file, buffer.data(), buffer.size());
+    if (rc < 0)
+        throw std::runtime_error("Failed to read trace");
+
+    buffer_pos = 0;
+    buffer_len = rc;
+
+    return buffer_len != 0;
+}
+
+uint8_t TraceReader::get8()
+{
+    if (buffer_pos == buffer_len && !fill())
+        throw std::runtime_error("Truncated trace");
+
+    return buffer[buffer_pos++];
+}
+
+uint16_t TraceReader::get16()
+{
+    uint16_t lo = get8();
+
+    return lo | (static_cast<uint16_t>(get8()) << 8);
+}
+
+uint32_t TraceReader::get32()
+{
+    uint32_t lo = get16();
+
+    return lo | (static_cast<uint32_t>(get16()) << 16);
+}
+
+uint32_t TraceReader::get_varint()
+{
+    uint32_t v = 0;
+
+    for (unsigned shift = 0; shift < 32; shift += 7) {
+        auto b = get8();
+        v |= static_cast<uint32_t>(b & 0x7f) << shift;
+        if (!(b & 0x80))
+            return v;
+    }
+
+    throw std::runtime_error("Corrupt trace varint");
+}
+
+bool TraceReader::next(TraceRecord *record)
+{
+    if (buffer_pos == buffer_len && !fill())
+        return false;
+
+    auto tag = get8();
+    auto length = tag & TAG_LENGTH_MASK;
+
+    record->index = next_index + (tag & TAG_SKIPPED ? get_varint() : 0);
+    if (tag & TAG_CS)
+        last_cs = get16();
+    record->cs = last_cs;
+    record->ip = next_ip;
+    if (tag & TAG_IP) {
+        auto zigzag = get_varint();
+        record->ip += static_cast<int32_t>(zigzag >> 1) ^ -(zigzag & 1);
+    }
+
+    record->changed = 0;
+    record->writes.clear();
+    if (tag & TAG_EFFECTS) {
+        record->changed = get16();
+        for (int r = 0; r < NUM_16BIT_REGS; ++r)
+            if (record->changed & (1 << r))
+                registers[r] = get16();
+        if (record->changed & flags_changed)
+            flags = get16();
+        for (auto count = get_varint(); count > 0; --count) {
+            MemoryWrite w;
+            w.addr = get_varint();
+            w.width = get8();
+            if (w.width != 1 && w.width != 2 && w.width != 4)
+                throw std::runtime_error("Corrupt trace memory write");
+            w.value = 0;
+            for (unsigned b = 0; b < w.width; ++b)
+                w.value |= static_cast<uint32_t>(get8()) << (b * 8);
+            record->writes.push_back(w);
+        }
+    }
+    std::copy(registers, registers + NUM_16BIT_REGS, record->registers);
+    record->flags = flags;
+
+    record->bytes.resize(length);
+    for (auto &b : record->bytes)
+        b = get8();
+
+    next_index = record->index + 1;
+    next_ip = record->ip + length;
+
+    return true;
+}
@@ -0,0 +1,219 @@
+// Copyright Jamie Iles, 2017
+//
+// This file is part of s80x86.
+//
+// s80x86 is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// s80x86 is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with s80x86.  If not, see <http://www.gnu.org/licenses/>.
+
+#pragma once
+
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <stdint.h>
+#include <string>
+#include <thread>
+#include <vector>
+#include <zlib.h>
+
+#include "Memory.h"
+#include "RegisterFile.h"
+
+// Binary execution traces.  A trace starts with the magic "S80TRACE", a
+// 32-bit version and 32-bit TraceFlags, then holds one record per traced
+// instruction.  Multi-byte fields are little endian and varints are LEB128:
+//
+//   tag       bits 0-3: instruction length, bit 4: CS follows,
+//             bit 5: IP delta follows, bit 6: side effects follow,
+//             bit 7: skipped instruction count follows
+//   skipped   varint, instructions executed but not traced since the last
+//             record
+//   cs        16-bit CS
+//   ip        zigzag varint delta from the end of the previous instruction
+//   effects   16-bit mask of changed registers with the flags in bit
+//             NUM_16BIT_REGS, each changed value as 16 bits, then a varint
+//             count of memory writes, each as a varint address, a width byte
+//             and a value of that width
+//   bytes     the instruction bytes
+//
+// Sequential instructions in the same segment are stored as just the tag
+// and the instruction bytes.  The file may be gzip compressed.
+enum TraceFlags {
+    TRACE_SIDE_EFFECTS = (1 << 0),
+};
+
+struct MemoryWrite {
+    phys_addr addr;
+    unsigned width;
+    uint32_t value;
+};
+
+struct TraceRecord {
+    TraceRecord();
+
+    // The number of the instruction in execution order.
+    unsigned long index;
+    uint16_t cs;
+    uint16_t ip;
+    // Truncated to max_length bytes.
+    std::vector<uint8_t> bytes;
+    // Register state other than IP after the instruction and the registers
+    // that changed, flags in bit NUM_16BIT_REGS.  Only valid with side
+    // effects.
+    uint16_t registers[NUM_16BIT_REGS];
+    uint16_t flags;
+    uint16_t changed;
+    std::vector<MemoryWrite> writes;
+
+    static const size_t max_length = 15;
+};
+
+// Selects which executed instructions are traced: those with an index in
+// [start, start + count) and, if a range is set, a CS:IP inside it.  A count
+// of zero is unlimited.
+class TraceFilter
+{
+public:
+    TraceFilter();
+    // "<cs>:<first ip>-<last ip>" in hex, both ends inclusive.
+    void set_range(const std::string &spec);
+    void set_window(unsigned long start, unsigned long count);
+    bool accept(unsigned long index, uint16_t cs, uint16_t ip) const;
+    // No later instruction can be accepted.
+    bool finished(unsigned long index) const;
+
+private:
+    bool have_range;
+    uint16_t range_cs;
+    uint16_t range_first;
+    uint16_t range_last;
+    unsigned long window_start;
+    unsigned long window_count;
+};
+
+// Appends the memory writes seen while it is the memory's observer to a
+// trace record, passing every access on to next, if set, so that other
+// observers can run at the same time.
+class TraceWriteLog : public MemoryObserver
+{
+public:
+    explicit TraceWriteLog(std::vector<MemoryWrite> *writes)
+        : writes(writes), next(nullptr)
+    {
+    }
+
+    void set_next(MemoryObserver *next)
+    {
+        this->next = next;
+    }
+
+    void access(phys_addr addr, unsigned width, bool write, uint32_t value)
+    {
+        if (write)
+            writes->push_back({addr, width, value});
+        if (next)
+            next->access(addr, width, write, value);
+    }
+
+private:
+    std::vector<MemoryWrite> *writes;
+    MemoryObserver *next;
+};
+
+// Records are encoded on the calling thread into buffers that a writer
+// thread compresses and writes out, so the simulation only stalls when the
+// writer falls behind by more than max_pending buffers.
+class TraceWriter
+{
+public:
+    TraceWriter(const std::string &path, bool compress, bool side_effects);
+    ~TraceWriter();
+    TraceWriter(const TraceWriter &) = delete;
+    TraceWriter &operator=(const TraceWriter &) = delete;
+
+    bool has_side_effects() const
+    {
+        return side_effects;
+    }
+    void write(const TraceRecord &record);
+    unsigned long records_written() const
+    {
+        return num_records;
+    }
+
+private:
+    void put8(uint8_t v);
+    void put16(uint16_t v);
+    void put32(uint32_t v);
+    void put_varint(uint32_t v);
+    void submit();
+    void writer_main();
+
+    static const size_t buffer_size = 1024 * 1024;
+    static const size_t max_pending = 8;
+
+    gzFile file;
+    bool side_effects;
+    std::vector<uint8_t> buffer;
+    std::deque<std::vector<uint8_t>> pending;
+    std::vector<std::vector<uint8_t>> free_buffers;
+    bool stopping;
+    bool write_failed;
+    std::mutex lock;
+    std::condition_variable cv;
+    std::thread writer_thread;
+
+    unsigned long num_records;
+    unsigned long next_index;
+    bool have_cs;
+    uint16_t last_cs;
+    uint16_t next_ip;
+    uint16_t registers[NUM_16BIT_REGS];
+    uint16_t flags;
+};
+
+// Reads compressed or uncompressed traces.
+class TraceReader
+{
+public:
+    explicit TraceReader(const std::string &path);
+    ~TraceReader();
+    TraceReader(const TraceReader &) = delete;
+    TraceReader &operator=(const TraceReader &) = delete;
+
+    bool has_side_effects() const
+    {
+        return side_effects;
+    }
+    // Returns false at the end of the trace.
+    bool next(TraceRecord *record);
+
+private:
+    bool fill();
+    uint8_t get8();
+    uint16_t get16();
+    uint32_t get32();
+    uint32_t get_varint();
+
+    gzFile file;
+    std::vector<uint8_t> buffer;
+    size_t buffer_pos;
+    size_t buffer_len;
+    bool side_effects;
+
+    unsigned long next_index;
+    uint16_t last_cs;
+    uint16_t next_ip;
+    uint16_t registers[NUM_16BIT_REGS];
+    uint16_t flags;
+};
@@ -0,0 +1,140 @@
+// Copyright Jamie Iles, 2017
+//
+// This file is part of s80x86.
+//
+// s80x86 is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// s80x86 is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with s80x86.  If not, see <http://www.gnu.org/licenses/>.
+
+#include <iostream>
+#include <string>
+
+#include <boost/format.hpp>
+#include <boost/program_options.hpp>
+
+#include "Disassembler.h"
+#include "Trace.h"
+
+static const char *reg_names[NUM_16BIT_REGS] = {"ax", "cx", "dx", "bx", "sp",
+                                                 "bp", "si", "di", "es", "cs",
+                                                 "ss", "ds", "ip"};
+
+static std::string format_side_effects(const TraceRecord &record)
+{
+    std::string effects;
+
+    for (int r = 0; r < NUM_16BIT_REGS; ++r)
+        if (record.changed & (1 << r))
+            effects += (boost::format(" %s=%04x") % reg_names[r] %
+                        record.registers[r])
+                           .str();
+    if (record.changed & (1 << NUM_16BIT_REGS))
+        effects += (boost::format(" flags=%04x") % record.flags).str();
+    for (auto &w : record.writes) {
+        auto value_format = "=%0" + std::to_string(w.width * 2) + "x";
+        effects += (boost::format(" [%05x]") % w.addr).str() +
+                   (boost::format(value_format) % w.value).str();
+    }
+
+    return effects.empty() ? "" : "  ;" + effects;
+}
+
+static void dump(const std::string &path, const TraceFilter &filter)
+{
+    TraceReader reader(path);
+    TraceRecord record;
+
+    while (reader.next(&record) && !filter.finished(record.index)) {
+        if (!filter.accept(record.index, record.cs, record.ip))
+            continue;
+
+        std::string hex_bytes;
+        for (auto b : record.bytes)
+            hex_bytes += (boost::format("%02x ") % static_cast<unsigned>(b))
+                             .str();
+
+        std::string text;
+        size_t offs = 0;
+        while (offs < record.bytes.size()) {
+            std::string insn;
+            offs += disassemble(record.bytes.data() + offs,
+                                record.bytes.size() - offs, record.ip + offs,
+                                &insn);
+            text += (text.empty() ? "" : "; ") + insn;
+        }
+
+        std::cout << boost::format("[%04x:%04x] %-21s%s%s") % record.cs %
+                         record.ip % hex_bytes % text %
+                         format_side_effects(record)
+                  << std::endl;
+    }
+}
+
+int main(int argc, char **argv)
+{
+    namespace po = boost::program_options;
+    std::string trace_path;
+    std::string range;
+    unsigned long start = 0;
+    unsigned long count = 0;
+
+    po::options_description desc("Options");
+    // clang-format off
+    desc.add_options()
+        ("help,h", "print this usage information and exit")
+        ("range", po::value<std::string>(&range),
+         "only print instructions in <cs>:<first ip>-<last ip>, hex and inclusive")
+        ("start", po::value<unsigned long>(&start),
+         "number of executed instructions to skip, default 0")
+        ("count", po::value<unsigned long>(&count),
+         "number of executed instructions to print from start, default 0 for all")
+        ("trace", po::value<std::string>(&trace_path)->required(),
+         "the trace file written by the simulator");
+    // clang-format on
+
+    po::positional_options_description positional;
+    positional.add("trace", 1);
+
+    TraceFilter filter;
+    po::variables_map variables_map;
+    try {
+        po::store(po::command_line_parser(argc, argv)
+                      .options(desc)
+                      .positional(positional)
+                      .run(),
+                  variables_map);
+        if (variables_map.count("help")) {
+            std::cout << desc << std::endl;
+            return 0;
+        }
+        po::notify(variables_map);
+
+        if (range != "")
+            filter.set_range(range);
+        filter.set_window(start, count);
+    } catch (std::invalid_argument &e) {
+        std::cerr << "Error: " << e.what() << std::endl;
+        return 2;
+    } catch (boost::program_options::error &e) {
+        std::cerr << "Error: " << e.what() << std::endl;
+        return 2;
+    }
+
+    try {
+        dump(trace_path, filter);
+    } catch (std::runtime_error &e) {
+        std::cerr << "Error: " << e.what() << std::endl;
+        return 1;
+    }
+
+    return 0;
+}
@@ -15,21 +15,46 @@
 // You should have received a copy of the GNU General Public License
 // along with s80x86.  If not, see <http://www.gnu.org/licenses/>.
 
-#include <iostream>
 #include <stdint.h>
 
 #include "UART.h"
 #include "CPU.h"
 
-UART::UART() : IOPorts(0xfffa, 1)
+UART::UART(std::unique_ptr<SerialBackend> backend,
+           PIC *pic,
+           int irq_num,
+           unsigned long flush_interval)
+    : IOPorts(0xfffa, 1),
+      backend(std::move(backend)),
+      pic(pic),
+      irq_num(irq_num),
+      flush_interval(flush_interval),
+      last_flush(0),
+      host_rx(host_rx_depth),
+      rx_fifo(rx_depth),
+      tx_fifo(tx_depth),
+      control(0),
+      got_exit(false)
 {
 }
 
+UART::~UART()
+{
+    flush();
+}
+
 void UART::write8(uint16_t __unused port_num, unsigned offs, uint8_t v)
 {
     if (offs == 0) {
-        std::cout << static_cast<char>(v);
-        std::cout.flush();
+        tx_fifo.push(v);
+        if (v == '\n' || tx_fifo.is_full())
+            flush();
+    } else {
+        auto was_enabled = control & control_rx_irq_enable;
+
+        control = v;
+        if (!was_enabled && !rx_fifo.empty())
+            raise_rx_irq();
     }
 }
 
@@ -41,25 +66,55 @@ void UART::write16(uint16_t __unused port_num, uint16_t v)
 
 uint8_t UART::read8(uint16_t __unused port_num, unsigned offs)
 {
-    if (offs == 0) {
-        if (!charbuf.size())
-            return 0;
+    if (offs == 0)
+        return rx_fifo.empty() ? 0 : rx_fifo.pop();
+    else
+        return rx_fifo.empty() ? 0 : status_rx_ready;
+}
+
+uint16_t UART::read16(uint16_t __unused port_num)
+{
+    return read8(0, 0) | (static_cast<uint16_t>(read8(0, 1)) << 8);
+}
 
-        auto v = charbuf[0];
-        charbuf.pop_front();
+void UART::flush()
+{
+    uint8_t buf[256];
 
-        return v;
-    } else {
-        return !!charbuf.size();
+    while (!tx_fifo.empty()) {
+        size_t len = 0;
+
+        while (len < sizeof(buf) && !tx_fifo.empty())
+            buf[len++] = tx_fifo.pop();
+        backend->write(buf, len);
     }
 }
 
-uint16_t UART::read16(uint16_t __unused port_num)
+void UART::service(unsigned long cycle_num)
 {
-    return read8(0, 0) | (static_cast<uint16_t>(read8(0, 1)) << 8);
+    if (cycle_num - last_flush >= flush_interval) {
+        flush();
+        last_flush = cycle_num;
+    }
+
+    bool received = false;
+    uint8_t v;
+
+    while (!rx_fifo.is_full() && host_rx.pop(v)) {
+        if (v == exit_char) {
+            got_exit = true;
+        } else {
+            rx_fifo.push(v);
+            received = true;
+        }
+    }
+
+    if (received)
+        raise_rx_irq();
 }
 
-void UART::add_char(int c)
+void UART::raise_rx_irq()
 {
-    charbuf.push_back(c);
+    if (irq_num >= 0 && (control & control_rx_irq_enable))
+        pic->raise_irq(irq_num);
 }
@@ -17,65 +17,84 @@
 
 #pragma once
 
-#include <deque>
-#include <iostream>
-#include <termios.h>
-#include <unistd.h>
-#include <stdexcept>
+#include <memory>
+#include <stdint.h>
 
-#include <boost/serialization/list.hpp>
-#include <boost/serialization/deque.hpp>
 #include <boost/serialization/string.hpp>
 #include <boost/serialization/version.hpp>
 
-#include "UART.h"
 #include "CPU.h"
+#include "Fifo.h"
+#include "PIC.h"
+#include "SerialBackend.h"
+#include "SPSCQueue.h"
 
-class RawTTY
+// Buffered UART.  Transmitted bytes are collected in a FIFO and written to the
+// backend on newline, when the FIFO fills or after flush_interval guest
+// cycles.  Bytes from the host arrive on a lock-free queue, filled by the
+// input thread, and are moved into the RX FIFO as it has room, optionally
+// raising an IRQ when the guest has set the RX interrupt enable bit.
+//
+// Port +0: data, port +1: read status (bit 0 RX ready, bit 1 TX busy), write
+// control (bit 0 RX interrupt enable).
+class UART : public IOPorts
 {
 public:
-    RawTTY()
+    UART(std::unique_ptr<SerialBackend> backend,
+         PIC *pic,
+         int irq_num,
+         unsigned long flush_interval);
+    ~UART();
+    void write8(uint16_t port_num, unsigned offs, uint8_t v);
+    void write16(uint16_t port_num, uint16_t v);
+    uint8_t read8(uint16_t port_num, unsigned offs);
+    uint16_t read16(uint16_t port_num);
+    // Flush pending output if due and pull in any received bytes.
+    void service(unsigned long cycle_num);
+    SerialBackend *serial_backend()
     {
-        if (tcgetattr(STDIN_FILENO, &old_termios))
-            throw std::runtime_error("Failed to get termios");
-
-        auto termios = old_termios;
-        cfmakeraw(&termios);
-        termios.c_cc[VMIN] = 0;
-        termios.c_cc[VTIME] = 0;
-        if (tcsetattr(STDIN_FILENO, TCSANOW, &termios))
-            throw std::runtime_error("Failed to set new termios");
+        return backend.get();
     }
-
-    ~RawTTY()
+    SPSCQueue<uint8_t> *host_rx_queue()
+    {
+        return &host_rx;
+    }
+    bool exit_requested() const
     {
-        tcsetattr(STDIN_FILENO, TCSANOW, &old_termios);
+        return got_exit;
     }
+    void flush();
 
 private:
-    struct termios old_termios;
-};
+    static const unsigned rx_depth = 256;
+    static const unsigned tx_depth = 4096;
+    static const unsigned host_rx_depth = 1024;
+    static const uint8_t status_rx_ready = 1 << 0;
+    static const uint8_t control_rx_irq_enable = 1 << 0;
+    // ^] on the serial line exits the simulator.
+    static const uint8_t exit_char = 0x1d;
 
-class UART : public IOPorts
-{
-public:
-    UART();
-    void write8(uint16_t port_num, unsigned offs, uint8_t v);
-    void write16(uint16_t port_num, uint16_t v);
-    uint8_t read8(uint16_t port_num, unsigned offs);
-    uint16_t read16(uint16_t port_num);
-    void add_char(int c);
+    void raise_rx_irq();
 
-private:
-    RawTTY raw_tty;
-    std::deque<uint8_t> charbuf;
+    std::unique_ptr<SerialBackend> backend;
+    PIC *pic;
+    int irq_num;
+    unsigned long flush_interval;
+    unsigned long last_flush;
+    SPSCQueue<uint8_t> host_rx;
+    Fifo<uint8_t> rx_fifo;
+    Fifo<uint8_t> tx_fifo;
+    uint8_t control;
+    bool got_exit;
 
     friend class boost::serialization::access;
     template <class Archive>
     void serialize(Archive &ar, const unsigned int __unused version)
     {
         // clang-format off
-        ar & charbuf;
+        ar & rx_fifo;
+        ar & tx_fifo;
+        ar & control;
         // clang-format on
     }
 };
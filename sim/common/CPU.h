@@ -19,6 +19,7 @@
 
 #include <memory>
 #include <functional>
+#include <ostream>
 #include <stdexcept>
 #include <string>
 #include <vector>
@@ -75,6 +76,14 @@ public:
         write8(port_num, 0, v);
         write8(port_num, 1, v >> 8);
     }
+    // Reads that can return a different value without an intervening write
+    // or device event, such as a free running counter.  A loop polling one of
+    // these is never treated as idle.
+    virtual bool read_is_volatile(uint16_t __unused port_num,
+                                  unsigned __unused offs) const
+    {
+        return false;
+    }
     uint16_t get_base() const
     {
         return base;
@@ -91,6 +100,13 @@ private:
 
 using NotImplemented = std::runtime_error;
 
+// The 16-bit registers, indexed by GPR, and the flags.  Bulk transfers never
+// go through guest memory, so the RTLCPU's cache is left as it was.
+struct RegisterState {
+    uint16_t registers[NUM_16BIT_REGS];
+    uint16_t flags;
+};
+
 class CPU
 {
 public:
@@ -130,6 +146,24 @@ public:
     virtual void write_flags(uint16_t val) = 0;
     virtual uint16_t read_flags() const = 0;
     virtual bool has_trapped() = 0;
+    // All of the registers at once, backends where each register access is
+    // expensive provide a bulk path.
+    virtual RegisterState read_all_regs() const
+    {
+        RegisterState state;
+
+        for (int r = 0; r < NUM_16BIT_REGS; ++r)
+            state.registers[r] = read_reg(static_cast<GPR>(r));
+        state.flags = read_flags();
+
+        return state;
+    }
+    virtual void write_all_regs(const RegisterState &state)
+    {
+        for (int r = 0; r < NUM_16BIT_REGS; ++r)
+            write_reg(static_cast<GPR>(r), state.registers[r]);
+        write_flags(state.flags);
+    }
     virtual void reset() = 0;
     virtual bool instruction_had_side_effects() const = 0;
     virtual void clear_side_effects() = 0;
@@ -200,10 +234,17 @@ public:
 class SimCPU : public CPU
 {
 public:
-    explicit SimCPU(const std::string &name)
-        : CPU(name), inta_handler([](int __unused irq_num) {})
+    // With shared_mem the CPU uses that memory rather than its own, so that
+    // execution can be handed between CPUs without copying.
+    explicit SimCPU(const std::string &name, Memory *shared_mem = nullptr)
+        : CPU(name),
+          own_mem(),
+          mem(shared_mem ? *shared_mem : own_mem),
+          inta_handler([](int __unused irq_num) {})
     {
     }
+    SimCPU(const SimCPU &) = delete;
+    SimCPU &operator=(const SimCPU &) = delete;
 
     Memory *get_memory()
     {
@@ -230,8 +271,77 @@ public:
         this->inta_handler = handler;
     }
 
+    // Remove and return an interrupt that has been raised but not yet taken,
+    // 0 if there isn't one.
+    virtual int take_pending_irq()
+    {
+        throw NotImplemented("take_pending_irq not implemented");
+    }
+
+    // Skip forward to the cycle before next_event() when the CPU is spinning
+    // in a loop that cannot make progress until a device event.  An empty
+    // function disables skipping.
+    virtual void set_fast_forward(std::function<unsigned long()> next_event)
+    {
+        (void)next_event;
+    }
+
+    virtual unsigned long fast_forwarded_cycles() const
+    {
+        return 0;
+    }
+
+    // JSON execution statistics, only collected by the SoftwareCPU when built
+    // with S80X86_INSN_STATS.
+    virtual void write_instruction_stats(std::ostream &out) const
+    {
+        (void)out;
+    }
+
+    // Called after an instruction raises the invalid opcode exception, only
+    // supported by the SoftwareCPU.
+    virtual void set_invalid_opcode_handler(std::function<void()> handler)
+    {
+        (void)handler;
+    }
+
+    // Waveform tracing of the Verilog model, only supported by the RTLCPU.
+    // An empty path uses the default name and a stop cycle of ~0UL never
+    // stops.
+    virtual void start_waveform(const std::string &path, int depth)
+    {
+        (void)path;
+        (void)depth;
+    }
+
+    virtual void stop_waveform()
+    {
+    }
+
+    virtual void waveform_window(unsigned long start_cycle,
+                                 unsigned long stop_cycle,
+                                 const std::string &path,
+                                 int depth)
+    {
+        (void)start_cycle;
+        (void)stop_cycle;
+        (void)path;
+        (void)depth;
+    }
+
+    // Cycles per microcode address and opcode, only supported by the RTLCPU.
+    virtual void start_microcode_profile()
+    {
+    }
+
+    virtual void write_microcode_profile(const std::string &path)
+    {
+        (void)path;
+    }
+
 protected:
-    Memory mem;
+    Memory own_mem;
+    Memory &mem;
 
     void ack_int(int irq_num)
     {
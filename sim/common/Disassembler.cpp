@@ -0,0 +1,523 @@
+// Copyright Jamie Iles, 2017
+//
+// This file is part of s80x86.
+//
+// s80x86 is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// s80x86 is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with s80x86.  If not, see <http://www.gnu.org/licenses/>.
+
+#include "Disassembler.h"
+
+#include <boost/format.hpp>
+
+enum ArgKind {
+    ARG_NONE,
+    ARG_EB, // ModRM r/m, byte
+    ARG_EV, // ModRM r/m, word
+    ARG_GB, // ModRM reg, byte
+    ARG_GV, // ModRM reg, word
+    ARG_SW, // ModRM reg, segment register
+    ARG_M,  // ModRM memory without a size
+    ARG_MP, // ModRM memory far pointer
+    ARG_IB,
+    ARG_IBS, // Sign extended byte immediate
+    ARG_IV,
+    ARG_JB,
+    ARG_JV,
+    ARG_AP, // Immediate far pointer
+    ARG_OB, // Direct memory offset, byte
+    ARG_OV, // Direct memory offset, word
+    ARG_AL,
+    ARG_AX,
+    ARG_CL,
+    ARG_DX,
+    ARG_ONE,
+    ARG_ZB, // Byte register in the low opcode bits
+    ARG_ZV, // Word register in the low opcode bits
+    ARG_ES,
+    ARG_CS,
+    ARG_SS,
+    ARG_DS,
+};
+
+enum OpcodeGroup {
+    NO_GROUP,
+    PREFIX,
+    GROUP_1,
+    GROUP_2,
+    GROUP_3,
+    GROUP_4,
+    GROUP_5,
+    GROUP_POP,
+    GROUP_MOV,
+    GROUP_ESC,
+};
+
+struct OpcodeInfo {
+    const char *mnemonic;
+    OpcodeGroup group;
+    ArgKind args[3];
+};
+
+// clang-format off
+static const OpcodeInfo opcodes[256] = {
+    // 0x00
+    {"add", NO_GROUP, {ARG_EB, ARG_GB}}, {"add", NO_GROUP, {ARG_EV, ARG_GV}},
+    {"add", NO_GROUP, {ARG_GB, ARG_EB}}, {"add", NO_GROUP, {ARG_GV, ARG_EV}},
+    {"add", NO_GROUP, {ARG_AL, ARG_IB}}, {"add", NO_GROUP, {ARG_AX, ARG_IV}},
+    {"push", NO_GROUP, {ARG_ES}}, {"pop", NO_GROUP, {ARG_ES}},
+    {"or", NO_GROUP, {ARG_EB, ARG_GB}}, {"or", NO_GROUP, {ARG_EV, ARG_GV}},
+    {"or", NO_GROUP, {ARG_GB, ARG_EB}}, {"or", NO_GROUP, {ARG_GV, ARG_EV}},
+    {"or", NO_GROUP, {ARG_AL, ARG_IB}}, {"or", NO_GROUP, {ARG_AX, ARG_IV}},
+    {"push", NO_GROUP, {ARG_CS}}, {nullptr, NO_GROUP, {}},
+    // 0x10
+    {"adc", NO_GROUP, {ARG_EB, ARG_GB}}, {"adc", NO_GROUP, {ARG_EV, ARG_GV}},
+    {"adc", NO_GROUP, {ARG_GB, ARG_EB}}, {"adc", NO_GROUP, {ARG_GV, ARG_EV}},
+    {"adc", NO_GROUP, {ARG_AL, ARG_IB}}, {"adc", NO_GROUP, {ARG_AX, ARG_IV}},
+    {"push", NO_GROUP, {ARG_SS}}, {"pop", NO_GROUP, {ARG_SS}},
+    {"sbb", NO_GROUP, {ARG_EB, ARG_GB}}, {"sbb", NO_GROUP, {ARG_EV, ARG_GV}},
+    {"sbb", NO_GROUP, {ARG_GB, ARG_EB}}, {"sbb", NO_GROUP, {ARG_GV, ARG_EV}},
+    {"sbb", NO_GROUP, {ARG_AL, ARG_IB}}, {"sbb", NO_GROUP, {ARG_AX, ARG_IV}},
+    {"push", NO_GROUP, {ARG_DS}}, {"pop", NO_GROUP, {ARG_DS}},
+    // 0x20
+    {"and", NO_GROUP, {ARG_EB, ARG_GB}}, {"and", NO_GROUP, {ARG_EV, ARG_GV}},
+    {"and", NO_GROUP, {ARG_GB, ARG_EB}}, {"and", NO_GROUP, {ARG_GV, ARG_EV}},
+    {"and", NO_GROUP, {ARG_AL, ARG_IB}}, {"and", NO_GROUP, {ARG_AX, ARG_IV}},
+    {"es", PREFIX, {}}, {"daa", NO_GROUP, {}},
+    {"sub", NO_GROUP, {ARG_EB, ARG_GB}}, {"sub", NO_GROUP, {ARG_EV, ARG_GV}},
+    {"sub", NO_GROUP, {ARG_GB, ARG_EB}}, {"sub", NO_GROUP, {ARG_GV, ARG_EV}},
+    {"sub", NO_GROUP, {ARG_AL, ARG_IB}}, {"sub", NO_GROUP, {ARG_AX, ARG_IV}},
+    {"cs", PREFIX, {}}, {"das", NO_GROUP, {}},
+    // 0x30
+    {"xor", NO_GROUP, {ARG_EB, ARG_GB}}, {"xor", NO_GROUP, {ARG_EV, ARG_GV}},
+    {"xor", NO_GROUP, {ARG_GB, ARG_EB}}, {"xor", NO_GROUP, {ARG_GV, ARG_EV}},
+    {"xor", NO_GROUP, {ARG_AL, ARG_IB}}, {"xor", NO_GROUP, {ARG_AX, ARG_IV}},
+    {"ss", PREFIX, {}}, {"aaa", NO_GROUP, {}},
+    {"cmp", NO_GROUP, {ARG_EB, ARG_GB}}, {"cmp", NO_GROUP, {ARG_EV, ARG_GV}},
+    {"cmp", NO_GROUP, {ARG_GB, ARG_EB}}, {"cmp", NO_GROUP, {ARG_GV, ARG_EV}},
+    {"cmp", NO_GROUP, {ARG_AL, ARG_IB}}, {"cmp", NO_GROUP, {ARG_AX, ARG_IV}},
+    {"ds", PREFIX, {}}, {"aas", NO_GROUP, {}},
+    // 0x40
+    {"inc", NO_GROUP, {ARG_ZV}}, {"inc", NO_GROUP, {ARG_ZV}},
+    {"inc", NO_GROUP, {ARG_ZV}}, {"inc", NO_GROUP, {ARG_ZV}},
+    {"inc", NO_GROUP, {ARG_ZV}}, {"inc", NO_GROUP, {ARG_ZV}},
+    {"inc", NO_GROUP, {ARG_ZV}}, {"inc", NO_GROUP, {ARG_ZV}},
+    {"dec", NO_GROUP, {ARG_ZV}}, {"dec", NO_GROUP, {ARG_ZV}},
+    {"dec", NO_GROUP, {ARG_ZV}}, {"dec", NO_GROUP, {ARG_ZV}},
+    {"dec", NO_GROUP, {ARG_ZV}}, {"dec", NO_GROUP, {ARG_ZV}},
+    {"dec", NO_GROUP, {ARG_ZV}}, {"dec", NO_GROUP, {ARG_ZV}},
+    // 0x50
+    {"push", NO_GROUP, {ARG_ZV}}, {"push", NO_GROUP, {ARG_ZV}},
+    {"push", NO_GROUP, {ARG_ZV}}, {"push", NO_GROUP, {ARG_ZV}},
+    {"push", NO_GROUP, {ARG_ZV}}, {"push", NO_GROUP, {ARG_ZV}},
+    {"push", NO_GROUP, {ARG_ZV}}, {"push", NO_GROUP, {ARG_ZV}},
+    {"pop", NO_GROUP, {ARG_ZV}}, {"pop", NO_GROUP, {ARG_ZV}},
+    {"pop", NO_GROUP, {ARG_ZV}}, {"pop", NO_GROUP, {ARG_ZV}},
+    {"pop", NO_GROUP, {ARG_ZV}}, {"pop", NO_GROUP, {ARG_ZV}},
+    {"pop", NO_GROUP, {ARG_ZV}}, {"pop", NO_GROUP, {ARG_ZV}},
+    // 0x60
+    {"pusha", NO_GROUP, {}}, {"popa", NO_GROUP, {}},
+    {"bound", NO_GROUP, {ARG_GV, ARG_M}}, {nullptr, NO_GROUP, {}},
+    {nullptr, NO_GROUP, {}}, {nullptr, NO_GROUP, {}},
+    {nullptr, NO_GROUP, {}}, {nullptr, NO_GROUP, {}},
+    {"push", NO_GROUP, {ARG_IV}}, {"imul", NO_GROUP, {ARG_GV, ARG_EV, ARG_IV}},
+    {"push", NO_GROUP, {ARG_IBS}},
+    {"imul", NO_GROUP, {ARG_GV, ARG_EV, ARG_IBS}},
+    {"insb", NO_GROUP, {}}, {"insw", NO_GROUP, {}},
+    {"outsb", NO_GROUP, {}}, {"outsw", NO_GROUP, {}},
+    // 0x70
+    {"jo", NO_GROUP, {ARG_JB}}, {"jno", NO_GROUP, {ARG_JB}},
+    {"jb", NO_GROUP, {ARG_JB}}, {"jnb", NO_GROUP, {ARG_JB}},
+    {"jz", NO_GROUP, {ARG_JB}}, {"jnz", NO_GROUP, {ARG_JB}},
+    {"jbe", NO_GROUP, {ARG_JB}}, {"ja", NO_GROUP, {ARG_JB}},
+    {"js", NO_GROUP, {ARG_JB}}, {"jns", NO_GROUP, {ARG_JB}},
+    {"jp", NO_GROUP, {ARG_JB}}, {"jnp", NO_GROUP, {ARG_JB}},
+    {"jl", NO_GROUP, {ARG_JB}}, {"jge", NO_GROUP, {ARG_JB}},
+    {"jle", NO_GROUP, {ARG_JB}}, {"jg", NO_GROUP, {ARG_JB}},
+    // 0x80
+    {nullptr, GROUP_1, {ARG_EB, ARG_IB}}, {nullptr, GROUP_1, {ARG_EV, ARG_IV}},
+    {nullptr, GROUP_1, {ARG_EB, ARG_IB}}, {nullptr, GROUP_1, {ARG_EV, ARG_IBS}},
+    {"test", NO_GROUP, {ARG_EB, ARG_GB}}, {"test", NO_GROUP, {ARG_EV, ARG_GV}},
+    {"xchg", NO_GROUP, {ARG_EB, ARG_GB}}, {"xchg", NO_GROUP, {ARG_EV, ARG_GV}},
+    {"mov", NO_GROUP, {ARG_EB, ARG_GB}}, {"mov", NO_GROUP, {ARG_EV, ARG_GV}},
+    {"mov", NO_GROUP, {ARG_GB, ARG_EB}}, {"mov", NO_GROUP, {ARG_GV, ARG_EV}},
+    {"mov", NO_GROUP, {ARG_EV, ARG_SW}}, {"lea", NO_GROUP, {ARG_GV, ARG_M}},
+    {"mov", NO_GROUP, {ARG_SW, ARG_EV}}, {nullptr, GROUP_POP, {ARG_EV}},
+    // 0x90
+    {"nop", NO_GROUP, {}}, {"xchg", NO_GROUP, {ARG_AX, ARG_ZV}},
+    {"xchg", NO_GROUP, {ARG_AX, ARG_ZV}}, {"xchg", NO_GROUP, {ARG_AX, ARG_ZV}},
+    {"xchg", NO_GROUP, {ARG_AX, ARG_ZV}}, {"xchg", NO_GROUP, {ARG_AX, ARG_ZV}},
+    {"xchg", NO_GROUP, {ARG_AX, ARG_ZV}}, {"xchg", NO_GROUP, {ARG_AX, ARG_ZV}},
+    {"cbw", NO_GROUP, {}}, {"cwd", NO_GROUP, {}},
+    {"call", NO_GROUP, {ARG_AP}}, {"wait", NO_GROUP, {}},
+    {"pushf", NO_GROUP, {}}, {"popf", NO_GROUP, {}},
+    {"sahf", NO_GROUP, {}}, {"lahf", NO_GROUP, {}},
+    // 0xa0
+    {"mov", NO_GROUP, {ARG_AL, ARG_OB}}, {"mov", NO_GROUP, {ARG_AX, ARG_OV}},
+    {"mov", NO_GROUP, {ARG_OB, ARG_AL}}, {"mov", NO_GROUP, {ARG_OV, ARG_AX}},
+    {"movsb", NO_GROUP, {}}, {"movsw", NO_GROUP, {}},
+    {"cmpsb", NO_GROUP, {}}, {"cmpsw", NO_GROUP, {}},
+    {"test", NO_GROUP, {ARG_AL, ARG_IB}}, {"test", NO_GROUP, {ARG_AX, ARG_IV}},
+    {"stosb", NO_GROUP, {}}, {"stosw", NO_GROUP, {}},
+    {"lodsb", NO_GROUP, {}}, {"lodsw", NO_GROUP, {}},
+    {"scasb", NO_GROUP, {}}, {"scasw", NO_GROUP, {}},
+    // 0xb0
+    {"mov", NO_GROUP, {ARG_ZB, ARG_IB}}, {"mov", NO_GROUP, {ARG_ZB, ARG_IB}},
+    {"mov", NO_GROUP, {ARG_ZB, ARG_IB}}, {"mov", NO_GROUP, {ARG_ZB, ARG_IB}},
+    {"mov", NO_GROUP, {ARG_ZB, ARG_IB}}, {"mov", NO_GROUP, {ARG_ZB, ARG_IB}},
+    {"mov", NO_GROUP, {ARG_ZB, ARG_IB}}, {"mov", NO_GROUP, {ARG_ZB, ARG_IB}},
+    {"mov", NO_GROUP, {ARG_ZV, ARG_IV}}, {"mov", NO_GROUP, {ARG_ZV, ARG_IV}},
+    {"mov", NO_GROUP, {ARG_ZV, ARG_IV}}, {"mov", NO_GROUP, {ARG_ZV, ARG_IV}},
+    {"mov", NO_GROUP, {ARG_ZV, ARG_IV}}, {"mov", NO_GROUP, {ARG_ZV, ARG_IV}},
+    {"mov", NO_GROUP, {ARG_ZV, ARG_IV}}, {"mov", NO_GROUP, {ARG_ZV, ARG_IV}},
+    // 0xc0
+    {nullptr, GROUP_2, {ARG_EB, ARG_IB}}, {nullptr, GROUP_2, {ARG_EV, ARG_IB}},
+    {"ret", NO_GROUP, {ARG_IV}}, {"ret", NO_GROUP, {}},
+    {"les", NO_GROUP, {ARG_GV, ARG_MP}}, {"lds", NO_GROUP, {ARG_GV, ARG_MP}},
+    {nullptr, GROUP_MOV, {ARG_EB, ARG_IB}},
+    {nullptr, GROUP_MOV, {ARG_EV, ARG_IV}},
+    {"enter", NO_GROUP, {ARG_IV, ARG_IB}}, {"leave", NO_GROUP, {}},
+    {"retf", NO_GROUP, {ARG_IV}}, {"retf", NO_GROUP, {}},
+    {"int3", NO_GROUP, {}}, {"int", NO_GROUP, {ARG_IB}},
+    {"into", NO_GROUP, {}}, {"iret", NO_GROUP, {}},
+    // 0xd0
+    {nullptr, GROUP_2, {ARG_EB, ARG_ONE}},
+    {nullptr, GROUP_2, {ARG_EV, ARG_ONE}},
+    {nullptr, GROUP_2, {ARG_EB, ARG_CL}}, {nullptr, GROUP_2, {ARG_EV, ARG_CL}},
+    {"aam", NO_GROUP, {ARG_IB}}, {"aad", NO_GROUP, {ARG_IB}},
+    {"salc", NO_GROUP, {}}, {"xlat", NO_GROUP, {}},
+    {nullptr, GROUP_ESC, {}}, {nullptr, GROUP_ESC, {}},
+    {nullptr, GROUP_ESC, {}}, {nullptr, GROUP_ESC, {}},
+    {nullptr, GROUP_ESC, {}}, {nullptr, GROUP_ESC, {}},
+    {nullptr, GROUP_ESC, {}}, {nullptr, GROUP_ESC, {}},
+    // 0xe0
+    {"loopnz", NO_GROUP, {ARG_JB}}, {"loopz", NO_GROUP, {ARG_JB}},
+    {"loop", NO_GROUP, {ARG_JB}}, {"jcxz", NO_GROUP, {ARG_JB}},
+    {"in", NO_GROUP, {ARG_AL, ARG_IB}}, {"in", NO_GROUP, {ARG_AX, ARG_IB}},
+    {"out", NO_GROUP, {ARG_IB, ARG_AL}}, {"out", NO_GROUP, {ARG_IB, ARG_AX}},
+    {"call", NO_GROUP, {ARG_JV}}, {"jmp", NO_GROUP, {ARG_JV}},
+    {"jmp", NO_GROUP, {ARG_AP}}, {"jmp", NO_GROUP, {ARG_JB}},
+    {"in", NO_GROUP, {ARG_AL, ARG_DX}}, {"in", NO_GROUP, {ARG_AX, ARG_DX}},
+    {"out", NO_GROUP, {ARG_DX, ARG_AL}}, {"out", NO_GROUP, {ARG_DX, ARG_AX}},
+    // 0xf0
+    {"lock", PREFIX, {}}, {nullptr, NO_GROUP, {}},
+    {"repne", PREFIX, {}}, {"rep", PREFIX, {}},
+    {"hlt", NO_GROUP, {}}, {"cmc", NO_GROUP, {}},
+    {nullptr, GROUP_3, {ARG_EB}}, {nullptr, GROUP_3, {ARG_EV}},
+    {"clc", NO_GROUP, {}}, {"stc", NO_GROUP, {}},
+    {"cli", NO_GROUP, {}}, {"sti", NO_GROUP, {}},
+    {"cld", NO_GROUP, {}}, {"std", NO_GROUP, {}},
+    {nullptr, GROUP_4, {ARG_EB}}, {nullptr, GROUP_5, {ARG_EV}},
+};
+// clang-format on
+
+static const char *group_1[8] = {"add", "or",  "adc", "sbb",
+                                 "and", "sub", "xor", "cmp"};
+// /6 is an undocumented alias of shl.
+static const char *group_2[8] = {"rol", "ror", "rcl", "rcr",
+                                 "shl", "shr", "shl", "sar"};
+static const char *group_3[8] = {"test", "test", "not", "neg",
+                                 "mul",  "imul", "div", "idiv"};
+
+static const char *regs8[8] = {"al", "cl", "dl", "bl", "ah", "ch", "dh", "bh"};
+static const char *regs16[8] = {"ax", "cx", "dx", "bx",
+                                "sp", "bp", "si", "di"};
+static const char *sregs[4] = {"es", "cs", "ss", "ds"};
+
+static std::string hex(unsigned v)
+{
+    return (boost::format("0x%x") % v).str();
+}
+
+static std::string signed_hex(int v)
+{
+    return (v < 0 ? "-" : "+") + hex(v < 0 ? -v : v);
+}
+
+class InstructionDecoder
+{
+public:
+    InstructionDecoder(const uint8_t *bytes, size_t num_bytes, uint16_t ip)
+        : bytes(bytes),
+          num_bytes(num_bytes),
+          ip(ip),
+          length(0),
+          valid(true),
+          opcode(0),
+          have_modrm(false),
+          mod(0),
+          reg(0),
+          rm(0),
+          displacement(0),
+          segment(),
+          segment_used(false)
+    {
+    }
+    InstructionDecoder(const InstructionDecoder &) = delete;
+    InstructionDecoder &operator=(const InstructionDecoder &) = delete;
+
+    size_t decode(std::string *text);
+
+private:
+    static const size_t max_length = 15;
+
+    uint8_t fetch8();
+    uint16_t fetch16();
+    void decode_modrm();
+    std::string memory_operand();
+    std::string rm_operand(const char **regs, const char *size);
+    std::string format_arg(ArgKind kind);
+    const char *group_mnemonic(const OpcodeInfo &info, const ArgKind **args);
+
+    const uint8_t *bytes;
+    size_t num_bytes;
+    uint16_t ip;
+    size_t length;
+    bool valid;
+    uint8_t opcode;
+    bool have_modrm;
+    int mod;
+    int reg;
+    int rm;
+    uint16_t displacement;
+    std::string segment;
+    bool segment_used;
+};
+
+uint8_t InstructionDecoder::fetch8()
+{
+    if (length >= num_bytes || length >= max_length) {
+        valid = false;
+        return 0;
+    }
+
+    return bytes[length++];
+}
+
+uint16_t InstructionDecoder::fetch16()
+{
+    uint16_t lo = fetch8();
+
+    return lo | (static_cast<uint16_t>(fetch8()) << 8);
+}
+
+void InstructionDecoder::decode_modrm()
+{
+    if (have_modrm)
+        return;
+
+    auto modrm = fetch8();
+    mod = modrm >> 6;
+    reg = (modrm >> 3) & 0x7;
+    rm = modrm & 0x7;
+    have_modrm = true;
+
+    if (mod == 1)
+        displacement = static_cast<int8_t>(fetch8());
+    else if (mod == 2 || (mod == 0 && rm == 6))
+        displacement = fetch16();
+}
+
+std::string InstructionDecoder::memory_operand()
+{
+    static const char *bases[8] = {"bx+si", "bx+di", "bp+si", "bp+di",
+                                   "si",    "di",    "bp",    "bx"};
+    std::string address;
+
+    if (mod == 3) {
+        valid = false;
+        return "";
+    }
+
+    if (mod == 0 && rm == 6)
+        address = hex(displacement);
+    else if (mod == 0)
+        address = bases[rm];
+    else if (mod == 1)
+        address = bases[rm] + signed_hex(static_cast<int16_t>(displacement));
+    else
+        address = bases[rm] + std::string("+") + hex(displacement);
+
+    segment_used = true;
+
+    return "[" + (segment.empty() ? "" : segment + ":") + address + "]";
+}
+
+std::string InstructionDecoder::rm_operand(const char **regs, const char *size)
+{
+    decode_modrm();
+
+    if (mod == 3)
+        return regs[rm];
+
+    return std::string(size) + memory_operand();
+}
+
+std::string InstructionDecoder::format_arg(ArgKind kind)
+{
+    switch (kind) {
+    case ARG_NONE: return "";
+    case ARG_EB: return rm_operand(regs8, "byte ");
+    case ARG_EV: return rm_operand(regs16, "word ");
+    case ARG_GB: decode_modrm(); return regs8[reg];
+    case ARG_GV: decode_modrm(); return regs16[reg];
+    case ARG_SW: decode_modrm(); return sregs[reg & 0x3];
+    case ARG_M: decode_modrm(); return memory_operand();
+    case ARG_MP: decode_modrm(); return "far " + memory_operand();
+    case ARG_IB: return hex(fetch8());
+    case ARG_IBS: {
+        int v = static_cast<int8_t>(fetch8());
+        return v < 0 ? signed_hex(v) : hex(v);
+    }
+    case ARG_IV: return hex(fetch16());
+    case ARG_JB: {
+        int8_t rel = fetch8();
+        return hex(static_cast<uint16_t>(ip + length + rel));
+    }
+    case ARG_JV: {
+        uint16_t rel = fetch16();
+        return hex(static_cast<uint16_t>(ip + length + rel));
+    }
+    case ARG_AP: {
+        auto offset = fetch16();
+        auto seg = fetch16();
+        return hex(seg) + ":" + hex(offset);
+    }
+    case ARG_OB:
+    case ARG_OV: {
+        auto offset = fetch16();
+        segment_used = true;
+        return (kind == ARG_OB ? "byte [" : "word [") +
+               (segment.empty() ? "" : segment + ":") + hex(offset) + "]";
+    }
+    case ARG_AL: return "al";
+    case ARG_AX: return "ax";
+    case ARG_CL: return "cl";
+    case ARG_DX: return "dx";
+    case ARG_ONE: return "1";
+    case ARG_ZB: return regs8[opcode & 0x7];
+    case ARG_ZV: return regs16[opcode & 0x7];
+    case ARG_ES: return "es";
+    case ARG_CS: return "cs";
+    case ARG_SS: return "ss";
+    case ARG_DS: return "ds";
+    }
+
+    return "";
+}
+
+// The reg field selects the operation, and for some groups the operands.
+const char *InstructionDecoder::group_mnemonic(const OpcodeInfo &info,
+                                               const ArgKind **args)
+{
+    static const ArgKind ev[3] = {ARG_EV};
+    static const ArgKind mp[3] = {ARG_MP};
+    static const ArgKind eb_ib[3] = {ARG_EB, ARG_IB};
+    static const ArgKind ev_iv[3] = {ARG_EV, ARG_IV};
+
+    decode_modrm();
+
+    switch (info.group) {
+    case GROUP_1: return group_1[reg];
+    case GROUP_2: return group_2[reg];
+    case GROUP_3:
+        if (reg < 2)
+            *args = info.args[0] == ARG_EB ? eb_ib : ev_iv;
+        return group_3[reg];
+    case GROUP_4:
+        return reg == 0 ? "inc" : reg == 1 ? "dec" : nullptr;
+    case GROUP_5:
+        if (reg == 3 || reg == 5)
+            *args = mp;
+        else
+            *args = ev;
+        switch (reg) {
+        case 0: return "inc";
+        case 1: return "dec";
+        case 2: // fallthrough
+        case 3: return "call";
+        case 4: // fallthrough
+        case 5: return "jmp";
+        case 6: return "push";
+        default: return nullptr;
+        }
+    case GROUP_POP: return reg == 0 ? "pop" : nullptr;
+    case GROUP_MOV: return reg == 0 ? "mov" : nullptr;
+    default: return nullptr;
+    }
+}
+
+size_t InstructionDecoder::decode(std::string *text)
+{
+    std::string prefixes;
+    const OpcodeInfo *info;
+
+    for (;;) {
+        opcode = fetch8();
+        info = &opcodes[opcode];
+        if (!valid || info->group != PREFIX)
+            break;
+
+        if (opcode == 0x26 || opcode == 0x2e || opcode == 0x36 ||
+            opcode == 0x3e)
+            segment = info->mnemonic;
+        else
+            prefixes += std::string(info->mnemonic) + " ";
+    }
+
+    const ArgKind *args = info->args;
+    const char *mnemonic = info->mnemonic;
+    std::string operands;
+
+    if (info->group == GROUP_ESC) {
+        decode_modrm();
+        mnemonic = "esc";
+        operands = hex(((opcode & 0x7) << 3) | reg) + ", " +
+                   rm_operand(regs16, "word ");
+    } else if (info->group != NO_GROUP) {
+        mnemonic = group_mnemonic(*info, &args);
+    }
+
+    if (valid && mnemonic && info->group != GROUP_ESC) {
+        for (int m = 0; m < 3 && args[m] != ARG_NONE; ++m)
+            operands += (m ? ", " : "") + format_arg(args[m]);
+    }
+
+    if (!valid || !mnemonic) {
+        *text = "db " + hex(bytes[0]);
+        return 1;
+    }
+
+    // An override with no memory operand to apply to, such as on a string
+    // instruction.
+    if (!segment.empty() && !segment_used)
+        prefixes = segment + " " + prefixes;
+
+    *text = prefixes + mnemonic + (operands.empty() ? "" : " " + operands);
+
+    return length;
+}
+
+size_t disassemble(const uint8_t *bytes,
+                   size_t num_bytes,
+                   uint16_t ip,
+                   std::string *text)
+{
+    if (num_bytes == 0) {
+        *text = "";
+        return 0;
+    }
+
+    InstructionDecoder decoder(bytes, num_bytes, ip);
+
+    return decoder.decode(text);
+}
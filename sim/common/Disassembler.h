@@ -0,0 +1,32 @@
+// Copyright Jamie Iles, 2017
+//
+// This file is part of s80x86.
+//
+// s80x86 is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// s80x86 is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with s80x86.  If not, see <http://www.gnu.org/licenses/>.
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string>
+
+// Disassemble the 80186 instruction at the start of bytes, fetched from ip,
+// into lower case Intel syntax.  Branch targets are resolved to offsets in
+// the same segment.  Returns the instruction length including prefixes.
+// Undefined opcodes and instructions running past num_bytes are written as
+// a single "db" byte.
+size_t disassemble(const uint8_t *bytes,
+                   size_t num_bytes,
+                   uint16_t ip,
+                   std::string *text);
@@ -21,6 +21,7 @@
 #include <cstring>
 
 Memory::Memory()
+    : written(false), num_writes(0), observer(nullptr)
 {
     memset(mem, mem_init_8, sizeof(mem));
     memset(mem + 0x1000, 0, 128);
@@ -34,6 +35,9 @@ void Memory::write(phys_addr addr, T val)
     memcpy(mem + addr, &val, sizeof(val));
 
     written = true;
+    ++num_writes;
+    if (observer)
+        observer->access(addr, sizeof(T), true, val);
 }
 template void Memory::write<uint8_t>(phys_addr addr, uint8_t val);
 template void Memory::write<uint16_t>(phys_addr addr, uint16_t val);
@@ -47,6 +51,9 @@ T Memory::read(phys_addr addr) const
     T val;
     memcpy(&val, mem + addr, sizeof(val));
 
+    if (observer)
+        observer->access(addr, sizeof(T), false, val);
+
     return val;
 }
 template uint8_t Memory::read<uint8_t>(phys_addr addr) const;
@@ -62,3 +69,13 @@ void Memory::clear_has_written()
 {
     written = false;
 }
+
+unsigned long Memory::write_count() const
+{
+    return num_writes;
+}
+
+void Memory::set_observer(MemoryObserver *observer)
+{
+    this->observer = observer;
+}
@@ -29,6 +29,21 @@
 const size_t MEMORY_SIZE = 1 * 1024 * 1024;
 typedef uint32_t phys_addr;
 
+// Notified of every access, for capturing memory reference streams and
+// instruction side effects.  value is the data read or written.
+class MemoryObserver
+{
+public:
+    virtual ~MemoryObserver()
+    {
+    }
+
+    virtual void access(phys_addr addr,
+                        unsigned width,
+                        bool write,
+                        uint32_t value) = 0;
+};
+
 class Memory
 {
 public:
@@ -39,10 +54,17 @@ public:
     T read(phys_addr addr) const;
     bool has_written() const;
     void clear_has_written();
+    // A running count of writes, unlike the written flag it is never cleared
+    // so any number of observers can compare it with an earlier value.
+    unsigned long write_count() const;
+    // Reads and writes are passed to observer until it is reset to nullptr.
+    void set_observer(MemoryObserver *observer);
 
 private:
     uint8_t mem[MEMORY_SIZE];
     bool written;
+    unsigned long num_writes;
+    MemoryObserver *observer;
 
 private:
     friend class boost::serialization::access;
@@ -18,15 +18,23 @@
 #include "Emulate.h"
 
 #include <cassert>
+#include <climits>
 #include <cstdlib>
 #include <iostream>
 #include <functional>
 #include <stdint.h>
+#include "InstructionStats.h"
 #include "Memory.h"
 #include "SoftwareCPU.h"
 
 #include <config.h>
 
+#if S80X86_INSN_STATS
+typedef InstructionStats EmulatorStats;
+#else
+typedef NullInstructionStats EmulatorStats;
+#endif
+
 template <typename Out, typename In>
 static inline Out sign_extend(In v)
 {
@@ -77,8 +85,48 @@ public:
     void reset();
     void raise_nmi();
     void raise_irq(int irq_num);
+    int take_pending_irq();
+
+    void set_fast_forward(std::function<unsigned long()> next_event)
+    {
+        this->next_event = next_event;
+        idle_loop.valid = false;
+    }
+
+    unsigned long take_skipped_cycles()
+    {
+        auto skipped = skipped_cycles;
+        skipped_cycles = 0;
+
+        return skipped;
+    }
+
+    void write_instruction_stats(std::ostream &out) const
+    {
+        stats.write_json(out);
+    }
+
+    void set_invalid_opcode_handler(std::function<void()> handler)
+    {
+        invalid_opcode_handler = handler;
+    }
 
 private:
+    // The head of a candidate idle loop: the state on arriving at the target
+    // of the last short backward branch.
+    struct IdleLoop {
+        bool valid;
+        // Set by anything in the loop body other than a register write or
+        // a memory write that could change what the next iteration does.
+        bool dirty;
+        uint16_t registers[NUM_16BIT_REGS];
+        uint16_t flags;
+        unsigned long mem_writes;
+        unsigned long deadline;
+    };
+
+    static const uint16_t max_idle_loop_bytes = 128;
+
     size_t emulate_insn();
     void mov88();
     void mov89();
@@ -361,6 +409,7 @@ private:
 
     void write_io8(uint32_t addr, uint8_t val)
     {
+        idle_loop.dirty = true;
         if (!io->count(addr & ~1))
             return;
 
@@ -369,6 +418,7 @@ private:
     }
     void write_io16(uint32_t addr, uint16_t val)
     {
+        idle_loop.dirty = true;
         if (!io->count(addr & ~1))
             return;
 
@@ -382,7 +432,10 @@ private:
             return 0;
 
         auto p = (*io)[addr & ~1];
-        return p->read8((addr & ~1) - p->get_base(), addr & 1);
+        auto port_num = (addr & ~1) - p->get_base();
+        if (p->read_is_volatile(port_num, addr & 1))
+            idle_loop.dirty = true;
+        return p->read8(port_num, addr & 1);
     }
     uint16_t read_io16(uint32_t addr)
     {
@@ -390,9 +443,18 @@ private:
             return 0;
 
         auto p = (*io)[addr & ~1];
-        return p->read16((addr & ~1) - p->get_base());
+        auto port_num = (addr & ~1) - p->get_base();
+        if (p->read_is_volatile(port_num, 0) ||
+            p->read_is_volatile(port_num, 1))
+            idle_loop.dirty = true;
+        return p->read16(port_num);
     }
 
+    void check_idle_loop(uint16_t prev_cs,
+                         uint16_t prev_ip,
+                         unsigned long cur_cycle_count);
+    void record_stats();
+
     void do_rep(std::function<void()> primitive,
                 std::function<bool()> should_terminate);
     bool string_rep_complete();
@@ -419,6 +481,11 @@ private:
     uint8_t pending_irq;
     bool tf_was_set;
     SimCPU *sim_cpu;
+    std::function<unsigned long()> next_event;
+    IdleLoop idle_loop;
+    unsigned long skipped_cycles;
+    EmulatorStats stats;
+    std::function<void()> invalid_opcode_handler;
 };
 
 void EmulatorPimpl::do_rep(std::function<void()> primitive,
@@ -429,12 +496,16 @@ void EmulatorPimpl::do_rep(std::function<void()> primitive,
         return;
     }
 
+    unsigned long iterations = 0;
     while (registers->get(CX) != 0) {
         primitive();
         registers->set(CX, registers->get(CX) - 1);
+        ++iterations;
         if (should_terminate())
             break;
     }
+
+    stats.rep(opcode, iterations);
 }
 
 bool EmulatorPimpl::string_rep_complete()
@@ -455,7 +526,12 @@ EmulatorPimpl::EmulatorPimpl(RegisterFile *registers, SimCPU *sim_cpu)
       rep_mode(REPE),
       has_rep_prefix(false),
       tf_was_set(false),
-      sim_cpu(sim_cpu)
+      sim_cpu(sim_cpu),
+      next_event(),
+      idle_loop(),
+      skipped_cycles(0),
+      stats(),
+      invalid_opcode_handler()
 {
     modrm_decoder = std::make_unique<ModRMDecoder>(
         [&] { return this->fetch_byte(); }, this->registers);
@@ -471,6 +547,7 @@ void EmulatorPimpl::reset()
     nmi_pending = false;
     ext_int_inhibit = false;
     pending_irq = 0;
+    idle_loop.valid = false;
 }
 
 void EmulatorPimpl::raise_nmi()
@@ -483,6 +560,14 @@ void EmulatorPimpl::raise_irq(int irq_num)
     pending_irq = irq_num;
 }
 
+int EmulatorPimpl::take_pending_irq()
+{
+    auto irq_num = pending_irq;
+    pending_irq = 0;
+
+    return irq_num;
+}
+
 void EmulatorPimpl::handle_nmi()
 {
     nmi_pending = false;
@@ -586,7 +671,68 @@ size_t EmulatorPimpl::step_with_io(
 {
     io_callback(cur_cycle_count);
 
-    return this->step();
+    if (!next_event)
+        return this->step();
+
+    auto cs = registers->get(CS);
+    auto ip = registers->get(IP);
+    auto len = this->step();
+    check_idle_loop(cs, ip, cur_cycle_count);
+
+    return len;
+}
+
+// A loop is idle if arriving back at its head finds exactly the state that
+// the previous arrival did, with no memory or I/O writes, no volatile I/O
+// reads and no device events in between.  Every iteration from then on would
+// be identical until a device event changes something, so the cycles up to
+// the next event can be skipped.  Interrupt entry pushes to the stack so it
+// is caught as a memory write.  Loops that count a register down are not
+// idle, they finish by themselves.
+void EmulatorPimpl::check_idle_loop(uint16_t prev_cs,
+                                    uint16_t prev_ip,
+                                    unsigned long cur_cycle_count)
+{
+    auto cs = registers->get(CS);
+    auto ip = registers->get(IP);
+
+    if (!jump_taken || cs != prev_cs || ip > prev_ip ||
+        prev_ip - ip > max_idle_loop_bytes)
+        return;
+
+    bool same_state = idle_loop.valid && !idle_loop.dirty &&
+                      idle_loop.mem_writes == mem->write_count() &&
+                      cur_cycle_count < idle_loop.deadline &&
+                      idle_loop.flags == registers->get_flags();
+    for (int r = 0; same_state && r < NUM_16BIT_REGS; ++r)
+        same_state =
+            idle_loop.registers[r] == registers->get(static_cast<GPR>(r));
+
+    if (same_state) {
+        auto deadline = next_event();
+        // Nothing is ever going to break the loop.
+        if (deadline == ULONG_MAX)
+            return;
+        if (deadline > cur_cycle_count + 1)
+            skipped_cycles = deadline - 1 - cur_cycle_count;
+        return;
+    }
+
+    idle_loop.valid = true;
+    idle_loop.dirty = false;
+    for (int r = 0; r < NUM_16BIT_REGS; ++r)
+        idle_loop.registers[r] = registers->get(static_cast<GPR>(r));
+    idle_loop.flags = registers->get_flags();
+    idle_loop.mem_writes = mem->write_count();
+    idle_loop.deadline = next_event();
+}
+
+void EmulatorPimpl::record_stats()
+{
+    stats.instruction(opcode, jump_taken);
+    if (modrm_decoder->decoded())
+        stats.modrm(opcode, modrm_decoder->raw_mod(),
+                    modrm_decoder->raw_reg(), modrm_decoder->raw_rm());
 }
 
 size_t EmulatorPimpl::emulate_insn()
@@ -833,6 +979,8 @@ size_t EmulatorPimpl::emulate_insn()
                 ":" << (unsigned)registers->get(IP) << std::endl;
         }
         // clang-format on
+        if (processing_prefixes)
+            stats.prefix(opcode);
     } while (processing_prefixes);
 
     if (instr_length >= 16) {
@@ -840,6 +988,9 @@ size_t EmulatorPimpl::emulate_insn()
         invalid_opcode();
     }
 
+    if (EmulatorStats::enabled)
+        record_stats();
+
     if (!jump_taken)
         registers->set(IP, registers->get(IP) + instr_length);
 
@@ -1307,6 +1458,9 @@ void EmulatorPimpl::invalid_opcode()
     registers->set(CS, new_cs);
     registers->set(IP, new_ip);
     jump_taken = true;
+
+    if (invalid_opcode_handler)
+        invalid_opcode_handler();
 }
 
 #include "instructions/mov.cpp"
@@ -1446,7 +1600,9 @@ void EmulatorPimpl::set_override_segment(GPR segment)
 }
 
 Emulator::Emulator(RegisterFile *registers, SoftwareCPU *cpu)
-    : pimpl(std::make_unique<EmulatorPimpl>(registers, cpu))
+    : pimpl(std::make_unique<EmulatorPimpl>(registers, cpu)),
+      num_cycles(0),
+      num_skipped_cycles(0)
 {
 }
 
@@ -1465,7 +1621,12 @@ size_t Emulator::step_with_io(std::function<void(unsigned long)> io_callback)
 {
     ++num_cycles;
 
-    return pimpl->step_with_io(io_callback, num_cycles);
+    auto len = pimpl->step_with_io(io_callback, num_cycles);
+    auto skipped = pimpl->take_skipped_cycles();
+    num_cycles += skipped;
+    num_skipped_cycles += skipped;
+
+    return len;
 }
 
 void Emulator::set_memory(Memory *mem)
@@ -1498,7 +1659,32 @@ void Emulator::raise_irq(int irq_num)
     pimpl->raise_irq(irq_num);
 }
 
+int Emulator::take_pending_irq()
+{
+    return pimpl->take_pending_irq();
+}
+
 unsigned long Emulator::cycle_count() const
 {
     return num_cycles;
 }
+
+void Emulator::set_fast_forward(std::function<unsigned long()> next_event)
+{
+    pimpl->set_fast_forward(next_event);
+}
+
+unsigned long Emulator::fast_forwarded_cycles() const
+{
+    return num_skipped_cycles;
+}
+
+void Emulator::write_instruction_stats(std::ostream &out) const
+{
+    pimpl->write_instruction_stats(out);
+}
+
+void Emulator::set_invalid_opcode_handler(std::function<void()> handler)
+{
+    pimpl->set_invalid_opcode_handler(handler);
+}
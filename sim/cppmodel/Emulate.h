@@ -22,6 +22,7 @@
 #include <functional>
 #include <memory>
 #include <map>
+#include <ostream>
 
 #include "CPU.h"
 #include "Memory.h"
@@ -45,9 +46,15 @@ public:
     void reset();
     void raise_nmi();
     void raise_irq(int irq_num);
+    int take_pending_irq();
     unsigned long cycle_count() const;
+    void set_fast_forward(std::function<unsigned long()> next_event);
+    unsigned long fast_forwarded_cycles() const;
+    void write_instruction_stats(std::ostream &out) const;
+    void set_invalid_opcode_handler(std::function<void()> handler);
 
 private:
     std::unique_ptr<EmulatorPimpl> pimpl;
     unsigned long num_cycles;
+    unsigned long num_skipped_cycles;
 };
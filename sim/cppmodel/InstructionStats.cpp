@@ -0,0 +1,216 @@
+// Copyright Jamie Iles, 2017
+//
+// This file is part of s80x86.
+//
+// s80x86 is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// s80x86 is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with s80x86.  If not, see <http://www.gnu.org/licenses/>.
+
+#include "InstructionStats.h"
+
+#include <boost/format.hpp>
+#include <cstring>
+#include <string>
+
+// Opcodes where the reg field of the ModRM byte selects the operation.
+static bool is_group_opcode(uint8_t opcode)
+{
+    switch (opcode) {
+    case 0x80 ... 0x83:
+    case 0x8f:
+    case 0xc0 ... 0xc1:
+    case 0xc6 ... 0xc7:
+    case 0xd0 ... 0xd3:
+    case 0xf6 ... 0xf7:
+    case 0xfe ... 0xff: return true;
+    default: return false;
+    }
+}
+
+// Jcc, LOOPNZ, LOOPZ, LOOP and JCXZ.
+static bool is_conditional_branch(uint8_t opcode)
+{
+    return (opcode >= 0x70 && opcode <= 0x7f) ||
+           (opcode >= 0xe0 && opcode <= 0xe3);
+}
+
+static std::string opcode_key(unsigned opcode)
+{
+    return (boost::format("\"0x%02x\"") % opcode).str();
+}
+
+InstructionStats::InstructionStats() : pending_prefixes(0), num_instructions(0)
+{
+    memset(opcodes, 0, sizeof(opcodes));
+    memset(groups, 0, sizeof(groups));
+    memset(modes, 0, sizeof(modes));
+    memset(addressing, 0, sizeof(addressing));
+    memset(prefix_combinations, 0, sizeof(prefix_combinations));
+    memset(rep_iterations, 0, sizeof(rep_iterations));
+    memset(rep_buckets, 0, sizeof(rep_buckets));
+    memset(branches_taken, 0, sizeof(branches_taken));
+    memset(branches_not_taken, 0, sizeof(branches_not_taken));
+}
+
+void InstructionStats::prefix(uint8_t prefix)
+{
+    switch (prefix) {
+    case 0xf0: pending_prefixes |= PREFIX_LOCK; break;
+    case 0x26: pending_prefixes |= PREFIX_ES; break;
+    case 0x2e: pending_prefixes |= PREFIX_CS; break;
+    case 0x36: pending_prefixes |= PREFIX_SS; break;
+    case 0x3e: pending_prefixes |= PREFIX_DS; break;
+    case 0xf2: pending_prefixes |= PREFIX_REPNE; break;
+    case 0xf3: pending_prefixes |= PREFIX_REP; break;
+    }
+}
+
+void InstructionStats::instruction(uint8_t opcode, bool jump_taken)
+{
+    ++num_instructions;
+    ++opcodes[opcode];
+    ++prefix_combinations[pending_prefixes];
+    pending_prefixes = 0;
+
+    if (is_conditional_branch(opcode))
+        ++(jump_taken ? branches_taken : branches_not_taken)[opcode];
+}
+
+void InstructionStats::modrm(uint8_t opcode, int mod, int reg, int rm)
+{
+    ++modes[opcode][mod];
+    ++addressing[mod][rm];
+    if (is_group_opcode(opcode))
+        ++groups[opcode][reg];
+}
+
+void InstructionStats::rep(uint8_t opcode, unsigned long iterations)
+{
+    int bucket = 0;
+    for (auto v = iterations; v != 0 && bucket < num_rep_buckets - 1; v >>= 1)
+        ++bucket;
+
+    rep_iterations[opcode] += iterations;
+    ++rep_buckets[opcode][bucket];
+}
+
+template <typename T, size_t N>
+static void write_array(std::ostream &out, const T (&values)[N])
+{
+    out << "[";
+    for (size_t m = 0; m < N; ++m)
+        out << (m ? ", " : "") << values[m];
+    out << "]";
+}
+
+void InstructionStats::write_prefixes(std::ostream &out) const
+{
+    static const char *names[] = {"lock", "es",    "cs", "ss",
+                                  "ds",   "repne", "rep"};
+    const char *sep = "";
+
+    out << "{";
+    for (int mask = 0; mask < NUM_PREFIX_COMBINATIONS; ++mask) {
+        if (!prefix_combinations[mask])
+            continue;
+
+        std::string key;
+        for (int bit = 0; bit < 7; ++bit)
+            if (mask & (1 << bit))
+                key += std::string(key.empty() ? "" : "+") + names[bit];
+
+        out << sep << "\n    \"" << (key.empty() ? "none" : key)
+            << "\": " << prefix_combinations[mask];
+        sep = ",";
+    }
+    out << "\n  }";
+}
+
+// Opcodes that were never executed are left out of the per opcode tables.
+void InstructionStats::write_json(std::ostream &out) const
+{
+    const char *sep;
+
+    out << "{\n  \"instructions\": " << num_instructions << ",\n";
+
+    out << "  \"opcodes\": {";
+    sep = "";
+    for (unsigned op = 0; op < 256; ++op) {
+        if (!opcodes[op])
+            continue;
+        out << sep << "\n    " << opcode_key(op) << ": " << opcodes[op];
+        sep = ",";
+    }
+    out << "\n  },\n";
+
+    out << "  \"groups\": {";
+    sep = "";
+    for (unsigned op = 0; op < 256; ++op) {
+        if (!is_group_opcode(op) || !opcodes[op])
+            continue;
+        out << sep << "\n    " << opcode_key(op) << ": ";
+        write_array(out, groups[op]);
+        sep = ",";
+    }
+    out << "\n  },\n";
+
+    out << "  \"modrm_modes\": {";
+    sep = "";
+    for (unsigned op = 0; op < 256; ++op) {
+        if (!modes[op][0] && !modes[op][1] && !modes[op][2] && !modes[op][3])
+            continue;
+        out << sep << "\n    " << opcode_key(op) << ": ";
+        write_array(out, modes[op]);
+        sep = ",";
+    }
+    out << "\n  },\n";
+
+    out << "  \"addressing\": [";
+    for (int mod = 0; mod < 4; ++mod) {
+        out << (mod ? "," : "") << "\n    ";
+        write_array(out, addressing[mod]);
+    }
+    out << "\n  ],\n";
+
+    out << "  \"prefixes\": ";
+    write_prefixes(out);
+    out << ",\n";
+
+    out << "  \"rep\": {";
+    sep = "";
+    for (unsigned op = 0; op < 256; ++op) {
+        uint64_t count = 0;
+        for (auto v : rep_buckets[op])
+            count += v;
+        if (!count)
+            continue;
+        out << sep << "\n    " << opcode_key(op) << ": {\"instructions\": "
+            << count << ", \"iterations\": " << rep_iterations[op]
+            << ", \"log2_histogram\": ";
+        write_array(out, rep_buckets[op]);
+        out << "}";
+        sep = ",";
+    }
+    out << "\n  },\n";
+
+    out << "  \"branches\": {";
+    sep = "";
+    for (unsigned op = 0; op < 256; ++op) {
+        if (!is_conditional_branch(op) || !opcodes[op])
+            continue;
+        out << sep << "\n    " << opcode_key(op)
+            << ": {\"taken\": " << branches_taken[op]
+            << ", \"not_taken\": " << branches_not_taken[op] << "}";
+        sep = ",";
+    }
+    out << "\n  }\n}\n";
+}
@@ -0,0 +1,95 @@
+// Copyright Jamie Iles, 2017
+//
+// This file is part of s80x86.
+//
+// s80x86 is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// s80x86 is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with s80x86.  If not, see <http://www.gnu.org/licenses/>.
+
+#pragma once
+
+#include <ostream>
+#include <stdint.h>
+
+// Execution statistics for the SoftwareCPU, selected at compile time with
+// S80X86_INSN_STATS.  The emulator only calls into the policy when enabled
+// is true so NullInstructionStats compiles away entirely.
+class NullInstructionStats
+{
+public:
+    static const bool enabled = false;
+
+    void prefix(uint8_t /* prefix */)
+    {
+    }
+    void instruction(uint8_t /* opcode */, bool /* jump_taken */)
+    {
+    }
+    void modrm(uint8_t /* opcode */,
+               int /* mod */,
+               int /* reg */,
+               int /* rm */)
+    {
+    }
+    void rep(uint8_t /* opcode */, unsigned long /* iterations */)
+    {
+    }
+    void write_json(std::ostream & /* out */) const
+    {
+    }
+};
+
+// Counts by opcode, group sub-opcode, ModRM mode, prefix combination, REP
+// iteration count and conditional branch outcome.  Prefixes are collected
+// until the instruction that they apply to completes.
+class InstructionStats
+{
+public:
+    static const bool enabled = true;
+
+    InstructionStats();
+
+    void prefix(uint8_t prefix);
+    void instruction(uint8_t opcode, bool jump_taken);
+    void modrm(uint8_t opcode, int mod, int reg, int rm);
+    void rep(uint8_t opcode, unsigned long iterations);
+    void write_json(std::ostream &out) const;
+
+private:
+    enum PrefixBit {
+        PREFIX_LOCK = (1 << 0),
+        PREFIX_ES = (1 << 1),
+        PREFIX_CS = (1 << 2),
+        PREFIX_SS = (1 << 3),
+        PREFIX_DS = (1 << 4),
+        PREFIX_REPNE = (1 << 5),
+        PREFIX_REP = (1 << 6),
+        NUM_PREFIX_COMBINATIONS = (1 << 7)
+    };
+
+    // Bucket 0 is no iterations, bucket n is 2^(n-1) to 2^n - 1.
+    static const int num_rep_buckets = 18;
+
+    void write_prefixes(std::ostream &out) const;
+
+    uint8_t pending_prefixes;
+    uint64_t num_instructions;
+    uint64_t opcodes[256];
+    uint64_t groups[256][8];
+    uint64_t modes[256][4];
+    uint64_t addressing[4][8];
+    uint64_t prefix_combinations[NUM_PREFIX_COMBINATIONS];
+    uint64_t rep_iterations[256];
+    uint64_t rep_buckets[256][num_rep_buckets];
+    uint64_t branches_taken[256];
+    uint64_t branches_not_taken[256];
+};
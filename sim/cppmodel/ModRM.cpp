@@ -69,6 +69,23 @@ int ModRMDecoder::raw_reg() const
     return (modrm >> 3) & 0x7;
 }
 
+int ModRMDecoder::raw_mod() const
+{
+    assert(is_decoded);
+    return (modrm >> 6) & 0x3;
+}
+
+int ModRMDecoder::raw_rm() const
+{
+    assert(is_decoded);
+    return modrm & 0x7;
+}
+
+bool ModRMDecoder::decoded() const
+{
+    return is_decoded;
+}
+
 GPR ModRMDecoder::rm_reg() const
 {
     assert(is_decoded);
@@ -40,6 +40,9 @@ public:
     void decode();
     GPR reg() const;
     int raw_reg() const;
+    int raw_mod() const;
+    int raw_rm() const;
+    bool decoded() const;
     GPR rm_reg() const;
     uint16_t effective_address();
     OperandType rm_type() const;
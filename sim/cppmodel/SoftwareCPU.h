@@ -30,8 +30,8 @@ public:
     SoftwareCPU() : SoftwareCPU("default")
     {
     }
-    SoftwareCPU(const std::string &name)
-        : SimCPU(name), emulator(&registers, this)
+    SoftwareCPU(const std::string &name, Memory *shared_mem = nullptr)
+        : SimCPU(name, shared_mem), emulator(&registers, this)
     {
         (void)name;
 
@@ -171,11 +171,36 @@ public:
         emulator.raise_irq(irq_num);
     }
 
+    virtual int take_pending_irq()
+    {
+        return emulator.take_pending_irq();
+    }
+
     unsigned long cycle_count() const
     {
         return emulator.cycle_count();
     }
 
+    void set_fast_forward(std::function<unsigned long()> next_event)
+    {
+        emulator.set_fast_forward(next_event);
+    }
+
+    unsigned long fast_forwarded_cycles() const
+    {
+        return emulator.fast_forwarded_cycles();
+    }
+
+    void write_instruction_stats(std::ostream &out) const
+    {
+        emulator.write_instruction_stats(out);
+    }
+
+    void set_invalid_opcode_handler(std::function<void()> handler)
+    {
+        emulator.set_invalid_opcode_handler(handler);
+    }
+
 private:
     RegisterFile registers;
     Emulator emulator;
@@ -98,10 +98,11 @@ void EmulatorPimpl::rcld2()
     auto v = read_data<uint8_t>();
     uint16_t flags;
 
-    if (!registers->get(CL))
+    auto count = registers->get(CL) & 0x1f;
+    if (!count)
         return;
 
-    std::tie(flags, v) = do_rcl(v, registers->get(CL), registers->get_flag(CF));
+    std::tie(flags, v) = do_rcl(v, count, registers->get_flag(CF));
 
     write_data<uint8_t>(v);
     registers->set_flags(flags, CF);
@@ -113,10 +114,11 @@ void EmulatorPimpl::rcld3()
     auto v = read_data<uint16_t>();
     uint16_t flags;
 
-    if (!registers->get(CL))
+    auto count = registers->get(CL) & 0x1f;
+    if (!count)
         return;
 
-    std::tie(flags, v) = do_rcl(v, registers->get(CL), registers->get_flag(CF));
+    std::tie(flags, v) = do_rcl(v, count, registers->get_flag(CF));
 
     write_data<uint16_t>(v);
     registers->set_flags(flags, CF);
@@ -101,10 +101,11 @@ void EmulatorPimpl::rcrd2()
     auto v = read_data<uint8_t>();
     uint16_t flags;
 
-    if (!registers->get(CL))
+    auto count = registers->get(CL) & 0x1f;
+    if (!count)
         return;
 
-    std::tie(flags, v) = do_rcr(v, registers->get(CL), registers->get_flag(CF));
+    std::tie(flags, v) = do_rcr(v, count, registers->get_flag(CF));
 
     write_data<uint8_t>(v);
     registers->set_flags(flags, CF);
@@ -116,10 +117,11 @@ void EmulatorPimpl::rcrd3()
     auto v = read_data<uint16_t>();
     uint16_t flags;
 
-    if (!registers->get(CL))
+    auto count = registers->get(CL) & 0x1f;
+    if (!count)
         return;
 
-    std::tie(flags, v) = do_rcr(v, registers->get(CL), registers->get_flag(CF));
+    std::tie(flags, v) = do_rcr(v, count, registers->get_flag(CF));
 
     write_data<uint16_t>(v);
     registers->set_flags(flags, CF);
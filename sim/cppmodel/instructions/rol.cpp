@@ -98,10 +98,11 @@ void EmulatorPimpl::rold2()
     auto v = read_data<uint8_t>();
     uint16_t flags;
 
-    if (!registers->get(CL))
+    auto count = registers->get(CL) & 0x1f;
+    if (!count)
         return;
 
-    std::tie(flags, v) = do_rol(v, registers->get(CL));
+    std::tie(flags, v) = do_rol(v, count);
 
     write_data<uint8_t>(v);
     registers->set_flags(flags, CF);
@@ -113,10 +114,11 @@ void EmulatorPimpl::rold3()
     auto v = read_data<uint16_t>();
     uint16_t flags;
 
-    if (!registers->get(CL))
+    auto count = registers->get(CL) & 0x1f;
+    if (!count)
         return;
 
-    std::tie(flags, v) = do_rol(v, registers->get(CL));
+    std::tie(flags, v) = do_rol(v, count);
 
     write_data<uint16_t>(v);
     registers->set_flags(flags, CF);
@@ -99,10 +99,11 @@ void EmulatorPimpl::rord2()
     auto v = read_data<uint8_t>();
     uint16_t flags;
 
-    if (!registers->get(CL))
+    auto count = registers->get(CL) & 0x1f;
+    if (!count)
         return;
 
-    std::tie(flags, v) = do_ror(v, registers->get(CL));
+    std::tie(flags, v) = do_ror(v, count);
 
     write_data<uint8_t>(v);
     registers->set_flags(flags, CF);
@@ -114,10 +115,11 @@ void EmulatorPimpl::rord3()
     auto v = read_data<uint16_t>();
     uint16_t flags;
 
-    if (!registers->get(CL))
+    auto count = registers->get(CL) & 0x1f;
+    if (!count)
         return;
 
-    std::tie(flags, v) = do_ror(v, registers->get(CL));
+    std::tie(flags, v) = do_ror(v, count);
 
     write_data<uint16_t>(v);
     registers->set_flags(flags, CF);
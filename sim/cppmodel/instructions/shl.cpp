@@ -104,10 +104,11 @@ void EmulatorPimpl::shld2()
     auto v = read_data<uint8_t>();
     uint16_t flags;
 
-    if (!registers->get(CL))
+    auto count = registers->get(CL) & 0x1f;
+    if (!count)
         return;
 
-    std::tie(flags, v) = do_shl(v, registers->get(CL));
+    std::tie(flags, v) = do_shl(v, count);
 
     write_data<uint8_t>(v);
     registers->set_flags(flags, CF | ZF | PF | SF);
@@ -119,11 +120,12 @@ void EmulatorPimpl::shld3()
     auto v = read_data<uint16_t>();
     uint16_t flags;
 
-    if (!registers->get(CL))
+    auto count = registers->get(CL) & 0x1f;
+    if (!count)
         return;
 
     uint16_t result;
-    std::tie(flags, result) = do_shl(v, registers->get(CL));
+    std::tie(flags, result) = do_shl(v, count);
 
     write_data<uint16_t>(result);
     registers->set_flags(flags, CF | ZF | PF | SF);
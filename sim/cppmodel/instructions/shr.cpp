@@ -100,10 +100,11 @@ void EmulatorPimpl::shrd2()
     auto v = read_data<uint8_t>();
     uint16_t flags;
 
-    if (!registers->get(CL))
+    auto count = registers->get(CL) & 0x1f;
+    if (!count)
         return;
 
-    std::tie(flags, v) = do_shr(v, registers->get(CL));
+    std::tie(flags, v) = do_shr(v, count);
 
     write_data<uint8_t>(v);
     registers->set_flags(flags, CF | ZF | PF | SF);
@@ -115,10 +116,11 @@ void EmulatorPimpl::shrd3()
     auto v = read_data<uint16_t>();
     uint16_t flags;
 
-    if (!registers->get(CL))
+    auto count = registers->get(CL) & 0x1f;
+    if (!count)
         return;
 
-    std::tie(flags, v) = do_shr(v, registers->get(CL));
+    std::tie(flags, v) = do_shr(v, count);
 
     write_data<uint16_t>(v);
     registers->set_flags(flags, CF | ZF | PF | SF);
@@ -30,7 +30,12 @@
 #include "Window.h"
 
 Display::Display(unsigned num_rows, unsigned num_cols)
-    : num_rows(num_rows), num_cols(num_cols), row(0), col(0), is_graphics(false)
+    : num_rows(num_rows),
+      num_cols(num_cols),
+      row(0),
+      col(0),
+      is_graphics(false),
+      framebuffer(8 * num_cols * 8 * num_rows * 3)
 {
     if (SDL_Init(SDL_INIT_VIDEO) != 0)
         throw std::runtime_error("Failed to initialize SDL " +
@@ -55,6 +60,11 @@ void Display::load_font()
     font_file.close();
 }
 
+void Display::set_status(const std::string &status)
+{
+    window->set_title("8086sim - " + status);
+}
+
 void Display::set_cursor(unsigned row, unsigned col)
 {
     this->row = row;
@@ -109,29 +119,23 @@ struct color Display::get_graphics_color(unsigned char idx) const
     return graphics_palette.colors[idx];
 }
 
-void Display::refresh()
+void Display::render()
 {
     assert(is_graphics);
-    window->clear();
 
     for (unsigned y = 0; y < 200; ++y)
         for (unsigned x = 0; x < 320; ++x) {
             auto color = get_graphics_color(pixels[y][x]);
 
             for (int i = 0; i < 2; ++i)
-                window->set_pixel(x * 2 + i, y, color.r, color.g, color.b);
+                set_framebuffer_pixel(x * 2 + i, y, color);
         }
-
-    window->redraw();
-
-    SDL_UpdateWindowSurface(window->get());
 }
 
-void Display::refresh(Cursor cursor)
+void Display::render(Cursor cursor)
 {
     assert(!is_graphics);
 
-    window->clear();
     for (unsigned y = 0; y < num_rows; ++y) {
         for (unsigned x = 0; x < num_cols; ++x) {
             uint16_t font_index = characters.get()[(y * (num_cols + 1)) + x];
@@ -149,13 +153,35 @@ void Display::refresh(Cursor cursor)
                                          (!pixel_set && render_cursor)
                                      ? fg
                                      : bg;
-                    window->set_pixel(x * 8 + j, y * 8 + i, color.r, color.g,
-                                      color.b);
+                    set_framebuffer_pixel(x * 8 + j, y * 8 + i, color);
                 }
         }
     }
+}
+
+void Display::blit()
+{
+    window->clear();
+
+    for (unsigned y = 0; y < get_height(); ++y)
+        for (unsigned x = 0; x < get_width(); ++x) {
+            auto p = &framebuffer[(y * get_width() + x) * 3];
+            window->set_pixel(x, y, p[0], p[1], p[2]);
+        }
 
     window->redraw();
 
     SDL_UpdateWindowSurface(window->get());
 }
+
+void Display::refresh()
+{
+    render();
+    blit();
+}
+
+void Display::refresh(Cursor cursor)
+{
+    render(cursor);
+    blit();
+}
@@ -20,6 +20,7 @@
 #include <memory>
 #include <string>
 #include <array>
+#include <vector>
 
 #include <boost/serialization/list.hpp>
 #include <boost/serialization/string.hpp>
@@ -72,6 +73,22 @@ public:
     void write_char(uint16_t c);
     void refresh(Cursor cursor);
     void refresh();
+    // Render into the RGB framebuffer without touching the window, used for
+    // frame capture.
+    void render(Cursor cursor);
+    void render();
+    const std::vector<uint8_t> &get_framebuffer() const
+    {
+        return framebuffer;
+    }
+    unsigned get_width() const
+    {
+        return 8 * num_cols;
+    }
+    unsigned get_height() const
+    {
+        return 8 * num_rows;
+    }
     void set_graphics(bool enabled)
     {
         is_graphics = enabled;
@@ -84,10 +101,21 @@ public:
     {
         graphics_palette = p;
     }
+    // Shown after the simulator name in the window title.
+    void set_status(const std::string &status);
 
 private:
     void load_font();
     struct color get_graphics_color(unsigned char idx) const;
+    void set_framebuffer_pixel(unsigned x, unsigned y, struct color c)
+    {
+        auto p = &framebuffer[(y * get_width() + x) * 3];
+
+        p[0] = c.r;
+        p[1] = c.g;
+        p[2] = c.b;
+    }
+    void blit();
 
     unsigned num_rows;
     unsigned num_cols;
@@ -99,4 +127,5 @@ private:
     char pixels[200][320];
     bool is_graphics;
     struct GraphicsPalette graphics_palette;
+    std::vector<uint8_t> framebuffer;
 };
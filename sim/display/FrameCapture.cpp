@@ -0,0 +1,191 @@
+// Copyright Jamie Iles, 2017
+//
+// This file is part of s80x86.
+//
+// s80x86 is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// s80x86 is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with s80x86.  If not, see <http://www.gnu.org/licenses/>.
+
+#include "FrameCapture.h"
+
+#include <cassert>
+#include <iostream>
+#include <stdexcept>
+
+#include <boost/format.hpp>
+
+CaptureFormat parse_capture_format(const std::string &name)
+{
+    if (name == "ppm")
+        return CAPTURE_PPM;
+    if (name == "y4m")
+        return CAPTURE_Y4M;
+
+    throw std::invalid_argument("invalid capture format \"" + name + "\"");
+}
+
+static uint64_t fnv1a(const std::vector<uint8_t> &v)
+{
+    uint64_t hash = 0xcbf29ce484222325LLU;
+
+    for (auto b : v) {
+        hash ^= b;
+        hash *= 0x100000001b3LLU;
+    }
+
+    return hash;
+}
+
+static uint8_t clamp_u8(int v)
+{
+    return v < 0 ? 0 : v > 255 ? 255 : v;
+}
+
+FrameCapture::FrameCapture(const std::string &path,
+                           CaptureFormat format,
+                           unsigned width,
+                           unsigned height)
+    : path(path),
+      format(format),
+      width(width),
+      height(height),
+      stream(),
+      planes(),
+      last_hash(0),
+      have_last_hash(false),
+      num_written(0),
+      num_duplicates(0),
+      lock(),
+      work_available(),
+      space_available(),
+      pending(),
+      done(false),
+      thread()
+{
+    if (format == CAPTURE_Y4M) {
+        stream.open(path, std::ios::binary | std::ios::out | std::ios::trunc);
+        if (!stream.good())
+            throw std::runtime_error("failed to open capture file " + path);
+        // The frame rate is nominal: duplicates are elided so each frame in
+        // the stream is a distinct screen state tagged with its guest cycle.
+        stream << "YUV4MPEG2 W" << width << " H" << height
+               << " F1:1 Ip A1:1 C444\n";
+        planes.resize(width * height * 3);
+    }
+
+    thread = std::thread([this] { this->worker(); });
+}
+
+FrameCapture::~FrameCapture()
+{
+    finish();
+}
+
+void FrameCapture::finish()
+{
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        done = true;
+    }
+    work_available.notify_one();
+    if (thread.joinable())
+        thread.join();
+}
+
+void FrameCapture::submit(unsigned long cycle, const std::vector<uint8_t> &rgb)
+{
+    assert(rgb.size() == width * height * 3);
+
+    std::unique_lock<std::mutex> guard(lock);
+    assert(!done);
+    space_available.wait(guard, [&] { return pending.size() < max_pending; });
+    pending.push_back(Frame{cycle, rgb});
+    guard.unlock();
+
+    work_available.notify_one();
+}
+
+void FrameCapture::worker()
+{
+    for (;;) {
+        std::unique_lock<std::mutex> guard(lock);
+        work_available.wait(guard, [&] { return done || !pending.empty(); });
+        if (pending.empty() && done)
+            break;
+
+        auto frame = std::move(pending.front());
+        pending.pop_front();
+        guard.unlock();
+        space_available.notify_one();
+
+        auto hash = fnv1a(frame.rgb);
+        if (have_last_hash && hash == last_hash) {
+            ++num_duplicates;
+            continue;
+        }
+        last_hash = hash;
+        have_last_hash = true;
+
+        write_frame(frame);
+        ++num_written;
+    }
+
+    if (stream.is_open())
+        stream.flush();
+}
+
+void FrameCapture::write_frame(const Frame &frame)
+{
+    if (format == CAPTURE_PPM)
+        write_ppm(frame);
+    else
+        write_y4m(frame);
+}
+
+void FrameCapture::write_ppm(const Frame &frame)
+{
+    auto filename =
+        (boost::format("%s-%012lu.ppm") % path % frame.cycle).str();
+    std::ofstream ppm(filename, std::ios::binary | std::ios::out);
+    if (!ppm.good()) {
+        // Running on the capture thread, nothing to propagate an exception to.
+        std::cerr << "warning: failed to open capture file " << filename
+                  << std::endl;
+        return;
+    }
+
+    ppm << "P6\n" << width << " " << height << "\n255\n";
+    ppm.write(reinterpret_cast<const char *>(frame.rgb.data()),
+              frame.rgb.size());
+}
+
+void FrameCapture::write_y4m(const Frame &frame)
+{
+    auto num_pixels = width * height;
+    auto y = planes.data();
+    auto u = y + num_pixels;
+    auto v = u + num_pixels;
+
+    // BT.601 studio swing, integer approximation.
+    for (unsigned i = 0; i < num_pixels; ++i) {
+        int r = frame.rgb[i * 3 + 0];
+        int g = frame.rgb[i * 3 + 1];
+        int b = frame.rgb[i * 3 + 2];
+
+        y[i] = clamp_u8(((66 * r + 129 * g + 25 * b + 128) >> 8) + 16);
+        u[i] = clamp_u8(((-38 * r - 74 * g + 112 * b + 128) >> 8) + 128);
+        v[i] = clamp_u8(((112 * r - 94 * g - 18 * b + 128) >> 8) + 128);
+    }
+
+    stream << "FRAME Xcycle=" << frame.cycle << "\n";
+    stream.write(reinterpret_cast<const char *>(planes.data()), planes.size());
+}
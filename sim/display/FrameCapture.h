@@ -0,0 +1,102 @@
+// Copyright Jamie Iles, 2017
+//
+// This file is part of s80x86.
+//
+// s80x86 is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// s80x86 is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with s80x86.  If not, see <http://www.gnu.org/licenses/>.
+
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <fstream>
+#include <mutex>
+#include <stdint.h>
+#include <string>
+#include <thread>
+#include <vector>
+
+enum CaptureFormat {
+    // One binary PPM per distinct frame, named <path>-<cycle>.ppm.
+    CAPTURE_PPM,
+    // A single YUV4MPEG2 (4:4:4) stream containing each distinct frame, with
+    // the guest cycle of the capture recorded in the frame header.
+    CAPTURE_Y4M,
+};
+
+CaptureFormat parse_capture_format(const std::string &name);
+
+// Captures rendered RGB frames to disk for visual regression testing.
+//
+// Frames are submitted from the simulation thread and handed to a worker
+// thread that hashes them, drops any frame identical to the previous one and
+// encodes the remainder so the emulation loop only pays for a copy.
+class FrameCapture
+{
+public:
+    FrameCapture(const std::string &path,
+                 CaptureFormat format,
+                 unsigned width,
+                 unsigned height);
+    ~FrameCapture();
+    FrameCapture(const FrameCapture &) = delete;
+    FrameCapture &operator=(const FrameCapture &) = delete;
+
+    void submit(unsigned long cycle, const std::vector<uint8_t> &rgb);
+    // Wait for the worker to write every submitted frame and stop it, the
+    // frame counts are final once this returns.  No frames may be submitted
+    // afterwards.
+    void finish();
+    unsigned long frames_written() const
+    {
+        return num_written;
+    }
+    unsigned long frames_dropped() const
+    {
+        return num_duplicates;
+    }
+
+private:
+    struct Frame {
+        unsigned long cycle;
+        std::vector<uint8_t> rgb;
+    };
+
+    void worker();
+    void write_frame(const Frame &frame);
+    void write_ppm(const Frame &frame);
+    void write_y4m(const Frame &frame);
+
+    // Bound the number of queued frames so that a slow disk throttles the
+    // simulation rather than consuming unbounded memory.
+    static const size_t max_pending = 16;
+
+    std::string path;
+    CaptureFormat format;
+    unsigned width;
+    unsigned height;
+    std::ofstream stream;
+    std::vector<uint8_t> planes;
+    uint64_t last_hash;
+    bool have_last_hash;
+    std::atomic<unsigned long> num_written;
+    std::atomic<unsigned long> num_duplicates;
+
+    std::mutex lock;
+    std::condition_variable work_available;
+    std::condition_variable space_available;
+    std::deque<Frame> pending;
+    bool done;
+    std::thread thread;
+};
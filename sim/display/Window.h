@@ -19,6 +19,7 @@
 
 #include <SDL.h>
 #include <stdexcept>
+#include <string>
 
 class Window
 {
@@ -54,6 +55,11 @@ public:
         return window;
     }
 
+    void set_title(const std::string &title)
+    {
+        SDL_SetWindowTitle(window, title.c_str());
+    }
+
     void clear()
     {
         SDL_SetRenderDrawColor(renderer, 0, 0, 0, 0);
@@ -0,0 +1,136 @@
+; Copyright Jamie Iles, 2017
+;
+; This file is part of s80x86.
+;
+; s80x86 is free software: you can redistribute it and/or modify
+; it under the terms of the GNU General Public License as published by
+; the Free Software Foundation, either version 3 of the License, or
+; (at your option) any later version.
+;
+; s80x86 is distributed in the hope that it will be useful,
+; but WITHOUT ANY WARRANTY; without even the implied warranty of
+; MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+; GNU General Public License for more details.
+;
+; You should have received a copy of the GNU General Public License
+; along with s80x86.  If not, see <http://www.gnu.org/licenses/>.
+
+; Boot sector for the disk throughput benchmark.  The extent table in the
+; sector following the boot sector lists the runs of sectors that hold the
+; payload file, each entry is a 32-bit LBA followed by a 16-bit sector count
+; and the table is terminated by a zero count.  Every extent is read through
+; the BIOS int 13h service so the benchmark exercises the same path as DOS.
+
+cpu 8086
+bits 16
+org 0x7c00
+
+%define EXTENT_TABLE        0x7e00
+%define BUFFER_SEGMENT      0x1000
+%define SECTORS_PER_TRACK   63
+%define NUM_HEADS           32
+
+start:
+    cli
+    xor         ax, ax
+    mov         ds, ax
+    mov         ss, ax
+    mov         sp, 0x7c00
+    sti
+    mov         [drive], dl
+
+    ; Load the extent table from LBA 1.
+    mov         es, ax
+    mov         bx, EXTENT_TABLE
+    mov         ax, 0x0201
+    mov         cx, 0x0002
+    xor         dh, dh
+    mov         dl, [drive]
+    int         0x13
+    jc          fail
+
+    mov         si, EXTENT_TABLE
+next_extent:
+    mov         cx, [si + 4]
+    test        cx, cx
+    jz          done
+    mov         ax, [si]
+    mov         dx, [si + 2]
+next_chunk:
+    ; Read at most one track's worth of sectors per call.
+    mov         bx, cx
+    cmp         bx, SECTORS_PER_TRACK
+    jbe         .count_ok
+    mov         bx, SECTORS_PER_TRACK
+.count_ok:
+    push        cx
+    push        bx
+    push        dx
+    push        ax
+    call        read_chunk
+    pop         ax
+    pop         dx
+    pop         bx
+    pop         cx
+    add         ax, bx
+    adc         dx, 0
+    sub         cx, bx
+    jnz         next_chunk
+    add         si, 6
+    jmp         next_extent
+
+done:
+    mov         si, done_msg
+    call        print
+    jmp         $
+
+fail:
+    mov         si, fail_msg
+    call        print
+    jmp         $
+
+; Read BX sectors starting at LBA DX:AX into BUFFER_SEGMENT:0000.
+read_chunk:
+    mov         di, bx
+    mov         cx, SECTORS_PER_TRACK
+    div         cx
+    mov         cl, dl
+    inc         cl
+    xor         dx, dx
+    mov         bx, NUM_HEADS
+    div         bx
+    mov         dh, dl
+    mov         ch, al
+    mov         bl, ah
+    and         bl, 3
+    ror         bl, 1
+    ror         bl, 1
+    or          cl, bl
+    mov         dl, [drive]
+    mov         ax, di
+    mov         ah, 0x02
+    mov         bx, BUFFER_SEGMENT
+    mov         es, bx
+    xor         bx, bx
+    int         0x13
+    jc          fail
+    ret
+
+; Print the NUL terminated string at DS:SI.
+print:
+    lodsb
+    test        al, al
+    jz          .out
+    mov         ah, 0x0e
+    mov         bx, 0x0007
+    int         0x10
+    jmp         print
+.out:
+    ret
+
+drive:      db 0
+done_msg:   db "DISKBENCH DONE", 13, 10, 0
+fail_msg:   db "DISKBENCH FAILED", 13, 10, 0
+
+    times 510 - ($ - $$) db 0
+    dw 0xaa55
@@ -0,0 +1,183 @@
+#!/usr/bin/env python3
+
+# Copyright Jamie Iles, 2017
+#
+# This file is part of s80x86.
+#
+# s80x86 is free software: you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation, either version 3 of the License, or
+# (at your option) any later version.
+#
+# s80x86 is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with s80x86.  If not, see <http://www.gnu.org/licenses/>.
+
+# Disk throughput benchmark: builds a FAT16 image containing a large payload
+# file, boots a sector that reads the file back through BIOS int 13h and
+# reports the throughput seen by the guest.
+
+import argparse
+import os
+import pty
+import select
+import struct
+import subprocess
+import sys
+import tempfile
+import time
+
+SECTOR_SIZE = 512
+# Sector 0 holds the boot sector, sector 1 the extent table.
+FS_START_LBA = 2
+# The BIOS geometry limits the disk to 65 cylinders, 32 heads, 63 sectors.
+MAX_DISK_SECTORS = 65 * 32 * 63
+DONE_MARKER = b'DISKBENCH DONE'
+FAIL_MARKER = b'DISKBENCH FAILED'
+BOOT_MARKER = b'Booting from SD card'
+
+def make_filesystem(path, fs_size_mb, payload_mb):
+    subprocess.check_call(['mkfs.fat', '-C', '-F', '16', path,
+                           str(fs_size_mb * 1024)],
+                          stdout=subprocess.DEVNULL)
+    with tempfile.NamedTemporaryFile() as payload:
+        payload.write(os.urandom(payload_mb * 1024 * 1024))
+        payload.flush()
+        env = dict(os.environ, MTOOLS_SKIP_CHECK='1')
+        subprocess.check_call(['mcopy', '-i', path, payload.name,
+                               '::PAYLOAD.BIN'], env=env)
+
+def payload_extents(fs):
+    """Return (lba, count) runs of the sectors holding PAYLOAD.BIN."""
+    (bytes_per_sector, sectors_per_cluster, reserved, num_fats,
+     root_entries, _, _, sectors_per_fat) = struct.unpack_from('<HBHBHHBH',
+                                                               fs, 11)
+    if bytes_per_sector != SECTOR_SIZE:
+        raise ValueError('unsupported sector size {0}'.format(bytes_per_sector))
+
+    fat_offset = reserved * SECTOR_SIZE
+    root_lba = reserved + num_fats * sectors_per_fat
+    data_lba = root_lba + (root_entries * 32 + SECTOR_SIZE - 1) // SECTOR_SIZE
+
+    for e in range(root_entries):
+        entry = fs[root_lba * SECTOR_SIZE + e * 32:][:32]
+        if entry[:11] == b'PAYLOADBIN ':
+            cluster, size = struct.unpack_from('<HI', entry, 26)
+            break
+    else:
+        raise ValueError('PAYLOAD.BIN not found in root directory')
+
+    sectors = []
+    while cluster < 0xfff8:
+        first = data_lba + (cluster - 2) * sectors_per_cluster
+        sectors.extend(range(first, first + sectors_per_cluster))
+        cluster = struct.unpack_from('<H', fs, fat_offset + cluster * 2)[0]
+    sectors = sectors[:(size + SECTOR_SIZE - 1) // SECTOR_SIZE]
+
+    extents = []
+    for s in sectors:
+        if extents and extents[-1][0] + extents[-1][1] == s and \
+                extents[-1][1] < 0xffff:
+            extents[-1][1] += 1
+        else:
+            extents.append([s, 1])
+
+    return [(FS_START_LBA + lba, count) for lba, count in extents], size
+
+def build_disk(path, boot_sector, fs_path):
+    with open(boot_sector, 'rb') as f:
+        boot = f.read()
+    with open(fs_path, 'rb') as f:
+        fs = f.read()
+
+    extents, size = payload_extents(fs)
+    table = b''.join(struct.pack('<IH', lba, count) for lba, count in extents)
+    table += struct.pack('<IH', 0, 0)
+    if len(table) > SECTOR_SIZE:
+        raise ValueError('payload too fragmented for the extent table')
+
+    with open(path, 'wb') as f:
+        f.write(boot.ljust(SECTOR_SIZE, b'\0'))
+        f.write(table.ljust(SECTOR_SIZE, b'\0'))
+        f.write(fs)
+
+    return size
+
+def run(simulator, bios, disk, backend, timeout):
+    # The simulator puts the console in raw mode so it needs a terminal.
+    master, slave = pty.openpty()
+    env = dict(os.environ)
+    env.setdefault('SDL_VIDEODRIVER', 'dummy')
+    proc = subprocess.Popen([simulator, '-b', backend, '--turbo', bios, disk],
+                            stdin=slave, stdout=slave, stderr=slave,
+                            env=env, close_fds=True)
+    os.close(slave)
+
+    output = b''
+    start = None
+    deadline = time.time() + timeout
+    try:
+        while True:
+            remaining = deadline - time.time()
+            if remaining <= 0:
+                raise RuntimeError('timed out waiting for the benchmark')
+            ready, _, _ = select.select([master], [], [], remaining)
+            if not ready:
+                continue
+            try:
+                output += os.read(master, 4096)
+            except OSError:
+                raise RuntimeError('simulator exited:\n' +
+                                   output.decode('ascii', 'replace'))
+            if start is None and BOOT_MARKER in output:
+                start = time.time()
+            if FAIL_MARKER in output:
+                raise RuntimeError('guest failed to read the payload')
+            if DONE_MARKER in output:
+                return time.time() - start
+    finally:
+        # ^] asks the simulator to exit.
+        try:
+            os.write(master, b'\x1d')
+            proc.wait(timeout=10)
+        except (OSError, subprocess.TimeoutExpired):
+            proc.kill()
+            proc.wait()
+        os.close(master)
+
+def main():
+    parser = argparse.ArgumentParser(
+        description='Measure int 13h disk read throughput')
+    parser.add_argument('--simulator', required=True)
+    parser.add_argument('--bios', required=True)
+    parser.add_argument('--boot-sector', required=True)
+    parser.add_argument('--backend', default='SoftwareCPU')
+    parser.add_argument('--fs-size', type=int, default=32,
+                        help='filesystem size in MB')
+    parser.add_argument('--payload-size', type=int, default=8,
+                        help='payload file size in MB')
+    parser.add_argument('--timeout', type=int, default=600,
+                        help='seconds to wait for the guest to finish')
+    args = parser.parse_args()
+
+    if args.fs_size * 1024 * 1024 // SECTOR_SIZE + FS_START_LBA > \
+            MAX_DISK_SECTORS:
+        parser.error('filesystem larger than the BIOS disk geometry')
+
+    with tempfile.TemporaryDirectory() as tmp:
+        fs_path = os.path.join(tmp, 'fs.img')
+        disk_path = os.path.join(tmp, 'disk.img')
+        make_filesystem(fs_path, args.fs_size, args.payload_size)
+        size = build_disk(disk_path, args.boot_sector, fs_path)
+        elapsed = run(args.simulator, args.bios, disk_path, args.backend,
+                      args.timeout)
+
+    print('{0}: read {1} bytes in {2:.2f}s, {3:.2f} KB/s'.format(
+        args.backend, size, elapsed, size / 1024.0 / elapsed))
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,108 @@
+#!/usr/bin/env python3
+
+# Copyright Jamie Iles, 2017
+#
+# This file is part of s80x86.
+#
+# s80x86 is free software: you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation, either version 3 of the License, or
+# (at your option) any later version.
+#
+# s80x86 is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with s80x86.  If not, see <http://www.gnu.org/licenses/>.
+
+# RTL simulation rate benchmark: boots the BIOS on the RTLCPU backend of one
+# or more simulators, each typically built with a different
+# VERILATOR_THREADS, and reports the simulated clock rate of each.
+
+import argparse
+import os
+import pty
+import re
+import select
+import subprocess
+import tempfile
+import time
+
+FREQUENCY_RE = re.compile(rb'Operating frequency: ([0-9.e+-]+)MHz')
+THREADS_RE = re.compile(rb'RTL model threads: ([0-9]+)')
+
+def run(simulator, bios, disk, duration):
+    # The simulator puts the console in raw mode so it needs a terminal.
+    master, slave = pty.openpty()
+    env = dict(os.environ)
+    env.setdefault('SDL_VIDEODRIVER', 'dummy')
+    # Fast forwarding would skip idle cycles without evaluating the model.
+    proc = subprocess.Popen([simulator, '-b', 'RTLCPU', '--turbo',
+                             '--no-fast-forward', bios, disk],
+                            stdin=slave, stdout=slave, stderr=slave,
+                            env=env, close_fds=True)
+    os.close(slave)
+
+    output = b''
+    deadline = time.time() + duration
+    exit_sent = False
+    try:
+        while True:
+            if not exit_sent and time.time() >= deadline:
+                # ^] asks the simulator to exit and report its statistics.
+                os.write(master, b'\x1d')
+                exit_sent = True
+            ready, _, _ = select.select([master], [], [], 1)
+            if not ready:
+                if exit_sent and proc.poll() is not None:
+                    break
+                continue
+            try:
+                data = os.read(master, 4096)
+            except OSError:
+                break
+            if not data:
+                break
+            output += data
+    finally:
+        try:
+            proc.wait(timeout=30)
+        except subprocess.TimeoutExpired:
+            proc.kill()
+            proc.wait()
+        os.close(master)
+
+    frequency = FREQUENCY_RE.search(output)
+    threads = THREADS_RE.search(output)
+    if not frequency or not threads:
+        raise RuntimeError('no statistics from {0}:\n{1}'.format(
+            simulator, output.decode('ascii', 'replace')))
+
+    return int(threads.group(1)), float(frequency.group(1))
+
+def main():
+    parser = argparse.ArgumentParser(
+        description='Measure the RTLCPU simulated clock rate')
+    parser.add_argument('--simulator', required=True, action='append',
+                        help='simulator to run, may be repeated')
+    parser.add_argument('--bios', required=True)
+    parser.add_argument('--duration', type=int, default=30,
+                        help='seconds to run each simulator for')
+    args = parser.parse_args()
+
+    results = []
+    with tempfile.NamedTemporaryFile() as disk:
+        # No boot sector, the BIOS is left waiting for a bootable disk.
+        disk.truncate(1024 * 1024)
+        for simulator in args.simulator:
+            results.append(run(simulator, args.bios, disk.name,
+                               args.duration))
+
+    print('{0:>8} {1:>10}'.format('threads', 'MHz'))
+    for threads, frequency in sorted(results):
+        print('{0:>8} {1:>10.3f}'.format(threads, frequency))
+
+if __name__ == '__main__':
+    main()
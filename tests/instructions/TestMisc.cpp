@@ -120,3 +120,31 @@ TEST_F(EmulateFixture, EscMemSegmentOverride)
         EXPECT_EQ(read_reg(IP), 0x0001 + 5);
     }
 }
+
+TEST_F(EmulateFixture, AllRegisters)
+{
+    write_mem16(0x0000, 0xa5a5);
+
+    RegisterState state = {{0x1111, 0x2222, 0x3333, 0x4444, 0x0100, 0x6666,
+                            0x7777, 0x8888, 0x4000, 0x0000, 0x2000, 0x7000,
+                            0x1000},
+                           FLAGS_STUCK_BITS | CF | ZF};
+    cpu->write_all_regs(state);
+
+    for (int r = 0; r < NUM_16BIT_REGS; ++r)
+        EXPECT_EQ(state.registers[r], read_reg(static_cast<GPR>(r)));
+    EXPECT_EQ(state.flags, read_flags());
+
+    auto read_back = cpu->read_all_regs();
+    for (int r = 0; r < NUM_16BIT_REGS; ++r)
+        EXPECT_EQ(state.registers[r], read_back.registers[r]);
+    EXPECT_EQ(state.flags, read_back.flags);
+
+    // The previous data segment is unchanged.
+    EXPECT_EQ(0xa5a5, cpu->read_mem16(0x6000, 0x0000));
+
+    // inc ax
+    set_instruction({0x40});
+    emulate();
+    EXPECT_EQ(0x1112, read_reg(AX));
+}
@@ -64,6 +64,12 @@ static const std::vector<struct ShiftTest<uint8_t>> rcl8_shiftN_tests = {
         {1, 0x80, 0x00, 0, CF}, {1, 0x80, 0x01, CF, CF}, {1, 0x80, 0x00, 0, CF},
         {1, 0xc0, 0x81, CF, CF}, {8, 0, 0, 0, 0}, {7, 1, 0x80, 0, 0},
         {8, 1, 0x00, 0, CF},
+        // Counts beyond the operand width, then counts masked to 5 bits.
+        {9, 0x81, 0x81, 0, 0}, {9, 0x81, 0x81, CF, CF}, {10, 0x81, 0x02, 0, CF},
+        {17, 0x01, 0x80, CF, CF}, {18, 0x81, 0x81, 0, 0},
+        {26, 0x40, 0x20, 0, 0}, {27, 0x81, 0x81, CF, CF},
+        {31, 0x81, 0x14, 0, 0}, {32, 0x81, 0x81, CF, CF},
+        {33, 0x81, 0x02, 0, CF}, {0xff, 0x81, 0x14, 0, 0},
 };
 
 static const std::vector<struct ShiftTest<uint16_t>> rcl16_shiftN_tests = {
@@ -72,6 +78,11 @@ static const std::vector<struct ShiftTest<uint16_t>> rcl16_shiftN_tests = {
         {1, 0x8000, 0x0000, 0, CF}, {1, 0xc000, 0x8001, CF, CF},
         {16, 0, 0, 0, 0}, {16, 0, 0x8000, CF, 0}, {15, 1, 0x8000, 0, 0},
         {16, 1, 0x0000, 0, CF},
+        // Counts beyond the operand width, then counts masked to 5 bits.
+        {17, 0x8001, 0x8001, 0, 0}, {18, 0x8001, 0x0003, CF, CF},
+        {24, 0x8001, 0x00a0, 0, 0}, {31, 0x4000, 0x2800, CF, 0},
+        {32, 0x8001, 0x8001, CF, CF}, {33, 0x8001, 0x0002, 0, CF},
+        {0xff, 0x8001, 0x5000, 0, 0},
 };
 
 INSTANTIATE_TEST_CASE_P(RclgN,
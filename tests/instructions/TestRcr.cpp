@@ -61,12 +61,23 @@ static const std::vector<struct ShiftTest<uint8_t>> rcr8_shiftN_tests = {
     {0, 1, 1, 0, 0}, {1, 0, 0, 0, 0}, {1, 0x80, 0x40, 0, 0},
         {1, 0, 0x80, CF, 0}, {1, 2, 1, 0, 0}, {1, 0x80, 0xc0, CF, 0},
         {8, 0, 0, 0, 0}, {7, 0x80, 0x1, 0, 0}, {8, 0x80, 0x00, 0, CF},
+        // Counts beyond the operand width, then counts masked to 5 bits.
+        {9, 0x81, 0x81, 0, 0}, {9, 0x81, 0x81, CF, CF}, {10, 0x81, 0x40, 0, CF},
+        {17, 0x80, 0x01, CF, CF}, {18, 0x81, 0x81, 0, 0},
+        {26, 0x02, 0x04, 0, 0}, {27, 0x81, 0x81, CF, CF},
+        {31, 0x81, 0x28, 0, 0}, {32, 0x81, 0x81, CF, CF},
+        {33, 0x81, 0x40, 0, CF}, {0xff, 0x81, 0x28, 0, 0},
 };
 
 static const std::vector<struct ShiftTest<uint16_t>> rcr16_shiftN_tests = {
     {0, 1, 1, 0, 0}, {1, 0, 0, 0, 0}, {1, 0x8000, 0x4000, 0, 0},
         {1, 0, 0x8000, CF, 0}, {1, 2, 1, 0, 0}, {1, 0x8000, 0xc000, CF, 0},
         {16, 0, 0, 0, 0}, {15, 0x8000, 0x1, 0, 0}, {16, 0x8000, 0x00, 0, CF},
+        // Counts beyond the operand width, then counts masked to 5 bits.
+        {17, 0x8001, 0x8001, 0, 0}, {18, 0x8001, 0xc000, CF, CF},
+        {24, 0x8001, 0x0500, 0, 0}, {31, 0x0002, 0x0014, CF, 0},
+        {32, 0x8001, 0x8001, CF, CF}, {33, 0x8001, 0x4000, 0, CF},
+        {0xff, 0x8001, 0x000a, 0, 0},
 };
 
 INSTANTIATE_TEST_CASE_P(RcrgN,
@@ -62,6 +62,10 @@ static const std::vector<struct ShiftTest<uint8_t>> ror8_shiftN_tests = {
         {1, 0x01, 0x80, 0, CF},
 
         {8, 0, 0, 0, 0}, {7, 0x80, 1, 0, 0}, {8, 1, 0x01, 0, 0},
+        // Counts beyond the operand width, then counts masked to 5 bits.
+        {9, 0x81, 0xc0, 0, CF}, {16, 0x81, 0x81, 0, CF}, {17, 0x02, 0x01, 0, 0},
+        {31, 0x81, 0x03, 0, 0}, {32, 0x81, 0x81, CF, CF},
+        {33, 0x81, 0xc0, 0, CF}, {0xff, 0x81, 0x03, 0, 0},
 };
 
 static const std::vector<struct ShiftTest<uint16_t>> ror16_shiftN_tests = {
@@ -69,6 +73,10 @@ static const std::vector<struct ShiftTest<uint16_t>> ror16_shiftN_tests = {
         {1, 0x8001, 0xc000, 0, CF}, {1, 0x0001, 0x8000, 0, CF},
 
         {16, 0, 0, 0, 0}, {15, 0x8000, 1, 0, 0}, {16, 1, 0x01, 0, 0},
+        // Counts beyond the operand width, then counts masked to 5 bits.
+        {17, 0x8001, 0xc000, 0, CF}, {24, 0x8001, 0x0180, 0, 0},
+        {31, 0x8001, 0x0003, 0, 0}, {32, 0x8001, 0x8001, CF, CF},
+        {33, 0x8001, 0xc000, 0, CF}, {0xff, 0x8001, 0x0003, 0, 0},
 };
 
 INSTANTIATE_TEST_CASE_P(RorN,
@@ -63,10 +63,11 @@ static const std::vector<struct ShiftTest<uint8_t>> sar8_shiftN_tests = {
     {0, 1, 1, 0, 0}, {1, 0, 0, 0, PF | ZF}, {1, 1, 0, 0, PF | ZF | CF},
         {1, 2, 1, 0, 0}, {1, 0, 0, CF, PF | ZF}, {1, 0x80, 0xc0, CF, PF | SF},
         {1, 0x80, 0xc0, 0, PF | SF}, {8, 0, 0, 0, PF | ZF},
-        {7, 0x80, 0xff, 0, PF | SF},
-    {
-        8, 0x80, 0xff, 0, PF | SF | CF
-    }
+        {7, 0x80, 0xff, 0, PF | SF}, {8, 0x80, 0xff, 0, PF | SF | CF},
+        // Counts beyond the operand width, then counts masked to 5 bits.
+        {9, 0x80, 0xff, 0, CF | PF | SF}, {16, 0x7f, 0x00, 0, PF | ZF},
+        {31, 0x80, 0xff, 0, CF | PF | SF}, {32, 0x81, 0x81, CF, CF},
+        {33, 0x81, 0xc0, 0, CF | PF | SF}, {0xff, 0x81, 0xff, 0, CF | PF | SF},
 };
 
 static const std::vector<struct ShiftTest<uint16_t>> sar16_shiftN_tests = {
@@ -74,9 +75,12 @@ static const std::vector<struct ShiftTest<uint16_t>> sar16_shiftN_tests = {
         {1, 2, 1, 0, 0}, {1, 0, 0, CF, PF | ZF},
         {1, 0x8000, 0xc000, CF, PF | SF}, {1, 0x8000, 0xc000, 0, PF | SF},
         {16, 0, 0, 0, PF | ZF}, {15, 0x8000, 0xffff, 0, PF | SF},
-    {
-        16, 0x8000, 0xffff, 0, PF | SF | CF
-    }
+        {16, 0x8000, 0xffff, 0, PF | SF | CF},
+        // Counts beyond the operand width, then counts masked to 5 bits.
+        {17, 0x8000, 0xffff, 0, CF | PF | SF}, {24, 0x7fff, 0x0000, 0, PF | ZF},
+        {31, 0x8000, 0xffff, 0, CF | PF | SF}, {32, 0x8001, 0x8001, CF, CF},
+        {33, 0x8001, 0xc000, 0, CF | PF | SF},
+        {0xff, 0x8001, 0xffff, 0, CF | PF | SF},
 };
 
 INSTANTIATE_TEST_CASE_P(SarN,
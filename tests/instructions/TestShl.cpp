@@ -73,6 +73,10 @@ static const std::vector<struct ShiftTest<uint8_t>> shl8_shiftN_tests = {
         {1, 0x80, 0x00, 0, CF | ZF | PF}, {1, 0xc0, 0x80, 0, CF | SF},
         {1, 0x40, 0x80, 0, SF}, {8, 0, 0, 0, PF | ZF}, {7, 1, 0x80, 0, SF},
         {8, 1, 0x00, 0, CF | PF | ZF},
+        // Counts beyond the operand width, then counts masked to 5 bits.
+        {9, 0xff, 0x00, 0, PF | ZF}, {16, 0xff, 0x00, 0, PF | ZF},
+        {31, 0xff, 0x00, 0, PF | ZF}, {32, 0x81, 0x81, CF, CF},
+        {33, 0x81, 0x02, 0, CF}, {0xff, 0x81, 0x00, 0, PF | ZF},
 };
 
 static const std::vector<struct ShiftTest<uint16_t>> shl16_shiftN_tests = {
@@ -81,6 +85,10 @@ static const std::vector<struct ShiftTest<uint16_t>> shl16_shiftN_tests = {
         {1, 0xc000, 0x8000, 0, CF | SF | PF}, {1, 0x4000, 0x8000, 0, SF | PF},
         {8, 0, 0, 0, PF | ZF}, {15, 1, 0x8000, 0, SF | PF},
         {16, 1, 0x0000, 0, CF | PF | ZF},
+        // Counts beyond the operand width, then counts masked to 5 bits.
+        {17, 0xffff, 0x0000, 0, PF | ZF}, {24, 0xffff, 0x0000, 0, PF | ZF},
+        {31, 0xffff, 0x0000, 0, PF | ZF}, {32, 0x8001, 0x8001, CF, CF},
+        {33, 0x8001, 0x0002, 0, CF}, {0xff, 0x8001, 0x0000, 0, PF | ZF},
 };
 
 INSTANTIATE_TEST_CASE_P(ShlN,
@@ -61,12 +61,20 @@ static const std::vector<struct ShiftTest<uint8_t>> shr8_shiftN_tests = {
     {0, 1, 1, 0, 0}, {1, 0, 0, 0, PF | ZF}, {1, 1, 0, 0, PF | ZF | CF},
         {1, 2, 1, 0, 0}, {1, 0, 0, CF, PF | ZF}, {8, 0, 0, 0, PF | ZF},
         {7, 0x80, 1, 0, 0}, {8, 0x80, 0x00, 0, CF | PF | ZF},
+        // Counts beyond the operand width, then counts masked to 5 bits.
+        {9, 0xff, 0x00, 0, PF | ZF}, {16, 0xff, 0x00, 0, PF | ZF},
+        {31, 0xff, 0x00, 0, PF | ZF}, {32, 0x81, 0x81, CF, CF},
+        {33, 0x81, 0x40, 0, CF}, {0xff, 0x81, 0x00, 0, PF | ZF},
 };
 
 static const std::vector<struct ShiftTest<uint16_t>> shr16_shiftN_tests = {
     {0, 1, 1, 0, 0}, {1, 0, 0, 0, PF | ZF}, {1, 1, 0, 0, PF | ZF | CF},
         {1, 2, 1, 0, 0}, {1, 0, 0, CF, PF | ZF}, {8, 0, 0, 0, PF | ZF},
         {15, 0x8000, 1, 0, 0}, {16, 0x8000, 0x00, 0, CF | PF | ZF},
+        // Counts beyond the operand width, then counts masked to 5 bits.
+        {17, 0xffff, 0x0000, 0, PF | ZF}, {24, 0xffff, 0x0000, 0, PF | ZF},
+        {31, 0xffff, 0x0000, 0, PF | ZF}, {32, 0x8001, 0x8001, CF, CF},
+        {33, 0x8001, 0x4000, 0, CF | PF}, {0xff, 0x8001, 0x0000, 0, PF | ZF},
 };
 
 INSTANTIATE_TEST_CASE_P(ShrN,
@@ -0,0 +1,58 @@
+// Copyright Jamie Iles, 2017
+//
+// This file is part of s80x86.
+//
+// s80x86 is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// s80x86 is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with s80x86.  If not, see <http://www.gnu.org/licenses/>.
+
+// Check that the cache model agrees with the Verilated Cache for a memory
+// reference stream captured with the simulator's --memory-trace.
+
+#include <iostream>
+#include <stdexcept>
+#include <string>
+
+#include "CacheChecker.h"
+#include "MemoryTrace.h"
+
+int main(int argc, char *argv[])
+{
+    if (argc < 2) {
+        std::cerr << "Usage: " << argv[0] << " TRACE [COUNT]" << std::endl;
+        return 2;
+    }
+    unsigned long count = argc > 2 ? std::stoul(argv[2]) : 0;
+
+    try {
+        MemoryTraceReader reader(argv[1]);
+        CacheChecker checker("cache-check");
+        MemoryReference ref;
+
+        while ((count == 0 || checker.references_checked() < count) &&
+               reader.next(&ref)) {
+            auto error = checker.check(ref);
+            if (!error.empty()) {
+                std::cerr << "Mismatch: " << error << std::endl;
+                return 1;
+            }
+        }
+
+        std::cout << checker.references_checked()
+                  << " references agree with Cache.sv" << std::endl;
+    } catch (std::runtime_error &e) {
+        std::cerr << "Error: " << e.what() << std::endl;
+        return 1;
+    }
+
+    return 0;
+}
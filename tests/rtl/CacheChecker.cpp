@@ -0,0 +1,144 @@
+// Copyright Jamie Iles, 2017
+//
+// This file is part of s80x86.
+//
+// s80x86 is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// s80x86 is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with s80x86.  If not, see <http://www.gnu.org/licenses/>.
+
+#include "CacheChecker.h"
+
+#include <boost/format.hpp>
+#include <stdexcept>
+
+CacheChecker::CacheChecker(const std::string &instance_name)
+    : VerilogDriver<VCache>(instance_name),
+      model(CacheConfig(), 1),
+      mem(MEMORY_SIZE / 2),
+      expected(),
+      transferring(false),
+      acked(false),
+      read_value(0),
+      words_read(0),
+      words_written(0),
+      num_checked(0)
+{
+    for (size_t m = 0; m < mem.size(); ++m)
+        mem[m] = m;
+    expected = mem;
+
+    dut.enabled = 1;
+
+    reset();
+
+    periodic(ClockCapture, [&] {
+        if (!this->dut.reset && this->dut.c_ack) {
+            this->acked = true;
+            this->read_value = this->dut.c_data_in;
+            this->dut.c_access = 0;
+        }
+    });
+    periodic(ClockSetup, [&] { this->memory_access(); });
+}
+
+void CacheChecker::memory_access()
+{
+    if (dut.reset || !dut.m_access || transferring)
+        return;
+
+    transferring = true;
+    auto word = dut.m_addr;
+    if (dut.m_wr_en)
+        ++words_written;
+    else
+        ++words_read;
+
+    after_n_cycles(2, [this, word] {
+        if (this->dut.m_wr_en)
+            this->mem[word] = this->dut.m_data_out;
+        else
+            this->dut.m_data_in = this->mem[word];
+        this->dut.m_ack = 1;
+        this->after_n_cycles(1, [this] {
+            this->dut.m_ack = 0;
+            this->transferring = false;
+        });
+    });
+}
+
+void CacheChecker::access(const MemoryReference &ref, uint16_t data)
+{
+    acked = false;
+    after_n_cycles(0, [this, ref, data] {
+        this->dut.c_addr = ref.addr >> 1;
+        this->dut.c_data_out = data;
+        this->dut.c_access = 1;
+        this->dut.c_wr_en = ref.write;
+        this->dut.c_bytesel = ref.bytesel & 0x3;
+    });
+
+    for (int m = 0; m < 1000 && !acked; ++m)
+        cycle();
+    if (!acked)
+        throw std::runtime_error("Cache failed to complete access");
+
+    // The rest of the line is filled after the requested word is returned,
+    // wait for the bus to be idle so that the transfer is counted against
+    // this reference.
+    for (int idle = 0; idle < 4;) {
+        cycle();
+        idle = transferring || dut.m_access ? 0 : idle + 1;
+    }
+}
+
+std::string CacheChecker::check(const MemoryReference &ref)
+{
+    auto index = num_checked++;
+    auto word = ref.addr >> 1;
+    uint16_t data = index * 0x9e37;
+
+    auto fills = model.stats().fills;
+    auto writebacks = model.stats().writebacks;
+    auto model_hit = model.access(ref.addr, ref.write);
+    auto line_words = model.config().line_size / 2;
+    auto model_read = (model.stats().fills - fills) * line_words;
+    auto model_written = (model.stats().writebacks - writebacks) * line_words;
+
+    auto cache_read = words_read;
+    auto cache_written = words_written;
+    access(ref, data);
+    cache_read = words_read - cache_read;
+    cache_written = words_written - cache_written;
+
+    auto what = (boost::format("reference %lu, %s %05x") % index %
+                 (ref.write ? "write" : "read") % ref.addr)
+                    .str();
+    if (cache_read != model_read || cache_written != model_written)
+        return (boost::format("%s: cache read %lu and wrote %lu words, model "
+                              "read %lu and wrote %lu on a %s") %
+                what % cache_read % cache_written % model_read %
+                model_written % (model_hit ? "hit" : "miss"))
+            .str();
+
+    if (ref.write) {
+        if (ref.bytesel & 0x1)
+            expected[word] = (expected[word] & 0xff00) | (data & 0x00ff);
+        if (ref.bytesel & 0x2)
+            expected[word] = (expected[word] & 0x00ff) | (data & 0xff00);
+    } else if (read_value != expected[word]) {
+        return (boost::format("%s: cache returned %04x, expected %04x") %
+                what % read_value % expected[word])
+            .str();
+    }
+
+    return "";
+}
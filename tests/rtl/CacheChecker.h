@@ -0,0 +1,60 @@
+// Copyright Jamie Iles, 2017
+//
+// This file is part of s80x86.
+//
+// s80x86 is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// s80x86 is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with s80x86.  If not, see <http://www.gnu.org/licenses/>.
+
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include <VCache.h>
+
+#include "CacheModel.h"
+#include "MemoryTrace.h"
+#include "VerilogDriver.h"
+
+// Runs a reference stream through both the Verilated Cache and a CacheModel
+// of the same configuration.  Each reference must hit or miss in both,
+// transfer the same number of words to and from memory and, for reads,
+// return the last value written.
+class CacheChecker : public VerilogDriver<VCache>
+{
+public:
+    explicit CacheChecker(const std::string &instance_name);
+
+    // Returns an empty string if the cache and model agree, otherwise a
+    // description of the mismatch.
+    std::string check(const MemoryReference &ref);
+    unsigned long references_checked() const
+    {
+        return num_checked;
+    }
+
+private:
+    void access(const MemoryReference &ref, uint16_t data);
+    void memory_access();
+
+    CacheModel model;
+    // The backing store and the value that each word should read as.
+    std::vector<uint16_t> mem;
+    std::vector<uint16_t> expected;
+    bool transferring;
+    bool acked;
+    uint16_t read_value;
+    unsigned long words_read;
+    unsigned long words_written;
+    unsigned long num_checked;
+};
@@ -0,0 +1,109 @@
+// Copyright Jamie Iles, 2017
+//
+// This file is part of s80x86.
+//
+// s80x86 is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// s80x86 is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with s80x86.  If not, see <http://www.gnu.org/licenses/>.
+
+// Measure the simulated clock rate of the Verilog driver.  The FIFO gives
+// the cost of the driver itself as the model is trivial, RTLCPU gives the
+// rate seen by the instruction tests and the simulator.
+
+#include <chrono>
+#include <iostream>
+#include <string>
+
+#include <VFifo.h>
+
+#include "RTLCPU.h"
+#include "VerilogDriver.h"
+
+class FifoBench : public VerilogDriver<VFifo>
+{
+public:
+    FifoBench() : VerilogDriver<VFifo>("fifo-bench"), popped(0)
+    {
+        dut.flush = 0;
+        dut.wr_en = 0;
+        dut.wr_data = 0LU;
+        dut.rd_en = 0;
+
+        periodic(ClockSetup, [&] {
+            this->dut.wr_en = !this->dut.full;
+            this->dut.wr_data = this->cur_cycle();
+        });
+        periodic(ClockCapture, [&] { this->popped += !this->dut.empty; });
+
+        reset();
+    }
+
+    void run(unsigned long count)
+    {
+        for (unsigned long m = 0; m < count; ++m) {
+            if (m % 4 == 0)
+                after_n_cycles(1, [&] {
+                    this->dut.rd_en = 1;
+                    this->after_n_cycles(1, [&] { this->dut.rd_en = 0; });
+                });
+            cycle();
+        }
+    }
+
+private:
+    unsigned long popped;
+};
+
+// Fn runs the benchmark and returns the number of cycles simulated.
+template <typename Fn>
+static void report(const std::string &name, Fn fn)
+{
+    auto start_time = std::chrono::steady_clock::now();
+    unsigned long cycles = fn();
+    auto end_time = std::chrono::steady_clock::now();
+
+    std::chrono::duration<double> elapsed_seconds = end_time - start_time;
+
+    std::cout << name << ": " << cycles << " cycles in "
+              << elapsed_seconds.count() << "s, "
+              << (cycles / 1000000.0) / elapsed_seconds.count() << "MHz"
+              << std::endl;
+}
+
+int main(int argc, char *argv[])
+{
+    unsigned long cycles = argc > 1 ? std::stoul(argv[1]) : 10000000;
+
+    FifoBench fifo;
+    report("Fifo", [&] {
+        fifo.run(cycles);
+        return cycles;
+    });
+
+    RTLCPU<> cpu("cycle-bench");
+    cpu.enable_cache();
+    cpu.reset();
+    cpu.write_reg(CS, 0x0000);
+    // inc ax; jmp $-3
+    cpu.write_vector8(0x0000, 0x1000, {0x40, 0xeb, 0xfd});
+    cpu.write_reg(IP, 0x1000);
+
+    // The CPU is much slower to evaluate, keep the run time comparable.
+    report("RTLCPU", [&] {
+        auto start_cycle = cpu.cycle_count();
+        while (cpu.cycle_count() - start_cycle < cycles / 10)
+            cpu.step();
+        return cpu.cycle_count() - start_cycle;
+    });
+
+    return 0;
+}
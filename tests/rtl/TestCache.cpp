@@ -20,7 +20,9 @@
 #include <VCache.h>
 #include <map>
 #include <memory>
+#include <random>
 
+#include "CacheChecker.h"
 #include "VerilogTestbench.h"
 
 using physaddr = uint32_t;
@@ -343,3 +345,21 @@ TEST_F(CacheTestbench, FlushDirtyLine)
         writes.push_back({0x0100 + i * 2, static_cast<uint16_t>(~i)});
     EXPECT_THAT(writes, ::testing::ContainerEq(get_writes()));
 }
+
+TEST(CacheModelCheck, RandomReferencesAgree)
+{
+    CacheChecker checker(current_test_name());
+    std::mt19937 rng(1);
+    // 64KB of words, so lines conflict in the 8KB cache and dirty lines are
+    // written back, with runs of sequential words for hits.
+    std::uniform_int_distribution<uint32_t> word_dist(0, 0x7fff);
+    uint32_t word = 0;
+
+    for (int m = 0; m < 4000; ++m) {
+        word = rng() % 4 ? word + 1 : word_dist(rng);
+        MemoryReference ref{(word & 0x7fff) << 1,
+                            static_cast<uint8_t>(1 + rng() % 3),
+                            rng() % 4 == 0};
+        ASSERT_EQ("", checker.check(ref));
+    }
+}
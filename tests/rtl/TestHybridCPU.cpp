@@ -0,0 +1,248 @@
+// Copyright Jamie Iles, 2017
+//
+// This file is part of s80x86.
+//
+// s80x86 is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// s80x86 is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with s80x86.  If not, see <http://www.gnu.org/licenses/>.
+
+#include <gtest/gtest.h>
+
+#include <initializer_list>
+
+#include "HybridCPU.h"
+
+// Stands in for the PS/2 mouse at its ports, the real device needs SDL.
+class MousePorts : public IOPorts
+{
+public:
+    MousePorts() : IOPorts(0xffe0, 7), last_write(0)
+    {
+    }
+
+    void write8(uint16_t __unused port_num, unsigned offs, uint8_t v)
+    {
+        if (offs == 0)
+            last_write = v;
+    }
+
+    uint8_t read8(uint16_t __unused port_num, unsigned __unused offs)
+    {
+        return 0xfa;
+    }
+
+    uint8_t last_write;
+};
+
+class HybridCPUTestFixture : public ::testing::Test
+{
+public:
+    HybridCPUTestFixture() : cpu("hybrid")
+    {
+        cpu.reset();
+    }
+
+    // Load code at 0000:0100 and start executing from there.
+    void load(std::initializer_list<uint8_t> code)
+    {
+        uint16_t offs = 0x100;
+
+        for (auto b : code)
+            cpu.write_mem8(0, offs++, b);
+        cpu.write_reg(CS, 0);
+        cpu.write_reg(IP, 0x100);
+    }
+
+protected:
+    HybridCPU cpu;
+};
+
+TEST_F(HybridCPUTestFixture, starts_on_software)
+{
+    load({0x40}); // inc ax
+
+    cpu.step();
+
+    ASSERT_FALSE(cpu.on_rtl());
+    ASSERT_EQ(0U, cpu.num_switches());
+}
+
+TEST_F(HybridCPUTestFixture, switch_after_instructions)
+{
+    load({
+        0xb8, 0x34, 0x12, // mov ax, 0x1234
+        0xfd,             // std
+        0x40,             // inc ax
+        0x40,             // inc ax
+    });
+    cpu.set_rtl_after(2);
+
+    cpu.step();
+    cpu.step();
+    ASSERT_FALSE(cpu.on_rtl());
+    auto cycles = cpu.cycle_count();
+
+    cpu.step();
+    ASSERT_TRUE(cpu.on_rtl());
+    ASSERT_EQ(0x1235, cpu.read_reg(AX));
+    ASSERT_EQ(0x0105, cpu.read_reg(IP));
+    ASSERT_TRUE(cpu.read_flags() & DF);
+    ASSERT_GT(cpu.cycle_count(), cycles);
+
+    cpu.step();
+    ASSERT_EQ(0x1236, cpu.read_reg(AX));
+    ASSERT_EQ(2LU, cpu.rtl_instructions());
+    ASSERT_EQ(1U, cpu.num_switches());
+}
+
+TEST_F(HybridCPUTestFixture, switch_at_address)
+{
+    load({
+        0x40, // inc ax
+        0x40, // inc ax
+        0x40, // inc ax
+    });
+    cpu.set_rtl_at(0, 0x102);
+
+    cpu.step();
+    cpu.step();
+    ASSERT_FALSE(cpu.on_rtl());
+
+    cpu.step();
+    ASSERT_TRUE(cpu.on_rtl());
+    ASSERT_EQ(3, cpu.read_reg(AX));
+}
+
+TEST_F(HybridCPUTestFixture, rtl_for_returns_to_software)
+{
+    load({
+        0x40, // inc ax
+        0x40, // inc ax
+        0x40, // inc ax
+    });
+    cpu.set_rtl_at(0, 0x100);
+    cpu.set_rtl_for(2);
+
+    cpu.step();
+    cpu.step();
+    ASSERT_TRUE(cpu.on_rtl());
+
+    cpu.step();
+    ASSERT_FALSE(cpu.on_rtl());
+    ASSERT_EQ(3, cpu.read_reg(AX));
+    ASSERT_EQ(2U, cpu.num_switches());
+}
+
+TEST_F(HybridCPUTestFixture, return_to_software)
+{
+    load({
+        0x40, // inc ax
+        0x40, // inc ax
+    });
+    cpu.set_rtl_at(0, 0x100);
+
+    cpu.step();
+    ASSERT_TRUE(cpu.on_rtl());
+
+    cpu.return_to_software();
+    ASSERT_FALSE(cpu.on_rtl());
+    ASSERT_EQ(1, cpu.read_reg(AX));
+    ASSERT_EQ(0x101, cpu.read_reg(IP));
+
+    // Already on the SoftwareCPU, nothing to do.
+    cpu.return_to_software();
+    ASSERT_EQ(2U, cpu.num_switches());
+}
+
+TEST_F(HybridCPUTestFixture, guest_hypercall)
+{
+    load({
+        0xba, 0xc0, 0xff, // mov dx, 0xffc0
+        0xb0, 0x01,       // mov al, 1
+        0xee,             // out dx, al
+        0x40,             // inc ax
+        0x30, 0xc0,       // xor al, al
+        0xee,             // out dx, al
+        0x40,             // inc ax
+    });
+
+    for (int i = 0; i < 4; ++i)
+        cpu.step();
+    ASSERT_TRUE(cpu.on_rtl());
+    ASSERT_EQ(1, cpu.read_io8(0xffc0));
+
+    for (int i = 0; i < 2; ++i)
+        cpu.step();
+    ASSERT_TRUE(cpu.on_rtl());
+
+    cpu.step();
+    ASSERT_FALSE(cpu.on_rtl());
+    ASSERT_EQ(1, cpu.read_reg(AX));
+}
+
+TEST_F(HybridCPUTestFixture, hypercall_with_mouse)
+{
+    MousePorts mouse;
+    cpu.add_ioport(&mouse);
+
+    load({
+        0xba, 0xe0, 0xff, // mov dx, 0xffe0
+        0xb0, 0x01,       // mov al, 1
+        0xee,             // out dx, al
+        0xec,             // in al, dx
+        0xba, 0xc0, 0xff, // mov dx, 0xffc0
+        0xb0, 0x01,       // mov al, 1
+        0xee,             // out dx, al
+        0x40,             // inc ax
+    });
+
+    for (int i = 0; i < 4; ++i)
+        cpu.step();
+    ASSERT_FALSE(cpu.on_rtl());
+    ASSERT_EQ(1, mouse.last_write);
+    ASSERT_EQ(0xfa, cpu.read_reg(AX) & 0xff);
+
+    for (int i = 0; i < 4; ++i)
+        cpu.step();
+    ASSERT_TRUE(cpu.on_rtl());
+    ASSERT_EQ(2, cpu.read_reg(AX) & 0xff);
+    ASSERT_EQ(0xfa, cpu.read_io8(0xffe0));
+}
+
+TEST_F(HybridCPUTestFixture, pending_irq_carried_over)
+{
+    // int 0x21 vectors to 0000:0200, which loops forever.
+    cpu.write_mem16(0, 0x21 * 4, 0x200);
+    cpu.write_mem16(0, 0x21 * 4 + 2, 0);
+    cpu.write_mem8(0, 0x200, 0xeb);
+    cpu.write_mem8(0, 0x201, 0xfe);
+    load({
+        0x90, // nop
+        0xfb, // sti
+        0x90, // nop
+        0x90, // nop
+        0x90, // nop
+    });
+    cpu.set_rtl_at(0, 0x101);
+
+    // Raised on the SoftwareCPU with interrupts disabled, so only taken
+    // after the switch.
+    cpu.raise_irq(0x21);
+    cpu.step();
+    ASSERT_FALSE(cpu.on_rtl());
+    ASSERT_EQ(0x101, cpu.read_reg(IP));
+
+    for (int i = 0; i < 4; ++i)
+        cpu.step();
+    ASSERT_TRUE(cpu.on_rtl());
+    ASSERT_EQ(0x200, cpu.read_reg(IP));
+}
@@ -17,17 +17,30 @@
 
 #pragma once
 
+#include <config.h>
 #include <verilated.h>
-#include <verilated_vcd_c.h>
 #include <verilated_cov.h>
+#include <verilated_save.h>
+#if S80X86_TRACE_FST
+#include <verilated_fst_c.h>
+#else
+#include <verilated_vcd_c.h>
+#endif
 
 #include <boost/algorithm/string/replace.hpp>
 #include <boost/format.hpp>
 #include <boost/type_index.hpp>
+#include <array>
+#include <cassert>
+#include <cstdlib>
 #include <functional>
-#include <map>
+#include <limits>
+#include <memory>
+#include <sstream>
+#include <thread>
 #include <vector>
 #include <errno.h>
+#include <stdexcept>
 
 #include <sys/stat.h>
 
@@ -43,14 +56,9 @@ enum PeriodicEventType {
     ClockSetup,
 };
 
-const int evals_per_cycle = 10;
-
 extern double sc_time_stamp();
 extern double cur_time_stamp;
 
-static_assert(evals_per_cycle % 2 == 0,
-              "evals_per_cycle must be divisible by 2");
-
 #ifdef DEBUG
 const bool verilator_debug_enabled = true;
 #else
@@ -63,6 +71,81 @@ const bool verilator_coverage_enabled = true;
 const bool verilator_coverage_enabled = false;
 #endif
 
+#if S80X86_TRACE_FST
+typedef VerilatedFstC WaveformTracer;
+const char *const waveform_suffix = "fst";
+#else
+typedef VerilatedVcdC WaveformTracer;
+const char *const waveform_suffix = "vcd";
+#endif
+
+const vluint64_t waveform_never = std::numeric_limits<vluint64_t>::max();
+const int waveform_max_depth = 99;
+
+inline bool &waveforms_enabled()
+{
+    static bool enabled = false;
+
+    return enabled;
+}
+
+// Turns on the activity tracking that lets a model start a waveform part way
+// through.  It costs every evaluation, so it is only enabled when a waveform
+// may be wanted, and must be called before the model is created: debug builds
+// and S80X86_WAVEFORM call it from the driver, the simulator for --waveform.
+inline void enable_waveforms()
+{
+    Verilated::traceEverOn(true);
+    waveforms_enabled() = true;
+}
+
+// A window of cycles to write a waveform for, from the S80X86_WAVEFORM
+// environment variable: a comma separated list of match=<instance name
+// substring>, start=<cycle>, stop=<cycle> and depth=<levels>, any of which
+// may be omitted.
+struct WaveformWindow {
+    WaveformWindow()
+        : match(),
+          start_cycle(0),
+          stop_cycle(waveform_never),
+          depth(waveform_max_depth)
+    {
+    }
+
+    explicit WaveformWindow(const std::string &spec) : WaveformWindow()
+    {
+        std::istringstream fields(spec);
+        std::string field;
+
+        while (std::getline(fields, field, ',')) {
+            auto eq = field.find('=');
+            auto key = field.substr(0, eq);
+            auto value = eq == std::string::npos ? "" : field.substr(eq + 1);
+
+            try {
+                if (key == "match")
+                    match = value;
+                else if (key == "start")
+                    start_cycle = std::stoull(value);
+                else if (key == "stop")
+                    stop_cycle = std::stoull(value);
+                else if (key == "depth")
+                    depth = std::stoi(value);
+                else if (!field.empty())
+                    throw std::invalid_argument(key);
+            } catch (std::logic_error &) {
+                throw std::invalid_argument("invalid waveform field \"" +
+                                            field + "\"");
+            }
+        }
+    }
+
+    std::string match;
+    vluint64_t start_cycle;
+    vluint64_t stop_cycle;
+    int depth;
+};
+
 template <typename T, bool debug_enabled = verilator_debug_enabled>
 class VerilogDriver
 {
@@ -72,19 +155,45 @@ public:
     VerilogDriver(const VerilogDriver &rhs) = delete;
     virtual ~VerilogDriver();
     void reset(int count = 2);
-    void after_n_cycles(vluint64_t delta, const std::function<void()> &cb)
+    // Deferred events must be due in fewer than max_deferred_delta cycles.
+    static const int max_deferred_delta = 64;
+    void after_n_cycles(vluint64_t delta, std::function<void()> cb)
     {
-        at_cycle(cycle_num + delta, cb);
+        at_cycle(cycle_num + delta, std::move(cb));
     }
     void periodic(PeriodicEventType edge_type, std::function<void()> fn)
     {
-        periodic_events[edge_type].push_back(fn);
+        auto &events = edge_type == ClockSetup ? setup_events : capture_events;
+        events.push_back(std::move(fn));
     }
     virtual void cycle(int count = 1);
     vluint64_t cur_cycle() const
     {
         return cycle_num;
     }
+    bool has_pending_events() const;
+    // Only for models verilated with --savable.  Deferred events can't be
+    // serialized so there must be none pending when saving, restoring
+    // discards any as they belong to the replaced state.  Periodic events
+    // are expected to have been registered by the constructor.
+    void save_model(VerilatedSerialize &os);
+    void restore_model(VerilatedDeserialize &is);
+
+    // Waveforms are written from now until stopped, or for the cycles in a
+    // window.  Depth limits the levels of hierarchy traced.  The default
+    // path is the instance name, suffixed with the start cycle if not 0.
+    // Debug builds trace every instance from the start.
+    void start_waveform(const std::string &path = "",
+                        int depth = waveform_max_depth);
+    void stop_waveform();
+    void waveform_window(vluint64_t start_cycle,
+                         vluint64_t stop_cycle,
+                         const std::string &path = "",
+                         int depth = waveform_max_depth);
+    bool waveform_active() const
+    {
+        return tracer != nullptr;
+    }
 
 protected:
     T dut;
@@ -92,17 +201,28 @@ protected:
 private:
     void at_cycle(vluint64_t cycle_num, std::function<void()> cb);
     void run_deferred_events();
-    void run_periodic_events(PeriodicEventType edge_type);
-    void setup_trace();
-    void teardown_trace();
-    VerilatedVcdC tracer;
+    void run_events(const std::vector<std::function<void()>> &events);
+    void update_waveform_window();
+    std::unique_ptr<WaveformTracer> tracer;
+    std::string waveform_path;
+    int waveform_depth;
+    vluint64_t waveform_start_cycle;
+    vluint64_t waveform_stop_cycle;
     vluint64_t cur_time;
     vluint64_t cycle_num;
 
-    static const int max_deferred_delta = 64;
-    std::vector<std::function<void()>> deferred_events[max_deferred_delta];
-    std::map<PeriodicEventType, std::vector<std::function<void()>>> periodic_events;
+    // A wheel of deferred events indexed by cycle number.  The due slot is
+    // swapped with running_events before being run so that neither vector
+    // gives up its storage and steady state scheduling does not allocate.
+    std::array<std::vector<std::function<void()>>, max_deferred_delta>
+        deferred_events;
+    std::vector<std::function<void()>> running_events;
+    std::vector<std::function<void()>> setup_events;
+    std::vector<std::function<void()>> capture_events;
     std::string instance_name;
+    // Multithreaded models evaluate on a pool of worker threads but the
+    // model, and the events here, are only safe to drive from one thread.
+    std::thread::id owner_thread;
 };
 template <typename T, bool debug_enabled>
 VerilogDriver<T, debug_enabled>::VerilogDriver()
@@ -113,60 +233,108 @@ VerilogDriver<T, debug_enabled>::VerilogDriver()
 
 template <typename T, bool debug_enabled>
 VerilogDriver<T, debug_enabled>::VerilogDriver(const std::string &instance_name)
-    : cycle_num(0), instance_name(instance_name)
+    : tracer(),
+      waveform_path(),
+      waveform_depth(waveform_max_depth),
+      waveform_start_cycle(waveform_never),
+      waveform_stop_cycle(waveform_never),
+      cycle_num(0),
+      instance_name(instance_name),
+      owner_thread(std::this_thread::get_id())
 {
     dut.reset = 0;
     dut.clk = 0;
     cur_time = 0;
     cur_time_stamp = 0;
+
+    auto spec = std::getenv("S80X86_WAVEFORM");
+    if (debug_enabled || spec)
+        enable_waveforms();
+
     if (debug_enabled)
-        setup_trace();
+        waveform_window(0, waveform_never);
+
+    if (spec) {
+        WaveformWindow window(spec);
+        if (instance_name.find(window.match) != std::string::npos)
+            waveform_window(window.start_cycle, window.stop_cycle, "",
+                            window.depth);
+    }
 }
 
 template <typename T, bool debug_enabled>
-struct tracer_impl {
-};
-
-template <typename T>
-struct tracer_impl<T, true> {
-    static void trace_dut(T *dut, VerilatedVcdC *tracer)
-    {
-        dut->trace(tracer, 99);
+void VerilogDriver<T, debug_enabled>::start_waveform(const std::string &path,
+                                                     int depth)
+{
+    stop_waveform();
+
+    if (!waveforms_enabled())
+        throw std::runtime_error("Failed to start waveform, waveforms must be "
+                                 "enabled before creating the model");
+
+    auto filename = path;
+    if (filename.empty()) {
+        filename = cycle_num == 0
+                       ? (boost::format("%s.%s") % instance_name %
+                          waveform_suffix).str()
+                       : (boost::format("%s-%lu.%s") % instance_name %
+                          cycle_num % waveform_suffix).str();
+        boost::replace_all(filename, "/", "_");
     }
-};
 
-template <typename T>
-struct tracer_impl<T, false> {
-    static void trace_dut(T *, VerilatedVcdC *)
-    {
+    tracer = std::make_unique<WaveformTracer>();
+    dut.trace(tracer.get(), depth);
+    tracer->open(filename.c_str());
+    if (!tracer->isOpen()) {
+        tracer.reset();
+        throw std::runtime_error("Failed to open waveform " + filename);
     }
-};
+}
 
 template <typename T, bool debug_enabled>
-void VerilogDriver<T, debug_enabled>::setup_trace()
+void VerilogDriver<T, debug_enabled>::stop_waveform()
 {
-    if (debug_enabled) {
-        Verilated::traceEverOn(true);
-        tracer_impl<T, debug_enabled>::trace_dut(&dut, &tracer);
+    if (!tracer)
+        return;
 
-        auto filename = (boost::format("%s.vcd") % instance_name).str();
-        boost::replace_all(filename, "/", "_");
-        tracer.open(filename.c_str());
+    tracer->close();
+    tracer.reset();
+}
+
+template <typename T, bool debug_enabled>
+void VerilogDriver<T, debug_enabled>::waveform_window(vluint64_t start_cycle,
+                                                      vluint64_t stop_cycle,
+                                                      const std::string &path,
+                                                      int depth)
+{
+    waveform_path = path;
+    waveform_depth = depth;
+    waveform_start_cycle = start_cycle;
+    waveform_stop_cycle = stop_cycle;
+
+    if (start_cycle <= cycle_num && cycle_num < stop_cycle) {
+        waveform_start_cycle = waveform_never;
+        start_waveform(path, depth);
     }
 }
 
 template <typename T, bool debug_enabled>
-void VerilogDriver<T, debug_enabled>::teardown_trace()
+void VerilogDriver<T, debug_enabled>::update_waveform_window()
 {
-    if (debug_enabled)
-        tracer.close();
+    if (cycle_num == waveform_start_cycle) {
+        waveform_start_cycle = waveform_never;
+        start_waveform(waveform_path, waveform_depth);
+    }
+    if (cycle_num == waveform_stop_cycle) {
+        waveform_stop_cycle = waveform_never;
+        stop_waveform();
+    }
 }
 
 template <typename T, bool debug_enabled>
 VerilogDriver<T, debug_enabled>::~VerilogDriver()
 {
-    if (debug_enabled)
-        teardown_trace();
+    stop_waveform();
 
     dut.final();
 
@@ -195,25 +363,30 @@ void VerilogDriver<T, debug_enabled>::reset(int count)
 template <typename T, bool debug_enabled>
 void VerilogDriver<T, debug_enabled>::cycle(int count)
 {
+    // None of the simulated designs have logic on the falling edge, so a
+    // cycle is two evaluations: the rising edge, then the falling edge which
+    // also settles any inputs changed by the deferred events before they
+    // are captured.
+    assert(std::this_thread::get_id() == owner_thread);
+
     for (int i = 0; i < count; ++i) {
-        for (auto j = 0; j < evals_per_cycle; ++j) {
-            if (debug_enabled)
-                tracer.dump(cur_time);
-            if (j == 0) {
-                run_periodic_events(ClockSetup);
-                dut.clk = !dut.clk;
-                dut.eval();
-                run_deferred_events();
-                dut.eval();
-                run_periodic_events(ClockCapture);
-            } else if (j == evals_per_cycle / 2) {
-                dut.clk = !dut.clk;
-                dut.eval();
-            } else {
-                dut.eval();
-            }
-            ++cur_time;
-        }
+        update_waveform_window();
+
+        run_events(setup_events);
+        dut.clk = 1;
+        dut.eval();
+        if (tracer)
+            tracer->dump(cur_time);
+        ++cur_time;
+
+        run_deferred_events();
+        dut.clk = 0;
+        dut.eval();
+        if (tracer)
+            tracer->dump(cur_time);
+        ++cur_time;
+
+        run_events(capture_events);
 
         ++cycle_num;
         ++cur_time_stamp;
@@ -221,21 +394,60 @@ void VerilogDriver<T, debug_enabled>::cycle(int count)
 }
 
 template <typename T, bool debug_enabled>
-void VerilogDriver<T, debug_enabled>::run_periodic_events(
-    PeriodicEventType edge_type)
+void VerilogDriver<T, debug_enabled>::run_events(
+    const std::vector<std::function<void()>> &events)
 {
-    for (auto &e : periodic_events[edge_type])
+    for (auto &e : events)
         e();
 }
 
 template <typename T, bool debug_enabled>
 void VerilogDriver<T, debug_enabled>::run_deferred_events()
 {
-    auto idx = cycle_num % max_deferred_delta;
-    auto events = deferred_events[idx];
-    deferred_events[idx].clear();
-    for (auto &e : events)
+    auto &due = deferred_events[cycle_num % max_deferred_delta];
+    if (due.empty())
+        return;
+
+    assert(running_events.empty());
+    // Events scheduled from a callback land in the now empty slot.
+    running_events.swap(due);
+    for (auto &e : running_events)
         e();
+    running_events.clear();
+}
+
+template <typename T, bool debug_enabled>
+bool VerilogDriver<T, debug_enabled>::has_pending_events() const
+{
+    for (auto &events : deferred_events)
+        if (!events.empty())
+            return true;
+
+    return false;
+}
+
+template <typename T, bool debug_enabled>
+void VerilogDriver<T, debug_enabled>::save_model(VerilatedSerialize &os)
+{
+    if (has_pending_events())
+        throw std::runtime_error("Failed to save model, events pending");
+
+    // The trace time isn't saved so that the VCD stays monotonic.
+    vluint64_t time_stamp = cur_time_stamp;
+    os << cycle_num << time_stamp;
+    os << dut;
+}
+
+template <typename T, bool debug_enabled>
+void VerilogDriver<T, debug_enabled>::restore_model(VerilatedDeserialize &is)
+{
+    for (auto &events : deferred_events)
+        events.clear();
+
+    vluint64_t time_stamp = 0;
+    is >> cycle_num >> time_stamp;
+    is >> dut;
+    cur_time_stamp = time_stamp;
 }
 
 template <typename T, bool debug_enabled>
@@ -245,7 +457,7 @@ void VerilogDriver<T, debug_enabled>::at_cycle(vluint64_t target_cycle_num,
     assert(target_cycle_num >= cycle_num);
     assert(target_cycle_num < cycle_num + max_deferred_delta);
 
-    auto target = (target_cycle_num + 0) % max_deferred_delta;
+    auto target = target_cycle_num % max_deferred_delta;
 
-    deferred_events[target].push_back(cb);
+    deferred_events[target].push_back(std::move(cb));
 }
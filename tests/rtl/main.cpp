@@ -15,18 +15,53 @@
 // You should have received a copy of the GNU General Public License
 // along with s80x86.  If not, see <http://www.gnu.org/licenses/>.
 
+#include <fcntl.h>
 #include <memory>
+#include <stdexcept>
+#include <stdlib.h>
 #include <string>
+#include <unistd.h>
 
+#include <boost/format.hpp>
+#include <config.h>
 #include <gtest/gtest.h>
 
 #include "RTLCPU.h"
 
+static bool check_backdoor = false;
+// Saved from the first CPU once it has been reset, later CPUs are cloned
+// from it rather than simulating the reset sequence.
+static std::string reset_image;
+
+// The image is written to a private directory and unlinked as soon as it is
+// open, later CPUs reopen it through the descriptor so nothing is left
+// behind however the tests exit.
+static std::string save_reset_image(RTLCPU<> *cpu)
+{
+    char dir[] = "/tmp/rtl-unittest-XXXXXX";
+    if (!mkdtemp(dir))
+        throw std::runtime_error("Failed to create reset image directory");
+
+    auto path = std::string(dir) + "/reset.vlt";
+    cpu->save_model(path);
+    auto fd = open(path.c_str(), O_RDONLY);
+    unlink(path.c_str());
+    rmdir(dir);
+    if (fd < 0)
+        throw std::runtime_error("Failed to open " + path);
+
+    return (boost::format("/proc/self/fd/%d") % fd).str();
+}
+
 std::unique_ptr<CPU> get_cpu(const std::string &test_name)
 {
-    auto cpu = std::make_unique<RTLCPU<>>(test_name);
+    auto cpu = std::make_unique<RTLCPU<>>(test_name, nullptr, reset_image);
 
     cpu->enable_cache();
+    cpu->set_backdoor_check(check_backdoor);
+
+    if (S80X86_RTL_SAVABLE && reset_image.empty())
+        reset_image = save_reset_image(cpu.get());
 
     return std::move(cpu);
 }
@@ -35,5 +70,10 @@ int main(int argc, char *argv[])
 {
     ::testing::InitGoogleTest(&argc, argv);
 
+    // Compare each backdoor memory access with the debug port.
+    for (int i = 1; i < argc; ++i)
+        if (std::string(argv[i]) == "--check-backdoor")
+            check_backdoor = true;
+
     return RUN_ALL_TESTS();
 }
@@ -0,0 +1,61 @@
+// Copyright Jamie Iles, 2017
+//
+// This file is part of s80x86.
+//
+// s80x86 is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// s80x86 is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with s80x86.  If not, see <http://www.gnu.org/licenses/>.
+
+#pragma once
+
+#include <stdexcept>
+#include <stdlib.h>
+#include <string>
+#include <unistd.h>
+
+// An empty, uniquely named file in /tmp, whatever is at the path is removed
+// when the TempFile is destroyed.
+class TempFile
+{
+public:
+    explicit TempFile(const std::string &name) : path(make_path(name))
+    {
+    }
+
+    ~TempFile()
+    {
+        unlink(path.c_str());
+    }
+
+    TempFile(const TempFile &) = delete;
+    TempFile &operator=(const TempFile &) = delete;
+
+    const std::string &get_path() const
+    {
+        return path;
+    }
+
+private:
+    static std::string make_path(const std::string &name)
+    {
+        std::string path = "/tmp/s80x86-" + name + "-XXXXXX";
+
+        auto fd = mkstemp(&path[0]);
+        if (fd < 0)
+            throw std::runtime_error("Failed to create temporary file");
+        close(fd);
+
+        return path;
+    }
+
+    std::string path;
+};
@@ -0,0 +1,130 @@
+// Copyright Jamie Iles, 2017
+//
+// This file is part of s80x86.
+//
+// s80x86 is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// s80x86 is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with s80x86.  If not, see <http://www.gnu.org/licenses/>.
+
+#include <gtest/gtest.h>
+
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "CacheModel.h"
+#include "MemoryTrace.h"
+#include "TempFile.h"
+
+TEST(CacheConfig, spec_overrides_defaults)
+{
+    CacheConfig config("size=16384,ways=2,policy=wt");
+
+    ASSERT_EQ(16384LU, config.size);
+    ASSERT_EQ(16U, config.line_size);
+    ASSERT_EQ(2U, config.ways);
+    ASSERT_FALSE(config.write_back);
+    ASSERT_EQ("16K/16B/2-way/wt", config.name());
+}
+
+TEST(CacheConfig, invalid_spec_throws)
+{
+    EXPECT_THROW(CacheConfig("size"), std::invalid_argument);
+    EXPECT_THROW(CacheConfig("assoc=2"), std::invalid_argument);
+    EXPECT_THROW(CacheConfig("size=3000"), std::invalid_argument);
+    EXPECT_THROW(CacheConfig("policy=wa"), std::invalid_argument);
+    EXPECT_THROW(CacheConfig("size=16,ways=4"), std::invalid_argument);
+}
+
+TEST(CacheModel, direct_mapped_conflict_writes_back_dirty_line)
+{
+    CacheModel cache(CacheConfig(), 4);
+
+    // Write allocate, then hit in the same line.
+    ASSERT_FALSE(cache.access(0x00100, true));
+    ASSERT_TRUE(cache.access(0x0010e, false));
+    // 8KB apart so the same line, the dirty line is written back.
+    ASSERT_FALSE(cache.access(0x02100, false));
+    ASSERT_FALSE(cache.access(0x00100, false));
+
+    auto &stats = cache.stats();
+    ASSERT_EQ(4LU, stats.accesses);
+    ASSERT_EQ(1LU, stats.hits);
+    ASSERT_EQ(3LU, stats.fills);
+    ASSERT_EQ(1LU, stats.writebacks);
+    ASSERT_EQ((3 + 1) * 8 * 4LU, stats.stall_cycles);
+}
+
+TEST(CacheModel, lru_replacement)
+{
+    CacheModel cache(CacheConfig("ways=2"), 4);
+
+    // Three lines in the same set of a 2-way 8KB cache, 4KB apart.
+    cache.access(0x0000, false);
+    cache.access(0x1000, false);
+    ASSERT_TRUE(cache.access(0x0000, false));
+    // Evicts 0x1000, the least recently used.
+    ASSERT_FALSE(cache.access(0x2000, false));
+    ASSERT_TRUE(cache.access(0x0000, false));
+    ASSERT_FALSE(cache.access(0x1000, false));
+}
+
+TEST(CacheModel, write_through_does_not_allocate)
+{
+    CacheModel cache(CacheConfig("policy=wt"), 4);
+
+    ASSERT_FALSE(cache.access(0x0100, true));
+    ASSERT_FALSE(cache.access(0x0100, false));
+    ASSERT_TRUE(cache.access(0x0100, true));
+
+    auto &stats = cache.stats();
+    ASSERT_EQ(1LU, stats.fills);
+    ASSERT_EQ(0LU, stats.writebacks);
+    ASSERT_EQ(2LU, stats.write_throughs);
+    ASSERT_EQ((8 + 2) * 4LU, stats.stall_cycles);
+}
+
+TEST(MemoryTrace, round_trip_splits_words_and_collapses_reads)
+{
+    TempFile file("memtrace");
+    auto path = file.get_path();
+
+    {
+        MemoryTraceWriter writer(path, true);
+        // An unaligned word spans two bus words.
+        writer.access(0x00101, 2, false, 0);
+        // Already read.
+        writer.access(0x00102, 1, false, 0);
+        writer.access(0x00102, 1, true, 0);
+        writer.access(0x00200, 4, true, 0);
+        ASSERT_EQ(5LU, writer.references_written());
+    }
+
+    MemoryTraceReader reader(path);
+    std::vector<MemoryReference> refs;
+    MemoryReference ref;
+    while (reader.next(&ref))
+        refs.push_back(ref);
+
+    ASSERT_EQ(5LU, refs.size());
+    EXPECT_EQ(0x00100U, refs[0].addr);
+    EXPECT_EQ(0x2, refs[0].bytesel);
+    EXPECT_FALSE(refs[0].write);
+    EXPECT_EQ(0x00102U, refs[1].addr);
+    EXPECT_EQ(0x1, refs[1].bytesel);
+    EXPECT_EQ(0x00102U, refs[2].addr);
+    EXPECT_TRUE(refs[2].write);
+    EXPECT_EQ(0x00200U, refs[3].addr);
+    EXPECT_EQ(0x3, refs[3].bytesel);
+    EXPECT_EQ(0x00202U, refs[4].addr);
+    EXPECT_EQ(0x3, refs[4].bytesel);
+}
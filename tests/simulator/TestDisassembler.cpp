@@ -0,0 +1,82 @@
+// Copyright Jamie Iles, 2017
+//
+// This file is part of s80x86.
+//
+// s80x86 is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// s80x86 is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with s80x86.  If not, see <http://www.gnu.org/licenses/>.
+
+#include <gtest/gtest.h>
+
+#include <string>
+#include <vector>
+
+#include "Disassembler.h"
+
+struct DisassemblyTest {
+    std::vector<uint8_t> bytes;
+    uint16_t ip;
+    size_t length;
+    const char *text;
+};
+
+class DisassemblerTestFixture
+    : public ::testing::TestWithParam<DisassemblyTest>
+{
+};
+
+TEST_P(DisassemblerTestFixture, disassemble)
+{
+    auto p = GetParam();
+    std::string text;
+
+    auto length = disassemble(p.bytes.data(), p.bytes.size(), p.ip, &text);
+
+    ASSERT_EQ(p.length, length);
+    ASSERT_EQ(p.text, text);
+}
+
+INSTANTIATE_TEST_CASE_P(
+    Disassembler,
+    DisassemblerTestFixture,
+    ::testing::Values(
+        DisassemblyTest{{0x90}, 0, 1, "nop"},
+        DisassemblyTest{{0x01, 0xd8}, 0, 2, "add ax, bx"},
+        DisassemblyTest{{0x88, 0x47, 0xfe}, 0, 3, "mov byte [bx-0x2], al"},
+        DisassemblyTest{{0x8b, 0x86, 0x34, 0x12},
+                        0,
+                        4,
+                        "mov ax, word [bp+0x1234]"},
+        DisassemblyTest{{0x26, 0xa1, 0x10, 0x00},
+                        0,
+                        4,
+                        "mov ax, word [es:0x10]"},
+        DisassemblyTest{{0xf3, 0xa4}, 0, 2, "rep movsb"},
+        DisassemblyTest{{0x2e, 0xac}, 0, 2, "cs lodsb"},
+        DisassemblyTest{{0x83, 0xe8, 0xff}, 0, 3, "sub ax, -0x1"},
+        DisassemblyTest{{0xc1, 0xe0, 0x04}, 0, 3, "shl ax, 0x4"},
+        DisassemblyTest{{0xf7, 0x06, 0x00, 0x10, 0x01, 0x00},
+                        0,
+                        6,
+                        "test word [0x1000], 0x1"},
+        DisassemblyTest{{0xff, 0x1f}, 0, 2, "call far [bx]"},
+        DisassemblyTest{{0x75, 0xfe}, 0x100, 2, "jnz 0x100"},
+        DisassemblyTest{{0xe8, 0x00, 0x01}, 0xff00, 3, "call 0x3"},
+        DisassemblyTest{{0xea, 0x5b, 0xe0, 0x00, 0xf0},
+                        0,
+                        5,
+                        "jmp 0xf000:0xe05b"},
+        DisassemblyTest{{0xc8, 0x08, 0x00, 0x01}, 0, 4, "enter 0x8, 0x1"},
+        DisassemblyTest{{0x0f}, 0, 1, "db 0xf"},
+        DisassemblyTest{{0xfe, 0x38}, 0, 1, "db 0xfe"},
+        DisassemblyTest{{0x8d, 0xc0}, 0, 1, "db 0x8d"},
+        DisassemblyTest{{0xb8, 0x34}, 0, 1, "db 0xb8"}));
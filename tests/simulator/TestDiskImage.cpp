@@ -0,0 +1,149 @@
+// Copyright Jamie Iles, 2017
+//
+// This file is part of s80x86.
+//
+// s80x86 is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// s80x86 is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with s80x86.  If not, see <http://www.gnu.org/licenses/>.
+
+#include <gtest/gtest.h>
+
+#include <cstdio>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <unistd.h>
+
+#include "DiskImage.h"
+#include "TempFile.h"
+
+class OverlayTestFixture : public ::testing::Test
+{
+public:
+    OverlayTestFixture()
+        : base_file("disk"),
+          delta_file("disk"),
+          base_path(base_file.get_path()),
+          delta_path(delta_file.get_path())
+    {
+        std::ofstream base(base_path, std::ios::binary);
+        for (unsigned m = 0; m < 4 * DiskImage::block_size; ++m)
+            base.put(static_cast<char>(m / DiskImage::block_size));
+        unlink(delta_path.c_str());
+    }
+
+    std::vector<uint8_t> read_base() const
+    {
+        std::ifstream base(base_path, std::ios::binary);
+        return std::vector<uint8_t>(std::istreambuf_iterator<char>(base),
+                                    std::istreambuf_iterator<char>());
+    }
+
+protected:
+    TempFile base_file;
+    TempFile delta_file;
+    std::string base_path;
+    std::string delta_path;
+};
+
+TEST_F(OverlayTestFixture, reads_pass_through_to_base)
+{
+    OverlayDiskImage disk(base_path, "");
+    uint8_t v[DiskImage::block_size];
+
+    disk.read(2 * DiskImage::block_size, v, sizeof(v));
+
+    ASSERT_EQ(2, v[0]);
+    ASSERT_EQ(2, v[DiskImage::block_size - 1]);
+}
+
+TEST_F(OverlayTestFixture, writes_do_not_modify_base)
+{
+    auto before = read_base();
+    {
+        OverlayDiskImage disk(base_path, delta_path);
+        std::vector<uint8_t> v(DiskImage::block_size, 0xaa);
+
+        disk.write(DiskImage::block_size, v.data(), v.size());
+    }
+
+    ASSERT_EQ(before, read_base());
+}
+
+TEST_F(OverlayTestFixture, partial_block_write_merges_with_base)
+{
+    OverlayDiskImage disk(base_path, "");
+    const uint8_t v[] = {0xaa, 0xbb};
+    uint8_t r[4];
+
+    disk.write(DiskImage::block_size + 1, v, sizeof(v));
+    disk.read(DiskImage::block_size, r, sizeof(r));
+
+    ASSERT_EQ(1, r[0]);
+    ASSERT_EQ(0xaa, r[1]);
+    ASSERT_EQ(0xbb, r[2]);
+    ASSERT_EQ(1, r[3]);
+}
+
+TEST_F(OverlayTestFixture, delta_persists)
+{
+    std::vector<uint8_t> v(DiskImage::block_size, 0x55);
+    {
+        OverlayDiskImage disk(base_path, delta_path);
+        disk.write(3 * DiskImage::block_size, v.data(), v.size());
+    }
+
+    OverlayDiskImage disk(base_path, delta_path);
+    std::vector<uint8_t> r(DiskImage::block_size);
+    disk.read(3 * DiskImage::block_size, r.data(), r.size());
+
+    ASSERT_EQ(v, r);
+    ASSERT_EQ(1LU, disk.saved_blocks().size());
+}
+
+TEST_F(OverlayTestFixture, volatile_overlay_discards_writes)
+{
+    std::vector<uint8_t> v(DiskImage::block_size, 0x55);
+    {
+        OverlayDiskImage disk(base_path, "");
+        disk.write(0, v.data(), v.size());
+    }
+
+    OverlayDiskImage disk(base_path, "");
+    uint8_t r;
+    disk.read(0, &r, 1);
+
+    ASSERT_EQ(0, r);
+}
+
+TEST_F(OverlayTestFixture, restore_replaces_delta)
+{
+    std::vector<uint8_t> v(DiskImage::block_size, 0x55);
+    DiskImage::BlockMap saved;
+    {
+        OverlayDiskImage disk(base_path, delta_path);
+        disk.write(0, v.data(), v.size());
+        saved = disk.saved_blocks();
+
+        disk.write(DiskImage::block_size, v.data(), v.size());
+        disk.restore_blocks(saved);
+    }
+
+    OverlayDiskImage disk(base_path, delta_path);
+    uint8_t r[2];
+    disk.read(0, &r[0], 1);
+    disk.read(DiskImage::block_size, &r[1], 1);
+
+    ASSERT_EQ(0x55, r[0]);
+    ASSERT_EQ(1, r[1]);
+    ASSERT_EQ(saved, disk.saved_blocks());
+}
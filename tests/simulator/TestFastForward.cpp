@@ -0,0 +1,172 @@
+// Copyright Jamie Iles, 2017
+//
+// This file is part of s80x86.
+//
+// s80x86 is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// s80x86 is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with s80x86.  If not, see <http://www.gnu.org/licenses/>.
+
+#include <gtest/gtest.h>
+
+#include <climits>
+#include <initializer_list>
+
+#include "SoftwareCPU.h"
+
+class FakePort : public IOPorts
+{
+public:
+    explicit FakePort(bool is_volatile)
+        : IOPorts(0x10, 1), is_volatile(is_volatile)
+    {
+    }
+
+    uint8_t read8(uint16_t __unused port_num, unsigned __unused offs)
+    {
+        return 0;
+    }
+
+    void write8(uint16_t __unused port_num,
+                unsigned __unused offs,
+                uint8_t __unused v)
+    {
+    }
+
+    bool read_is_volatile(uint16_t __unused port_num,
+                          unsigned __unused offs) const
+    {
+        return is_volatile;
+    }
+
+private:
+    bool is_volatile;
+};
+
+// An event at event_cycle sets the flag at 0000:0500 that the loops poll.
+class FastForwardTestFixture : public ::testing::Test
+{
+public:
+    FastForwardTestFixture()
+        : cpu("fastforward"), event_cycle(1000), event_fired(false)
+    {
+        cpu.write_mem8(0, 0x500, 0);
+        cpu.write_reg(CS, 0);
+        cpu.write_reg(IP, 0x100);
+    }
+
+    void load(std::initializer_list<uint8_t> code)
+    {
+        uint16_t addr = 0x100;
+        for (auto b : code)
+            cpu.write_mem8(0, addr++, b);
+    }
+
+    void enable_fast_forward()
+    {
+        cpu.set_fast_forward(
+            [this] { return event_fired ? ULONG_MAX : event_cycle; });
+    }
+
+    // Returns the number of instructions executed before IP reaches end.
+    unsigned long run_until(uint16_t end, unsigned long max_steps)
+    {
+        auto io_callback = [this](unsigned long cycle_num) {
+            if (cycle_num >= event_cycle && !event_fired) {
+                cpu.write_mem8(0, 0x500, 1);
+                event_fired = true;
+            }
+        };
+
+        unsigned long steps = 0;
+        while (cpu.read_reg(IP) != end && steps < max_steps) {
+            cpu.step_with_io(io_callback);
+            ++steps;
+        }
+
+        return steps;
+    }
+
+protected:
+    SoftwareCPU cpu;
+    unsigned long event_cycle;
+    bool event_fired;
+};
+
+// mov al, [0x500]; test al, al; jz -7
+static const std::initializer_list<uint8_t> poll_memory = {
+    0xa0, 0x00, 0x05, 0x84, 0xc0, 0x74, 0xf9,
+};
+
+TEST_F(FastForwardTestFixture, MemoryPollSkipsToEvent)
+{
+    load(poll_memory);
+    enable_fast_forward();
+
+    auto steps = run_until(0x107, 1000);
+
+    ASSERT_EQ(0x107, cpu.read_reg(IP));
+    ASSERT_LT(steps, 20LU);
+    // The event fires before the load, then the test and the exit branch.
+    ASSERT_EQ(event_cycle + 2, cpu.cycle_count());
+    ASSERT_EQ(cpu.cycle_count() - steps, cpu.fast_forwarded_cycles());
+}
+
+TEST_F(FastForwardTestFixture, DisabledExecutesEveryIteration)
+{
+    load(poll_memory);
+
+    auto steps = run_until(0x107, 2000);
+
+    ASSERT_EQ(0x107, cpu.read_reg(IP));
+    ASSERT_EQ(cpu.cycle_count(), steps);
+    ASSERT_EQ(0LU, cpu.fast_forwarded_cycles());
+}
+
+TEST_F(FastForwardTestFixture, CountdownNotSkipped)
+{
+    // loop $
+    load({0xe2, 0xfe});
+    cpu.write_reg(CX, 0x100);
+    enable_fast_forward();
+
+    auto steps = run_until(0x102, 1000);
+
+    ASSERT_EQ(0x100LU, steps);
+    ASSERT_EQ(0LU, cpu.fast_forwarded_cycles());
+}
+
+TEST_F(FastForwardTestFixture, VolatilePortPollNotSkipped)
+{
+    FakePort port(true);
+    cpu.add_ioport(&port);
+    // in al, 0x10; test al, al; jz -6
+    load({0xe4, 0x10, 0x84, 0xc0, 0x74, 0xfa});
+    enable_fast_forward();
+
+    run_until(0x106, 100);
+
+    ASSERT_EQ(100LU, cpu.cycle_count());
+    ASSERT_EQ(0LU, cpu.fast_forwarded_cycles());
+}
+
+TEST_F(FastForwardTestFixture, StablePortPollSkipped)
+{
+    FakePort port(false);
+    cpu.add_ioport(&port);
+    // in al, 0x10; test al, al; jz -6
+    load({0xe4, 0x10, 0x84, 0xc0, 0x74, 0xfa});
+    enable_fast_forward();
+
+    run_until(0x106, 100);
+
+    ASSERT_NE(0LU, cpu.fast_forwarded_cycles());
+}
@@ -62,3 +62,86 @@ TEST(Fifo, push_pop_in_order)
     for (int i = 0; i < 3; ++i)
         ASSERT_EQ(i, f.pop());
 }
+
+TEST(Fifo, wraps_around)
+{
+    Fifo<int> f(3);
+
+    for (int i = 0; i < 10; ++i) {
+        f.push(i);
+        ASSERT_EQ(i, f.pop());
+    }
+    ASSERT_TRUE(f.empty());
+}
+
+TEST(Fifo, block_push_wraps)
+{
+    Fifo<int> f(4);
+    const int v[] = {2, 3, 4};
+
+    f.push(0);
+    f.push(1);
+    ASSERT_EQ(0, f.pop());
+    ASSERT_EQ(1, f.pop());
+
+    f.push(v, 3);
+    ASSERT_EQ(3LU, f.size());
+    for (int i = 2; i < 5; ++i)
+        ASSERT_EQ(i, f.pop());
+}
+
+TEST(Fifo, block_push_overflow_throws)
+{
+    Fifo<int> f(2);
+    const int v[] = {1, 2, 3};
+
+    ASSERT_THROW(f.push(v, 3), std::overflow_error);
+    ASSERT_TRUE(f.empty());
+}
+
+TEST(Fifo, reserve_commit_wraps)
+{
+    Fifo<int> f(4);
+
+    f.push(0);
+    f.push(1);
+    f.push(2);
+    ASSERT_EQ(0, f.pop());
+    ASSERT_EQ(1, f.pop());
+
+    auto spans = f.reserve(3);
+    ASSERT_EQ(1LU, spans.first.len);
+    ASSERT_EQ(2LU, spans.second.len);
+    ASSERT_EQ(1LU, f.size());
+
+    spans.first.data[0] = 3;
+    spans.second.data[0] = 4;
+    spans.second.data[1] = 5;
+    f.commit(3);
+
+    ASSERT_TRUE(f.is_full());
+    for (int i = 2; i < 6; ++i)
+        ASSERT_EQ(i, f.pop());
+}
+
+TEST(Fifo, reserve_overflow_throws)
+{
+    Fifo<int> f(2);
+
+    f.push(1);
+    ASSERT_THROW(f.reserve(2), std::overflow_error);
+    ASSERT_THROW(f.commit(2), std::overflow_error);
+    ASSERT_EQ(1LU, f.size());
+}
+
+TEST(Fifo, clear_empties)
+{
+    Fifo<int> f(2);
+
+    f.push(1);
+    f.push(2);
+    f.clear();
+
+    ASSERT_TRUE(f.empty());
+    ASSERT_THROW(f.pop(), std::underflow_error);
+}
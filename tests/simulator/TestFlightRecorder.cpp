@@ -0,0 +1,105 @@
+// Copyright Jamie Iles, 2017
+//
+// This file is part of s80x86.
+//
+// s80x86 is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// s80x86 is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with s80x86.  If not, see <http://www.gnu.org/licenses/>.
+
+#include <gtest/gtest.h>
+
+#include <initializer_list>
+#include <sstream>
+#include <string>
+
+#include "FlightRecorder.h"
+#include "SoftwareCPU.h"
+
+class FlightRecorderTestFixture : public ::testing::Test
+{
+public:
+    FlightRecorderTestFixture() : cpu("flightrecorder")
+    {
+        cpu.write_reg(CS, 0);
+        cpu.write_reg(IP, 0x100);
+    }
+
+    void load(std::initializer_list<uint8_t> code)
+    {
+        uint16_t addr = 0x100;
+        for (auto b : code)
+            cpu.write_mem8(0, addr++, b);
+    }
+
+    void run(FlightRecorder *recorder, unsigned num_instructions)
+    {
+        for (unsigned m = 0; m < num_instructions; ++m) {
+            auto cs = cpu.read_reg(CS);
+            auto ip = cpu.read_reg(IP);
+            recorder->record(cs, ip, cpu.step());
+        }
+    }
+
+    std::string dump(const FlightRecorder &recorder)
+    {
+        std::ostringstream out;
+        recorder.dump(out, "test");
+        return out.str();
+    }
+
+protected:
+    SoftwareCPU cpu;
+};
+
+TEST_F(FlightRecorderTestFixture, listing_with_registers)
+{
+    FlightRecorder recorder(&cpu, 16, true);
+    load({0xb8, 0x01, 0x00, 0x40, 0x90});
+
+    run(&recorder, 3);
+
+    auto listing = dump(recorder);
+    EXPECT_NE(std::string::npos,
+              listing.find("test, last 3 of 3 instructions"));
+    EXPECT_NE(std::string::npos, listing.find("[0000:0100] b8 01 00"));
+    EXPECT_NE(std::string::npos, listing.find("mov ax, 0x1"));
+    EXPECT_NE(std::string::npos, listing.find("inc ax  ; ax=0002"));
+    EXPECT_NE(std::string::npos, listing.find("[0000:0104] 90"));
+}
+
+TEST_F(FlightRecorderTestFixture, ring_keeps_most_recent)
+{
+    FlightRecorder recorder(&cpu, 3, false);
+    load({0x90, 0x90, 0x90, 0x90, 0x90, 0x90, 0x90, 0x90, 0x90, 0x90});
+
+    run(&recorder, 10);
+
+    // Rounded up to 4 entries.
+    auto listing = dump(recorder);
+    EXPECT_NE(std::string::npos,
+              listing.find("test, last 4 of 10 instructions"));
+    EXPECT_EQ(std::string::npos, listing.find("[0000:0105]"));
+    EXPECT_NE(std::string::npos, listing.find("[0000:0106]"));
+    EXPECT_NE(std::string::npos, listing.find("[0000:0109]"));
+}
+
+TEST_F(FlightRecorderTestFixture, invalid_opcode_handler_called)
+{
+    bool called = false;
+    cpu.set_invalid_opcode_handler([&called] { called = true; });
+    load({0x90, 0x0f});
+
+    cpu.step();
+    ASSERT_FALSE(called);
+    cpu.step();
+    ASSERT_TRUE(called);
+}
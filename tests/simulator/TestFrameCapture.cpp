@@ -0,0 +1,111 @@
+// Copyright Jamie Iles, 2017
+//
+// This file is part of s80x86.
+//
+// s80x86 is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// s80x86 is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with s80x86.  If not, see <http://www.gnu.org/licenses/>.
+
+#include <gtest/gtest.h>
+
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <unistd.h>
+#include <vector>
+
+#include "FrameCapture.h"
+#include "TempFile.h"
+
+static const unsigned width = 4;
+static const unsigned height = 2;
+
+static std::vector<uint8_t> frame(uint8_t v)
+{
+    return std::vector<uint8_t>(width * height * 3, v);
+}
+
+static std::string read_file(const std::string &path)
+{
+    std::ifstream f(path, std::ios::binary);
+
+    return std::string(std::istreambuf_iterator<char>(f),
+                       std::istreambuf_iterator<char>());
+}
+
+static size_t count_frames(const std::string &y4m)
+{
+    size_t count = 0;
+
+    for (auto pos = y4m.find("FRAME "); pos != std::string::npos;
+         pos = y4m.find("FRAME ", pos + 1))
+        ++count;
+
+    return count;
+}
+
+TEST(FrameCapture, y4m_drops_consecutive_duplicates)
+{
+    TempFile file("capture");
+    FrameCapture capture(file.get_path(), CAPTURE_Y4M, width, height);
+
+    capture.submit(10, frame(0x00));
+    capture.submit(20, frame(0x00));
+    capture.submit(30, frame(0xff));
+    capture.submit(40, frame(0x00));
+    capture.finish();
+
+    ASSERT_EQ(3LU, capture.frames_written());
+    ASSERT_EQ(1LU, capture.frames_dropped());
+
+    auto y4m = read_file(file.get_path());
+    ASSERT_EQ(3LU, count_frames(y4m));
+    ASSERT_NE(std::string::npos, y4m.find("FRAME Xcycle=10\n"));
+    ASSERT_EQ(std::string::npos, y4m.find("FRAME Xcycle=20\n"));
+    ASSERT_NE(std::string::npos, y4m.find("FRAME Xcycle=40\n"));
+}
+
+TEST(FrameCapture, ppm_written_per_frame)
+{
+    TempFile file("capture");
+    auto ppm_path = file.get_path() + "-000000000010.ppm";
+
+    {
+        FrameCapture capture(file.get_path(), CAPTURE_PPM, width, height);
+        capture.submit(10, frame(0x80));
+        capture.finish();
+
+        ASSERT_EQ(1LU, capture.frames_written());
+    }
+
+    auto ppm = read_file(ppm_path);
+    unlink(ppm_path.c_str());
+
+    ASSERT_EQ("P6\n4 2\n255\n" + std::string(width * height * 3, '\x80'), ppm);
+}
+
+TEST(FrameCapture, every_frame_accounted_for_under_backpressure)
+{
+    TempFile file("capture");
+    FrameCapture capture(file.get_path(), CAPTURE_Y4M, width, height);
+
+    // Far more frames than the worker queues, submit blocks until there is
+    // room so none are lost, only the duplicate of each pair is dropped.
+    const unsigned num_frames = 512;
+    for (unsigned m = 0; m < num_frames; ++m)
+        capture.submit(m, frame(m / 2));
+    capture.finish();
+
+    ASSERT_EQ(num_frames / 2, capture.frames_written());
+    ASSERT_EQ(num_frames / 2, capture.frames_dropped());
+    ASSERT_EQ(num_frames / 2, count_frames(read_file(file.get_path())));
+}
@@ -0,0 +1,70 @@
+// Copyright Jamie Iles, 2017
+//
+// This file is part of s80x86.
+//
+// s80x86 is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// s80x86 is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with s80x86.  If not, see <http://www.gnu.org/licenses/>.
+
+#include <gtest/gtest.h>
+
+#include <chrono>
+#include <thread>
+
+#include "Governor.h"
+
+typedef std::chrono::steady_clock Clock;
+
+static long elapsed_ms(Clock::time_point start)
+{
+    return std::chrono::duration_cast<std::chrono::milliseconds>(Clock::now() -
+                                                                 start)
+        .count();
+}
+
+TEST(Governor, SleepsUntilGuestTime)
+{
+    // 1 cycle per ms.
+    Governor governor(1000, false);
+
+    governor.pace(0);
+    auto start = Clock::now();
+    governor.pace(20);
+    governor.pace(40);
+
+    ASSERT_GE(elapsed_ms(start), 39);
+}
+
+TEST(Governor, TurboIsUnthrottled)
+{
+    Governor governor(1000, true);
+
+    auto start = Clock::now();
+    governor.pace(0);
+    governor.pace(1000);
+
+    ASSERT_LT(elapsed_ms(start), 500);
+}
+
+TEST(Governor, DoesNotCatchUpAfterStall)
+{
+    Governor governor(1000, false);
+
+    governor.pace(0);
+    std::this_thread::sleep_for(std::chrono::milliseconds(150));
+    // Behind by more than the maximum lag, the origin moves to now.
+    governor.pace(1);
+
+    auto start = Clock::now();
+    governor.pace(21);
+    ASSERT_GE(elapsed_ms(start), 19);
+}
@@ -0,0 +1,102 @@
+// Copyright Jamie Iles, 2017
+//
+// This file is part of s80x86.
+//
+// s80x86 is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// s80x86 is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with s80x86.  If not, see <http://www.gnu.org/licenses/>.
+
+#include <gtest/gtest.h>
+
+#include <chrono>
+#include <thread>
+#include <unistd.h>
+
+#include "InputThread.h"
+
+class PipeSerialBackend : public SerialBackend
+{
+public:
+    PipeSerialBackend() : fds()
+    {
+        if (pipe(fds))
+            throw std::runtime_error("Failed to create pipe");
+    }
+
+    ~PipeSerialBackend()
+    {
+        close(fds[0]);
+        close(fds[1]);
+    }
+
+    size_t read(uint8_t *buf, size_t len)
+    {
+        auto rc = ::read(fds[0], buf, len);
+
+        return rc > 0 ? rc : 0;
+    }
+
+    void write(const uint8_t * /* buf */, size_t /* len */)
+    {
+    }
+
+    int poll_fd()
+    {
+        return fds[0];
+    }
+
+    void send(const std::string &s)
+    {
+        ASSERT_EQ(static_cast<ssize_t>(s.size()),
+                  ::write(fds[1], s.data(), s.size()));
+    }
+
+private:
+    int fds[2];
+};
+
+static std::string receive(SPSCQueue<uint8_t> *q, size_t len)
+{
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(2);
+    std::string received;
+
+    while (received.size() < len &&
+           std::chrono::steady_clock::now() < deadline) {
+        uint8_t v;
+        if (q->pop(v))
+            received.push_back(v);
+        else
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+
+    return received;
+}
+
+TEST(InputThread, ForwardsSerialInput)
+{
+    PipeSerialBackend backend;
+    SPSCQueue<uint8_t> q(16);
+    InputThread input_thread(&backend, &q);
+
+    backend.send("hello");
+    ASSERT_EQ("hello", receive(&q, 5));
+}
+
+TEST(InputThread, WaitsForQueueSpace)
+{
+    PipeSerialBackend backend;
+    SPSCQueue<uint8_t> q(4);
+    InputThread input_thread(&backend, &q);
+
+    backend.send("abcdefghij");
+    ASSERT_EQ("abcdefghij", receive(&q, 10));
+}
@@ -0,0 +1,92 @@
+// Copyright Jamie Iles, 2017
+//
+// This file is part of s80x86.
+//
+// s80x86 is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// s80x86 is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with s80x86.  If not, see <http://www.gnu.org/licenses/>.
+
+#include <gtest/gtest.h>
+
+#include <sstream>
+#include <string>
+
+#include "InstructionStats.h"
+
+static std::string to_json(const InstructionStats &stats)
+{
+    std::ostringstream out;
+    stats.write_json(out);
+    return out.str();
+}
+
+static bool contains(const std::string &s, const std::string &substr)
+{
+    return s.find(substr) != std::string::npos;
+}
+
+TEST(InstructionStats, counts_opcodes_and_prefixes)
+{
+    InstructionStats stats;
+
+    stats.prefix(0xf3);
+    stats.prefix(0x26);
+    stats.instruction(0xa4, false);
+    stats.instruction(0x90, false);
+    stats.instruction(0x90, false);
+
+    auto json = to_json(stats);
+
+    EXPECT_TRUE(contains(json, "\"instructions\": 3,"));
+    EXPECT_TRUE(contains(json, "\"0x90\": 2"));
+    EXPECT_TRUE(contains(json, "\"0xa4\": 1"));
+    EXPECT_TRUE(contains(json, "\"none\": 2"));
+    EXPECT_TRUE(contains(json, "\"es+rep\": 1"));
+}
+
+TEST(InstructionStats, group_sub_opcodes_and_modes)
+{
+    InstructionStats stats;
+
+    stats.instruction(0xff, false);
+    stats.modrm(0xff, 3, 6, 0);
+    stats.instruction(0x8b, false);
+    stats.modrm(0x8b, 1, 2, 6);
+
+    auto json = to_json(stats);
+
+    EXPECT_TRUE(contains(json, "\"0xff\": [0, 0, 0, 0, 0, 0, 1, 0]"));
+    EXPECT_FALSE(contains(json, "\"0x8b\": [0, 0, 0, 0, 0, 0, 0, 0]"));
+    EXPECT_TRUE(contains(json, "\"0x8b\": [0, 1, 0, 0]"));
+    // Register direct with rm 0 is the last addressing row.
+    EXPECT_TRUE(contains(json, "[1, 0, 0, 0, 0, 0, 0, 0]\n  ]"));
+}
+
+TEST(InstructionStats, rep_iterations_and_branches)
+{
+    InstructionStats stats;
+
+    stats.instruction(0xa4, false);
+    stats.rep(0xa4, 0);
+    stats.instruction(0xa4, false);
+    stats.rep(0xa4, 5);
+    stats.instruction(0x74, true);
+    stats.instruction(0x74, false);
+    stats.instruction(0x74, true);
+
+    auto json = to_json(stats);
+
+    EXPECT_TRUE(contains(json, "\"0xa4\": {\"instructions\": 2, "
+                               "\"iterations\": 5, \"log2_histogram\": "
+                               "[1, 0, 0, 1, 0"));
+    EXPECT_TRUE(contains(json, "\"0x74\": {\"taken\": 2, \"not_taken\": 1}"));
+}
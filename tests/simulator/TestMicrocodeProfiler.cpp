@@ -0,0 +1,82 @@
+// Copyright Jamie Iles, 2017
+//
+// This file is part of s80x86.
+//
+// s80x86 is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// s80x86 is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with s80x86.  If not, see <http://www.gnu.org/licenses/>.
+
+#include <gtest/gtest.h>
+
+#include <sstream>
+#include <string>
+
+#include "MicrocodeProfiler.h"
+
+TEST(MicrocodeProfiler, dispatch_counted_against_next_instruction)
+{
+    MicrocodeProfiler profiler(0x200);
+
+    // Waiting on the prefetch queue, then a two cycle instruction.
+    profiler.add_sample(0x100, 0x90, 0, false);
+    profiler.add_sample(0x100, 0x90, 0, true);
+    profiler.add_sample(0x40, 0x40, 0, false);
+    profiler.add_sample(0x180, 0x40, 0, false);
+
+    std::ostringstream out;
+    profiler.write(out);
+
+    ASSERT_EQ("address 040 1 0 0 0\n"
+              "address 100 2 0 0 2\n"
+              "address 180 1 0 0 0\n"
+              "opcode 40 1 4 0 0 2\n",
+              out.str());
+    ASSERT_EQ(4LU, profiler.num_cycles());
+    ASSERT_EQ(1LU, profiler.num_instructions());
+}
+
+TEST(MicrocodeProfiler, stalls_counted_by_unit)
+{
+    MicrocodeProfiler profiler(0x200);
+
+    profiler.add_sample(0x100, 0x00, 0, true);
+    profiler.add_sample(0xf6, 0xf6, 0, false);
+    profiler.add_sample(0x150, 0xf6, MicrocodeProfiler::divide_busy, false);
+    profiler.add_sample(0x150, 0xf6, MicrocodeProfiler::divide_busy, false);
+    profiler.add_sample(0x151, 0xf6,
+                        MicrocodeProfiler::loadstore_busy |
+                            MicrocodeProfiler::divide_busy,
+                        false);
+
+    std::ostringstream out;
+    profiler.write(out);
+
+    ASSERT_EQ("address 0f6 1 0 0 0\n"
+              "address 100 1 0 0 1\n"
+              "address 150 2 0 2 0\n"
+              "address 151 1 1 0 0\n"
+              "opcode f6 1 5 1 2 1\n",
+              out.str());
+}
+
+TEST(MicrocodeProfiler, debug_wait_not_counted)
+{
+    MicrocodeProfiler profiler(0x200);
+
+    profiler.add_sample(MicrocodeProfiler::debug_wait_address, 0x90, 0, false);
+
+    std::ostringstream out;
+    profiler.write(out);
+
+    ASSERT_EQ("", out.str());
+    ASSERT_EQ(0LU, profiler.num_cycles());
+}
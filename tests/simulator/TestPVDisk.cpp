@@ -0,0 +1,130 @@
+// Copyright Jamie Iles, 2017
+//
+// This file is part of s80x86.
+//
+// s80x86 is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// s80x86 is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with s80x86.  If not, see <http://www.gnu.org/licenses/>.
+
+#include <gtest/gtest.h>
+
+#include <fstream>
+#include <memory>
+#include <string>
+
+#include "Memory.h"
+#include "PVDisk.h"
+#include "SoftwareCPU.h"
+#include "TempFile.h"
+
+class PVDiskTestFixture : public ::testing::Test
+{
+public:
+    PVDiskTestFixture()
+        : image("pvdisk"),
+          image_path(fill_image(image.get_path())),
+          cpu("pvdisk"),
+          mem(cpu.get_memory()),
+          disk(std::make_shared<OverlayDiskImage>(image_path, "")),
+          pv_disk(mem, disk)
+    {
+        cpu.add_ioport(&pv_disk);
+    }
+
+    // Registers are driven through the CPU's I/O ports, at the same byte
+    // offsets from the base port that the BIOS uses.
+    void write_reg(uint16_t offs, uint16_t v)
+    {
+        cpu.write_io16(pv_disk.get_base() + offs, v);
+    }
+
+    uint16_t read_reg(uint16_t offs)
+    {
+        return cpu.read_io16(pv_disk.get_base() + offs);
+    }
+
+    uint16_t transfer(uint16_t command,
+                      uint32_t lba,
+                      uint16_t count,
+                      uint16_t seg,
+                      uint16_t offs)
+    {
+        write_reg(0x4, lba & 0xffff);
+        write_reg(0x6, lba >> 16);
+        write_reg(0x8, count);
+        write_reg(0xa, seg);
+        write_reg(0xc, offs);
+        write_reg(0x0, command);
+
+        return read_reg(0x2);
+    }
+
+protected:
+    TempFile image;
+    std::string image_path;
+    SoftwareCPU cpu;
+    Memory *mem;
+    std::shared_ptr<DiskImage> disk;
+    PVDisk pv_disk;
+
+private:
+    static std::string fill_image(const std::string &path)
+    {
+        std::ofstream image(path, std::ios::binary);
+        for (unsigned m = 0; m < 4 * DiskImage::block_size; ++m)
+            image.put(static_cast<char>(m / DiskImage::block_size + 1));
+
+        return path;
+    }
+};
+
+TEST_F(PVDiskTestFixture, identifies)
+{
+    ASSERT_EQ(PVDisk::id, read_reg(0x0));
+}
+
+TEST_F(PVDiskTestFixture, read_sectors)
+{
+    ASSERT_EQ(0x1, transfer(1, 1, 2, 0x1000, 0x0010));
+
+    ASSERT_EQ(0, mem->read<uint8_t>(0x1000f));
+    ASSERT_EQ(2, mem->read<uint8_t>(0x10010));
+    ASSERT_EQ(3, mem->read<uint8_t>(0x10010 + 2 * 512 - 1));
+    ASSERT_EQ(0, mem->read<uint8_t>(0x10010 + 2 * 512));
+}
+
+TEST_F(PVDiskTestFixture, write_sectors)
+{
+    for (unsigned m = 0; m < 512; ++m)
+        mem->write<uint8_t>(0x20000 + m, 0xaa);
+
+    ASSERT_EQ(0x1, transfer(2, 3, 1, 0x2000, 0));
+
+    uint8_t v[2];
+    disk->read(3 * 512, &v[0], 1);
+    disk->read(2 * 512, &v[1], 1);
+    ASSERT_EQ(0xaa, v[0]);
+    ASSERT_EQ(3, v[1]);
+}
+
+TEST_F(PVDiskTestFixture, out_of_range_fails)
+{
+    ASSERT_EQ(0x3, transfer(1, 3, 2, 0x1000, 0));
+}
+
+TEST_F(PVDiskTestFixture, status_write_clears)
+{
+    transfer(1, 0, 1, 0x1000, 0);
+    write_reg(0x2, 0);
+
+    ASSERT_EQ(0, read_reg(0x2));
+}
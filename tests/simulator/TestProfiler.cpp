@@ -0,0 +1,131 @@
+// Copyright Jamie Iles, 2017
+//
+// This file is part of s80x86.
+//
+// s80x86 is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// s80x86 is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with s80x86.  If not, see <http://www.gnu.org/licenses/>.
+
+#include <gtest/gtest.h>
+
+#include <sstream>
+#include <string>
+
+#include "Profiler.h"
+
+TEST(SymbolTable, link_map_symbols)
+{
+    std::istringstream map(
+        "Linker script and memory map\n"
+        "\n"
+        " .text          0x000000000000c000      0x1a4 entry.S.o\n"
+        "                0x000000000000c000                bios_start = .\n"
+        "                0x000000000000c000                _start\n"
+        " .text.bios_main\n"
+        "                0x000000000000c0a0       0x52 bios.c.o\n"
+        "                0x000000000000c0a0                bios_main\n");
+    SymbolTable symbols;
+
+    symbols.load_link_map(map, SymbolTable::bios_segment);
+
+    ASSERT_EQ("", symbols.lookup(0xf000, 0xbfff));
+    ASSERT_EQ("_start", symbols.lookup(0xf000, 0xc000));
+    ASSERT_EQ("_start", symbols.lookup(0xf000, 0xc09f));
+    ASSERT_EQ("bios_main", symbols.lookup(0xf000, 0xc0a0));
+    ASSERT_EQ("", symbols.lookup(0x1000, 0xc0a0));
+}
+
+TEST(SymbolTable, nasm_map_symbols)
+{
+    std::istringstream map(
+        "- NASM Map file ----------------------------------------------\n"
+        "\n"
+        "-- Sections (summary) ---------------------------------------\n"
+        "\n"
+        "Vstart            Start             Stop              Length\n"
+        "             100               100               10C  0000000C\n"
+        "\n"
+        "-- Symbols --------------------------------------------------\n"
+        "\n"
+        "---- Section .text ------------------------------------------\n"
+        "\n"
+        "Real              Virtual           Name\n"
+        "             100               100  start\n"
+        "             105               105  wait\n");
+    SymbolTable symbols;
+
+    symbols.load_nasm_map(map, SymbolTable::any_segment);
+
+    ASSERT_EQ("", symbols.lookup(0x1234, 0xff));
+    ASSERT_EQ("start", symbols.lookup(0x1234, 0x104));
+    ASSERT_EQ("wait", symbols.lookup(0x5678, 0x10b));
+}
+
+TEST(SymbolTable, nasm_listing_labels)
+{
+    std::istringstream listing(
+        "     1                                  org 100h\n"
+        "     2                                  start:\n"
+        "     3 00000000 B8004C                      mov ax, 0x4c00\n"
+        "     4                                  .local:\n"
+        "     5 00000003 CD21                        int 0x21\n"
+        "     6 00000005 EBFE                    spin: jmp spin\n");
+    SymbolTable symbols;
+
+    symbols.load_nasm_listing(listing, 0x2000);
+
+    ASSERT_EQ("start", symbols.lookup(0x2000, 0x100));
+    ASSERT_EQ("start", symbols.lookup(0x2000, 0x103));
+    ASSERT_EQ("spin", symbols.lookup(0x2000, 0x105));
+    ASSERT_EQ("", symbols.lookup(0x3000, 0x105));
+}
+
+TEST(Profiler, folds_stacks_by_symbol)
+{
+    std::istringstream listing(
+        "     1                                  org 100h\n"
+        "     2 00000000 90                      outer: nop\n"
+        "     3 00000001 90                      inner: nop\n");
+    SymbolTable symbols;
+    symbols.load_nasm_listing(listing, SymbolTable::any_segment);
+    Profiler profiler(&symbols);
+
+    profiler.add_sample(0x1000, 0x101, {0x100});
+    profiler.add_sample(0x1000, 0x102, {0x100});
+    profiler.add_sample(0x1000, 0x100, {});
+    profiler.add_sample(0x1000, 0x101, {0x100, 0x50});
+
+    std::ostringstream out;
+    profiler.write_folded(out);
+
+    ASSERT_EQ(4LU, profiler.num_samples());
+    ASSERT_EQ("1000:0050;outer;inner 1\n"
+              "outer 1\n"
+              "outer;inner 2\n",
+              out.str());
+}
+
+TEST(Profiler, SampleCountsEveryInterval)
+{
+    SymbolTable symbols;
+    Profiler profiler(&symbols);
+
+    // A fast forwarded idle loop passes several intervals in one step.
+    profiler.add_sample(0x1000, 0x100, {}, 3);
+    profiler.add_sample(0x1000, 0x100, {});
+
+    std::ostringstream out;
+    profiler.write_folded(out);
+
+    ASSERT_EQ(4LU, profiler.num_samples());
+    ASSERT_EQ("1000:0100 4\n", out.str());
+}
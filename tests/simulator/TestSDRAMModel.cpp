@@ -0,0 +1,112 @@
+// Copyright Jamie Iles, 2017
+//
+// This file is part of s80x86.
+//
+// s80x86 is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// s80x86 is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with s80x86.  If not, see <http://www.gnu.org/licenses/>.
+
+#include <gtest/gtest.h>
+
+#include <stdexcept>
+
+#include "SDRAMModel.h"
+
+static SDRAMTiming no_refresh()
+{
+    return SDRAMTiming("refresh=0");
+}
+
+TEST(SDRAMTiming, spec_overrides_defaults)
+{
+    SDRAMTiming timing("cas=3,burst=8");
+
+    ASSERT_EQ(3, timing.cas);
+    ASSERT_EQ(8, timing.burst);
+    ASSERT_EQ(2, timing.trcd);
+    ASSERT_EQ(390LU, timing.refresh_interval);
+}
+
+TEST(SDRAMTiming, invalid_spec_throws)
+{
+    EXPECT_THROW(SDRAMTiming("cas"), std::invalid_argument);
+    EXPECT_THROW(SDRAMTiming("tras=2"), std::invalid_argument);
+    EXPECT_THROW(SDRAMTiming("banks=3"), std::invalid_argument);
+    EXPECT_THROW(SDRAMTiming("burst=0"), std::invalid_argument);
+}
+
+TEST(SDRAMTiming, refresh_interval_must_exceed_refresh_time)
+{
+    // A refresh is 10 cycles and the slowest access 7, a refresh held off
+    // by an access could otherwise run straight into the next one.
+    EXPECT_THROW(SDRAMTiming("refresh=10"), std::invalid_argument);
+    EXPECT_THROW(SDRAMTiming("refresh=17"), std::invalid_argument);
+    EXPECT_THROW(SDRAMTiming("refresh=27,trc=18"), std::invalid_argument);
+    EXPECT_NO_THROW(SDRAMTiming("refresh=0"));
+
+    // The shortest interval allowed stays within the worst case.
+    SDRAMModel sdram(SDRAMTiming("refresh=18"));
+    unsigned long cycle = 0;
+    for (uint32_t m = 0; m < 500; ++m) {
+        auto latency = sdram.access(cycle, m * 0x4000, m & 1);
+        ASSERT_LE(latency, sdram.worst_case_latency());
+        cycle += latency + 1 + m % 7;
+    }
+}
+
+TEST(SDRAMModel, row_hit_miss_and_conflict)
+{
+    SDRAMModel sdram(no_refresh());
+
+    // Closed row: activate then read.
+    ASSERT_EQ(2 + 3, sdram.access(0, 0x0000, false));
+    // Same row.
+    ASSERT_EQ(3, sdram.access(10, 0x0002, false));
+    // Same bank, different row: precharge, activate then write.
+    ASSERT_EQ(2 + 2 + 3, sdram.access(20, 0x4000, true));
+    // A different bank has its own row.
+    ASSERT_EQ(2 + 3, sdram.access(30, 0x0400, false));
+
+    ASSERT_EQ(4LU, sdram.num_accesses());
+    ASSERT_EQ(1LU, sdram.num_row_hits());
+}
+
+TEST(SDRAMModel, burst_reads_complete_in_one_cycle)
+{
+    SDRAMTiming timing("refresh=0,burst=4");
+    SDRAMModel sdram(timing);
+
+    ASSERT_EQ(5, sdram.access(0, 0x0000, false));
+    ASSERT_EQ(0, sdram.access(10, 0x0002, false));
+    ASSERT_EQ(0, sdram.access(11, 0x0006, false));
+    // The next block needs a new read command.
+    ASSERT_EQ(3, sdram.access(12, 0x0008, false));
+}
+
+TEST(SDRAMModel, refresh_closes_rows_and_stalls)
+{
+    SDRAMTiming timing("refresh=100");
+    SDRAMModel sdram(timing);
+
+    ASSERT_EQ(5, sdram.access(0, 0x0000, false));
+    // The refresh at cycle 100 occupies the device until 110.
+    ASSERT_EQ(5 + 5, sdram.access(105, 0x0002, false));
+    // Refreshes while idle don't stall.
+    ASSERT_EQ(5, sdram.access(10050, 0x0002, false));
+}
+
+TEST(SDRAMModel, worst_case_latency)
+{
+    SDRAMModel sdram(SDRAMTiming{});
+
+    ASSERT_EQ(2 + 8 + 2 + 2 + 2 + 1, sdram.worst_case_latency());
+}
@@ -0,0 +1,192 @@
+// Copyright Jamie Iles, 2017
+//
+// This file is part of s80x86.
+//
+// s80x86 is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// s80x86 is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with s80x86.  If not, see <http://www.gnu.org/licenses/>.
+
+#include <gtest/gtest.h>
+
+#include <fstream>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "SPI.h"
+#include "TempFile.h"
+
+class SPITestFixture : public ::testing::Test
+{
+public:
+    SPITestFixture()
+        : image("spi"), image_path(fill_image(image.get_path())), spi(nullptr)
+    {
+        spi = std::make_unique<SPI>(
+            std::make_unique<OverlayDiskImage>(image_path, ""));
+        // Fast clock, CS enabled.
+        spi->write16(0, 0x1);
+    }
+
+    uint8_t xfer(uint8_t v)
+    {
+        spi->write16(1, v);
+        return spi->read8(1, 0);
+    }
+
+    int command(uint8_t cmd, uint32_t arg)
+    {
+        xfer(0xff);
+        xfer(cmd);
+        for (int shift = 24; shift >= 0; shift -= 8)
+            xfer(arg >> shift);
+        xfer(0x01);
+
+        for (int m = 0; m < 8; ++m) {
+            auto r1 = xfer(0xff);
+            if (r1 != 0xff)
+                return r1;
+        }
+
+        return -1;
+    }
+
+    std::vector<uint8_t> read_data_block()
+    {
+        std::vector<uint8_t> data;
+        uint8_t token = 0xff;
+
+        for (int m = 0; m < 16 && token == 0xff; ++m)
+            token = xfer(0xff);
+        EXPECT_EQ(0xfe, token);
+
+        for (unsigned m = 0; m < DiskImage::block_size; ++m)
+            data.push_back(xfer(0xff));
+        xfer(0xff);
+        xfer(0xff);
+
+        return data;
+    }
+
+    void wait_not_busy()
+    {
+        int m;
+
+        for (m = 0; m < 16 && xfer(0xff) != 0xff; ++m)
+            continue;
+        ASSERT_LT(m, 16);
+    }
+
+protected:
+    TempFile image;
+    std::string image_path;
+    std::unique_ptr<SPI> spi;
+
+private:
+    static std::string fill_image(const std::string &path)
+    {
+        std::ofstream image(path, std::ios::binary);
+        for (unsigned m = 0; m < 8 * DiskImage::block_size; ++m)
+            image.put(static_cast<char>(m / DiskImage::block_size));
+
+        return path;
+    }
+};
+
+TEST_F(SPITestFixture, read_multiple_blocks)
+{
+    ASSERT_EQ(0x00, command(0x52, 2 * DiskImage::block_size));
+
+    for (uint8_t b = 2; b < 5; ++b)
+        ASSERT_EQ(std::vector<uint8_t>(DiskImage::block_size, b),
+                  read_data_block());
+
+    // STOP_TRANSMISSION, discarding the stuff byte.
+    xfer(0x4c);
+    for (int m = 0; m < 5; ++m)
+        xfer(0x00);
+    xfer(0xff);
+    int r1 = 0xff;
+    for (int m = 0; m < 8 && r1 == 0xff; ++m)
+        r1 = xfer(0xff);
+    ASSERT_EQ(0x00, r1);
+    wait_not_busy();
+
+    // Back to accepting commands.
+    ASSERT_EQ(0x00, command(0x52, 7 * DiskImage::block_size));
+    ASSERT_EQ(std::vector<uint8_t>(DiskImage::block_size, 7),
+              read_data_block());
+}
+
+TEST_F(SPITestFixture, write_multiple_blocks)
+{
+    ASSERT_EQ(0x00, command(0x59, 1 * DiskImage::block_size));
+
+    for (uint8_t b = 0xa0; b < 0xa2; ++b) {
+        xfer(0xff);
+        xfer(0xfc);
+        for (unsigned m = 0; m < DiskImage::block_size; ++m)
+            xfer(b);
+        xfer(0x00);
+        xfer(0x00);
+
+        uint8_t response = 0xff;
+        for (int m = 0; m < 8 && response == 0xff; ++m)
+            response = xfer(0xff);
+        ASSERT_EQ(0x05, response & 0x1f);
+        wait_not_busy();
+    }
+
+    // Stop tran token, stuff byte, busy.
+    xfer(0xfd);
+    xfer(0xff);
+    wait_not_busy();
+
+    ASSERT_EQ(0x00, command(0x52, 0));
+    for (uint8_t b : {0x00, 0xa0, 0xa1, 0x03})
+        ASSERT_EQ(std::vector<uint8_t>(DiskImage::block_size, b),
+                  read_data_block());
+}
+
+TEST_F(SPITestFixture, read_multiple_blocks_across_ring_wrap)
+{
+    auto pattern = [](uint8_t b) {
+        std::vector<uint8_t> v;
+        for (unsigned m = 0; m < DiskImage::block_size; ++m)
+            v.push_back(static_cast<uint8_t>(m * 7 + b));
+        return v;
+    };
+
+    ASSERT_EQ(0x00, command(0x59, 0));
+    for (uint8_t b = 0; b < 4; ++b) {
+        xfer(0xff);
+        xfer(0xfc);
+        for (auto v : pattern(b))
+            xfer(v);
+        xfer(0x00);
+        xfer(0x00);
+
+        uint8_t response = 0xff;
+        for (int m = 0; m < 8 && response == 0xff; ++m)
+            response = xfer(0xff);
+        ASSERT_EQ(0x05, response & 0x1f);
+        wait_not_busy();
+    }
+    xfer(0xfd);
+    xfer(0xff);
+    wait_not_busy();
+
+    // Later blocks are queued behind the earlier ones and wrap the ring.
+    ASSERT_EQ(0x00, command(0x52, 0));
+    for (uint8_t b = 0; b < 4; ++b)
+        ASSERT_EQ(pattern(b), read_data_block());
+}
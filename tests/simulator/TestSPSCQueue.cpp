@@ -0,0 +1,86 @@
+// Copyright Jamie Iles, 2017
+//
+// This file is part of s80x86.
+//
+// s80x86 is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// s80x86 is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with s80x86.  If not, see <http://www.gnu.org/licenses/>.
+
+#include <gtest/gtest.h>
+
+#include <stdexcept>
+#include <thread>
+
+#include "SPSCQueue.h"
+
+TEST(SPSCQueue, PushPop)
+{
+    SPSCQueue<int> q(4);
+    int v = 0;
+
+    ASSERT_TRUE(q.empty());
+    ASSERT_FALSE(q.pop(v));
+
+    ASSERT_TRUE(q.push(1));
+    ASSERT_TRUE(q.push(2));
+    ASSERT_FALSE(q.empty());
+
+    ASSERT_TRUE(q.pop(v));
+    ASSERT_EQ(1, v);
+    ASSERT_TRUE(q.pop(v));
+    ASSERT_EQ(2, v);
+    ASSERT_TRUE(q.empty());
+}
+
+TEST(SPSCQueue, Full)
+{
+    SPSCQueue<int> q(2);
+    int v = 0;
+
+    ASSERT_TRUE(q.push(1));
+    ASSERT_TRUE(q.push(2));
+    ASSERT_FALSE(q.push(3));
+
+    ASSERT_TRUE(q.pop(v));
+    ASSERT_TRUE(q.push(3));
+    ASSERT_TRUE(q.pop(v));
+    ASSERT_EQ(2, v);
+    ASSERT_TRUE(q.pop(v));
+    ASSERT_EQ(3, v);
+}
+
+TEST(SPSCQueue, CapacityPowerOfTwo)
+{
+    EXPECT_THROW(SPSCQueue<int>(3), std::invalid_argument);
+}
+
+TEST(SPSCQueue, CrossThreadOrdering)
+{
+    SPSCQueue<unsigned> q(16);
+    const unsigned num_values = 10000;
+
+    std::thread producer([&] {
+        for (unsigned m = 0; m < num_values; ++m)
+            while (!q.push(m))
+                std::this_thread::yield();
+    });
+
+    for (unsigned expected = 0; expected < num_values;) {
+        unsigned v;
+        if (q.pop(v))
+            ASSERT_EQ(expected++, v);
+        else
+            std::this_thread::yield();
+    }
+
+    producer.join();
+}
@@ -0,0 +1,84 @@
+// Copyright Jamie Iles, 2017
+//
+// This file is part of s80x86.
+//
+// s80x86 is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// s80x86 is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with s80x86.  If not, see <http://www.gnu.org/licenses/>.
+
+#include <gtest/gtest.h>
+
+#include <vector>
+
+#include "Scheduler.h"
+
+TEST(Scheduler, DispatchesInDeadlineOrder)
+{
+    Scheduler scheduler;
+    std::vector<int> fired;
+
+    auto a = scheduler.add_event([&](unsigned long) { fired.push_back(0); });
+    auto b = scheduler.add_event([&](unsigned long) { fired.push_back(1); });
+
+    scheduler.schedule(a, 20);
+    scheduler.schedule(b, 10);
+    ASSERT_EQ(10LU, scheduler.next_event());
+
+    scheduler.advance(9);
+    ASSERT_TRUE(fired.empty());
+
+    scheduler.advance(25);
+    ASSERT_EQ(std::vector<int>({1, 0}), fired);
+    ASSERT_FALSE(scheduler.is_scheduled(a));
+    ASSERT_FALSE(scheduler.is_scheduled(b));
+}
+
+TEST(Scheduler, CallbackGetsDeadline)
+{
+    Scheduler scheduler;
+    unsigned long deadline = 0;
+
+    auto e = scheduler.add_event([&](unsigned long d) { deadline = d; });
+    scheduler.schedule(e, 100);
+    scheduler.advance(150);
+
+    ASSERT_EQ(100LU, deadline);
+}
+
+TEST(Scheduler, Cancel)
+{
+    Scheduler scheduler;
+    bool fired = false;
+
+    auto e = scheduler.add_event([&](unsigned long) { fired = true; });
+    scheduler.schedule(e, 100);
+    scheduler.cancel(e);
+    scheduler.advance(100);
+
+    ASSERT_FALSE(fired);
+}
+
+TEST(Scheduler, PeriodicEventsDoNotDrift)
+{
+    Scheduler scheduler;
+    std::vector<unsigned long> fired;
+
+    scheduler.add_periodic_event(
+        1000, [&](unsigned long d) { fired.push_back(d); });
+
+    scheduler.advance(1500);
+    scheduler.advance(2999);
+    scheduler.advance(3001);
+
+    // The late dispatch of the first event doesn't move the second.
+    ASSERT_EQ(std::vector<unsigned long>({1000, 2000, 3000}), fired);
+}
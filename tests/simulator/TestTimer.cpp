@@ -0,0 +1,206 @@
+// Copyright Jamie Iles, 2017
+//
+// This file is part of s80x86.
+//
+// s80x86 is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// s80x86 is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with s80x86.  If not, see <http://www.gnu.org/licenses/>.
+
+#include <gtest/gtest.h>
+
+#include <sstream>
+
+#include <boost/archive/text_iarchive.hpp>
+#include <boost/archive/text_oarchive.hpp>
+
+#include "PIC.h"
+#include "Scheduler.h"
+#include "SoftwareCPU.h"
+#include "Timer.h"
+
+class TimerTestFixture : public ::testing::Test
+{
+public:
+    TimerTestFixture()
+        : cpu("timer"),
+          scheduler(),
+          pic(&cpu),
+          timer(&pic, &scheduler, 50000000)
+    {
+    }
+
+    void program(int channel, int mode, uint16_t reload)
+    {
+        timer.write8(2, 1, (channel << 6) | (3 << 4) | (mode << 1));
+        write_data(channel, reload & 0xff);
+        write_data(channel, reload >> 8);
+    }
+
+    uint16_t latch_and_read(int channel)
+    {
+        timer.write8(2, 1, channel << 6);
+        uint16_t v = read_data(channel);
+        return v | (static_cast<uint16_t>(read_data(channel)) << 8);
+    }
+
+    bool irq0_pending()
+    {
+        return pic.read8(0, 0) & 0x1;
+    }
+
+protected:
+    void write_data(int channel, uint8_t v)
+    {
+        timer.write8(channel & ~1, channel & 1, v);
+    }
+
+    uint8_t read_data(int channel)
+    {
+        return timer.read8(channel & ~1, channel & 1);
+    }
+
+    SoftwareCPU cpu;
+    Scheduler scheduler;
+    PIC pic;
+    TimerTick timer;
+};
+
+// The first cycle at which the timer has counted the given number of ticks of
+// its 1.193182MHz clock with a 50MHz CPU.
+static unsigned long ticks_to_cycles(unsigned long ticks)
+{
+    return (ticks * 50000000 + 1193182 - 1) / 1193182;
+}
+
+TEST_F(TimerTestFixture, RateGeneratorRaisesIRQ)
+{
+    program(0, 2, 100);
+
+    scheduler.advance(ticks_to_cycles(100) - 1);
+    ASSERT_FALSE(irq0_pending());
+
+    scheduler.advance(ticks_to_cycles(100));
+    ASSERT_TRUE(irq0_pending());
+    ASSERT_EQ(ticks_to_cycles(200), scheduler.next_event());
+}
+
+TEST_F(TimerTestFixture, CounterComputedFromCycle)
+{
+    program(0, 2, 100);
+
+    scheduler.advance(ticks_to_cycles(50));
+    ASSERT_EQ(50, latch_and_read(0));
+
+    // Reads after the period has wrapped continue from the reload value.
+    scheduler.advance(ticks_to_cycles(125));
+    ASSERT_EQ(75, latch_and_read(0));
+}
+
+TEST_F(TimerTestFixture, LatchHoldsValue)
+{
+    program(0, 2, 100);
+
+    scheduler.advance(ticks_to_cycles(50));
+    timer.write8(2, 1, 0x00);
+    scheduler.advance(ticks_to_cycles(75));
+
+    uint16_t v = read_data(0);
+    v |= static_cast<uint16_t>(read_data(0)) << 8;
+    ASSERT_EQ(50, v);
+    ASSERT_EQ(25, latch_and_read(0));
+}
+
+TEST_F(TimerTestFixture, InterruptOnTerminalCountIsOneShot)
+{
+    unsigned long never = Scheduler::never;
+
+    program(0, 0, 100);
+    ASSERT_FALSE(timer.output(0));
+
+    scheduler.advance(ticks_to_cycles(100));
+    ASSERT_TRUE(irq0_pending());
+    ASSERT_TRUE(timer.output(0));
+    ASSERT_EQ(never, scheduler.next_event());
+}
+
+TEST_F(TimerTestFixture, SquareWaveOutput)
+{
+    program(0, 3, 100);
+
+    ASSERT_TRUE(timer.output(0));
+    scheduler.advance(ticks_to_cycles(25));
+    ASSERT_TRUE(timer.output(0));
+    scheduler.advance(ticks_to_cycles(75));
+    ASSERT_FALSE(timer.output(0));
+
+    scheduler.advance(ticks_to_cycles(100));
+    ASSERT_TRUE(irq0_pending());
+    ASSERT_TRUE(timer.output(0));
+}
+
+TEST_F(TimerTestFixture, Channel2Gated)
+{
+    program(2, 0, 100);
+
+    // The speaker gate is low out of reset so the count is held.
+    scheduler.advance(ticks_to_cycles(200));
+    ASSERT_EQ(100, latch_and_read(2));
+    ASSERT_FALSE(timer.output(2));
+
+    timer.set_gate(2, true);
+    scheduler.advance(ticks_to_cycles(200) + ticks_to_cycles(50));
+    ASSERT_EQ(50, latch_and_read(2));
+    ASSERT_FALSE(timer.output(2));
+
+    scheduler.advance(ticks_to_cycles(200) + ticks_to_cycles(100));
+    ASSERT_TRUE(timer.output(2));
+    // Only channel 0 is connected to the PIC.
+    ASSERT_FALSE(irq0_pending());
+}
+
+TEST_F(TimerTestFixture, ReprogramCancelsIRQ)
+{
+    unsigned long never = Scheduler::never;
+
+    program(0, 2, 100);
+    timer.write8(2, 1, (3 << 4) | (2 << 1));
+
+    ASSERT_EQ(never, scheduler.next_event());
+}
+
+TEST_F(TimerTestFixture, OverdueIRQFiresAfterRestore)
+{
+    std::stringstream snapshot;
+
+    // A single advance can pass several deadlines, the snapshot is taken by
+    // an earlier event while the terminal count IRQ is still pending.
+    program(0, 0, 100);
+    auto save_event = scheduler.add_event([&](unsigned long) {
+        boost::archive::text_oarchive oa(snapshot);
+        oa << timer;
+    });
+    scheduler.schedule(save_event, ticks_to_cycles(50));
+    scheduler.advance(ticks_to_cycles(200));
+    ASSERT_TRUE(irq0_pending());
+
+    Scheduler restored_scheduler;
+    PIC restored_pic(&cpu);
+    TimerTick restored_timer(&restored_pic, &restored_scheduler, 50000000);
+    {
+        boost::archive::text_iarchive ia(snapshot);
+        ia >> restored_timer;
+    }
+
+    ASSERT_EQ(0LU, restored_scheduler.next_event());
+    restored_scheduler.advance(0);
+    ASSERT_TRUE(restored_pic.read8(0, 0) & 0x1);
+}
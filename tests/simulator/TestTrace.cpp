@@ -0,0 +1,225 @@
+// Copyright Jamie Iles, 2017
+//
+// This file is part of s80x86.
+//
+// s80x86 is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// s80x86 is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with s80x86.  If not, see <http://www.gnu.org/licenses/>.
+
+#include <gtest/gtest.h>
+
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "TempFile.h"
+#include "Trace.h"
+
+class TraceTestFixture : public ::testing::Test
+{
+public:
+    TraceTestFixture() : file("trace"), path(file.get_path())
+    {
+    }
+
+    std::vector<TraceRecord> round_trip(const std::vector<TraceRecord> &in,
+                                        bool compress,
+                                        bool side_effects)
+    {
+        {
+            TraceWriter writer(path, compress, side_effects);
+            for (auto &r : in)
+                writer.write(r);
+        }
+
+        TraceReader reader(path);
+        std::vector<TraceRecord> out;
+        TraceRecord r;
+        while (reader.next(&r))
+            out.push_back(r);
+
+        return out;
+    }
+
+    static TraceRecord record(unsigned long index,
+                              uint16_t cs,
+                              uint16_t ip,
+                              std::vector<uint8_t> bytes)
+    {
+        TraceRecord r;
+
+        r.index = index;
+        r.cs = cs;
+        r.ip = ip;
+        r.bytes = bytes;
+
+        return r;
+    }
+
+protected:
+    TempFile file;
+    std::string path;
+};
+
+TEST_F(TraceTestFixture, locations_round_trip)
+{
+    std::vector<TraceRecord> in = {
+        record(0, 0xf000, 0xfff0, {0xea, 0x5b, 0xe0, 0x00, 0xf0}),
+        record(1, 0xf000, 0xe05b, {0x90}), record(2, 0xf000, 0xe05c, {0x90}),
+        record(10, 0x0070, 0x0100, {0xeb, 0xfe}),
+        record(11, 0x0070, 0x0100, {0xeb, 0xfe}),
+    };
+
+    for (auto compress : {false, true}) {
+        auto out = round_trip(in, compress, false);
+
+        ASSERT_EQ(in.size(), out.size());
+        for (size_t m = 0; m < in.size(); ++m) {
+            EXPECT_EQ(in[m].index, out[m].index);
+            EXPECT_EQ(in[m].cs, out[m].cs);
+            EXPECT_EQ(in[m].ip, out[m].ip);
+            EXPECT_EQ(in[m].bytes, out[m].bytes);
+            EXPECT_EQ(0, out[m].changed);
+        }
+    }
+}
+
+TEST_F(TraceTestFixture, side_effects_round_trip)
+{
+    auto first = record(0, 0, 0x100, {0xb8, 0x34, 0x12});
+    first.registers[AX] = 0x1234;
+    first.flags = 0xf002;
+    auto second = record(1, 0, 0x103, {0xa3, 0x00, 0x04});
+    second.registers[AX] = 0x1234;
+    second.flags = 0xf002;
+    second.writes.push_back({0x400, 2, 0x1234});
+
+    auto out = round_trip({first, second}, false, true);
+
+    ASSERT_EQ(2U, out.size());
+    EXPECT_EQ((1 << AX) | (1 << NUM_16BIT_REGS), out[0].changed);
+    EXPECT_EQ(0x1234, out[0].registers[AX]);
+    EXPECT_EQ(0xf002, out[0].flags);
+    EXPECT_TRUE(out[0].writes.empty());
+
+    EXPECT_EQ(0, out[1].changed);
+    EXPECT_EQ(0x1234, out[1].registers[AX]);
+    ASSERT_EQ(1U, out[1].writes.size());
+    EXPECT_EQ(0x400U, out[1].writes[0].addr);
+    EXPECT_EQ(2U, out[1].writes[0].width);
+    EXPECT_EQ(0x1234U, out[1].writes[0].value);
+}
+
+TEST_F(TraceTestFixture, sequential_records_are_compact)
+{
+    std::vector<TraceRecord> in;
+    for (unsigned m = 0; m < 1000; ++m)
+        in.push_back(record(m, 0x1000, m, {0x90}));
+
+    round_trip(in, false, false);
+
+    FILE *f = fopen(path.c_str(), "rb");
+    ASSERT_NE(nullptr, f);
+    fseek(f, 0, SEEK_END);
+    auto size = ftell(f);
+    fclose(f);
+
+    // Header, then a tag and a byte per nop.
+    EXPECT_LT(size, 16 + 2 * 1000 + 8);
+}
+
+TEST_F(TraceTestFixture, truncated_trace_throws)
+{
+    round_trip({record(0, 0x1000, 0, {0xb8, 0x34, 0x12})}, false, false);
+    ASSERT_EQ(0, truncate(path.c_str(), 16 + 2));
+
+    TraceReader reader(path);
+    TraceRecord r;
+    ASSERT_THROW(reader.next(&r), std::runtime_error);
+}
+
+TEST(TraceFilter, window)
+{
+    TraceFilter filter;
+    filter.set_window(10, 5);
+
+    EXPECT_FALSE(filter.accept(9, 0, 0));
+    EXPECT_TRUE(filter.accept(10, 0, 0));
+    EXPECT_TRUE(filter.accept(14, 0, 0));
+    EXPECT_FALSE(filter.finished(14));
+    EXPECT_FALSE(filter.accept(15, 0, 0));
+    EXPECT_TRUE(filter.finished(15));
+}
+
+TEST(TraceFilter, range)
+{
+    TraceFilter filter;
+    filter.set_range("f000:e000-e0ff");
+
+    EXPECT_TRUE(filter.accept(0, 0xf000, 0xe000));
+    EXPECT_TRUE(filter.accept(1, 0xf000, 0xe0ff));
+    EXPECT_FALSE(filter.accept(2, 0xf000, 0xe100));
+    EXPECT_FALSE(filter.accept(3, 0xf001, 0xe000));
+    EXPECT_FALSE(filter.finished(1000000));
+}
+
+TEST(TraceFilter, invalid_range_throws)
+{
+    TraceFilter filter;
+
+    ASSERT_THROW(filter.set_range("f000:e000"), std::invalid_argument);
+    ASSERT_THROW(filter.set_range("f000:e100-e000"), std::invalid_argument);
+    ASSERT_THROW(filter.set_range("f000:e000-e100x"), std::invalid_argument);
+}
+
+class CountingObserver : public MemoryObserver
+{
+public:
+    CountingObserver() : reads(0), writes(0)
+    {
+    }
+
+    void access(phys_addr __unused addr,
+                unsigned __unused width,
+                bool write,
+                uint32_t __unused value)
+    {
+        ++(write ? writes : reads);
+    }
+
+    unsigned reads;
+    unsigned writes;
+};
+
+TEST(TraceWriteLog, records_writes_and_forwards)
+{
+    Memory mem;
+    std::vector<MemoryWrite> writes;
+    TraceWriteLog log(&writes);
+    CountingObserver next;
+
+    mem.set_observer(&log);
+    mem.write<uint16_t>(0x100, 0x1234);
+    log.set_next(&next);
+    mem.write<uint8_t>(0x200, 0x56);
+    mem.read<uint16_t>(0x100);
+
+    ASSERT_EQ(2LU, writes.size());
+    EXPECT_EQ(0x100U, writes[0].addr);
+    EXPECT_EQ(2U, writes[0].width);
+    EXPECT_EQ(0x1234U, writes[0].value);
+    EXPECT_EQ(0x200U, writes[1].addr);
+    EXPECT_EQ(1U, writes[1].width);
+    EXPECT_EQ(0x56U, writes[1].value);
+    EXPECT_EQ(1U, next.writes);
+    EXPECT_EQ(1U, next.reads);
+}
@@ -0,0 +1,150 @@
+// Copyright Jamie Iles, 2017
+//
+// This file is part of s80x86.
+//
+// s80x86 is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// s80x86 is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with s80x86.  If not, see <http://www.gnu.org/licenses/>.
+
+#include <gtest/gtest.h>
+
+#include <initializer_list>
+#include <memory>
+#include <string>
+
+#include "PIC.h"
+#include "SoftwareCPU.h"
+#include "UART.h"
+
+class FakeSerialBackend : public SerialBackend
+{
+public:
+    explicit FakeSerialBackend(std::string *output) : output(output)
+    {
+    }
+
+    size_t read(uint8_t * /* buf */, size_t /* len */)
+    {
+        return 0;
+    }
+
+    void write(const uint8_t *buf, size_t len)
+    {
+        output->append(reinterpret_cast<const char *>(buf), len);
+    }
+
+    int poll_fd()
+    {
+        return -1;
+    }
+
+private:
+    std::string *output;
+};
+
+class UARTTestFixture : public ::testing::Test
+{
+public:
+    UARTTestFixture()
+        : cpu("uart"),
+          pic(&cpu),
+          output(),
+          uart(std::make_unique<FakeSerialBackend>(&output),
+               &pic,
+               4,
+               1000)
+    {
+    }
+
+    void putstr(const std::string &s)
+    {
+        for (auto c : s)
+            uart.write8(0, 0, c);
+    }
+
+    void receive(std::initializer_list<uint8_t> bytes)
+    {
+        for (auto b : bytes)
+            ASSERT_TRUE(uart.host_rx_queue()->push(b));
+    }
+
+protected:
+    SoftwareCPU cpu;
+    PIC pic;
+    std::string output;
+    UART uart;
+};
+
+TEST_F(UARTTestFixture, tx_flushed_on_newline)
+{
+    putstr("hello");
+    ASSERT_EQ("", output);
+
+    putstr(" world\n");
+    ASSERT_EQ("hello world\n", output);
+}
+
+TEST_F(UARTTestFixture, tx_flushed_after_interval)
+{
+    putstr("$ ");
+    uart.service(999);
+    ASSERT_EQ("", output);
+
+    uart.service(1000);
+    ASSERT_EQ("$ ", output);
+}
+
+TEST_F(UARTTestFixture, rx_fifo_in_order)
+{
+    receive({'a', 'b'});
+    uart.service(0);
+
+    ASSERT_EQ(0x1, uart.read8(0, 1));
+    ASSERT_EQ('a', uart.read8(0, 0));
+    ASSERT_EQ('b', uart.read8(0, 0));
+    ASSERT_EQ(0x0, uart.read8(0, 1));
+}
+
+TEST_F(UARTTestFixture, exit_char_not_queued)
+{
+    receive({0x1d});
+    uart.service(0);
+
+    ASSERT_TRUE(uart.exit_requested());
+    ASSERT_EQ(0x0, uart.read8(0, 1));
+}
+
+TEST_F(UARTTestFixture, rx_irq_only_when_enabled)
+{
+    receive({'a'});
+    uart.service(0);
+    ASSERT_EQ(0, pic.read8(0, 0) & (1 << 4));
+
+    uart.write8(0, 1, 0x1);
+    ASSERT_NE(0, pic.read8(0, 0) & (1 << 4));
+}
+
+TEST_F(UARTTestFixture, rx_drained_as_fifo_has_room)
+{
+    for (auto m = 0; m < 257; ++m)
+        ASSERT_TRUE(uart.host_rx_queue()->push('a' + m % 26));
+    uart.service(0);
+
+    // The FIFO holds 256 bytes, the last stays queued until there is room.
+    for (auto m = 0; m < 256; ++m)
+        ASSERT_EQ('a' + m % 26, uart.read8(0, 0));
+    ASSERT_EQ(0x0, uart.read8(0, 1));
+
+    uart.service(1);
+    ASSERT_EQ(0x1, uart.read8(0, 1));
+    ASSERT_EQ('a' + 256 % 26, uart.read8(0, 0));
+}